@@ -9,6 +9,7 @@
 #include "main.h"
 #include "deca_device_api.h"
 #include "deca_regs.h"
+#include "deca_spi.h"
 
 
 /*! ----------------------------------------------------------------------------
@@ -102,42 +103,6 @@ void port_set_dw1000_fastrate(void)
 //    return 0;
 //} // end writetospi()
 
-//This is a new WriteSPI form my friend Beacon.
-#pragma GCC optimize ("03")
-int writetospi(uint16 headerLength,
-			   const uint8 *headerBuffer,
-			   uint32 bodyLength,
-			   const uint8 *bodyBuffer)
-{
-	decaIrqStatus_t stat;
-	stat = decamutexon();
-
-	uint8_t headBuf[headerLength];
-	for (int i = 0; i < headerLength; ++i) {
-		headBuf[i] = headerBuffer[i];
-	}
-	uint8_t bodyBuf[bodyLength];
-	for (int i = 0; i < bodyLength; ++i) {
-		bodyBuf[i] = bodyBuffer[i];
-	}
-
-	HAL_GPIO_WritePin(DW_NSS_GPIO_Port, DW_NSS_Pin, GPIO_PIN_RESET);
-
-	HAL_SPI_Transmit(&hspi1, headBuf, headerLength, 5);
-//	HAL_SPI_Transmit(&hspi1, headBuf, headerLength, HAL_MAX_DELAY);
-	while(HAL_SPI_GetState(&hspi1) == HAL_SPI_STATE_BUSY) {}
-
-	HAL_SPI_Transmit(&hspi1, bodyBuf, bodyLength, 5);
-//	HAL_SPI_Transmit(&hspi1, bodyBuf, bodyLength, HAL_MAX_DELAY);
-	while(HAL_SPI_GetState(&hspi1) == HAL_SPI_STATE_BUSY) {}
-
-	HAL_GPIO_WritePin(DW_NSS_GPIO_Port, DW_NSS_Pin, GPIO_PIN_SET);
-
-	decamutexoff(stat);
-	return 0;
-}
-
-
 /*! ------------------------------------------------------------------------------------------------------------------
  * Function: readfromspi()
  *
@@ -200,40 +165,225 @@ int writetospi(uint16 headerLength,
 //} // end readfromspi()
 
 
-// This is a new READSPI form my friend Beacon.
+#define SPI_TIMEOUT_MS	5
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: stm32_writetospi()
+ *
+ * Polled STM32 HAL backend of writetospi(), see deca_spi.h
+ * Takes two separate byte buffers for write header and write data
+ * Both buffers are clocked out directly from the caller's memory: the HAL only
+ * reads from pData in transmit mode, so no staging copy is needed.
+ * returns 0 for success, or -1 for error
+ */
 #pragma GCC optimize ("O3")
-int readfromspi(uint16 headerLength, const uint8 *headerBuffer, uint32 readlength, uint8 *readBuffer) {
+static int stm32_writetospi(void *ctx,
+							uint16 headerLength,
+							const uint8 *headerBuffer,
+							uint32 bodyLength,
+							const uint8 *bodyBuffer)
+{
 	decaIrqStatus_t stat;
+	int ret = 0;
+
 	stat = decamutexon();
 
-	uint8_t headBuf[headerLength]; //make a copy
-	for (int i = 0; i < headerLength; ++i)
+	HAL_GPIO_WritePin(DW_NSS_GPIO_Port, DW_NSS_Pin, GPIO_PIN_RESET);
+
+	/* HAL_SPI_Transmit() is blocking and returns with the bus idle and the RX FIFO drained */
+	if (HAL_SPI_Transmit(&hspi1, (uint8_t *)headerBuffer, headerLength, SPI_TIMEOUT_MS) != HAL_OK)
 	{
-		headBuf[i] = headerBuffer[i];
+		ret = -1;
 	}
+	else if (bodyLength != 0 &&
+			 HAL_SPI_Transmit(&hspi1, (uint8_t *)bodyBuffer, bodyLength, SPI_TIMEOUT_MS) != HAL_OK)
+	{
+		ret = -1;
+	}
+
+	HAL_GPIO_WritePin(DW_NSS_GPIO_Port, DW_NSS_Pin, GPIO_PIN_SET);
+
+	decamutexoff(stat);
+	return ret;
+} // end stm32_writetospi()
+
 
-	for (int i = 0; i < readlength; ++i)
+/* Wait, at most until SPI_TIMEOUT_MS after 'tickstart', for 'flag' of the SR register to read 'set'.
+ * Returns 0, or -1 on timeout. */
+static int spi_wait_flag(SPI_TypeDef *spi, uint32 flag, int set, uint32_t tickstart)
+{
+	while (((spi->SR & flag) != 0) != set)
 	{
-		readBuffer[i] = 0;
+		if ((HAL_GetTick() - tickstart) > SPI_TIMEOUT_MS)
+		{
+			return -1;
+		}
 	}
+	return 0;
+}
 
-	HAL_GPIO_WritePin(DW_NSS_GPIO_Port, DW_NSS_Pin, GPIO_PIN_RESET);
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: stm32_readfromspi()
+ *
+ * Polled STM32 HAL backend of readfromspi(), see deca_spi.h
+ * Takes two separate byte buffers for write header and read data
+ * The header is sent straight from the caller's buffer. The data phase does not
+ * use HAL_SPI_Receive(): in full-duplex master mode it clocks the contents of the
+ * receive buffer out on MOSI, which is why readBuffer previously had to be zeroed
+ * first. Instead 0x00 is written to DR for every byte (as the DW1000 needs for
+ * dwt_spicswakeup()) and the received byte lands directly in readBuffer.
+ * Like the write path, a bus that stays busy for SPI_TIMEOUT_MS fails the read
+ * rather than hanging with the DW1000 interrupt masked.
+ * returns 0 for success, or -1 for error
+ */
+#pragma GCC optimize ("O3")
+static int stm32_readfromspi(void *ctx,
+							 uint16 headerLength,
+							 const uint8 *headerBuffer,
+							 uint32 readlength,
+							 uint8 *readBuffer)
+{
+	decaIrqStatus_t stat;
+	SPI_TypeDef *spi = hspi1.Instance;
+	uint32_t tickstart;
+	uint32 i;
+	int ret = 0;
+
+	stat = decamutexon();
 
-	HAL_SPI_Transmit(&hspi1, headBuf, headerLength, 5);
-//	HAL_SPI_Transmit(&hspi1, headBuf, headerLength, HAL_MAX_DELAY);
-	while(HAL_SPI_GetState(&hspi1) == HAL_SPI_STATE_BUSY) {}
+	HAL_GPIO_WritePin(DW_NSS_GPIO_Port, DW_NSS_Pin, GPIO_PIN_RESET);
 
-	HAL_SPI_Receive(&hspi1, readBuffer, readlength, 5);
-//	HAL_SPI_Receive(&hspi1, readBuffer, readlength, HAL_MAX_DELAY);
-	while(HAL_SPI_GetState(&hspi1) == HAL_SPI_STATE_BUSY) {}
+	if (HAL_SPI_Transmit(&hspi1, (uint8_t *)headerBuffer, headerLength, SPI_TIMEOUT_MS) != HAL_OK)
+	{
+		ret = -1;
+	}
+	else
+	{
+		/* 8-bit accesses to DR so the FIFO packs/unpacks exactly one byte per frame. The timeout runs per byte: a
+		 * long read at the slow rate takes longer than SPI_TIMEOUT_MS in all. */
+		for (i = 0; i < readlength && ret == 0; i++)
+		{
+			tickstart = HAL_GetTick();
+			ret = spi_wait_flag(spi, SPI_FLAG_TXE, 1, tickstart);
+			if (ret == 0)
+			{
+				*(__IO uint8_t *)&spi->DR = 0;
+				ret = spi_wait_flag(spi, SPI_FLAG_RXNE, 1, tickstart);
+			}
+			if (ret == 0)
+			{
+				readBuffer[i] = *(__IO uint8_t *)&spi->DR;
+			}
+		}
+		if (ret == 0)
+		{
+			ret = spi_wait_flag(spi, SPI_FLAG_BSY, 0, HAL_GetTick());
+		}
+	}
 
 	HAL_GPIO_WritePin(DW_NSS_GPIO_Port, DW_NSS_Pin, GPIO_PIN_SET);
 
 	decamutexoff(stat);
 
-	return 0;
+	return ret;
+} // end stm32_readfromspi()
+
+const deca_spi_backend_t deca_spi_stm32 =
+{
+	"stm32",
+	stm32_writetospi,
+	stm32_readfromspi,
+	NULL
+};
+
+
+#ifdef DWM_SPI_USE_DMA
+/*
+ * STM32 hooks for the DMA transport in spi_dma.c. hspi1 must have its TX and RX
+ * DMA channels linked in CubeMX, and the DMA interrupts must be of higher
+ * priority than the DW1000 EXTI line (see spi_dma.c).
+ */
+#include "spi_dma.h"
+
+#define SPI_DMA_RX_CHUNK	(128)	// read phase is clocked out of this zero buffer
+
+static const uint8_t spi_dma_zeros[SPI_DMA_RX_CHUNK];
+
+void spi_dma_port_cs(int asserted)
+{
+	HAL_GPIO_WritePin(DW_NSS_GPIO_Port, DW_NSS_Pin, asserted ? GPIO_PIN_RESET : GPIO_PIN_SET);
+}
+
+uint32 spi_dma_port_start_tx(const uint8 *buf, uint32 len)
+{
+	if (len > 0xFFFF)
+	{
+		len = 0xFFFF;
+	}
+	return (HAL_SPI_Transmit_DMA(&hspi1, (uint8_t *)buf, (uint16_t)len) == HAL_OK) ? len : 0;
+}
+
+uint32 spi_dma_port_start_rx(uint8 *buf, uint32 len)
+{
+	/* HAL_SPI_Receive_DMA() would send the buffer contents on MOSI, so transmit zeros explicitly */
+	if (len > SPI_DMA_RX_CHUNK)
+	{
+		len = SPI_DMA_RX_CHUNK;
+	}
+	return (HAL_SPI_TransmitReceive_DMA(&hspi1, (uint8_t *)spi_dma_zeros, buf, (uint16_t)len) == HAL_OK) ? len : 0;
+}
+
+static uint32_t spi_dma_primask;
+static uint32_t spi_dma_lock_depth;
+
+void spi_dma_port_lock(void)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	if (spi_dma_lock_depth++ == 0)
+	{
+		spi_dma_primask = primask;
+	}
+}
+
+void spi_dma_port_unlock(void)
+{
+	if (--spi_dma_lock_depth == 0 && spi_dma_primask == 0)
+	{
+		__enable_irq();
+	}
+}
+
+void spi_dma_port_wait(void)
+{
+	/* nothing to do, the completion interrupt advances the queue */
+}
+
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+	if (hspi == &hspi1)
+	{
+		spi_dma_complete(DWT_SUCCESS);
+	}
+}
+
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+	if (hspi == &hspi1)
+	{
+		spi_dma_complete(DWT_SUCCESS);
+	}
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+{
+	if (hspi == &hspi1)
+	{
+		spi_dma_complete(DWT_ERROR);
+	}
 }
+#endif /* DWM_SPI_USE_DMA */
 
 
 
@@ -35,6 +35,25 @@ void leds(int led_mode);
  */
 void deca_sleep(unsigned int time_ms);
 
+/* SPI transfer counters, filled by writetospi()/readfromspi() when built with DWM_SPI_STATS */
+typedef struct
+{
+    uint32_t transactions;  // number of chip-select cycles
+    uint32_t header_bytes;  // register header bytes (1..3 per transaction)
+    uint32_t tx_bytes;      // payload bytes written
+    uint32_t rx_bytes;      // payload bytes read
+} dwm_spi_stats_t;
+
+void dwm_spi_stats_get(dwm_spi_stats_t *stats);
+void dwm_spi_stats_reset(void);
+
+#ifdef DWM_SPI_STATS
+void dwm_spi_stats_add(uint32_t header, uint32_t tx, uint32_t rx);
+#define DWM_SPI_STATS_ADD(hdr, tx, rx)  dwm_spi_stats_add((hdr), (tx), (rx))
+#else
+#define DWM_SPI_STATS_ADD(hdr, tx, rx)  do { } while (0)
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,128 @@
+/*! ----------------------------------------------------------------------------
+ * @file    deca_spi.c
+ * @brief   writetospi()/readfromspi() dispatch to the active SPI backend
+ *
+ *          The SPI transfer counters of DWM_functions.h, and those of
+ *          twr_trace.h, are kept here, so they count the same way whichever
+ *          backend is in use.
+ */
+
+#include <string.h>
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+#include "DWM_functions.h"
+#include "deca_spi.h"
+#include "twr_trace.h"
+
+#if defined(DECA_SPI_NO_DEFAULT_BACKEND)
+static const deca_spi_backend_t *backend = NULL;
+#elif defined(DWM_SPI_USE_DMA)
+static const deca_spi_backend_t *backend = &deca_spi_dma;
+#else
+static const deca_spi_backend_t *backend = &deca_spi_stm32;
+#endif
+
+#ifdef DWM_SPI_STATS
+static dwm_spi_stats_t spi_stats;
+#endif
+
+void deca_spi_set_backend(const deca_spi_backend_t *b)
+{
+    backend = b;
+}
+
+const deca_spi_backend_t *deca_spi_get_backend(void)
+{
+    return backend;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: writetospi()
+ *
+ * Low level abstract function to write to the SPI, see deca_device_api.h
+ * returns 0 for success, or -1 for error
+ */
+int writetospi(uint16 headerLength, const uint8 *headerBuffer, uint32 bodyLength, const uint8 *bodyBuffer)
+{
+    const deca_spi_backend_t *b = backend;
+    decaIrqStatus_t stat;
+    int ret;
+
+    if (b == NULL)
+    {
+        return DWT_ERROR;
+    }
+
+    /* Under the mutex, so that an access from dwt_isr() cannot interrupt the counting */
+    stat = decamutexon();
+    DWM_SPI_STATS_ADD(headerLength, bodyLength, 0);
+    TWR_TRACE_SPI(headerLength, bodyLength, 0);
+    ret = b->write(b->ctx, headerLength, headerBuffer, bodyLength, bodyBuffer);
+    decamutexoff(stat);
+
+    return ret;
+} // end writetospi()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: readfromspi()
+ *
+ * Low level abstract function to read from the SPI, see deca_device_api.h
+ * returns the offset into read buffer where first byte of read data may be found,
+ * or returns 0
+ */
+int readfromspi(uint16 headerLength, const uint8 *headerBuffer, uint32 readLength, uint8 *readBuffer)
+{
+    const deca_spi_backend_t *b = backend;
+    decaIrqStatus_t stat;
+    int ret;
+
+    if (b == NULL)
+    {
+        return DWT_ERROR;
+    }
+
+    stat = decamutexon();
+    DWM_SPI_STATS_ADD(headerLength, 0, readLength);
+    TWR_TRACE_SPI(headerLength, 0, readLength);
+    ret = b->read(b->ctx, headerLength, headerBuffer, readLength, readBuffer);
+    decamutexoff(stat);
+
+    return ret;
+} // end readfromspi()
+
+
+/*
+ * SPI transfer accounting. Every call of writetospi()/readfromspi() is one
+ * chip-select cycle, so the counters give the number of SPI transactions and
+ * the bytes clocked in each direction. Build with DWM_SPI_STATS to enable.
+ */
+#ifdef DWM_SPI_STATS
+void dwm_spi_stats_add(uint32_t header, uint32_t tx, uint32_t rx)
+{
+    spi_stats.transactions++;
+    spi_stats.header_bytes += header;
+    spi_stats.tx_bytes += tx;
+    spi_stats.rx_bytes += rx;
+}
+#endif
+
+void dwm_spi_stats_get(dwm_spi_stats_t *stats)
+{
+#ifdef DWM_SPI_STATS
+    decaIrqStatus_t stat = decamutexon();
+    *stats = spi_stats;
+    decamutexoff(stat);
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+void dwm_spi_stats_reset(void)
+{
+#ifdef DWM_SPI_STATS
+    decaIrqStatus_t stat = decamutexon();
+    memset(&spi_stats, 0, sizeof(spi_stats));
+    decamutexoff(stat);
+#endif
+}
@@ -0,0 +1,53 @@
+/*! ----------------------------------------------------------------------------
+ * @file    deca_spi.h
+ * @brief   Pluggable SPI backend for the decadriver
+ *
+ *          writetospi()/readfromspi() (deca_device_api.h) dispatch to the active
+ *          backend. On the board this is the polled STM32 HAL implementation, or
+ *          the DMA transport when built with DWM_SPI_USE_DMA. On Linux it is the
+ *          DW1000 register-file emulator in Host/dw1000_emu.c.
+ */
+
+#ifndef DECA_SPI_H_
+#define DECA_SPI_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+
+typedef struct
+{
+    const char *name;
+    /* Same contract as writetospi()/readfromspi(), ctx is the backend's own context */
+    int (*write)(void *ctx, uint16 headerLength, const uint8 *headerBuffer, uint32 bodyLength, const uint8 *bodyBuffer);
+    int (*read)(void *ctx, uint16 headerLength, const uint8 *headerBuffer, uint32 readLength, uint8 *readBuffer);
+    void *ctx;
+} deca_spi_backend_t;
+
+/* Backends provided by DWM_platform */
+extern const deca_spi_backend_t deca_spi_stm32;     // DWM_functions.c, polled HAL
+extern const deca_spi_backend_t deca_spi_dma;       // spi_dma.c, DMA queue, with DWM_SPI_USE_DMA
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn deca_spi_set_backend()
+ *
+ * @brief Select the backend used by writetospi()/readfromspi(). Must not be called while an SPI
+ *        access is in progress. Without a call the build default is used: deca_spi_stm32, or
+ *        deca_spi_dma with DWM_SPI_USE_DMA, or none with DECA_SPI_NO_DEFAULT_BACKEND (host builds).
+ *
+ * input parameters
+ * @param backend - backend to use, NULL to detach (accesses then fail with DWT_ERROR)
+ *
+ * no return value
+ */
+void deca_spi_set_backend(const deca_spi_backend_t *backend);
+
+const deca_spi_backend_t *deca_spi_get_backend(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DECA_SPI_H_ */
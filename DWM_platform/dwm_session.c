@@ -0,0 +1,130 @@
+/*! ----------------------------------------------------------------------------
+ * @file    dwm_session.c
+ * @brief   Persistent DW1000 session for the ranging examples, see dwm_session.h
+ */
+
+#include <string.h>
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+#include "DWM_functions.h"
+#include "dwm_session.h"
+
+static int same_config(const dwt_config_t *a, const dwt_config_t *b)
+{
+    return a->chan == b->chan && a->prf == b->prf && a->txPreambLength == b->txPreambLength &&
+           a->rxPAC == b->rxPAC && a->txCode == b->txCode && a->rxCode == b->rxCode &&
+           a->nsSFD == b->nsSFD && a->dataRate == b->dataRate && a->phrMode == b->phrMode &&
+           a->sfdTO == b->sfdTO;
+}
+
+int dwm_session_open(dwm_session_t *s, const dwm_session_cfg_t *cfg)
+{
+    dwt_regimage_t image;
+    int changed = 0, reconfigured = 0;
+
+    if (!s->open)
+    {
+        s->config = *cfg->config;
+        if (dwt_compileconfig(&s->config, &s->image) == DWT_ERROR)
+        {
+            return DWT_ERROR;
+        }
+
+        /* Reset and initialise DW1000.
+         * For initialisation, DW1000 clocks must be temporarily set to crystal speed. After initialisation SPI rate can be increased for optimum
+         * performance. */
+        deca_reset(); /* Target specific drive of RSTn line into DW1000 low for a period. */
+
+        port_set_dw1000_slowrate();
+
+        if (dwt_initialise(DWT_LOADUCODE) == DWT_ERROR)
+        {
+            return DWT_ERROR;
+        }
+
+        port_set_dw1000_fastrate();
+
+        dwt_applyconfig(&s->image);
+
+        dwt_settxantennadelay(cfg->txAntDly);
+        dwt_setrxantennadelay(cfg->rxAntDly);
+        dwt_setrxaftertxdelay(cfg->rxAfterTxDelay);
+        dwt_setrxtimeout(cfg->rxTimeout);
+        dwt_setpreambledetecttimeout(cfg->preambleTimeout);
+
+        s->cfg = *cfg;
+        s->cfg.config = &s->config;
+        s->open = 1;
+        s->stats.full_inits++;
+        return DWT_SUCCESS;
+    }
+
+    if (!same_config(cfg->config, &s->config))
+    {
+        /* Another radio configuration: only the registers that differ from the applied one */
+        if (dwt_compileconfig(cfg->config, &image) == DWT_ERROR)
+        {
+            return DWT_ERROR;
+        }
+        dwt_switchconfig(&s->image, &image);
+        s->image = image;
+        s->config = *cfg->config;
+        s->stats.reconfigs++;
+        reconfigured = 1;
+    }
+
+    /* Only write the settings that differ */
+    if (cfg->txAntDly != s->cfg.txAntDly)
+    {
+        dwt_settxantennadelay(cfg->txAntDly);
+        changed = 1;
+    }
+    if (cfg->rxAntDly != s->cfg.rxAntDly)
+    {
+        dwt_setrxantennadelay(cfg->rxAntDly);
+        changed = 1;
+    }
+    if (cfg->rxAfterTxDelay != s->cfg.rxAfterTxDelay)
+    {
+        dwt_setrxaftertxdelay(cfg->rxAfterTxDelay);
+        changed = 1;
+    }
+    if (cfg->rxTimeout != s->cfg.rxTimeout)
+    {
+        dwt_setrxtimeout(cfg->rxTimeout);
+        changed = 1;
+    }
+    if (cfg->preambleTimeout != s->cfg.preambleTimeout)
+    {
+        dwt_setpreambledetecttimeout(cfg->preambleTimeout);
+        changed = 1;
+    }
+
+    s->cfg = *cfg;
+    s->cfg.config = &s->config;
+    if (changed && !reconfigured)
+    {
+        s->stats.updates++;
+    }
+    else if (!reconfigured)
+    {
+        s->stats.reuses++;
+    }
+    return DWT_SUCCESS;
+}
+
+void dwm_session_close(dwm_session_t *s)
+{
+    s->open = 0;
+}
+
+int dwm_session_is_open(const dwm_session_t *s)
+{
+    return s->open;
+}
+
+void dwm_session_get_stats(const dwm_session_t *s, dwm_session_stats_t *stats)
+{
+    *stats = s->stats;
+}
@@ -0,0 +1,93 @@
+/*! ----------------------------------------------------------------------------
+ * @file    dwm_session.h
+ * @brief   Persistent DW1000 session for the ranging examples
+ *
+ *          The initiators used to hard reset and fully initialise the DW1000 on
+ *          every anchor round: deca_reset(), slow rate dwt_initialise() with OTP
+ *          reads and LDE microcode load, then dwt_configure(). The session does
+ *          that once. The chip keeps its configuration between rounds, so
+ *          dwm_session_open() on an open session with the same settings costs no
+ *          SPI access. A round then only writes its frame (addresses and
+ *          sequence number) and starts the exchange.
+ *
+ *          A different radio configuration on an open session is written over
+ *          the current one, without the reset: dwt_switchconfig() only sends
+ *          the registers that differ between the two compiled configurations.
+ *
+ *          One dwm_session_t per DW1000. The session only knows about the
+ *          settings it wrote itself: after changing them elsewhere, or after
+ *          a reset or sleep, call dwm_session_close().
+ */
+
+#ifndef DWM_SESSION_H_
+#define DWM_SESSION_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+
+typedef struct
+{
+    const dwt_config_t *config;         // radio configuration, see dwt_configure()
+    uint16              txAntDly;       // see dwt_settxantennadelay()
+    uint16              rxAntDly;       // see dwt_setrxantennadelay()
+    uint32              rxAfterTxDelay; // UUS, see dwt_setrxaftertxdelay()
+    uint16              rxTimeout;      // UUS, 0 disables, see dwt_setrxtimeout()
+    uint16              preambleTimeout;// PACs, 0 disables, see dwt_setpreambledetecttimeout()
+} dwm_session_cfg_t;
+
+typedef struct
+{
+    uint32  full_inits;     // reset + dwt_initialise() + dwt_configure()
+    uint32  reconfigs;      // open with another radio configuration, written over the current one
+    uint32  updates;        // open with only timing/antenna settings changed
+    uint32  reuses;         // open with nothing to do
+} dwm_session_stats_t;
+
+typedef struct
+{
+    uint8               open;
+    dwt_config_t        config;     // copy of the applied radio configuration
+    dwt_regimage_t      image;      // the same, compiled, see dwt_compileconfig()
+    dwm_session_cfg_t   cfg;        // applied settings, .config points to config above
+    dwm_session_stats_t stats;
+} dwm_session_t;
+
+/* Static initialiser of a closed session */
+#define DWM_SESSION_INIT    { 0 }
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwm_session_open()
+ *
+ * @brief Make sure the DW1000 is initialised and configured as described by cfg.
+ *        - first call or after dwm_session_close(): full reset and initialisation
+ *        - a different radio configuration: the registers it changes, see dwt_switchconfig()
+ *        - the antenna delays or the RX delay/timeouts differ: those registers are written
+ *        - same settings: nothing is done
+ *        The session keeps a copy of *cfg->config.
+ *
+ * input parameters
+ * @param s   - session of the device
+ * @param cfg - session settings
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS, or DWT_ERROR if dwt_initialise() failed (the session is then closed)
+ */
+int dwm_session_open(dwm_session_t *s, const dwm_session_cfg_t *cfg);
+
+/* Forget the device state, e.g. after the DW1000 has been reset or put to sleep. The next open fully initialises. */
+void dwm_session_close(dwm_session_t *s);
+
+int dwm_session_is_open(const dwm_session_t *s);
+
+void dwm_session_get_stats(const dwm_session_t *s, dwm_session_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DWM_SESSION_H_ */
@@ -53,6 +53,34 @@ portGetTickCnt(void)
 }
 
 
+/* @fn    port_cycles_init
+ * @brief start the DWT cycle counter of the core, for port_cycles()
+ * */
+void port_cycles_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/* @fn    port_cycles
+ * @brief core clock cycles since port_cycles_init(), wraps every
+ *        2^32 / port_cycles_hz() s (67 s at 64 MHz)
+ * */
+uint32_t port_cycles(void)
+{
+    return DWT->CYCCNT;
+}
+
+/* @fn    port_cycles_hz
+ * @brief rate of port_cycles()
+ * */
+uint32_t port_cycles_hz(void)
+{
+    return SystemCoreClock;
+}
+
+
 /* @fn    usleep
  * @brief precise usleep() delay
  * */
@@ -367,6 +395,15 @@ __INLINE uint32_t port_CheckEXT_IRQ(void)
 }
 
 
+/* @fn      port_wait_for_irq
+ * @brief   sleep until an interrupt, e.g. the DW1000 IRQ, has been serviced
+ * */
+void port_wait_for_irq(void)
+{
+    __WFI();
+}
+
+
 /****************************************************************************//**
  *
  *                              END OF IRQ section
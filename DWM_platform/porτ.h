@@ -169,6 +169,11 @@ typedef int64_t         int64 ;
 //void Sleep(uint32_t Delay);
 unsigned long portGetTickCnt(void);
 
+/* DWT cycle counter of the core, for timing code, see port.c */
+void port_cycles_init(void);
+uint32_t port_cycles(void);
+uint32_t port_cycles_hz(void);
+
 #define S1_SWITCH_ON  (1)
 #define S1_SWITCH_OFF (0)
 //when switch (S1) is 'on' the pin is low
@@ -210,6 +215,7 @@ uint32_t port_GetEXT_IRQStatus(void);
 uint32_t port_CheckEXT_IRQ(void);
 void port_DisableEXT_IRQ(void);
 void port_EnableEXT_IRQ(void);
+void port_wait_for_irq(void);
 extern uint32_t     HAL_GetTick(void);
 HAL_StatusTypeDef   flush_report_buff(void);
 
@@ -0,0 +1,328 @@
+/*! ----------------------------------------------------------------------------
+ * @file    spi_dma.c
+ * @brief   Non-blocking, DMA driven SPI transport for the DW1000 driver
+ *
+ *          Descriptors live in a ring of SPI_DMA_QUEUE_LEN entries. The head is
+ *          only moved by the submitter, the tail only by the completion path, so
+ *          the lock is needed just to decide who starts an idle engine.
+ *
+ *          Sequence for one descriptor, each step started from the completion of
+ *          the previous one:
+ *              NSS low -> header (tx) -> body (tx, or rx in chunks) -> NSS high -> callback
+ *
+ *          Built only with DWM_SPI_USE_DMA, the build that defines the
+ *          spi_dma_port_xxx() hooks.
+ */
+
+#include <string.h>
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+#include "deca_spi.h"
+#include "spi_dma.h"
+
+#ifdef DWM_SPI_USE_DMA
+
+#define SPI_DMA_WRITE       (0)
+#define SPI_DMA_READ        (1)
+
+#define PHASE_HEADER        (0)
+#define PHASE_BODY          (1)
+
+typedef struct
+{
+    uint8           header[SPI_DMA_MAX_HEADER];
+    uint8           headerLength;
+    uint8           dir;
+    uint8           phase;
+    const uint8    *txBuffer;
+    uint8          *rxBuffer;
+    uint32          length;     // body length
+    uint32          done;       // body bytes transferred so far
+    uint32          chunk;      // body bytes of the DMA transfer in progress
+    spi_dma_cb_t    cb;
+    void           *arg;
+} spi_dma_xfer_t;
+
+static spi_dma_xfer_t   queue[SPI_DMA_QUEUE_LEN];
+static volatile uint32  head;       // next free slot, written by the submitter
+static volatile uint32  tail;       // descriptor in flight, written by the completion path
+static volatile uint8   running;    // DMA engine owns queue[tail]
+static spi_dma_stats_t  stats;
+
+#define QUEUE_MASK          (SPI_DMA_QUEUE_LEN - 1)
+#define QUEUE_DEPTH()       (head - tail)   // free-running counters, wrap is harmless
+
+#if (SPI_DMA_QUEUE_LEN & QUEUE_MASK) != 0
+#error "SPI_DMA_QUEUE_LEN must be a power of 2"
+#endif
+
+static void spi_dma_start_body(spi_dma_xfer_t *x);
+static void spi_dma_finish(spi_dma_xfer_t *x, int status);
+
+/* Start queue[tail], called with the engine idle */
+static void spi_dma_start(void)
+{
+    spi_dma_xfer_t *x = &queue[tail & QUEUE_MASK];
+
+    running = 1;
+    x->phase = PHASE_HEADER;
+    x->done = 0;
+
+    spi_dma_port_cs(1);
+    stats.dma_starts++;
+    if (spi_dma_port_start_tx(x->header, x->headerLength) != x->headerLength)
+    {
+        spi_dma_finish(x, DWT_ERROR);
+    }
+}
+
+static void spi_dma_start_body(spi_dma_xfer_t *x)
+{
+    uint32 left = x->length - x->done;
+
+    x->phase = PHASE_BODY;
+    stats.dma_starts++;
+    if (x->dir == SPI_DMA_WRITE)
+    {
+        x->chunk = spi_dma_port_start_tx(x->txBuffer + x->done, left);
+    }
+    else
+    {
+        x->chunk = spi_dma_port_start_rx(x->rxBuffer + x->done, left);
+    }
+
+    if (x->chunk == 0)
+    {
+        spi_dma_finish(x, DWT_ERROR);
+    }
+}
+
+static void spi_dma_finish(spi_dma_xfer_t *x, int status)
+{
+    spi_dma_cb_t cb = x->cb;
+    void *arg = x->arg;
+
+    spi_dma_port_cs(0);
+
+    stats.completed++;
+    if (status != DWT_SUCCESS)
+    {
+        stats.errors++;
+    }
+
+    // Release the slot before the callback so that it may queue the next access
+    tail++;
+    running = 0;
+
+    if (cb != NULL)
+    {
+        cb(arg, status);
+    }
+
+    if (!running && QUEUE_DEPTH() != 0)
+    {
+        spi_dma_start();
+    }
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spi_dma_complete()
+ *
+ * @brief Advance the descriptor in flight, see spi_dma.h
+ */
+void spi_dma_complete(int status)
+{
+    spi_dma_xfer_t *x;
+
+    if (!running)
+    {
+        return;
+    }
+    x = &queue[tail & QUEUE_MASK];
+
+    if (status != DWT_SUCCESS)
+    {
+        spi_dma_finish(x, DWT_ERROR);
+        return;
+    }
+
+    if (x->phase == PHASE_BODY)
+    {
+        x->done += x->chunk;
+    }
+
+    if (x->done < x->length)
+    {
+        spi_dma_start_body(x);
+    }
+    else
+    {
+        spi_dma_finish(x, DWT_SUCCESS);
+    }
+}
+
+static int spi_dma_submit(uint8 dir, uint16 headerLength, const uint8 *headerBuffer, uint32 length,
+                          const uint8 *txBuffer, uint8 *rxBuffer, spi_dma_cb_t cb, void *arg)
+{
+    spi_dma_xfer_t *x;
+    uint32 depth;
+
+    if (headerLength == 0 || headerLength > SPI_DMA_MAX_HEADER)
+    {
+        return DWT_ERROR;
+    }
+
+    spi_dma_port_lock();
+
+    if (QUEUE_DEPTH() >= SPI_DMA_QUEUE_LEN)
+    {
+        stats.rejected++;
+        spi_dma_port_unlock();
+        return DWT_ERROR;
+    }
+
+    x = &queue[head & QUEUE_MASK];
+    memcpy(x->header, headerBuffer, headerLength);
+    x->headerLength = (uint8)headerLength;
+    x->dir = dir;
+    x->txBuffer = txBuffer;
+    x->rxBuffer = rxBuffer;
+    x->length = length;
+    x->cb = cb;
+    x->arg = arg;
+    head++;
+
+    stats.submitted++;
+    depth = QUEUE_DEPTH();
+    if (depth > stats.max_depth)
+    {
+        stats.max_depth = depth;
+    }
+
+    if (!running)
+    {
+        spi_dma_start();
+    }
+
+    spi_dma_port_unlock();
+    return DWT_SUCCESS;
+}
+
+int spi_dma_write(uint16 headerLength, const uint8 *headerBuffer, uint32 bodyLength, const uint8 *bodyBuffer,
+                  spi_dma_cb_t cb, void *arg)
+{
+    return spi_dma_submit(SPI_DMA_WRITE, headerLength, headerBuffer, bodyLength, bodyBuffer, NULL, cb, arg);
+}
+
+int spi_dma_read(uint16 headerLength, const uint8 *headerBuffer, uint32 readLength, uint8 *readBuffer,
+                 spi_dma_cb_t cb, void *arg)
+{
+    return spi_dma_submit(SPI_DMA_READ, headerLength, headerBuffer, readLength, NULL, readBuffer, cb, arg);
+}
+
+uint32 spi_dma_pending(void)
+{
+    return QUEUE_DEPTH();
+}
+
+void spi_dma_flush(void)
+{
+    while (QUEUE_DEPTH() != 0)
+    {
+        spi_dma_port_wait();
+    }
+}
+
+void spi_dma_get_stats(spi_dma_stats_t *s)
+{
+    spi_dma_port_lock();
+    *s = stats;
+    spi_dma_port_unlock();
+}
+
+void spi_dma_reset_stats(void)
+{
+    spi_dma_port_lock();
+    memset(&stats, 0, sizeof(stats));
+    spi_dma_port_unlock();
+}
+
+
+/****************************************************************************************************************************************************
+ *
+ * Blocking backend for writetospi()/readfromspi() (deca_spi.h): submit and wait for completion
+ *
+ * NB: the DW1000 driver may access the SPI from dwt_isr(), so the DMA interrupt must have a
+ * higher priority than the DW1000 EXTI line or the wait below never ends.
+ *
+ ****************************************************************************************************************************************************/
+
+static void spi_dma_blocking_done(void *arg, int status)
+{
+    *(volatile int *)arg = status;
+}
+
+static int spi_dma_wait(volatile int *result)
+{
+    while (*result == SPI_DMA_PENDING)
+    {
+        spi_dma_port_wait();
+    }
+    return *result;
+}
+
+static int spi_dma_writetospi(void *ctx, uint16 headerLength, const uint8 *headerBuffer, uint32 bodyLength, const uint8 *bodyBuffer)
+{
+    volatile int result = SPI_DMA_PENDING;
+    decaIrqStatus_t stat;
+
+    (void)ctx;
+    stat = decamutexon();
+    if (spi_dma_write(headerLength, headerBuffer, bodyLength, bodyBuffer, spi_dma_blocking_done, (void *)&result) != DWT_SUCCESS)
+    {
+        // queue full of asynchronous accesses: let it drain and try once more
+        spi_dma_flush();
+        if (spi_dma_write(headerLength, headerBuffer, bodyLength, bodyBuffer, spi_dma_blocking_done, (void *)&result) != DWT_SUCCESS)
+        {
+            decamutexoff(stat);
+            return DWT_ERROR;
+        }
+    }
+    spi_dma_wait(&result);
+    decamutexoff(stat);
+
+    return result;
+} // end spi_dma_writetospi()
+
+static int spi_dma_readfromspi(void *ctx, uint16 headerLength, const uint8 *headerBuffer, uint32 readLength, uint8 *readBuffer)
+{
+    volatile int result = SPI_DMA_PENDING;
+    decaIrqStatus_t stat;
+
+    (void)ctx;
+    stat = decamutexon();
+    if (spi_dma_read(headerLength, headerBuffer, readLength, readBuffer, spi_dma_blocking_done, (void *)&result) != DWT_SUCCESS)
+    {
+        spi_dma_flush();
+        if (spi_dma_read(headerLength, headerBuffer, readLength, readBuffer, spi_dma_blocking_done, (void *)&result) != DWT_SUCCESS)
+        {
+            decamutexoff(stat);
+            return DWT_ERROR;
+        }
+    }
+    spi_dma_wait(&result);
+    decamutexoff(stat);
+
+    return result;
+} // end spi_dma_readfromspi()
+
+const deca_spi_backend_t deca_spi_dma =
+{
+    "dma",
+    spi_dma_writetospi,
+    spi_dma_readfromspi,
+    NULL
+};
+
+#endif /* DWM_SPI_USE_DMA */
@@ -0,0 +1,134 @@
+/*! ----------------------------------------------------------------------------
+ * @file    spi_dma.h
+ * @brief   Non-blocking, DMA driven SPI transport for the DW1000 driver
+ *
+ *          Register accesses are queued as (header, body) descriptors and run
+ *          back to back by the DMA engine. Each descriptor is framed by its own
+ *          chip-select cycle and completes with a callback, in submission order.
+ *          The deca_spi_dma backend (deca_spi.h) provides the blocking
+ *          writetospi()/readfromspi() used by deca_device.c as thin
+ *          submit-and-wait wrappers on top; it is the default backend when
+ *          built with DWM_SPI_USE_DMA.
+ *
+ *          The platform supplies the spi_dma_port_xxx() hooks below: DWM_functions.c
+ *          for the STM32 HAL, Host/spi_dma_mock.c for the Linux mock engine.
+ */
+
+#ifndef SPI_DMA_H_
+#define SPI_DMA_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+
+#define SPI_DMA_QUEUE_LEN       (8)     // descriptors in flight, must be a power of 2
+#define SPI_DMA_MAX_HEADER      (3)     // DW1000 header is 1 to 3 bytes
+#define SPI_DMA_PENDING         (1)     // status of a descriptor not yet completed
+
+/* Completion callback, status is DWT_SUCCESS or DWT_ERROR.
+ * NB: on the target this is called from the DMA interrupt. */
+typedef void (*spi_dma_cb_t)(void *arg, int status);
+
+typedef struct
+{
+    uint32  submitted;      // descriptors accepted
+    uint32  completed;      // descriptors completed (with or without error)
+    uint32  errors;         // descriptors completed with DWT_ERROR
+    uint32  rejected;       // submissions refused because the queue was full
+    uint32  dma_starts;     // individual DMA transfers started (header + body chunks)
+    uint32  max_depth;      // high water mark of the queue
+} spi_dma_stats_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spi_dma_write()
+ *
+ * @brief Queue a write of headerLength header bytes followed by bodyLength bytes of body.
+ *        The header is copied into the descriptor, the body is sent from the caller's buffer
+ *        which must stay valid until the callback has run.
+ *
+ * input parameters
+ * @param headerLength - number of header bytes (at most SPI_DMA_MAX_HEADER)
+ * @param headerBuffer - header bytes
+ * @param bodyLength   - number of body bytes
+ * @param bodyBuffer   - body bytes
+ * @param cb           - completion callback, may be NULL
+ * @param arg          - argument passed to cb
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS if queued, DWT_ERROR if the queue is full or the header too long
+ */
+int spi_dma_write(uint16 headerLength, const uint8 *headerBuffer, uint32 bodyLength, const uint8 *bodyBuffer,
+                  spi_dma_cb_t cb, void *arg);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spi_dma_read()
+ *
+ * @brief Queue a write of the header followed by a read of readLength bytes into readBuffer.
+ *        MOSI is held at 0 during the read phase.
+ *
+ * input parameters
+ * @param headerLength - number of header bytes (at most SPI_DMA_MAX_HEADER)
+ * @param headerBuffer - header bytes
+ * @param readLength   - number of bytes to read
+ * @param readBuffer   - destination, must stay valid until the callback has run
+ * @param cb           - completion callback, may be NULL
+ * @param arg          - argument passed to cb
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS if queued, DWT_ERROR if the queue is full or the header too long
+ */
+int spi_dma_read(uint16 headerLength, const uint8 *headerBuffer, uint32 readLength, uint8 *readBuffer,
+                 spi_dma_cb_t cb, void *arg);
+
+/* Number of descriptors queued or in flight */
+uint32 spi_dma_pending(void);
+
+/* Block until the queue has drained */
+void spi_dma_flush(void);
+
+void spi_dma_get_stats(spi_dma_stats_t *stats);
+void spi_dma_reset_stats(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spi_dma_complete()
+ *
+ * @brief To be called by the platform when the transfer started by spi_dma_port_start_tx()/_rx() has finished.
+ *
+ * input parameters
+ * @param status - DWT_SUCCESS or DWT_ERROR
+ *
+ * no return value
+ */
+void spi_dma_complete(int status);
+
+/****************************************************************************************************************************************************
+ *
+ * Platform hooks
+ *
+ ****************************************************************************************************************************************************/
+
+/* Drive the DW1000 chip select, asserted != 0 means NSS low */
+void spi_dma_port_cs(int asserted);
+
+/* Start a transmit-only DMA transfer. Returns the number of bytes started (may be less than len), 0 on error */
+uint32 spi_dma_port_start_tx(const uint8 *buf, uint32 len);
+
+/* Start a DMA read clocking out zeros. Returns the number of bytes started (may be less than len), 0 on error */
+uint32 spi_dma_port_start_rx(uint8 *buf, uint32 len);
+
+/* Mask / unmask the DMA completion interrupt around queue updates */
+void spi_dma_port_lock(void);
+void spi_dma_port_unlock(void);
+
+/* Called while a blocking caller waits for its descriptor (e.g. sleep until interrupt, or run the mock engine) */
+void spi_dma_port_wait(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPI_DMA_H_ */
@@ -0,0 +1,71 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_cir.c
+ * @brief   Channel impulse responses sent with the range reports, see twr_cir.h
+ */
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+#include "twr_report.h"
+#include "twr_cir.h"
+
+void twr_cir_arm(twr_cir_t *c, const twr_range_report_t *r, uint8 prf)
+{
+    if (++c->reports % TWR_CIR_PERIOD != 0)
+    {
+        return;
+    }
+    c->due = 1;
+    c->prf = prf;
+    c->seq = r->seq;
+    c->fp_index = r->quality.fp_index;
+}
+
+int twr_cir_capture(twr_cir_t *c, uint8 node)
+{
+    uint8 buf[1 + 4 * TWR_CIR_CHUNK];   // the first byte read is a dummy, see dwt_readaccdata()
+    twr_cir_report_t r;
+    uint16 len = (c->prf == DWT_PRF_64M) ? TWR_CIR_LEN_PRF64 : TWR_CIR_LEN_PRF16;
+    uint16 first = c->fp_index >> 6;
+    uint16 start, done, n, i;
+    const uint8 *s;
+
+    if (!c->due)
+    {
+        return DWT_SUCCESS;
+    }
+    c->due = 0;
+
+    /* All or none, so the host never gets half a capture */
+    if (TWR_REPORT_QUEUE_SIZE - 1 - twr_report_pending() < TWR_CIR_PIECES * TWR_RPT_CIR_FRAME(TWR_CIR_CHUNK))
+    {
+        c->skipped++;
+        return DWT_ERROR;
+    }
+
+    /* The window, kept inside the accumulator */
+    start = (first > TWR_CIR_BEFORE) ? first - TWR_CIR_BEFORE : 0;
+    if (start + TWR_CIR_SAMPLES > len)
+    {
+        start = len - TWR_CIR_SAMPLES;
+    }
+
+    r.node = node;
+    r.pieces = TWR_CIR_PIECES;
+    r.seq = c->seq;
+    r.fp_index = c->fp_index;
+    for (r.piece = 0, done = 0; done < TWR_CIR_SAMPLES; r.piece++, done += n)
+    {
+        n = (TWR_CIR_SAMPLES - done < TWR_CIR_CHUNK) ? TWR_CIR_SAMPLES - done : TWR_CIR_CHUNK;
+        dwt_readaccdata(buf, (uint16)(1 + 4 * n), (uint16)(4 * (start + done)));
+        r.start = start + done;
+        r.count = (uint8)n;
+        for (i = 0, s = &buf[1]; i < n; i++, s += 4)
+        {
+            r.re[i] = (int16)(s[0] | (s[1] << 8));
+            r.im[i] = (int16)(s[2] | (s[3] << 8));
+        }
+        twr_report_cir(&r);
+    }
+    c->captures++;
+    return DWT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_cir.h
+ * @brief   Channel impulse responses sent with the range reports
+ *
+ *          The worst distances come from frames whose direct path is
+ *          blocked (NLOS): the first path detected is weak, or is a
+ *          reflection. The accumulator of the DW1000 holds the channel
+ *          impulse response (CIR) of the last frame received, and its shape
+ *          around the first path tells these cases apart offline.
+ *
+ *          An engine with TWR_FLAG_CIR captures, for one range report in
+ *          every TWR_CIR_PERIOD, the TWR_CIR_SAMPLES accumulator samples
+ *          from TWR_CIR_BEFORE before the first path index of the frame
+ *          (dwt_rxdiag_t firstPath). The capture runs once the exchange has
+ *          ended, before the receiver is turned back on, so that no frame
+ *          overwrites the accumulator and no exchange waits for it. It
+ *          reads TWR_CIR_CHUNK samples per SPI transaction, and each chunk
+ *          goes out on the report stream as one delta coded CIR frame (see
+ *          twr_report.h), so neither the SPI buffer nor a frame grows with
+ *          the window. A capture is only read if all its frames fit in the
+ *          report queue, a slow USB skips captures, never range reports.
+ *
+ *          The default window costs 4 SPI reads of 65 bytes. Host/cir_store.c
+ *          writes the captures to a file for batch analysis.
+ */
+
+#ifndef TWR_CIR_H_
+#define TWR_CIR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+#include "twr_report.h"
+
+/* A capture every this many range reports */
+#ifndef TWR_CIR_PERIOD
+#define TWR_CIR_PERIOD          10
+#endif
+
+/* Window: samples before the first path index, and in all */
+#ifndef TWR_CIR_BEFORE
+#define TWR_CIR_BEFORE          16
+#endif
+#ifndef TWR_CIR_SAMPLES
+#define TWR_CIR_SAMPLES         64
+#endif
+
+/* Samples per SPI read and per CIR frame */
+#ifndef TWR_CIR_CHUNK
+#define TWR_CIR_CHUNK           16
+#endif
+
+#if TWR_CIR_CHUNK > TWR_RPT_CIR_MAX_SAMPLES
+#error "TWR_CIR_CHUNK must not exceed TWR_RPT_CIR_MAX_SAMPLES"
+#endif
+
+/* CIR frames of a capture */
+#define TWR_CIR_PIECES          ((TWR_CIR_SAMPLES + TWR_CIR_CHUNK - 1) / TWR_CIR_CHUNK)
+
+/* Accumulator samples of a frame at each PRF, 4 bytes each */
+#define TWR_CIR_LEN_PRF16       992
+#define TWR_CIR_LEN_PRF64       1016
+
+typedef struct
+{
+    uint8       due;            // the accumulator holds the frame of a report to capture
+    uint8       prf;            // of that frame
+    uint16      seq;            // range report of that frame
+    uint16      fp_index;       // first path index of that frame, 10.6 fixed point
+    uint32      reports;        // range reports seen
+    uint32      captures;       // captures queued
+    uint32      skipped;        // captures due but dropped on a full report queue
+} twr_cir_t;
+
+/* A range report was queued for the frame just received, with its diagnostics. Every TWR_CIR_PERIOD reports, makes
+ * a capture due. */
+void twr_cir_arm(twr_cir_t *c, const twr_range_report_t *r, uint8 prf);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_cir_capture()
+ *
+ * @brief If a capture is due, read the accumulator window around its first path and queue it as CIR frames. Call it
+ *        once the exchange has ended and before the receiver is turned back on.
+ *
+ * input parameters
+ * @param c    - capture state of the DW1000
+ * @param node - anchor label, 0 for a tag
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS, or DWT_ERROR if a capture was due and did not fit in the report queue
+ */
+int twr_cir_capture(twr_cir_t *c, uint8 node);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TWR_CIR_H_ */
@@ -0,0 +1,1189 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_engine.c
+ * @brief   Table driven two-way ranging engine, see twr_engine.h
+ *
+ *          The exchanges, delays and formulas are those of the DS_TWR_Compete
+ *          and SS_TWR_Complete examples, see the NOTES there.
+ */
+
+#include <string.h>
+
+#include "deca_device_api.h"
+#include "deca_regs.h"
+#include "deca_timestamps.h"
+#include "DWM_functions.h"
+#include "twr_engine.h"
+#include "twr_math.h"
+#include "twr_report.h"
+#include "twr_timing.h"
+#include "twr_trace.h"
+#include "twr_ts.h"
+
+#include "port.h"
+
+/* UWB microsecond (uus) to device time unit (dtu, around 15.65 ps) conversion factor.
+ * 1 uus = 512 / 499.2 us and 1 us = 499.2 * 128 dtu. */
+#define UUS_TO_DWT_TIME     65536
+
+/* Which address byte must hold the anchor id of a frame */
+#define TWR_ID_SELF         0   // anchor: own id
+#define TWR_ID_PEER         1   // tag: the anchor being ranged
+#define TWR_ID_OTHER        2   // master anchor: any other anchor
+#define TWR_ID_ALL          3   // broadcast
+
+/* dwt_readsystimestamphi32() counts 256 DTU */
+#define UUS_TO_SYS_HI32     (UUS_TO_DWT_TIME >> 8)
+
+/* DW1000 events handled by the engine with TWR_FLAG_IRQ */
+#define TWR_IRQ_EVENTS      (DWT_INT_TFRS | DWT_INT_RFCG | DWT_INT_RFTO | DWT_INT_RXPTO | DWT_INT_RPHE | DWT_INT_RFCE | \
+                             DWT_INT_RFSL | DWT_INT_SFDT)
+
+typedef void (*twr_handler_t)(twr_engine_t *e, uint32 len);
+
+typedef struct
+{
+    uint8           fcode;      // function code
+    uint8           dir;        // first address byte: 'W' tag to anchor, 'V' anchor to tag, 'D' relay
+    uint8           role;
+    uint8           modes;      // TWR_MODE_xxx the entry applies to
+    uint8           starts;     // != 0 if the frame starts an exchange, else it must be expected
+    uint8           id;         // TWR_ID_xxx
+    uint8           min_len;
+    twr_handler_t   handler;
+} twr_dispatch_t;
+
+static void twr_on_ds_poll(twr_engine_t *e, uint32 len);
+static void twr_on_ds_final(twr_engine_t *e, uint32 len);
+static void twr_on_relay(twr_engine_t *e, uint32 len);
+static void twr_on_ss_poll(twr_engine_t *e, uint32 len);
+static void twr_on_ds_resp(twr_engine_t *e, uint32 len);
+static void twr_on_ss_resp(twr_engine_t *e, uint32 len);
+static void twr_on_bcast_poll(twr_engine_t *e, uint32 len);
+static void twr_on_bcast_final(twr_engine_t *e, uint32 len);
+
+static const twr_dispatch_t twr_dispatch[] =
+{
+    /* fcode            dir  role             modes        starts id            min_len           handler */
+    { TWR_FC_DS_POLL,   'W', TWR_ROLE_ANCHOR, TWR_MODE_DS, 1,     TWR_ID_SELF,  TWR_POLL_LEN,     twr_on_ds_poll  },
+    { TWR_FC_DS_FINAL,  'W', TWR_ROLE_ANCHOR, TWR_MODE_DS, 0,     TWR_ID_SELF,  TWR_DS_FINAL_LEN, twr_on_ds_final },
+    { TWR_FC_RELAY,     'D', TWR_ROLE_ANCHOR, TWR_MODE_DS, 1,     TWR_ID_OTHER, TWR_RELAY_LEN,    twr_on_relay    },
+    { TWR_FC_SS_POLL,   'W', TWR_ROLE_ANCHOR, TWR_MODE_SS, 1,     TWR_ID_SELF,  TWR_POLL_LEN,     twr_on_ss_poll  },
+    { TWR_FC_BCAST_POLL,'W', TWR_ROLE_ANCHOR, TWR_MODE_DS, 1,     TWR_ID_ALL,   TWR_BCAST_POLL_LEN(1), twr_on_bcast_poll  },
+    { TWR_FC_BCAST_FINAL,'W',TWR_ROLE_ANCHOR, TWR_MODE_DS, 0,     TWR_ID_ALL,   TWR_BFINAL_LEN(1),     twr_on_bcast_final },
+    { TWR_FC_DS_RESP,   'V', TWR_ROLE_TAG,    TWR_MODE_DS, 0,     TWR_ID_PEER,  TWR_DS_RESP_LEN,  twr_on_ds_resp  },
+    { TWR_FC_SS_RESP,   'V', TWR_ROLE_TAG,    TWR_MODE_SS, 0,     TWR_ID_PEER,  TWR_SS_RESP_LEN,  twr_on_ss_resp  },
+};
+
+/* Address bytes 5, 6 and 8 of each direction, byte 7 is the anchor id */
+static const uint8 twr_addr_to_anchor[] = {'W', 'A', 0, 'E'};
+static const uint8 twr_addr_to_tag[]    = {'V', 'E', 0, 'A'};
+static const uint8 twr_addr_relay[]     = {'D', 'I', 0, 'T'};
+
+static void twr_header(twr_engine_t *e, uint8 *msg, const uint8 *addr, uint8 id, uint8 fcode)
+{
+    msg[0] = 0x41;
+    msg[1] = 0x88;
+    msg[TWR_MSG_SN_IDX] = e->seq;
+    msg[3] = 0xCA;
+    msg[4] = 0xDE;
+    msg[TWR_MSG_ADDR_IDX] = addr[0];
+    msg[TWR_MSG_ADDR_IDX + 1] = addr[1];
+    msg[TWR_MSG_ID_IDX] = id;
+    msg[TWR_MSG_ADDR_IDX + 3] = addr[3];
+    msg[TWR_MSG_FC_IDX] = fcode;
+}
+
+static const uint8 *twr_dir_addr(uint8 dir)
+{
+    return (dir == 'W') ? twr_addr_to_anchor : (dir == 'V') ? twr_addr_to_tag : twr_addr_relay;
+}
+
+static void twr_set_rx_timeout(twr_engine_t *e, uint16 uus)
+{
+    if (uus != e->rx_timeout)
+    {
+        dwt_setrxtimeout(uus);
+        e->rx_timeout = uus;
+    }
+}
+
+static void twr_set_rx_after_tx(twr_engine_t *e, uint32 uus)
+{
+    if (uus != e->rx_after_tx)
+    {
+        dwt_setrxaftertxdelay(uus);
+        e->rx_after_tx = uus;
+    }
+}
+
+static uint16 twr_get16(const uint8 *p)
+{
+    return (uint16)(p[0] | (p[1] << 8));
+}
+
+static void twr_put16(uint8 *p, uint16 v)
+{
+    p[0] = (uint8)v;
+    p[1] = (uint8)(v >> 8);
+}
+
+/* Engine run by the DW1000 interrupt, the dwt_isr() callbacks have no context argument */
+static twr_engine_t *twr_irq_engine = NULL;
+
+static void twr_bcast_next(twr_engine_t *e);
+
+/* Anchor listening with double RX buffering */
+static int twr_dbl_rx(const twr_engine_t *e)
+{
+    return (e->cfg->flags & TWR_FLAG_DBL_RX) && e->cfg->role == TWR_ROLE_ANCHOR;
+}
+
+/* After dwm_session_open(): dwt_initialise() turns double RX buffering off */
+static void twr_rx_buffers(twr_engine_t *e)
+{
+    if (twr_dbl_rx(e) && e->dbl_inits != e->session.stats.full_inits)
+    {
+        dwt_setdblrxbuffmode(1);
+        e->dbl_inits = e->session.stats.full_inits;
+    }
+}
+
+/* TWR_FLAG_DBL_RX: turn the receiver that twr_rx_good() turned back on off again, to transmit or reconfigure. The frame
+ * being handled keeps its buffer set until released after its handler. A frame received into the other set meanwhile is
+ * dropped: its set becomes the host's now, and is released with the frame handled, so that both sets end up free. The RX
+ * registers then show the dropped frame, the snapshot of the one handled was read before (twr_rx_good()). */
+static void twr_rx_off(twr_engine_t *e)
+{
+    if (!e->rx_on)
+    {
+        return;
+    }
+    e->rx_on = 0;
+    dwt_write8bitoffsetreg(SYS_CTRL_ID, SYS_CTRL_OFFSET, (uint8)SYS_CTRL_TRXOFF);
+    if (dwt_read32bitreg(SYS_STATUS_ID) & SYS_STATUS_RXFCG)
+    {
+        dwt_write8bitoffsetreg(SYS_CTRL_ID, SYS_CTRL_HRBT_OFFSET, 1);
+        e->stats.rx_dropped++;
+    }
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_GOOD | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR);
+}
+
+/* Switch to radio profile p, writing only the registers and settings that differ, see dwm_session_open() */
+static void twr_use_profile(twr_engine_t *e, uint8 p)
+{
+    e->cfg = e->profiles->cfg[p];
+
+    /* The session does not see the changes of twr_set_rx_timeout() and twr_set_rx_after_tx() */
+    e->session.cfg.rxTimeout = e->rx_timeout;
+    e->session.cfg.rxAfterTxDelay = e->rx_after_tx;
+    dwm_session_open(&e->session, &e->cfg->session);
+    twr_rx_buffers(e);
+    e->rx_timeout = e->cfg->session.rxTimeout;
+    e->rx_after_tx = e->cfg->session.rxAfterTxDelay;
+
+    e->profile = p;
+    e->stats.switches++;
+    if (e->cfg->role == TWR_ROLE_ANCHOR && p != TWR_PROFILE_LONG)
+    {
+        e->poll_heard = dwt_readsystimestamphi32();
+    }
+}
+
+/* Anchor with profiles: take the profile announced by a tag poll, whichever anchor it is for */
+static void twr_anchor_heard(twr_engine_t *e, uint32 len)
+{
+    const uint8 *rx = e->rx_buf;
+    uint32 idx;
+
+    if (rx[TWR_MSG_ADDR_IDX] != twr_addr_to_anchor[0] || rx[TWR_MSG_ADDR_IDX + 1] != twr_addr_to_anchor[1])
+    {
+        return;
+    }
+    switch (rx[TWR_MSG_FC_IDX])
+    {
+    case TWR_FC_DS_POLL:
+    case TWR_FC_SS_POLL:
+        idx = TWR_POLL_PROFILE_IDX;
+        break;
+    case TWR_FC_BCAST_POLL:
+        idx = TWR_BCAST_PROFILE_IDX(rx[TWR_BCAST_N_IDX]);
+        break;
+    default:
+        return;
+    }
+
+    /* The profile byte is followed by the FCS, polls without it are from a tag without profiles */
+    if (idx + 2 < len && rx[idx] < TWR_NUM_PROFILES)
+    {
+        e->announced = rx[idx];
+    }
+    if (e->profile != TWR_PROFILE_LONG)
+    {
+        e->poll_heard = dwt_readsystimestamphi32();
+    }
+}
+
+/* End of the exchange: the tag goes idle, the anchor turns its receiver back on for the next request */
+static void twr_done(twr_engine_t *e)
+{
+    TWR_TRACE_END(TWR_TRACE_EXCHANGE);
+    e->expect = 0;
+    e->n_slots = 0;
+
+    /* The accumulator still holds the last frame of the exchange while the receiver is off. Polled, from the main loop,
+     * reports due go out first, so that the capture does not delay them. */
+    if ((e->cfg->flags & TWR_FLAG_CIR) && e->cir.due && !e->rx_on)
+    {
+        if (!(e->cfg->flags & TWR_FLAG_IRQ))
+        {
+            twr_report_poll();
+        }
+        twr_cir_capture(&e->cir, (e->cfg->role == TWR_ROLE_ANCHOR) ? TWR_LABEL(e->cfg->id) : 0);
+    }
+    if (e->cfg->role == TWR_ROLE_TAG)
+    {
+        if (e->profiles != NULL)
+        {
+            twr_link_update(&e->link, &e->profiles->policy, e->profile, e->result == DWT_SUCCESS, e->level_dbm);
+        }
+        e->state = TWR_STATE_IDLE;
+        return;
+    }
+
+    if (e->profiles != NULL && e->announced != e->profile)
+    {
+        twr_rx_off(e);
+        twr_use_profile(e, e->announced);
+    }
+
+    /* Clear reception timeout to start next ranging process. */
+    twr_set_rx_timeout(e, e->cfg->session.rxTimeout);
+    e->state = TWR_STATE_RX;
+
+    /* Double RX buffering: still listening since the frame arrived. The buffer pointers are kept in step by the release of
+     * every frame, see twr_engine_step(). */
+    if (e->rx_on)
+    {
+        e->rx_on = 0;
+        return;
+    }
+
+    /* Activate reception immediately. */
+    dwt_rxenable(DWT_START_RX_IMMEDIATE | (twr_dbl_rx(e) ? DWT_NO_SYNC_PTRS : 0));
+}
+
+/* Wait for frame fcode, the receiver is turned on by the caller */
+static void twr_expect(twr_engine_t *e, uint8 fcode)
+{
+    e->expect = fcode;
+    e->state = TWR_STATE_RX;
+}
+
+/* Send the last frame of the exchange, DWT_START_TX_IMMEDIATE or DWT_START_TX_DELAYED. The exchange ends once it has
+ * left, or now if a delayed transmission is refused. */
+static int twr_send_last(twr_engine_t *e, uint8 *msg, uint16 len, int ranging, uint8 mode)
+{
+    twr_rx_off(e);
+    dwt_writetxdata(len, msg, 0);
+    dwt_writetxfctrl(len, 0, ranging);
+    e->state = TWR_STATE_TX;
+    if (dwt_starttx(mode) == DWT_ERROR)
+    {
+        e->stats.late_tx++;
+        twr_done(e);
+        return DWT_ERROR;
+    }
+    e->seq++;
+    return DWT_SUCCESS;
+}
+
+/* Queue the report of a distance computed here, with the RX quality of the frame just received */
+static void twr_report(twr_engine_t *e, twr_range_report_t *r)
+{
+    const dwt_rxdiag_t *diag = &e->rx.diag;
+
+    TWR_TRACE_BEGIN(TWR_TRACE_REPORT);
+    r->exchange = e->rx_buf[TWR_MSG_SN_IDX];
+    r->quality.fp_index = diag->firstPath;
+    r->quality.fp_amp1 = diag->firstPathAmp1;
+    r->quality.fp_amp2 = diag->firstPathAmp2;
+    r->quality.fp_amp3 = diag->firstPathAmp3;
+    r->quality.cir_power = diag->maxGrowthCIR;
+    r->quality.std_noise = diag->stdNoise;
+    r->quality.rx_pacc = diag->rxPreamCount;
+    if (twr_report_range(r) == DWT_SUCCESS && (e->cfg->flags & TWR_FLAG_CIR))
+    {
+        twr_cir_arm(&e->cir, r, e->cfg->session.config->prf);
+    }
+    TWR_TRACE_END(TWR_TRACE_REPORT);
+}
+
+/* Tag with profiles: keep the weakest response level of the exchange */
+static void twr_tag_level(twr_engine_t *e)
+{
+    int16 level;
+
+    if (e->profiles == NULL)
+    {
+        return;
+    }
+    level = twr_link_level_dbm(&e->rx.diag, e->cfg->session.config->prf);
+    if (e->level_dbm == TWR_LEVEL_NONE || level < e->level_dbm)
+    {
+        e->level_dbm = level;
+    }
+}
+
+static const twr_dispatch_t *twr_lookup(const twr_engine_t *e, uint8 expect, uint32 len)
+{
+    const uint8 *rx = e->rx_buf;
+    const twr_dispatch_t *d;
+    const uint8 *addr;
+    uint8 id;
+
+    for (d = twr_dispatch; d < twr_dispatch + sizeof(twr_dispatch) / sizeof(twr_dispatch[0]); d++)
+    {
+        if (d->fcode != rx[TWR_MSG_FC_IDX] || d->dir != rx[TWR_MSG_ADDR_IDX] ||
+            d->role != e->cfg->role || !(d->modes & e->cfg->mode))
+        {
+            continue;
+        }
+        addr = twr_dir_addr(d->dir);
+        if (rx[TWR_MSG_ADDR_IDX + 1] != addr[1] || rx[TWR_MSG_ADDR_IDX + 3] != addr[3])
+        {
+            continue;
+        }
+        id = rx[TWR_MSG_ID_IDX];
+        if ((d->id == TWR_ID_SELF && id != e->cfg->id) || (d->id == TWR_ID_PEER && id != e->peer) ||
+            (d->id == TWR_ID_OTHER && (id == e->cfg->id || !(e->cfg->flags & TWR_FLAG_MASTER))) ||
+            (d->id == TWR_ID_ALL && id != TWR_ID_BROADCAST))
+        {
+            return NULL;
+        }
+        if ((expect != 0) ? (d->fcode != expect) : !d->starts)
+        {
+            return NULL;
+        }
+        return (len >= d->min_len) ? d : NULL;
+    }
+    return NULL;
+}
+
+
+/*
+ * Events
+ */
+
+/* The frame awaited did not come, or was not for us: next broadcast slot, or end of the exchange */
+static void twr_rx_ended(twr_engine_t *e)
+{
+    if (e->cfg->role == TWR_ROLE_TAG && e->n_slots != 0)
+    {
+        twr_bcast_next(e);
+        return;
+    }
+    twr_done(e);
+}
+
+/* What the handlers of the frame awaited read from its snapshot besides the frame and the RX timestamp: the diagnostics
+ * for a range report or the RX level of a tag with profiles, the carrier integrator for the SS tag */
+static uint8 twr_rx_snap_flags(const twr_engine_t *e, uint8 expect)
+{
+    if (e->cfg->role == TWR_ROLE_TAG)
+    {
+        if (expect == TWR_FC_SS_RESP)
+        {
+            return DWT_RXSNAP_DIAG | DWT_RXSNAP_CI;
+        }
+        return (e->profiles != NULL) ? DWT_RXSNAP_DIAG : 0;
+    }
+    return (expect == TWR_FC_DS_FINAL || expect == TWR_FC_BCAST_FINAL) ? DWT_RXSNAP_DIAG : 0;
+}
+
+/* RX good: read the frame and what its handler needs in one snapshot, then run the handler of its table entry. While
+ * waiting for requests most frames heard are for the other anchors: the RX timestamp is read once the frame is known to
+ * be ours, in as many SPI transactions as in one snapshot. */
+static void twr_rx_good(twr_engine_t *e)
+{
+    const twr_dispatch_t *d = NULL;
+    uint8 expect = e->expect;
+    uint32 len;
+
+    e->expect = 0;
+    if (expect == 0 && twr_dbl_rx(e))
+    {
+        /* Waiting for requests: listen into the other buffer set while this frame is read and handled */
+        dwt_rxenable(DWT_START_RX_IMMEDIATE | DWT_NO_SYNC_PTRS);
+        e->rx_on = 1;
+    }
+    len = dwt_readrxsnapshot(&e->rx, e->rx_buf, TWR_RX_BUF_LEN,
+                             (expect != 0) ? DWT_RXSNAP_FRAME | DWT_RXSNAP_TIME | twr_rx_snap_flags(e, expect)
+                                           : DWT_RXSNAP_FRAME);
+    if (len >= TWR_MSG_COMMON_LEN && len <= TWR_RX_BUF_LEN)
+    {
+        if (e->profiles != NULL && e->cfg->role == TWR_ROLE_ANCHOR)
+        {
+            twr_anchor_heard(e, len);
+        }
+        d = twr_lookup(e, expect, len);
+    }
+    if (d == NULL)
+    {
+        e->stats.ignored++;
+        twr_rx_ended(e);
+        return;
+    }
+    if (expect == 0 && d->handler != twr_on_relay)
+    {
+        TWR_TRACE_BEGIN(TWR_TRACE_EXCHANGE);
+        TWR_TRACE_BEGIN(TWR_TRACE_RESP_TX);
+        dwt_readrxsnapshot(&e->rx, NULL, 0, DWT_RXSNAP_TIME);
+    }
+    else if (expect == TWR_FC_DS_RESP || expect == TWR_FC_SS_RESP)
+    {
+        TWR_TRACE_END(TWR_TRACE_RESP_RX);
+    }
+    else if (expect != 0)
+    {
+        TWR_TRACE_END(TWR_TRACE_FINAL_RX);
+    }
+    d->handler(e, len);
+}
+
+/* RX timeout or error, the receiver has been reset */
+static void twr_rx_failed(twr_engine_t *e)
+{
+    e->expect = 0;
+    e->stats.rx_errors++;
+
+    /* Fast anchor: without tag polls for a while, the tag is back on the long range profile */
+    if (e->profiles != NULL && e->cfg->role == TWR_ROLE_ANCHOR && e->profile != TWR_PROFILE_LONG &&
+        dwt_readsystimestamphi32() - e->poll_heard > e->profiles->policy.holdUus * UUS_TO_SYS_HI32)
+    {
+        e->announced = TWR_PROFILE_LONG;
+    }
+    twr_rx_ended(e);
+}
+
+/* TX done of the last frame of the exchange */
+static void twr_tx_done(twr_engine_t *e)
+{
+    if (e->cfg->role == TWR_ROLE_TAG)
+    {
+        e->result = DWT_SUCCESS;
+    }
+    twr_done(e);
+}
+
+/* dwt_isr() callbacks. dwt_isr() has cleared the events and reset the receiver after an error. A TX done followed by
+ * the reception of the response (DWT_RESPONSE_EXPECTED) is not an event of the exchange. */
+static void twr_irq_tx_done(const dwt_cb_data_t *cb)
+{
+    twr_engine_t *e = twr_irq_engine;
+
+    (void)cb;
+    if (e != NULL && e->state == TWR_STATE_TX)
+    {
+        twr_tx_done(e);
+    }
+}
+
+static void twr_irq_rx_ok(const dwt_cb_data_t *cb)
+{
+    twr_engine_t *e = twr_irq_engine;
+
+    if (e == NULL)
+    {
+        return;
+    }
+    if (cb->status & SYS_STATUS_RXOVRR)
+    {
+        dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_RXOVRR);
+        e->stats.rx_overruns++;
+    }
+    /* With double RX buffering dwt_isr() releases the buffer set on return */
+    if (e->state == TWR_STATE_RX)
+    {
+        twr_rx_good(e);
+    }
+}
+
+static void twr_irq_rx_failed(const dwt_cb_data_t *cb)
+{
+    twr_engine_t *e = twr_irq_engine;
+
+    (void)cb;
+    if (e != NULL && e->state == TWR_STATE_RX)
+    {
+        twr_rx_failed(e);
+    }
+}
+
+/* Open the session of e->cfg and, after a full initialisation, set up the DW1000 for its flags. With TWR_FLAG_IRQ, install the
+ * interrupt callbacks. */
+static int twr_engine_open(twr_engine_t *e)
+{
+    const twr_cfg_t *cfg = e->cfg;
+
+    if (dwm_session_open(&e->session, &cfg->session) == DWT_ERROR)
+    {
+        return DWT_ERROR;
+    }
+    twr_rx_buffers(e);
+
+    /* dwt_initialise() leaves the event counters disabled */
+    if ((cfg->flags & TWR_FLAG_TELEMETRY) && e->evc_inits != e->session.stats.full_inits)
+    {
+        twr_telemetry_start(&e->telemetry);
+        e->evc_inits = e->session.stats.full_inits;
+    }
+
+    if (cfg->flags & TWR_FLAG_IRQ)
+    {
+        twr_irq_engine = e;
+        if (e->irq_inits != e->session.stats.full_inits)
+        {
+            /* dwt_initialise() clears the callbacks and the reset clears the interrupt mask */
+            port_set_deca_isr(dwt_isr);
+            dwt_setcallbacks(twr_irq_tx_done, twr_irq_rx_ok, twr_irq_rx_failed, twr_irq_rx_failed);
+            dwt_setinterrupt(TWR_IRQ_EVENTS, 1);
+            e->irq_inits = e->session.stats.full_inits;
+        }
+    }
+    return DWT_SUCCESS;
+}
+
+int twr_engine_init(twr_engine_t *e, const twr_cfg_t *cfg)
+{
+    if (e->cfg != cfg || e->profiles != NULL)
+    {
+        memset(e, 0, sizeof(*e));
+        e->cfg = cfg;
+        e->rx_timeout = cfg->session.rxTimeout;
+        e->rx_after_tx = cfg->session.rxAfterTxDelay;
+    }
+    return twr_engine_open(e);
+}
+
+int twr_engine_init_profiles(twr_engine_t *e, const twr_profiles_t *profiles)
+{
+    if (e->profiles != profiles)
+    {
+        memset(e, 0, sizeof(*e));
+        e->profiles = profiles;
+        e->cfg = profiles->cfg[TWR_PROFILE_LONG];
+        e->profile = TWR_PROFILE_LONG;
+        e->announced = TWR_PROFILE_LONG;
+        e->rx_timeout = e->cfg->session.rxTimeout;
+        e->rx_after_tx = e->cfg->session.rxAfterTxDelay;
+    }
+    return twr_engine_open(e);
+}
+
+void twr_engine_step(twr_engine_t *e)
+{
+    uint32 status;
+
+    /* Send the reports queued so far once a batch is due, before waiting for the next event */
+    twr_report_poll();
+
+    /* Sample the event counters while no frame is awaited, so the SPI reads cannot delay the handling of one */
+    if ((e->cfg->flags & TWR_FLAG_TELEMETRY) && e->expect == 0)
+    {
+        twr_telemetry_poll(&e->telemetry, (e->cfg->role == TWR_ROLE_ANCHOR) ? TWR_LABEL(e->cfg->id) : 0);
+    }
+
+    if (e->cfg->flags & TWR_FLAG_IRQ)
+    {
+        /* The interrupt does the work */
+        port_wait_for_irq();
+        return;
+    }
+
+    if (e->state == TWR_STATE_TX)
+    {
+        /* Poll DW1000 until TX frame sent event set, then clear it. */
+        while (!(dwt_read32bitreg(SYS_STATUS_ID) & SYS_STATUS_TXFRS))
+        {
+            TWR_TRACE_POLL();
+        }
+        dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_TXFRS);
+        twr_tx_done(e);
+        return;
+    }
+    if (e->state != TWR_STATE_RX)
+    {
+        return;
+    }
+
+    /* Poll for reception of a frame or error/timeout. See NOTE 8 of the DS responder. */
+    do
+    {
+        TWR_TRACE_POLL();
+        status = dwt_read32bitreg(SYS_STATUS_ID);
+    }
+    while (!(status & (SYS_STATUS_RXFCG | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR)));
+
+    if (!(status & SYS_STATUS_RXFCG))
+    {
+        /* Clear RX error/timeout events in the DW1000 status register. */
+        dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR);
+
+        /* Reset RX to properly reinitialise LDE operation. */
+        dwt_rxreset();
+        twr_rx_failed(e);
+        return;
+    }
+
+    /* Clear good RX frame event and TX frame sent in the DW1000 status register. */
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_RXFCG | SYS_STATUS_TXFRS | (status & SYS_STATUS_RXOVRR));
+    if (status & SYS_STATUS_RXOVRR)
+    {
+        e->stats.rx_overruns++;
+    }
+
+    /* A frame has been received, read it into the local buffer. */
+    twr_rx_good(e);
+
+    /* Double RX buffering: hand the buffer set back, the next frame shows if one is waiting in the other */
+    if (twr_dbl_rx(e))
+    {
+        dwt_write8bitoffsetreg(SYS_CTRL_ID, SYS_CTRL_HRBT_OFFSET, 1);
+    }
+}
+
+int twr_engine_busy(const twr_engine_t *e)
+{
+    return e->state != TWR_STATE_IDLE;
+}
+
+void twr_anchor_start(twr_engine_t *e)
+{
+    twr_done(e);
+}
+
+void twr_anchor_run(twr_engine_t *e)
+{
+    /* Turn the receiver on, then loop forever responding to ranging requests. */
+    twr_anchor_start(e);
+    while (1)
+    {
+        twr_engine_step(e);
+    }
+}
+
+/* Tag with profiles: take the profile announced by the last poll, and the one to announce in this poll */
+static void twr_tag_profile(twr_engine_t *e)
+{
+    e->level_dbm = TWR_LEVEL_NONE;
+    if (e->profiles == NULL)
+    {
+        return;
+    }
+    if (e->announced != e->profile)
+    {
+        twr_use_profile(e, e->announced);
+    }
+    e->announced = e->link.want;
+}
+
+void twr_tag_start(twr_engine_t *e, uint8 anchor)
+{
+    uint8 poll[TWR_POLL_LEN + TWR_PROFILE_LEN] = {0};
+    uint16 len = TWR_POLL_LEN;
+
+    TWR_TRACE_BEGIN(TWR_TRACE_EXCHANGE);
+    TWR_TRACE_BEGIN(TWR_TRACE_POLL_TX);
+    twr_tag_profile(e);
+    e->peer = anchor;
+    e->result = DWT_ERROR;
+    e->n_slots = 0;
+
+    /* Write frame data to DW1000 and prepare transmission. See NOTE 8 of the DS initiator. */
+    twr_header(e, poll, twr_addr_to_anchor, anchor, (e->cfg->mode == TWR_MODE_SS) ? TWR_FC_SS_POLL : TWR_FC_DS_POLL);
+    if (e->profiles != NULL)
+    {
+        poll[TWR_POLL_PROFILE_IDX] = e->announced;
+        len += TWR_PROFILE_LEN;
+    }
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_TXFRS);
+    dwt_writetxdata(len, poll, 0);
+    dwt_writetxfctrl(len, 0, 1);
+
+    /* Start transmission, indicating that a response is expected so that reception is enabled automatically after the frame is sent and the delay
+     * set by dwt_setrxaftertxdelay() has elapsed. */
+    twr_expect(e, (e->cfg->mode == TWR_MODE_SS) ? TWR_FC_SS_RESP : TWR_FC_DS_RESP);
+    dwt_starttx(DWT_START_TX_IMMEDIATE | DWT_RESPONSE_EXPECTED);
+    TWR_TRACE_END(TWR_TRACE_POLL_TX);
+    TWR_TRACE_BEGIN(TWR_TRACE_RESP_RX);
+    e->seq++;
+    e->stats.polls++;
+}
+
+int twr_tag_range(twr_engine_t *e, uint8 anchor)
+{
+    twr_tag_start(e, anchor);
+    while (e->state != TWR_STATE_IDLE)
+    {
+        twr_engine_step(e);
+    }
+    twr_report_poll();
+    return e->result;
+}
+
+int twr_tag_start_all(twr_engine_t *e, const uint8 *anchors, uint8 n)
+{
+    const twr_cfg_t *cfg;
+    uint8 poll[TWR_BCAST_POLL_LEN(TWR_MAX_ANCHORS) + TWR_PROFILE_LEN] = {0};
+    uint16 len;
+
+    if (n == 0 || n > TWR_MAX_ANCHORS || e->cfg->mode != TWR_MODE_DS)
+    {
+        return DWT_ERROR;
+    }
+    TWR_TRACE_BEGIN(TWR_TRACE_EXCHANGE);
+    TWR_TRACE_BEGIN(TWR_TRACE_POLL_TX);
+    twr_tag_profile(e);
+    cfg = e->cfg;
+
+    memcpy(e->anchors, anchors, n);
+    e->n_slots = n;
+    e->slot = 0;
+    e->heard = 0;
+    memset(e->slot_ok, 0, sizeof(e->slot_ok));
+    e->peer = anchors[0];
+    e->result = DWT_ERROR;
+
+    /* Poll all anchors, the first slot is received as the response of an ordinary poll */
+    twr_header(e, poll, twr_addr_to_anchor, TWR_ID_BROADCAST, TWR_FC_BCAST_POLL);
+    poll[TWR_BCAST_N_IDX] = n;
+    twr_put16(&poll[TWR_BCAST_FIRST_IDX], cfg->firstSlotUus);
+    twr_put16(&poll[TWR_BCAST_SLOT_IDX], cfg->slotUus);
+    memcpy(&poll[TWR_BCAST_IDS_IDX], anchors, n);
+    len = TWR_BCAST_POLL_LEN(n);
+    if (e->profiles != NULL)
+    {
+        poll[TWR_BCAST_PROFILE_IDX(n)] = e->announced;
+        len += TWR_PROFILE_LEN;
+    }
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_TXFRS);
+    dwt_writetxdata(len, poll, 0);
+    dwt_writetxfctrl(len, 0, 1);
+    twr_expect(e, TWR_FC_DS_RESP);
+    dwt_starttx(DWT_START_TX_IMMEDIATE | DWT_RESPONSE_EXPECTED);
+    TWR_TRACE_END(TWR_TRACE_POLL_TX);
+    TWR_TRACE_BEGIN(TWR_TRACE_RESP_RX);
+    e->seq++;
+    e->stats.polls++;
+    return DWT_SUCCESS;
+}
+
+int twr_tag_range_all(twr_engine_t *e, const uint8 *anchors, uint8 n)
+{
+    if (twr_tag_start_all(e, anchors, n) == DWT_ERROR)
+    {
+        return 0;
+    }
+    while (e->state != TWR_STATE_IDLE)
+    {
+        twr_engine_step(e);
+    }
+    return (e->result == DWT_SUCCESS) ? e->heard : 0;
+}
+
+/* Final after the last slot, listing the anchors heard. See NOTE 10 of the DS initiator. */
+static void twr_bcast_final(twr_engine_t *e)
+{
+    const twr_cfg_t *cfg = e->cfg;
+    uint8 final[TWR_BFINAL_LEN(TWR_MAX_ANCHORS)] = {0};
+    uint8 n = e->n_slots;
+    twr_ts_t final_tx_ts;
+    uint32 final_tx_time;
+    uint8 k, m;
+
+    e->n_slots = 0;
+    if (e->heard == 0)
+    {
+        twr_done(e);
+        return;
+    }
+    TWR_TRACE_BEGIN(TWR_TRACE_FINAL_TX);
+
+    final_tx_time = twr_ts_dx_time(twr_ts_add(e->poll_tx_ts, TWR_TS_UUS(cfg->firstSlotUus + (uint32)(n - 1) * cfg->slotUus +
+                                                                         cfg->replyDelayUus)));
+    dwt_setdelayedtrxtime(final_tx_time);
+    final_tx_ts = twr_ts_dx_tx(final_tx_time, cfg->session.txAntDly);
+
+    twr_header(e, final, twr_addr_to_anchor, TWR_ID_BROADCAST, TWR_FC_BCAST_FINAL);
+    twr_ts_put(&final[TWR_BFINAL_POLL_TX_TS_IDX], e->poll_tx_ts);
+    twr_ts_put(&final[TWR_BFINAL_FINAL_TX_TS_IDX], final_tx_ts);
+    for (k = 0, m = 0; k < n; k++)
+    {
+        if (e->slot_ok[k])
+        {
+            final[TWR_BFINAL_ENTRIES_IDX + m * TWR_BFINAL_ENTRY_LEN] = e->anchors[k];
+            twr_ts_put(&final[TWR_BFINAL_ENTRIES_IDX + m * TWR_BFINAL_ENTRY_LEN + 1], e->resp_rx_ts[k]);
+            m++;
+        }
+    }
+    final[TWR_BFINAL_N_IDX] = m;
+    if (twr_send_last(e, final, TWR_BFINAL_LEN(m), 1, DWT_START_TX_DELAYED) == DWT_SUCCESS)
+    {
+        TWR_TRACE_END(TWR_TRACE_FINAL_TX);
+    }
+}
+
+/* End of broadcast slot e->slot: receive the next one, or send the final after the last */
+static void twr_bcast_next(twr_engine_t *e)
+{
+    const twr_cfg_t *cfg = e->cfg;
+    twr_ts_t rx_on;
+    uint16 len;
+
+    if (e->slot == 0)
+    {
+        e->poll_tx_ts = get_tx_timestamp_u64();
+    }
+    if (++e->slot >= e->n_slots)
+    {
+        twr_bcast_final(e);
+        return;
+    }
+
+    /* Turn the receiver on as in the first slot, rxAfterTxDelay after the end of the poll, so that the RX and preamble timeouts of
+     * the response fit every slot. See twr_on_bcast_poll(). */
+    len = TWR_BCAST_POLL_LEN(e->n_slots) + ((e->profiles != NULL) ? TWR_PROFILE_LEN : 0);
+    rx_on = twr_ts_add(e->poll_tx_ts, (int64_t)twr_payload_clk(cfg->session.config, len) * TWR_DTU_PER_CLK +
+                                      TWR_TS_UUS(cfg->session.rxAfterTxDelay + (uint32)e->slot * cfg->slotUus));
+    e->peer = e->anchors[e->slot];
+    TWR_TRACE_BEGIN(TWR_TRACE_RESP_RX);
+    twr_expect(e, TWR_FC_DS_RESP);
+    dwt_setdelayedtrxtime(twr_ts_dx_time(rx_on));
+    if (dwt_rxenable(DWT_START_RX_DELAYED) != DWT_SUCCESS)
+    {
+        e->stats.late_tx++;     // already in the slot, the receiver was turned on immediately
+    }
+}
+
+/*
+ * Anchor handlers
+ */
+
+/* Send the DS response replyUus after the poll and wait for the final. rx_after_tx: end of the response to receiver on */
+static void twr_send_ds_resp(twr_engine_t *e, uint32 replyUus, uint32 rx_after_tx, uint8 expect)
+{
+    uint8 resp[TWR_DS_RESP_LEN] = {0};
+    uint32 resp_tx_time;
+
+    twr_rx_off(e);
+
+    /* Set send time for response. See NOTE 9 of the DS responder. */
+    resp_tx_time = twr_ts_dx_time(twr_ts_add(e->poll_rx_ts, TWR_TS_UUS(replyUus)));
+    dwt_setdelayedtrxtime(resp_tx_time);
+
+    /* Set expected delay and timeout for final message reception. */
+    twr_set_rx_after_tx(e, rx_after_tx);
+    twr_set_rx_timeout(e, e->cfg->finalTimeoutUus);
+
+    /* Write and send the response message, 0x02 = activity code "go on with ranging". */
+    twr_header(e, resp, twr_addr_to_tag, e->cfg->id, TWR_FC_DS_RESP);
+    resp[TWR_MSG_COMMON_LEN] = 0x02;
+    dwt_writetxdata(sizeof(resp), resp, 0);
+    dwt_writetxfctrl(sizeof(resp), 0, 1);
+
+    /* If dwt_starttx() returns an error, abandon this ranging exchange and proceed to the next one. See NOTE 11 of the DS responder. */
+    twr_expect(e, expect);
+    if (dwt_starttx(DWT_START_TX_DELAYED | DWT_RESPONSE_EXPECTED) == DWT_ERROR)
+    {
+        e->stats.late_tx++;
+        twr_done(e);
+        return;
+    }
+    TWR_TRACE_END(TWR_TRACE_RESP_TX);
+    TWR_TRACE_BEGIN(TWR_TRACE_FINAL_RX);
+    e->seq++;
+    e->stats.polls++;
+}
+
+static void twr_on_ds_poll(twr_engine_t *e, uint32 len)
+{
+    (void)len;
+
+    /* Retrieve poll reception timestamp. */
+    e->poll_rx_ts = twr_ts_get(e->rx.rxStamp);
+    e->n_slots = 0;
+    twr_send_ds_resp(e, e->cfg->replyDelayUus, e->cfg->session.rxAfterTxDelay, TWR_FC_DS_FINAL);
+}
+
+static void twr_on_bcast_poll(twr_engine_t *e, uint32 len)
+{
+    const uint8 *rx = e->rx_buf;
+    uint8 n = rx[TWR_BCAST_N_IDX];
+    uint8 k;
+
+    if (n == 0 || n > TWR_MAX_ANCHORS || len < TWR_BCAST_POLL_LEN(n))
+    {
+        e->stats.ignored++;
+        twr_done(e);
+        return;
+    }
+    for (k = 0; k < n && rx[TWR_BCAST_IDS_IDX + k] != e->cfg->id; k++)
+    { };
+    if (k == n)
+    {
+        twr_done(e);    // not polled this time
+        return;
+    }
+
+    /* Answer in slot k, and turn the receiver on for the final once the slots after ours have passed */
+    e->poll_rx_ts = twr_ts_get(e->rx.rxStamp);
+    e->n_slots = n;
+    e->slot = k;
+    e->first_uus = twr_get16(&rx[TWR_BCAST_FIRST_IDX]);
+    e->slot_uus = twr_get16(&rx[TWR_BCAST_SLOT_IDX]);
+    twr_send_ds_resp(e, e->first_uus + (uint32)k * e->slot_uus,
+                     e->cfg->session.rxAfterTxDelay + (uint32)(n - 1 - k) * e->slot_uus, TWR_FC_BCAST_FINAL);
+}
+
+/* DS TWR distance from the timestamps of the final message, then report and relay it */
+static void twr_ds_range(twr_engine_t *e, const uint8 *poll_tx, const uint8 *resp_rx, const uint8 *final_tx)
+{
+    uint8 relay[TWR_RELAY_LEN] = {0};
+    twr_range_report_t report = {0};
+    twr_ts_t poll_tx_ts, resp_rx_ts, final_tx_ts;
+    twr_ts_t resp_tx_ts, final_rx_ts;
+    int64_t tof_dtu;
+    int32 cm;
+
+    /* Retrieve response transmission and final reception timestamps. */
+    resp_tx_ts  = get_tx_timestamp_u64();
+    final_rx_ts = twr_ts_get(e->rx.rxStamp);
+
+    /* Get timestamps embedded in the final message. */
+    poll_tx_ts = twr_ts_get(poll_tx);
+    resp_rx_ts = twr_ts_get(resp_rx);
+    final_tx_ts = twr_ts_get(final_tx);
+
+    /* Compute time of flight. 40-bit intervals are exact even if the clock has wrapped. See NOTE 12 of the DS responder. */
+    TWR_TRACE_BEGIN(TWR_TRACE_COMPUTE);
+    tof_dtu = twr_ds_tof_dtu(twr_ts_elapsed(resp_rx_ts, poll_tx_ts), twr_ts_elapsed(final_rx_ts, resp_tx_ts),
+                             twr_ts_elapsed(final_tx_ts, resp_rx_ts), twr_ts_elapsed(resp_tx_ts, e->poll_rx_ts));
+
+    e->distance_mm = twr_dtu_to_distance(tof_dtu, TWR_UNIT_MM);
+    TWR_TRACE_END(TWR_TRACE_COMPUTE);
+    e->stats.ranges++;
+
+    report.anchor = TWR_LABEL(e->cfg->id);
+    report.kind = TWR_RPT_KIND_DS;
+    report.distance_mm = e->distance_mm;
+    report.ts[0] = (uint32)poll_tx_ts;
+    report.ts[1] = (uint32)resp_rx_ts;
+    report.ts[2] = (uint32)final_tx_ts;
+    report.ts[3] = (uint32)e->poll_rx_ts;
+    report.ts[4] = (uint32)resp_tx_ts;
+    report.ts[5] = (uint32)final_rx_ts;
+    twr_report(e, &report);
+
+    if (!(e->cfg->flags & TWR_FLAG_RELAY))
+    {
+        twr_done(e);
+        return;
+    }
+
+    /* The master anchor takes the profile announced by the poll as soon as it has heard it, see twr_anchor_heard() */
+    if (e->profiles != NULL && e->announced != e->profile)
+    {
+        twr_use_profile(e, e->announced);
+    }
+
+    /* Send the distance to the master anchor as whole metres and centimetres */
+    cm = twr_dtu_to_distance(tof_dtu, TWR_UNIT_CM);
+    cm = (cm < 0) ? 0 : (cm > 25599) ? 25599 : cm;
+    twr_header(e, relay, twr_addr_relay, e->cfg->id, TWR_FC_RELAY);
+    relay[TWR_RELAY_METRES_IDX] = (uint8)(cm / 100);
+    relay[TWR_RELAY_CM_IDX] = (uint8)(cm % 100);
+    if (e->n_slots == 0)
+    {
+        twr_send_last(e, relay, sizeof(relay), 0, DWT_START_TX_IMMEDIATE);
+        e->stats.relays++;
+        return;
+    }
+
+    /* Broadcast exchange: the relays of all anchors follow the final, each in its slot */
+    dwt_setdelayedtrxtime(twr_ts_dx_time(twr_ts_add(final_rx_ts, TWR_TS_UUS(e->first_uus + (uint32)e->slot * e->slot_uus))));
+    if (twr_send_last(e, relay, sizeof(relay), 0, DWT_START_TX_DELAYED) == DWT_SUCCESS)
+    {
+        e->stats.relays++;
+    }
+}
+
+static void twr_on_ds_final(twr_engine_t *e, uint32 len)
+{
+    (void)len;
+
+    twr_ds_range(e, &e->rx_buf[TWR_FINAL_POLL_TX_TS_IDX], &e->rx_buf[TWR_FINAL_RESP_RX_TS_IDX],
+                 &e->rx_buf[TWR_FINAL_FINAL_TX_TS_IDX]);
+}
+
+static void twr_on_bcast_final(twr_engine_t *e, uint32 len)
+{
+    const uint8 *rx = e->rx_buf;
+    const uint8 *entry;
+    uint8 n = rx[TWR_BFINAL_N_IDX];
+    uint8 i;
+
+    if (n > TWR_MAX_ANCHORS || len < TWR_BFINAL_LEN(n))
+    {
+        e->stats.ignored++;
+        twr_done(e);
+        return;
+    }
+
+    /* Our response RX timestamp, absent if the tag missed our response */
+    for (i = 0; i < n; i++)
+    {
+        entry = &rx[TWR_BFINAL_ENTRIES_IDX + i * TWR_BFINAL_ENTRY_LEN];
+        if (entry[0] == e->cfg->id)
+        {
+            twr_ds_range(e, &rx[TWR_BFINAL_POLL_TX_TS_IDX], &entry[1], &rx[TWR_BFINAL_FINAL_TX_TS_IDX]);
+            return;
+        }
+    }
+    twr_done(e);
+}
+
+static void twr_on_relay(twr_engine_t *e, uint32 len)
+{
+    twr_range_report_t report = {0};
+
+    (void)len;
+
+    report.anchor = TWR_LABEL(e->rx_buf[TWR_MSG_ID_IDX]);
+    report.exchange = e->rx_buf[TWR_MSG_SN_IDX];
+    report.kind = TWR_RPT_KIND_RELAY;
+    report.distance_mm = (e->rx_buf[TWR_RELAY_METRES_IDX] * 100 + e->rx_buf[TWR_RELAY_CM_IDX]) * 10;
+    twr_report_range(&report);
+    e->stats.relays++;
+    twr_done(e);
+}
+
+static void twr_on_ss_poll(twr_engine_t *e, uint32 len)
+{
+    uint8 resp[TWR_SS_RESP_LEN] = {0};
+    uint32 resp_tx_time;
+    twr_ts_t resp_tx_ts;
+
+    (void)len;
+
+    /* Retrieve poll reception timestamp and compute response transmission time. See NOTE 7 of the SS responder. */
+    e->poll_rx_ts = twr_ts_get(e->rx.rxStamp);
+    resp_tx_time = twr_ts_dx_time(twr_ts_add(e->poll_rx_ts, TWR_TS_UUS(e->cfg->replyDelayUus)));
+    dwt_setdelayedtrxtime(resp_tx_time);
+
+    /* Response TX timestamp is the transmission time we programmed plus the antenna delay. */
+    resp_tx_ts = twr_ts_dx_tx(resp_tx_time, e->cfg->session.txAntDly);
+
+    /* Write all timestamps in the response message. See NOTE 8 of the SS responder. */
+    twr_header(e, resp, twr_addr_to_tag, e->cfg->id, TWR_FC_SS_RESP);
+    twr_ts_put(&resp[TWR_RESP_POLL_RX_TS_IDX], e->poll_rx_ts);
+    twr_ts_put(&resp[TWR_RESP_RESP_TX_TS_IDX], resp_tx_ts);
+
+    /* If dwt_starttx() returns an error, abandon this ranging exchange and proceed to the next one. See NOTE 10 of the SS responder. */
+    if (twr_send_last(e, resp, sizeof(resp), 1, DWT_START_TX_DELAYED) == DWT_SUCCESS)
+    {
+        TWR_TRACE_END(TWR_TRACE_RESP_TX);
+        e->stats.polls++;
+    }
+}
+
+/*
+ * Tag handlers
+ */
+
+static void twr_on_ds_resp(twr_engine_t *e, uint32 len)
+{
+    uint8 final[TWR_DS_FINAL_LEN] = {0};
+    twr_ts_t poll_tx_ts, resp_rx_ts, final_tx_ts;
+    uint32 final_tx_time;
+
+    (void)len;
+
+    if (e->n_slots != 0)
+    {
+        /* Broadcast exchange: keep the RX timestamp for the final */
+        e->resp_rx_ts[e->slot] = twr_ts_get(e->rx.rxStamp);
+        e->slot_ok[e->slot] = 1;
+        e->heard++;
+        twr_tag_level(e);
+        twr_bcast_next(e);
+        return;
+    }
+
+    TWR_TRACE_BEGIN(TWR_TRACE_FINAL_TX);
+    poll_tx_ts = get_tx_timestamp_u64();
+    resp_rx_ts = twr_ts_get(e->rx.rxStamp);
+    twr_tag_level(e);
+
+    /* Compute final message transmission time. See NOTE 10 of the DS initiator. */
+    final_tx_time = twr_ts_dx_time(twr_ts_add(resp_rx_ts, TWR_TS_UUS(e->cfg->replyDelayUus)));
+    dwt_setdelayedtrxtime(final_tx_time);
+
+    /* Final TX timestamp is the transmission time we programmed plus the TX antenna delay. */
+    final_tx_ts = twr_ts_dx_tx(final_tx_time, e->cfg->session.txAntDly);
+
+    /* Write all timestamps in the final message. See NOTE 11 of the DS initiator. */
+    twr_header(e, final, twr_addr_to_anchor, e->peer, TWR_FC_DS_FINAL);
+    twr_ts_put(&final[TWR_FINAL_POLL_TX_TS_IDX], poll_tx_ts);
+    twr_ts_put(&final[TWR_FINAL_RESP_RX_TS_IDX], resp_rx_ts);
+    twr_ts_put(&final[TWR_FINAL_FINAL_TX_TS_IDX], final_tx_ts);
+
+    /* If dwt_starttx() returns an error, abandon this ranging exchange. See NOTE 12 of the DS initiator. The exchange has
+     * completed once the final has left. */
+    if (twr_send_last(e, final, sizeof(final), 1, DWT_START_TX_DELAYED) == DWT_SUCCESS)
+    {
+        TWR_TRACE_END(TWR_TRACE_FINAL_TX);
+    }
+}
+
+static void twr_on_ss_resp(twr_engine_t *e, uint32 len)
+{
+    const dwt_config_t *config = e->cfg->session.config;
+    twr_ts_t poll_tx_ts, resp_rx_ts, poll_rx_ts, resp_tx_ts;
+    int64_t rtd_init, rtd_resp;
+    int32 carrier_integrator;
+    twr_range_report_t report = {0};
+
+    (void)len;
+
+    /* Retrieve poll transmission and response reception timestamps. See NOTE 9 of the SS initiator. */
+    poll_tx_ts = get_tx_timestamp_u64();
+    resp_rx_ts = twr_ts_get(e->rx.rxStamp);
+
+    /* Carrier integrator value, for the clock offset ratio. See NOTE 11 of the SS initiator. */
+    carrier_integrator = e->rx.carrierInt;
+
+    /* Get timestamps embedded in response message. */
+    poll_rx_ts = twr_ts_get(&e->rx_buf[TWR_RESP_POLL_RX_TS_IDX]);
+    resp_tx_ts = twr_ts_get(&e->rx_buf[TWR_RESP_RESP_TX_TS_IDX]);
+
+    /* Compute time of flight and distance, using clock offset ratio to correct for differing local and remote clock rates */
+    TWR_TRACE_BEGIN(TWR_TRACE_COMPUTE);
+    rtd_init = twr_ts_diff(resp_rx_ts, poll_tx_ts);
+    rtd_resp = twr_ts_diff(resp_tx_ts, poll_rx_ts);
+
+    e->distance_mm = twr_ss_distance(rtd_init, rtd_resp, carrier_integrator, config, TWR_UNIT_MM);
+    TWR_TRACE_END(TWR_TRACE_COMPUTE);
+    e->stats.ranges++;
+
+    report.anchor = TWR_LABEL(e->peer);
+    report.kind = TWR_RPT_KIND_SS;
+    report.distance_mm = e->distance_mm;
+    report.ts[0] = (uint32)poll_tx_ts;
+    report.ts[1] = (uint32)resp_rx_ts;
+    report.ts[2] = (uint32)poll_rx_ts;
+    report.ts[3] = (uint32)resp_tx_ts;
+    twr_report(e, &report);
+    twr_tag_level(e);
+    e->result = DWT_SUCCESS;
+    twr_done(e);
+}
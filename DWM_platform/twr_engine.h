@@ -0,0 +1,345 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_engine.h
+ * @brief   Table driven two-way ranging engine for the tag and the anchors
+ *
+ *          One engine runs the DS TWR (poll 0x21, response 0x10, final 0x23)
+ *          and SS TWR (poll 0xE0, response 0xE1) exchanges of the examples,
+ *          for either side. Role, anchor address, reply delays, timeouts and
+ *          radio configuration are runtime parameters, so the same code
+ *          serves every anchor ID.
+ *
+ *          A received frame is looked up in a table keyed on its function
+ *          code (and on the direction given by its addresses). The matching
+ *          entry checks the length and the addressing, then its handler runs.
+ *          There are no per-anchor frame templates to memcmp against. The
+ *          frame, its RX timestamp and, when the exchange will need them, the
+ *          diagnostics and carrier integrator are read in one snapshot
+ *          (dwt_readrxsnapshot()). A request heard while waiting may be for
+ *          another anchor: its timestamp is read once it is found to be ours.
+ *
+ *          Frame layout (see NOTE 2 of the DS examples), all frames:
+ *           - byte 0/1: frame control 0x8841, byte 2: sequence number, byte 3/4: PAN ID 0xDECA
+ *           - byte 5..8: 'W' 'A' <id> 'E' tag to anchor, 'V' 'E' <id> 'A' anchor to tag,
+ *                        'D' 'I' <id> 'T' anchor relaying its distance to the master anchor
+ *           - byte 9: function code
+ *           - timestamps (final, SS response): 5 bytes each, the 40 bits of the DW1000
+ *             system time, least significant byte first, see twr_ts.h
+ *          The anchor address <id> is '1', '2', '3', ... and anchor '1' reports as "DIST A"
+ *          (anchor 'A' of the range reports, see twr_report.h).
+ *
+ *          Broadcast DS TWR (twr_tag_range_all()) ranges N anchors with N + 2
+ *          frames: one poll to all of them (0x22), one response per anchor in
+ *          its own time slot, and one final (0x24) carrying the response RX
+ *          timestamps of every anchor heard. The tag sets the slot timing in
+ *          the poll, the anchors take their slot from their place in its list.
+ *          Relays to the master anchor use the same slots after the final.
+ *
+ *          Each exchange is a small state machine: the engine waits for a
+ *          frame (TWR_STATE_RX), for the end of its last transmission
+ *          (TWR_STATE_TX), or for nothing (TWR_STATE_IDLE). The RX good, RX
+ *          timeout/error and TX done events advance it. They come either from
+ *          polling the status register (default), or with TWR_FLAG_IRQ from
+ *          the dwt_isr() callbacks, in which case the MCU sleeps in
+ *          port_wait_for_irq() or does other work between the events.
+ *
+ *          With TWR_FLAG_DBL_RX an anchor receives into both RX buffer sets
+ *          of the DW1000 (dwt_setdblrxbuffmode()). While it waits for
+ *          requests, it turns the receiver back on as soon as a frame has
+ *          arrived, before reading it, so that the next frame lands in the
+ *          other set while this one is handled. Handing the set back
+ *          (host side buffer toggle) shows the next frame, if any. Frames
+ *          received while the anchor turns around to answer a request are
+ *          dropped and counted.
+ *
+ *          An engine started with twr_engine_init_profiles() has a twr_cfg_t
+ *          for the long range and for the fast radio profile, and switches
+ *          between them as described in twr_profile.h. Its polls carry one
+ *          more byte, the profile announced: after the anchor address list of
+ *          a broadcast poll, at byte 10 of the others. Engines without
+ *          profiles accept those polls and ignore the byte.
+ */
+
+#ifndef TWR_ENGINE_H_
+#define TWR_ENGINE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+#include "dwm_session.h"
+#include "twr_cir.h"
+#include "twr_profile.h"
+#include "twr_telemetry.h"
+#include "twr_ts.h"
+
+/* Function codes */
+#define TWR_FC_DS_POLL          0x21
+#define TWR_FC_DS_RESP          0x10
+#define TWR_FC_DS_FINAL         0x23
+#define TWR_FC_SS_POLL          0xE0
+#define TWR_FC_SS_RESP          0xE1
+#define TWR_FC_RELAY            TWR_FC_DS_POLL  // with the 'D' 'I' <id> 'T' addresses
+#define TWR_FC_BCAST_POLL       0x22
+#define TWR_FC_BCAST_FINAL      0x24
+
+#define TWR_ID_BROADCAST        0xFF    // anchor address of the broadcast frames
+#define TWR_MAX_ANCHORS         8       // anchors of one broadcast exchange
+
+/* Frame fields */
+#define TWR_MSG_SN_IDX          2
+#define TWR_MSG_ADDR_IDX        5
+#define TWR_MSG_ID_IDX          7
+#define TWR_MSG_FC_IDX          9
+#define TWR_MSG_COMMON_LEN      10
+#define TWR_MSG_TS_LEN          TWR_TS_LEN      // 40 bit timestamps, see twr_ts.h
+#define TWR_FINAL_POLL_TX_TS_IDX    10
+#define TWR_FINAL_RESP_RX_TS_IDX    15
+#define TWR_FINAL_FINAL_TX_TS_IDX   20
+#define TWR_RESP_POLL_RX_TS_IDX     10  // SS response
+#define TWR_RESP_RESP_TX_TS_IDX     15
+#define TWR_RELAY_METRES_IDX    11      // relayed distance, whole metres
+#define TWR_RELAY_CM_IDX        13      // and centimetres
+#define TWR_BCAST_N_IDX         10      // broadcast poll: number of anchors
+#define TWR_BCAST_FIRST_IDX     11      //  poll RX to first response TX, UUS (2 bytes)
+#define TWR_BCAST_SLOT_IDX      13      //  slot spacing, UUS (2 bytes)
+#define TWR_BCAST_IDS_IDX       15      //  anchor addresses, in slot order
+#define TWR_POLL_PROFILE_IDX    10      // poll with profiles: profile announced, see twr_profile.h
+#define TWR_BCAST_PROFILE_IDX(n)    (TWR_BCAST_IDS_IDX + (n))   //  same, broadcast poll of n anchors
+#define TWR_BFINAL_POLL_TX_TS_IDX   10  // broadcast final
+#define TWR_BFINAL_FINAL_TX_TS_IDX  15
+#define TWR_BFINAL_N_IDX        20      //  number of entries
+#define TWR_BFINAL_ENTRIES_IDX  21      //  entries of anchor address + response RX timestamp
+#define TWR_BFINAL_ENTRY_LEN    (1 + TWR_MSG_TS_LEN)
+
+/* Frame lengths, FCS included */
+#define TWR_POLL_LEN            12
+#define TWR_DS_RESP_LEN         15
+#define TWR_DS_FINAL_LEN        27
+#define TWR_SS_RESP_LEN         22
+#define TWR_RELAY_LEN           24
+#define TWR_BCAST_POLL_LEN(n)   ((uint32)(TWR_BCAST_IDS_IDX + (n) + 2))
+#define TWR_PROFILE_LEN         1       // added to the poll length by the profile byte
+#define TWR_BFINAL_LEN(n)       ((uint32)(TWR_BFINAL_ENTRIES_IDX + (n) * TWR_BFINAL_ENTRY_LEN + 2))
+
+#define TWR_RX_BUF_LEN          TWR_BFINAL_LEN(TWR_MAX_ANCHORS)    // longest frame handled
+
+#define TWR_ROLE_TAG            0
+#define TWR_ROLE_ANCHOR         1
+
+#define TWR_MODE_DS             0x01
+#define TWR_MODE_SS             0x02
+
+/* Flags */
+#define TWR_FLAG_MASTER         0x01    // anchor: report the distances relayed by the other anchors
+#define TWR_FLAG_RELAY          0x02    // anchor: send each computed distance to the master anchor
+#define TWR_FLAG_IRQ            0x04    // run from the DW1000 interrupt, one such engine per device
+#define TWR_FLAG_DBL_RX         0x08    // anchor: listen for requests with double RX buffering, see above
+#define TWR_FLAG_TELEMETRY      0x10    // send the DW1000 event counts with the reports, see twr_telemetry.h
+#define TWR_FLAG_CIR            0x20    // send channel impulse responses with the reports, see twr_cir.h
+
+/* Exchange states */
+#define TWR_STATE_IDLE          0       // tag: no exchange in progress
+#define TWR_STATE_RX            1       // receiver on, waiting for the frame 'expect' (anchor: any request if 0)
+#define TWR_STATE_TX            2       // last frame of the exchange being sent
+
+/* "DIST A" label of anchor address id, the anchor of its range reports */
+#define TWR_LABEL(id)           ((char)('A' + (id) - '1'))
+
+typedef struct
+{
+    uint8               role;           // TWR_ROLE_xxx
+    uint8               mode;           // TWR_MODE_DS or TWR_MODE_SS
+    uint8               id;             // anchor: own address, e.g. '1'
+    uint8               flags;          // TWR_FLAG_xxx
+    dwm_session_cfg_t   session;        // radio configuration and antenna delays, see below
+    uint16              replyDelayUus;  // anchor: poll RX to response TX; DS tag: response RX to final TX
+    uint16              finalTimeoutUus;// DS anchor: final RX timeout, only set during an exchange
+    uint16              firstSlotUus;   // broadcast tag: anchor poll RX to first response TX
+    uint16              slotUus;        // broadcast tag: spacing of the response (and relay) slots
+} twr_cfg_t;
+
+/* session settings of each role:
+ *  - tag: rxAfterTxDelay and rxTimeout apply to the response, preambleTimeout to every frame. In a broadcast exchange
+ *    they apply to every slot: the receiver goes on as far into each slot as into the first.
+ *  - anchor: rxAfterTxDelay applies to the final (DS), rxTimeout must be 0 (wait for polls without timeout)
+ * A slot must hold a response or a relay frame plus the time to turn the receiver around. */
+
+typedef struct
+{
+    uint32  polls;          // tag: polls sent, anchor: polls answered
+    uint32  ranges;         // distances computed here
+    uint32  relays;         // anchor: distances sent to (relay) or received by (master) the master anchor
+    uint32  rx_errors;      // receive timeouts and errors
+    uint32  late_tx;        // delayed transmissions refused by dwt_starttx()
+    uint32  ignored;        // frames with no table entry, unexpected, or addressed to another device
+    uint32  switches;       // changes of radio profile
+    uint32  rx_dropped;     // TWR_FLAG_DBL_RX: frames waiting in the other RX buffer when turning around to answer
+    uint32  rx_overruns;    // TWR_FLAG_DBL_RX: receiver overruns (RXOVRR), a frame lost with both RX buffers full
+} twr_stats_t;
+
+/* Radio profiles of an engine, see twr_engine_init_profiles() */
+typedef struct
+{
+    const twr_cfg_t    *cfg[TWR_NUM_PROFILES];  // TWR_PROFILE_xxx settings, all with the same role, mode, id and flags
+    twr_link_policy_t   policy;
+} twr_profiles_t;
+
+typedef struct
+{
+    const twr_cfg_t    *cfg;
+    const twr_profiles_t *profiles;     // NULL if started with twr_engine_init()
+    dwm_session_t       session;
+    volatile uint8      state;          // TWR_STATE_xxx, changed by the DW1000 interrupt with TWR_FLAG_IRQ
+    uint8               seq;            // frame sequence number
+    uint8               peer;           // tag: anchor being ranged
+    uint8               expect;         // function code of the next frame of the exchange, 0 if none
+    volatile int        result;         // tag: DWT_SUCCESS once the exchange has completed
+    uint32              irq_inits;      // session full_inits count the interrupt mask was set for
+    uint32              dbl_inits;      // session full_inits count double RX buffering was enabled for
+    uint32              evc_inits;      // session full_inits count the event counters were enabled for
+    uint8               rx_on;          // TWR_FLAG_DBL_RX: receiver back on while the frame received is handled
+    dwt_rxsnapshot_t    rx;             // frame being handled: length, RX timestamp, and what its handler needs
+    uint16              rx_timeout;     // current RX timeout, UUS
+    uint32              rx_after_tx;    // current RX after TX delay, UUS
+    twr_ts_t            poll_rx_ts;     // anchor: poll RX timestamp of the exchange
+    twr_ts_t            poll_tx_ts;     // broadcast tag: poll TX timestamp
+    uint8               n_slots;        // anchors of the current broadcast exchange, 0 if not broadcast
+    uint8               slot;           // own slot (anchor) or slot being received (tag)
+    uint16              first_uus;      // anchor: slot timing of the current broadcast exchange
+    uint16              slot_uus;
+    uint8               heard;          // tag: slots with a response
+    uint8               anchors[TWR_MAX_ANCHORS];   // broadcast tag: anchor of each slot
+    uint8               slot_ok[TWR_MAX_ANCHORS];
+    twr_ts_t            resp_rx_ts[TWR_MAX_ANCHORS];
+    int32               distance_mm;    // last distance, mm
+    uint8               profile;        // TWR_PROFILE_xxx in use
+    uint8               announced;      // tag: profile of its last poll, anchor: of the last tag poll heard
+    int16               level_dbm;      // tag: weakest response of the exchange, see twr_link_level_dbm()
+    uint32              poll_heard;     // fast anchor: dwt_readsystimestamphi32() at the last tag poll heard
+    twr_link_t          link;           // tag
+    twr_stats_t         stats;
+    twr_telemetry_t     telemetry;      // TWR_FLAG_TELEMETRY
+    twr_cir_t           cir;            // TWR_FLAG_CIR
+    uint8               rx_buf[TWR_RX_BUF_LEN];
+} twr_engine_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_engine_init()
+ *
+ * @brief Bind the engine to cfg and make sure the DW1000 is configured, see dwm_session_open(). The first call, or a call
+ *        with another cfg, resets the engine state. Later calls with the same cfg cost no SPI access, so a tag can call it
+ *        before every round.
+ *
+ * input parameters
+ * @param e   - engine, zero initialised before the first call
+ * @param cfg - settings, must stay valid while the engine is in use
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS, or DWT_ERROR if the DW1000 could not be initialised
+ */
+int twr_engine_init(twr_engine_t *e, const twr_cfg_t *cfg);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_engine_init_profiles()
+ *
+ * @brief twr_engine_init() for an engine that switches between the radio profiles of 'profiles', see twr_profile.h. It
+ *        starts on TWR_PROFILE_LONG. The first call, or a call with other profiles, resets the engine state; later
+ *        calls keep the profile in use. A fast anchor profile needs a preamble timeout, so that the anchor notices the
+ *        silence of the tag and can fall back to the long range profile.
+ *
+ * input parameters
+ * @param e        - engine, zero initialised before the first call
+ * @param profiles - settings of each profile, must stay valid while the engine is in use
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS, or DWT_ERROR if the DW1000 could not be initialised
+ */
+int twr_engine_init_profiles(twr_engine_t *e, const twr_profiles_t *profiles);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_tag_range()
+ *
+ * @brief Run one exchange with anchor 'anchor': send the poll and handle the response. In DS mode the final message is
+ *        sent and the anchor computes the distance. In SS mode the distance is computed here, queued as a range
+ *        report (see twr_report.h) and left in e->distance_mm. Queued reports are sent at the end of the exchange.
+ *
+ * input parameters
+ * @param e      - tag engine
+ * @param anchor - address of the anchor, e.g. '1'
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS if the exchange completed, DWT_ERROR otherwise
+ */
+int twr_tag_range(twr_engine_t *e, uint8 anchor);
+
+/* twr_tag_range() without the wait: send the poll and return. The exchange has ended when twr_engine_busy() returns 0,
+ * e->result then tells whether it completed. With TWR_FLAG_IRQ the caller is free until then; without, it has to call
+ * twr_engine_step() until then. */
+void twr_tag_start(twr_engine_t *e, uint8 anchor);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_tag_range_all()
+ *
+ * @brief Broadcast DS TWR with n anchors: one poll, a response from each anchor in its slot, one final. Each anchor heard
+ *        computes its distance from the final.
+ *
+ * input parameters
+ * @param e       - tag engine, DS mode, with firstSlotUus and slotUus set
+ * @param anchors - anchor addresses, in slot order
+ * @param n       - number of anchors, 1 to TWR_MAX_ANCHORS
+ *
+ * output parameters
+ *
+ * returns the number of anchors included in the final message, 0 if none answered or the final could not be sent
+ */
+int twr_tag_range_all(twr_engine_t *e, const uint8 *anchors, uint8 n);
+
+/* twr_tag_range_all() without the wait, see twr_tag_start(). Once done, e->heard anchors are in the final message if
+ * e->result is DWT_SUCCESS. Returns DWT_ERROR, and starts nothing, if the arguments are invalid. */
+int twr_tag_start_all(twr_engine_t *e, const uint8 *anchors, uint8 n);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_anchor_run()
+ *
+ * @brief Answer ranging requests forever. Distances are queued as range reports, sent between events, and, with
+ *        TWR_FLAG_RELAY, sent to the master anchor.
+ *
+ * input parameters
+ * @param e - anchor engine
+ *
+ * no return value
+ */
+void twr_anchor_run(twr_engine_t *e);
+
+/* twr_anchor_run() without the loop: turn the receiver on for the first request. The caller then calls
+ * twr_engine_step() whenever it likes. */
+void twr_anchor_start(twr_engine_t *e);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_engine_step()
+ *
+ * @brief Wait for the next event of the exchange and handle it. Polled: busy waits on the status register for the frame
+ *        or the end of transmission expected by e->state. TWR_FLAG_IRQ: sleeps in port_wait_for_irq() until the next
+ *        interrupt, which does the work. twr_anchor_run() and twr_tag_range() are loops around it. Before waiting, it
+ *        sends the queued reports and, with TWR_FLAG_TELEMETRY and no frame awaited, samples the event counters.
+ *
+ * input parameters
+ * @param e - engine
+ *
+ * no return value
+ */
+void twr_engine_step(twr_engine_t *e);
+
+/* Non-zero while an exchange of the tag is in progress */
+int twr_engine_busy(const twr_engine_t *e);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TWR_ENGINE_H_ */
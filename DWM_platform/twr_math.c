@@ -0,0 +1,254 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_math.c
+ * @brief   Integer time of flight and distance of the DS and SS TWR exchanges, see twr_math.h
+ */
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+#include "twr_math.h"
+
+/* Speed of light in air, used to calculate distance, m/s */
+#define SPEED_OF_LIGHT      299702547
+
+/* One DTU is 1 / (128 * 499.2 MHz) = 1 / (975 * 2^16) us, so tof_dtu * c / (975 * 2^16) is a distance in mm */
+#define DTU_PER_US_975      975
+#define DTU_PER_US_SHIFT    16
+
+/* FREQ_OFFSET_MULTIPLIER * HERTZ_TO_PPM_MULTIPLIER / 1e6 = -998.4 MHz / (2^28 * carrier frequency). The carrier
+ * frequencies are 998.4 MHz times 7/2 (channel 1), 4 (channels 2 and 4), 9/2 (channel 3) or 13/2 (channels 5 and 7),
+ * so the clock offset ratio is -carrier_integrator * a / (b * 2^28), 2^31 at 110 kb/s. */
+#define FREQ_OFFSET_SHIFT       28
+#define FREQ_OFFSET_SHIFT_110KB 31
+
+/* dwt_readcarrierintegrator() returns a 21 bit signed value */
+#define CARRIER_INTEGRATOR_MAX  ((1L << 20) - 1)
+
+/* Add v * 2^(32 * limb) to the 128 bit number w, least significant limb first */
+static void u128_add(uint32_t w[4], uint64_t v, int limb)
+{
+    uint64_t t;
+
+    for (; limb < 4; limb++)
+    {
+        t = (uint64_t)w[limb] + (uint32_t)v;
+        w[limb] = (uint32_t)t;
+        v = (v >> 32) + (t >> 32);
+    }
+}
+
+/*
+ * Rounded n * c / (div * 2^shift), with n a magnitude and neg its sign, saturated to the int32 range. The 93 bit
+ * product is built from 32 x 32 bit products, the rounding (half away from zero) is added before the shift, and the
+ * shifted value is divided by div one 32 bit limb at a time. 1 <= shift <= 63 and div < 2^31.
+ */
+static int32 scale_by_c(uint64_t n, int neg, uint32_t div, int shift)
+{
+    uint32_t w[4];
+    uint64_t t;
+    uint64_t rem;
+    int32 q;
+    int i;
+
+    t = (uint64_t)(uint32_t)n * SPEED_OF_LIGHT;
+    w[0] = (uint32_t)t;
+    t = (t >> 32) + (uint64_t)(uint32_t)(n >> 32) * SPEED_OF_LIGHT;
+    w[1] = (uint32_t)t;
+    w[2] = (uint32_t)(t >> 32);
+    w[3] = 0;
+
+    /* + div * 2^shift / 2 */
+    u128_add(w, (uint64_t)div << ((shift - 1) & 31), (shift - 1) >> 5);
+
+    /* >> shift */
+    for (; shift >= 32; shift -= 32)
+    {
+        w[0] = w[1];
+        w[1] = w[2];
+        w[2] = w[3];
+        w[3] = 0;
+    }
+    if (shift > 0)
+    {
+        for (i = 0; i < 3; i++)
+        {
+            w[i] = (w[i] >> shift) | (w[i + 1] << (32 - shift));
+        }
+        w[3] >>= shift;
+    }
+
+    /* / div */
+    rem = 0;
+    for (i = 3; i >= 0; i--)
+    {
+        t = (rem << 32) | w[i];
+        w[i] = (uint32_t)(t / div);
+        rem = t % div;
+    }
+
+    q = (w[3] | w[2] | w[1] || w[0] > INT32_MAX) ? INT32_MAX : (int32)w[0];
+    return neg ? -q : q;
+}
+
+/* 128 bit product of a and b, least significant limb first */
+static void u128_mul(uint32_t w[4], uint64_t a, uint64_t b)
+{
+    uint64_t t;
+
+    t = (uint64_t)(uint32_t)a * (uint32_t)b;
+    w[0] = (uint32_t)t;
+    w[1] = (uint32_t)(t >> 32);
+    w[2] = 0;
+    w[3] = 0;
+    u128_add(w, (uint64_t)(uint32_t)a * (uint32_t)(b >> 32), 1);
+    u128_add(w, (uint64_t)(uint32_t)(a >> 32) * (uint32_t)b, 1);
+    u128_add(w, (a >> 32) * (b >> 32), 2);
+}
+
+/* w -= v, w >= v */
+static void u128_sub(uint32_t w[4], const uint32_t v[4])
+{
+    uint64_t t;
+    uint32_t borrow = 0;
+    int i;
+
+    for (i = 0; i < 4; i++)
+    {
+        t = (uint64_t)w[i] - v[i] - borrow;
+        w[i] = (uint32_t)t;
+        borrow = (uint32_t)(t >> 63);
+    }
+}
+
+/* w >= v */
+static int u128_ge(const uint32_t w[4], const uint32_t v[4])
+{
+    int i;
+
+    for (i = 3; i > 0 && w[i] == v[i]; i--)
+    { };
+    return w[i] >= v[i];
+}
+
+/* w / div, 16 bits at a time so that the remainder and the next digit fit in 64 bits. The quotient fits in 64 bits and
+ * div < 2^48. */
+static uint64_t u128_div(const uint32_t w[4], uint64_t div)
+{
+    uint64_t q = 0;
+    uint64_t rem = 0;
+    uint64_t t;
+    int i;
+
+    for (i = 7; i >= 0; i--)
+    {
+        t = (rem << 16) | ((w[i >> 1] >> ((i & 1) * 16)) & 0xFFFF);
+        q = (q << 16) | (t / div);
+        rem = t % div;
+    }
+    return q;
+}
+
+int64_t twr_ds_tof_dtu(uint64_t Ra, uint64_t Rb, uint64_t Da, uint64_t Db)
+{
+    uint32_t round_trips[4], replies[4];
+    uint64_t den;
+
+    if (Ra > TWR_DS_MAX_INTERVAL || Rb > TWR_DS_MAX_INTERVAL || Da > TWR_DS_MAX_INTERVAL || Db > TWR_DS_MAX_INTERVAL)
+    {
+        return 0;
+    }
+    den = Ra + Rb + Da + Db;
+
+    /* |Ra * Rb - Da * Db| / den <= max(Ra, Da), the quotient always fits */
+    if (den == 0)
+    {
+        return 0;
+    }
+
+    /* Intervals under 67 ms, those of every exchange of the examples: 64 bit products */
+    if (((Ra | Rb | Da | Db) >> 32) == 0)
+    {
+        uint64_t rt = Ra * Rb;
+        uint64_t rp = Da * Db;
+
+        if (rt >= rp)
+        {
+            return (int64_t)((rt - rp) / den);
+        }
+        return -(int64_t)((rp - rt) / den);
+    }
+
+    /* Up to 80 bit products, 42 bit denominator */
+    u128_mul(round_trips, Ra, Rb);
+    u128_mul(replies, Da, Db);
+    if (u128_ge(round_trips, replies))
+    {
+        u128_sub(round_trips, replies);
+        return (int64_t)u128_div(round_trips, den);
+    }
+    u128_sub(replies, round_trips);
+    return -(int64_t)u128_div(replies, den);
+}
+
+int32 twr_dtu_to_distance(int64_t tof_dtu, uint32 unit)
+{
+    uint64_t n = (tof_dtu < 0) ? 0 - (uint64_t)tof_dtu : (uint64_t)tof_dtu;
+
+    return scale_by_c(n, tof_dtu < 0, DTU_PER_US_975 * unit, DTU_PER_US_SHIFT);
+}
+
+int32 twr_ss_distance(int64_t rtd_init, int64_t rtd_resp, int32 carrier_integrator, const dwt_config_t *config,
+                      uint32 unit)
+{
+    int64_t diff = rtd_init - rtd_resp;
+    int shift = (config->dataRate == DWT_BR_110K) ? FREQ_OFFSET_SHIFT_110KB : FREQ_OFFSET_SHIFT;
+    uint32_t a, b;
+    int64_t n;
+
+    switch (config->chan)
+    {
+    case 1:
+        a = 2; b = 7;
+        break;
+    case 2:
+    case 4:
+        a = 1; b = 4;
+        break;
+    case 3:
+        a = 2; b = 9;
+        break;
+    default:
+        a = 2; b = 13;
+        break;
+    }
+
+    if (rtd_resp > TWR_SS_MAX_RTD)
+    {
+        rtd_resp = TWR_SS_MAX_RTD;
+    }
+    else if (rtd_resp < -TWR_SS_MAX_RTD)
+    {
+        rtd_resp = -TWR_SS_MAX_RTD;
+    }
+    if (diff > TWR_SS_MAX_RTD_DIFF)
+    {
+        diff = TWR_SS_MAX_RTD_DIFF;
+    }
+    else if (diff < -TWR_SS_MAX_RTD_DIFF)
+    {
+        diff = -TWR_SS_MAX_RTD_DIFF;
+    }
+    if (carrier_integrator > CARRIER_INTEGRATOR_MAX)
+    {
+        carrier_integrator = CARRIER_INTEGRATOR_MAX;
+    }
+    else if (carrier_integrator < -CARRIER_INTEGRATOR_MAX)
+    {
+        carrier_integrator = -CARRIER_INTEGRATOR_MAX;
+    }
+
+    /* 2 * tof_dtu * b * 2^shift = diff * b * 2^shift - rtd_resp * carrier_integrator * a, below 2^62 + 2^61 */
+    n = diff * (int64_t)b * ((int64_t)1 << shift) - (int64_t)rtd_resp * carrier_integrator * (int64_t)a;
+
+    return scale_by_c((n < 0) ? 0 - (uint64_t)n : (uint64_t)n, n < 0, DTU_PER_US_975 * b * unit,
+                      shift + 1 + DTU_PER_US_SHIFT);
+}
@@ -0,0 +1,103 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_math.h
+ * @brief   Integer time of flight and distance of the DS and SS TWR exchanges
+ *
+ *          The examples computed the distance in double, and the SS clock
+ *          offset ratio in float. The STM32L4 FPU is single precision only, so
+ *          every double operation was a library call. Here everything is done
+ *          with 32 x 32 -> 64 bit products and, where the result needs it, a
+ *          128 bit intermediate made of 32 bit limbs. The intervals are those
+ *          of the 40 bit timestamps (twr_ts.h): DS intervals over 2^32 DTU
+ *          (67 ms) take the 128 bit path, the others the 64 bit one.
+ *
+ *          The results are the exact values of the formulas, rounded:
+ *           - DS: tof_dtu = (Ra * Rb - Da * Db) / (Ra + Rb + Da + Db), truncated
+ *             toward zero as the (int64_t) cast of the double version
+ *           - SS: tof = (rtd_init - rtd_resp * (1 - clockOffsetRatio)) / 2, with
+ *             the clock offset ratio taken as the exact rational that the
+ *             FREQ_OFFSET_MULTIPLIER and HERTZ_TO_PPM_MULTIPLIER constants of
+ *             deca_device_api.h reduce to
+ *           - distances: tof * c, rounded half away from zero to the unit
+ *          Host/twr_math_bench.c checks them against a 128 bit reference and
+ *          times them against the double version.
+ */
+
+#ifndef TWR_MATH_H_
+#define TWR_MATH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+
+/* Distance units, as a number of millimetres */
+#define TWR_UNIT_MM         1
+#define TWR_UNIT_CM         10
+
+/* Largest |rtd_init - rtd_resp| handled by twr_ss_distance(), DTU (2.1 ms, far beyond any radio range) */
+#define TWR_SS_MAX_RTD_DIFF ((1L << 27) - 1)
+
+/* Largest |rtd_resp| of twr_ss_distance() and interval of twr_ds_tof_dtu(), DTU: the 40 bit system time, 17.2 s */
+#define TWR_SS_MAX_RTD      (((int64_t)1 << 40) - 1)
+#define TWR_DS_MAX_INTERVAL (((uint64_t)1 << 40) - 1)
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_ds_tof_dtu()
+ *
+ * @brief DS TWR time of flight from the round trip (Ra, Rb) and reply (Da, Db) times, see NOTE 12 of the DS responder.
+ *
+ * input parameters
+ * @param Ra - initiator: response RX - poll TX, DTU
+ * @param Rb - responder: final RX - response TX, DTU
+ * @param Da - initiator: final TX - response RX, DTU
+ * @param Db - responder: response TX - poll RX, DTU
+ *
+ * output parameters
+ *
+ * returns the time of flight in DTU, truncated toward zero, 0 if all times are 0 or one is above TWR_DS_MAX_INTERVAL
+ */
+int64_t twr_ds_tof_dtu(uint64_t Ra, uint64_t Rb, uint64_t Da, uint64_t Db);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_dtu_to_distance()
+ *
+ * @brief Distance travelled at the speed of light in air during tof_dtu.
+ *
+ * input parameters
+ * @param tof_dtu - time of flight, DTU
+ * @param unit    - TWR_UNIT_MM or TWR_UNIT_CM
+ *
+ * output parameters
+ *
+ * returns the distance in unit, rounded
+ */
+int32 twr_dtu_to_distance(int64_t tof_dtu, uint32 unit);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_ss_distance()
+ *
+ * @brief SS TWR distance, corrected for the clock offset of the responder as measured by the carrier integrator. See
+ *        NOTE 11 of the SS initiator.
+ *
+ * input parameters
+ * @param rtd_init           - initiator: response RX - poll TX, DTU
+ * @param rtd_resp           - responder: response TX - poll RX, DTU
+ * @param carrier_integrator - dwt_readcarrierintegrator() at the response
+ * @param config             - radio configuration, for the channel and data rate
+ * @param unit               - TWR_UNIT_MM or TWR_UNIT_CM
+ *
+ * output parameters
+ *
+ * returns the distance in unit, rounded. |rtd_init - rtd_resp| is limited to TWR_SS_MAX_RTD_DIFF, |rtd_resp| to
+ *         TWR_SS_MAX_RTD.
+ */
+int32 twr_ss_distance(int64_t rtd_init, int64_t rtd_resp, int32 carrier_integrator, const dwt_config_t *config,
+                      uint32 unit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TWR_MATH_H_ */
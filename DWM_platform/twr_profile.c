@@ -0,0 +1,91 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_profile.c
+ * @brief   Choice between the long range and the fast radio profiles, see twr_profile.h
+ */
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+#include "twr_profile.h"
+
+/* The constant A of the RX level formula, tenths of dB */
+#define RX_LEVEL_A_PRF16        1138
+#define RX_LEVEL_A_PRF64        1217
+
+/* 10 * log10(2^17), tenths of dB */
+#define RX_LEVEL_2_POW_17       512
+
+/* 10 * log10(1 + (i + 0.5) / 16), tenths of dB */
+static const uint8 db10_frac[16] = { 1, 4, 6, 9, 11, 13, 15, 17, 19, 20, 22, 24, 25, 27, 28, 29 };
+
+/* 10 * log10(x) in tenths of dB, x > 0: 3.0103 dB per bit of the leading one, then the 4 bits after it */
+static int32 db10(uint32 x)
+{
+    int32 k = 31;
+
+    while (!(x & 0x80000000UL))
+    {
+        x <<= 1;
+        k--;
+    }
+    return (k * 30103 + 500) / 1000 + db10_frac[(x >> 27) & 0xF];
+}
+
+int16 twr_link_level_dbm(const dwt_rxdiag_t *diag, uint8 prf)
+{
+    int32 level;
+
+    if (diag->maxGrowthCIR == 0 || diag->rxPreamCount == 0)
+    {
+        return TWR_LEVEL_NONE;
+    }
+
+    /* 10 * log10(C * 2^17 / N^2) - A */
+    level = db10(diag->maxGrowthCIR) + RX_LEVEL_2_POW_17 - 2 * db10(diag->rxPreamCount) -
+            ((prf == DWT_PRF_64M) ? RX_LEVEL_A_PRF64 : RX_LEVEL_A_PRF16);
+
+    /* Rounded to whole dBm, the level is negative */
+    return (int16)((level - 5) / 10);
+}
+
+uint8 twr_link_update(twr_link_t *link, const twr_link_policy_t *policy, uint8 profile, int ok, int16 level_dbm)
+{
+    link->level_dbm = ok ? level_dbm : TWR_LEVEL_NONE;
+
+    if (profile == TWR_PROFILE_LONG)
+    {
+        /* Strong enough for a while: short frames from now on */
+        link->fails = 0;
+        if (ok && level_dbm != TWR_LEVEL_NONE && level_dbm > policy->fastEnterDbm)
+        {
+            if (++link->good >= policy->fastEnterCount)
+            {
+                link->want = TWR_PROFILE_FAST;
+                link->good = 0;
+            }
+        }
+        else
+        {
+            link->want = TWR_PROFILE_LONG;
+            link->good = 0;
+        }
+        return link->want;
+    }
+
+    /* FAST: back to long frames when getting weak, or when the anchors stop answering */
+    link->good = 0;
+    if (!ok)
+    {
+        if (++link->fails >= policy->fastMaxFails)
+        {
+            link->want = TWR_PROFILE_LONG;
+            link->fails = 0;
+        }
+        return link->want;
+    }
+    link->fails = 0;
+    if (level_dbm != TWR_LEVEL_NONE && level_dbm < policy->fastLeaveDbm)
+    {
+        link->want = TWR_PROFILE_LONG;
+    }
+    return link->want;
+}
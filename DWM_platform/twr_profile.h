@@ -0,0 +1,99 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_profile.h
+ * @brief   Choice between the long range and the fast radio profiles
+ *
+ *          The examples range at 110 kb/s with a 1024 symbol preamble: about
+ *          2.5 ms on air per frame, needed for the far anchors. A tag near its
+ *          anchors gets the same results from 6.8 Mb/s frames with a 128
+ *          symbol preamble, about 0.2 ms each. An engine given a twr_profiles_t
+ *          (see twr_engine.h) holds a twr_cfg_t for each and switches between
+ *          them per exchange, see dwm_session_open():
+ *           - the tag picks the profile from the RX level of the responses
+ *             and the exchanges that failed, see twr_link_update()
+ *           - each tag poll carries the profile the tag will use from its
+ *             next poll on. Every anchor that hears it, whoever it is
+ *             addressed to, takes that profile at the end of the exchange
+ *             (before its relay, for the anchor polled), so that the relays
+ *             reach the master anchor.
+ *           - an anchor on the fast profile goes back to the long range one
+ *             after holdUus without a tag poll: the tag may have left the
+ *             fast profile's range, or missed it, and polls at 110 kb/s
+ *
+ *          One profile for all the anchors that hear each other: tags that
+ *          need different profiles do not share anchors.
+ */
+
+#ifndef TWR_PROFILE_H_
+#define TWR_PROFILE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+
+#define TWR_PROFILE_LONG        0       // 110 kb/s, long preamble
+#define TWR_PROFILE_FAST        1       // 6.8 Mb/s, short preamble
+#define TWR_NUM_PROFILES        2
+
+/* twr_link_level_dbm() of a frame without diagnostics */
+#define TWR_LEVEL_NONE          0x7FFF
+
+typedef struct
+{
+    int16   fastEnterDbm;   // tag: LONG -> FAST after fastEnterCount exchanges in a row with every response above this
+    int16   fastLeaveDbm;   // tag: FAST -> LONG on an exchange with a response below this
+    uint8   fastEnterCount;
+    uint8   fastMaxFails;   // tag: FAST -> LONG after this many failed exchanges in a row
+    uint32  holdUus;        // anchor: FAST -> LONG after this long without a tag poll, at most 16 s
+} twr_link_policy_t;
+
+/* Tag link state, zero initialised */
+typedef struct
+{
+    uint8   want;           // TWR_PROFILE_xxx the tag announces in its next poll
+    uint8   good;           // LONG: exchanges in a row above fastEnterDbm
+    uint8   fails;          // FAST: failed exchanges in a row
+    int16   level_dbm;      // weakest response of the last exchange, TWR_LEVEL_NONE if none
+} twr_link_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_link_level_dbm()
+ *
+ * @brief Estimated RX level of the frame just received, from the CIR power and the preamble accumulation count of its
+ *        diagnostics (DW1000 user manual 4.7.2), in whole dBm. Integer arithmetic only, within 0.3 dB.
+ *
+ * input parameters
+ * @param diag - see dwt_readdiagnostics()
+ * @param prf  - DWT_PRF_16M or DWT_PRF_64M
+ *
+ * output parameters
+ *
+ * returns the level in dBm, TWR_LEVEL_NONE if the diagnostics are empty
+ */
+int16 twr_link_level_dbm(const dwt_rxdiag_t *diag, uint8 prf);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_link_update()
+ *
+ * @brief Tag: account for an exchange run with profile 'profile' and decide the profile of the next ones.
+ *
+ * input parameters
+ * @param link      - tag link state
+ * @param policy    - thresholds
+ * @param profile   - TWR_PROFILE_xxx of the exchange
+ * @param ok        - non-zero if the exchange completed
+ * @param level_dbm - weakest response of the exchange, TWR_LEVEL_NONE if none
+ *
+ * output parameters
+ *
+ * returns link->want, the profile to announce
+ */
+uint8 twr_link_update(twr_link_t *link, const twr_link_policy_t *policy, uint8 profile, int ok, int16 level_dbm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TWR_PROFILE_H_ */
@@ -0,0 +1,368 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_report.c
+ * @brief   Encoding and stream decoding of the binary range reports, see twr_report.h
+ */
+
+#include <string.h>
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+#include "twr_report.h"
+
+static void put16(uint8 *p, uint16 v)
+{
+    p[0] = (uint8)v;
+    p[1] = (uint8)(v >> 8);
+}
+
+static void put32(uint8 *p, uint32 v)
+{
+    p[0] = (uint8)v;
+    p[1] = (uint8)(v >> 8);
+    p[2] = (uint8)(v >> 16);
+    p[3] = (uint8)(v >> 24);
+}
+
+static uint16 get16(const uint8 *p)
+{
+    return (uint16)(p[0] | (p[1] << 8));
+}
+
+static uint32 get32(const uint8 *p)
+{
+    return (uint32)p[0] | ((uint32)p[1] << 8) | ((uint32)p[2] << 16) | ((uint32)p[3] << 24);
+}
+
+static uint16 fletcher16(const uint8 *p, uint16 len)
+{
+    uint16 s1 = 0, s2 = 0;
+
+    while (len--)
+    {
+        s1 = (uint16)((s1 + *p++) % 255);
+        s2 = (uint16)((s2 + s1) % 255);
+    }
+    return (uint16)((s2 << 8) | s1);
+}
+
+uint16 twr_report_encode(const twr_range_report_t *r, uint8 *buf)
+{
+    uint8 *p = &buf[TWR_RPT_HDR_LEN];
+    int i;
+
+    buf[0] = TWR_RPT_SYNC0;
+    buf[1] = TWR_RPT_SYNC1;
+    buf[2] = TWR_RPT_RANGE;
+    buf[3] = TWR_RPT_RANGE_LEN;
+
+    put16(&p[TWR_RPT_SEQ_IDX], r->seq);
+    p[TWR_RPT_ANCHOR_IDX] = r->anchor;
+    p[TWR_RPT_EXCHANGE_IDX] = r->exchange;
+    p[TWR_RPT_KIND_IDX] = r->kind;
+    p[TWR_RPT_KIND_IDX + 1] = 0;
+    put32(&p[TWR_RPT_DISTANCE_IDX], (uint32)r->distance_mm);
+    for (i = 0; i < TWR_RPT_N_TS; i++)
+    {
+        put32(&p[TWR_RPT_TS_IDX + 4 * i], r->ts[i]);
+    }
+    put16(&p[TWR_RPT_QUALITY_IDX], r->quality.fp_index);
+    put16(&p[TWR_RPT_QUALITY_IDX + 2], r->quality.fp_amp1);
+    put16(&p[TWR_RPT_QUALITY_IDX + 4], r->quality.fp_amp2);
+    put16(&p[TWR_RPT_QUALITY_IDX + 6], r->quality.fp_amp3);
+    put16(&p[TWR_RPT_QUALITY_IDX + 8], r->quality.cir_power);
+    put16(&p[TWR_RPT_QUALITY_IDX + 10], r->quality.std_noise);
+    put16(&p[TWR_RPT_QUALITY_IDX + 12], r->quality.rx_pacc);
+    put16(&p[TWR_RPT_DROPPED_IDX], r->dropped);
+
+    put16(&p[TWR_RPT_RANGE_LEN], fletcher16(buf, TWR_RPT_HDR_LEN + TWR_RPT_RANGE_LEN));
+    return TWR_RPT_MAX_FRAME;
+}
+
+uint16 twr_report_encode_trace(const twr_trace_report_t *t, uint8 *buf)
+{
+    uint8 *p = &buf[TWR_RPT_HDR_LEN];
+    int i;
+
+    buf[0] = TWR_RPT_SYNC0;
+    buf[1] = TWR_RPT_SYNC1;
+    buf[2] = TWR_RPT_TRACE;
+    buf[3] = TWR_RPT_TRACE_LEN;
+
+    p[TWR_RPT_TR_PHASE_IDX] = t->phase;
+    p[TWR_RPT_TR_PHASE_IDX + 1] = 0;
+    put32(&p[TWR_RPT_TR_COUNT_IDX], t->count);
+    put32(&p[TWR_RPT_TR_CPU_HZ_IDX], t->cpu_hz);
+    put32(&p[TWR_RPT_TR_CYCLES_IDX], t->cycles_min);
+    put32(&p[TWR_RPT_TR_CYCLES_IDX + 4], t->cycles_mean);
+    put32(&p[TWR_RPT_TR_CYCLES_IDX + 8], t->cycles_max);
+    put32(&p[TWR_RPT_TR_DEVICE_IDX], t->device_mean);
+    put32(&p[TWR_RPT_TR_SPI_IDX], t->spi_xfers);
+    put32(&p[TWR_RPT_TR_SPI_IDX + 4], t->spi_bytes);
+    put32(&p[TWR_RPT_TR_POLLS_IDX], t->polls);
+    for (i = 0; i < TWR_RPT_TR_BUCKETS; i++)
+    {
+        put32(&p[TWR_RPT_TR_HIST_IDX + 4 * i], t->hist[i]);
+    }
+
+    put16(&p[TWR_RPT_TRACE_LEN], fletcher16(buf, TWR_RPT_HDR_LEN + TWR_RPT_TRACE_LEN));
+    return TWR_RPT_TRACE_FRAME;
+}
+
+uint16 twr_report_encode_telemetry(const twr_telemetry_report_t *t, uint8 *buf)
+{
+    uint8 *p = &buf[TWR_RPT_HDR_LEN];
+    int i;
+
+    buf[0] = TWR_RPT_SYNC0;
+    buf[1] = TWR_RPT_SYNC1;
+    buf[2] = TWR_RPT_TELEMETRY;
+    buf[3] = TWR_RPT_TELEMETRY_LEN;
+
+    p[TWR_RPT_TM_NODE_IDX] = t->node;
+    p[TWR_RPT_TM_NODE_IDX + 1] = 0;
+    put16(&p[TWR_RPT_TM_SEQ_IDX], t->seq);
+    put32(&p[TWR_RPT_TM_MS_IDX], t->period_ms);
+    for (i = 0; i < TWR_RPT_TM_NUM_COUNTS; i++)
+    {
+        put16(&p[TWR_RPT_TM_COUNTS_IDX + 2 * i], t->counts[i]);
+    }
+
+    put16(&p[TWR_RPT_TELEMETRY_LEN], fletcher16(buf, TWR_RPT_HDR_LEN + TWR_RPT_TELEMETRY_LEN));
+    return TWR_RPT_TELEMETRY_FRAME;
+}
+
+/* One part of a CIR sample, see TWR_RPT_CIR_ESCAPE. Returns the bytes written. */
+static uint16 put_delta(uint8 *p, int16 prev, int16 v)
+{
+    int32 d = (int32)v - prev;
+
+    if (d >= -127 && d <= 127)
+    {
+        p[0] = (uint8)(int8)d;
+        return 1;
+    }
+    p[0] = TWR_RPT_CIR_ESCAPE;
+    put16(&p[1], (uint16)v);
+    return 3;
+}
+
+uint16 twr_report_encode_cir(const twr_cir_report_t *c, uint8 *buf)
+{
+    uint8 *p = &buf[TWR_RPT_HDR_LEN];
+    uint16 len = TWR_RPT_CIR_DATA_IDX;
+    int16 re = 0, im = 0;
+    int i;
+
+    buf[0] = TWR_RPT_SYNC0;
+    buf[1] = TWR_RPT_SYNC1;
+    buf[2] = TWR_RPT_CIR;
+
+    p[TWR_RPT_CIR_NODE_IDX] = c->node;
+    p[TWR_RPT_CIR_PIECE_IDX] = c->piece;
+    p[TWR_RPT_CIR_PIECES_IDX] = c->pieces;
+    p[TWR_RPT_CIR_COUNT_IDX] = c->count;
+    put16(&p[TWR_RPT_CIR_SEQ_IDX], c->seq);
+    put16(&p[TWR_RPT_CIR_FP_IDX], c->fp_index);
+    put16(&p[TWR_RPT_CIR_START_IDX], c->start);
+    for (i = 0; i < c->count && i < TWR_RPT_CIR_MAX_SAMPLES; i++)
+    {
+        len += put_delta(&p[len], re, c->re[i]);
+        len += put_delta(&p[len], im, c->im[i]);
+        re = c->re[i];
+        im = c->im[i];
+    }
+    buf[3] = (uint8)len;
+
+    put16(&p[len], fletcher16(buf, TWR_RPT_HDR_LEN + len));
+    return TWR_RPT_HDR_LEN + len + TWR_RPT_CHECK_LEN;
+}
+
+static void decode_trace(const uint8 *p, twr_trace_report_t *t)
+{
+    int i;
+
+    t->phase = p[TWR_RPT_TR_PHASE_IDX];
+    t->count = get32(&p[TWR_RPT_TR_COUNT_IDX]);
+    t->cpu_hz = get32(&p[TWR_RPT_TR_CPU_HZ_IDX]);
+    t->cycles_min = get32(&p[TWR_RPT_TR_CYCLES_IDX]);
+    t->cycles_mean = get32(&p[TWR_RPT_TR_CYCLES_IDX + 4]);
+    t->cycles_max = get32(&p[TWR_RPT_TR_CYCLES_IDX + 8]);
+    t->device_mean = get32(&p[TWR_RPT_TR_DEVICE_IDX]);
+    t->spi_xfers = get32(&p[TWR_RPT_TR_SPI_IDX]);
+    t->spi_bytes = get32(&p[TWR_RPT_TR_SPI_IDX + 4]);
+    t->polls = get32(&p[TWR_RPT_TR_POLLS_IDX]);
+    for (i = 0; i < TWR_RPT_TR_BUCKETS; i++)
+    {
+        t->hist[i] = get32(&p[TWR_RPT_TR_HIST_IDX + 4 * i]);
+    }
+}
+
+static void decode_telemetry(const uint8 *p, twr_telemetry_report_t *t)
+{
+    int i;
+
+    t->node = p[TWR_RPT_TM_NODE_IDX];
+    t->seq = get16(&p[TWR_RPT_TM_SEQ_IDX]);
+    t->period_ms = get32(&p[TWR_RPT_TM_MS_IDX]);
+    for (i = 0; i < TWR_RPT_TM_NUM_COUNTS; i++)
+    {
+        t->counts[i] = get16(&p[TWR_RPT_TM_COUNTS_IDX + 2 * i]);
+    }
+}
+
+/* Undo put_delta() for the len bytes at p[*i]. Returns 0 if they run out. */
+static int get_delta(const uint8 *p, uint16 len, uint16 *i, int16 *v)
+{
+    if (*i >= len)
+    {
+        return 0;
+    }
+    if (p[*i] != TWR_RPT_CIR_ESCAPE)
+    {
+        *v = (int16)(*v + (int8)p[(*i)++]);
+        return 1;
+    }
+    if (*i + 3 > len)
+    {
+        return 0;
+    }
+    *v = (int16)get16(&p[*i + 1]);
+    *i += 3;
+    return 1;
+}
+
+/* Returns 0 if the samples and the payload length disagree */
+static int decode_cir(const uint8 *p, uint16 len, twr_cir_report_t *c)
+{
+    uint16 k = TWR_RPT_CIR_DATA_IDX;
+    int16 re = 0, im = 0;
+    int i;
+
+    c->node = p[TWR_RPT_CIR_NODE_IDX];
+    c->piece = p[TWR_RPT_CIR_PIECE_IDX];
+    c->pieces = p[TWR_RPT_CIR_PIECES_IDX];
+    c->count = p[TWR_RPT_CIR_COUNT_IDX];
+    c->seq = get16(&p[TWR_RPT_CIR_SEQ_IDX]);
+    c->fp_index = get16(&p[TWR_RPT_CIR_FP_IDX]);
+    c->start = get16(&p[TWR_RPT_CIR_START_IDX]);
+    if (c->count > TWR_RPT_CIR_MAX_SAMPLES)
+    {
+        return 0;
+    }
+    for (i = 0; i < c->count; i++)
+    {
+        if (!get_delta(p, len, &k, &re) || !get_delta(p, len, &k, &im))
+        {
+            return 0;
+        }
+        c->re[i] = re;
+        c->im[i] = im;
+    }
+    return k == len;
+}
+
+/* Forget the first n buffered bytes (a frame, or the first byte of a bad one), then those up to the next sync byte */
+static void decoder_drop(twr_report_decoder_t *d, uint16 n, int bad)
+{
+    uint16 i = n;
+
+    while (i < d->len && d->buf[i] != TWR_RPT_SYNC0)
+    {
+        i++;
+    }
+    d->errors += bad ? i : i - n;
+    memmove(d->buf, &d->buf[i], d->len - i);
+    d->len -= i;
+}
+
+/* Handle the start of the buffer: 0 if more bytes are needed */
+static int decoder_parse(twr_report_decoder_t *d, twr_report_cb_t cb, void *ctx)
+{
+    const uint8 *p = &d->buf[TWR_RPT_HDR_LEN];
+    twr_range_report_t r;
+    twr_trace_report_t t;
+    twr_telemetry_report_t tm;
+    twr_cir_report_t c;
+    uint16 total;
+    int i;
+
+    if (d->len < 2)
+    {
+        return 0;
+    }
+    if (d->buf[1] != TWR_RPT_SYNC1)
+    {
+        decoder_drop(d, 1, 1);
+        return 1;
+    }
+    if (d->len < TWR_RPT_HDR_LEN)
+    {
+        return 0;
+    }
+    total = TWR_RPT_HDR_LEN + d->buf[3] + TWR_RPT_CHECK_LEN;
+    if (d->len < total)
+    {
+        return 0;
+    }
+    if (fletcher16(d->buf, TWR_RPT_HDR_LEN + d->buf[3]) != get16(&d->buf[total - TWR_RPT_CHECK_LEN]))
+    {
+        decoder_drop(d, 1, 1);
+        return 1;
+    }
+
+    d->frames++;
+    if (d->buf[2] == TWR_RPT_RANGE && d->buf[3] >= TWR_RPT_RANGE_LEN)
+    {
+        r.seq = get16(&p[TWR_RPT_SEQ_IDX]);
+        r.anchor = p[TWR_RPT_ANCHOR_IDX];
+        r.exchange = p[TWR_RPT_EXCHANGE_IDX];
+        r.kind = p[TWR_RPT_KIND_IDX];
+        r.distance_mm = (int32)get32(&p[TWR_RPT_DISTANCE_IDX]);
+        for (i = 0; i < TWR_RPT_N_TS; i++)
+        {
+            r.ts[i] = get32(&p[TWR_RPT_TS_IDX + 4 * i]);
+        }
+        r.quality.fp_index = get16(&p[TWR_RPT_QUALITY_IDX]);
+        r.quality.fp_amp1 = get16(&p[TWR_RPT_QUALITY_IDX + 2]);
+        r.quality.fp_amp2 = get16(&p[TWR_RPT_QUALITY_IDX + 4]);
+        r.quality.fp_amp3 = get16(&p[TWR_RPT_QUALITY_IDX + 6]);
+        r.quality.cir_power = get16(&p[TWR_RPT_QUALITY_IDX + 8]);
+        r.quality.std_noise = get16(&p[TWR_RPT_QUALITY_IDX + 10]);
+        r.quality.rx_pacc = get16(&p[TWR_RPT_QUALITY_IDX + 12]);
+        r.dropped = get16(&p[TWR_RPT_DROPPED_IDX]);
+        cb(ctx, &r);
+    }
+    else if (d->buf[2] == TWR_RPT_TRACE && d->buf[3] >= TWR_RPT_TRACE_LEN && d->trace_cb != NULL)
+    {
+        decode_trace(p, &t);
+        d->trace_cb(d->trace_ctx, &t);
+    }
+    else if (d->buf[2] == TWR_RPT_TELEMETRY && d->buf[3] >= TWR_RPT_TELEMETRY_LEN && d->telemetry_cb != NULL)
+    {
+        decode_telemetry(p, &tm);
+        d->telemetry_cb(d->telemetry_ctx, &tm);
+    }
+    else if (d->buf[2] == TWR_RPT_CIR && d->buf[3] >= TWR_RPT_CIR_DATA_IDX && d->cir_cb != NULL &&
+             decode_cir(p, d->buf[3], &c))
+    {
+        d->cir_cb(d->cir_ctx, &c);
+    }
+    decoder_drop(d, total, 0);
+    return 1;
+}
+
+void twr_report_decode(twr_report_decoder_t *d, const uint8 *buf, uint32 len, twr_report_cb_t cb, void *ctx)
+{
+    while (len--)
+    {
+        if (d->len == 0 && *buf != TWR_RPT_SYNC0)
+        {
+            d->errors++;
+            buf++;
+            continue;
+        }
+        d->buf[d->len++] = *buf++;
+        while (d->len > 0 && decoder_parse(d, cb, ctx))
+        { };
+    }
+}
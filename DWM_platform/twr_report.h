@@ -0,0 +1,369 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_report.h
+ * @brief   Binary range reports, queued and sent to the PC in batches
+ *
+ *          The ranging engine used to sprintf() each distance into a
+ *          "DIST A: 1.23 m" line and hand it straight to CDC_Transmit_FS().
+ *          When the USB was still busy with the previous line the new one was
+ *          lost, and every distance cost its own USB transfer.
+ *
+ *          A report is now a binary frame carrying the anchor, the exchange,
+ *          the distance in mm, the raw timestamps and the RX quality. It is
+ *          copied into a ring buffer (struct circ_buf of port.h), which can be
+ *          done from the DW1000 interrupt. twr_report_poll(), called from the
+ *          main loop, lets the reports build up to TWR_REPORT_FLUSH_BYTES, or
+ *          for at most TWR_REPORT_FLUSH_MS, and then sends them all in one
+ *          CDC_Transmit_FS(). Reports produced while a transfer is in flight
+ *          share the next one.
+ *
+ *          Frame, all fields little endian:
+ *           - byte 0/1: sync 0xCA 0xDE
+ *           - byte 2: type, byte 3: payload length
+ *           - payload
+ *           - Fletcher-16 of all the above (2 bytes), the sync bytes make it
+ *             non-zero for a run of zeros
+ *          twr_report.c encodes and decodes frames and has no board
+ *          dependency, twr_report_queue.c holds the queue and the USB side.
+ *          Host/report_decode.c turns a captured stream back into text or CSV.
+ *
+ *          Built with TWR_TRACE, the stream also carries the phase timings of
+ *          twr_trace.h, one trace frame per phase. Engines with
+ *          TWR_FLAG_TELEMETRY add the DW1000 event counts of twr_telemetry.h,
+ *          and engines with TWR_FLAG_CIR the channel impulse responses of
+ *          twr_cir.h.
+ */
+
+#ifndef TWR_REPORT_H_
+#define TWR_REPORT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+
+#define TWR_RPT_SYNC0           0xCA
+#define TWR_RPT_SYNC1           0xDE
+
+#define TWR_RPT_HDR_LEN         4
+#define TWR_RPT_CHECK_LEN       2
+
+/* Frame types */
+#define TWR_RPT_RANGE           0x01
+#define TWR_RPT_TRACE           0x02    // timing of one phase of the exchanges, see twr_trace.h
+#define TWR_RPT_TELEMETRY       0x03    // DW1000 event counts of a sample period, see twr_telemetry.h
+#define TWR_RPT_CIR             0x04    // piece of a channel impulse response, see twr_cir.h
+
+/* Range payload */
+#define TWR_RPT_SEQ_IDX         0       // report number (2 bytes), a gap means reports were lost
+#define TWR_RPT_ANCHOR_IDX      2       // "DIST" label of the anchor, 'A', 'B', ...
+#define TWR_RPT_EXCHANGE_IDX    3       // frame sequence number of the exchange
+#define TWR_RPT_KIND_IDX        4       // TWR_RPT_KIND_xxx, byte 5 is 0
+#define TWR_RPT_DISTANCE_IDX    6       // distance, mm (4 bytes, signed)
+#define TWR_RPT_TS_IDX          10      // TWR_RPT_N_TS timestamps, low 32 bits (4 bytes each)
+#define TWR_RPT_QUALITY_IDX     34      // dwt_rxdiag_t of the last frame received (7 x 2 bytes), see twr_rpt_quality_t
+#define TWR_RPT_DROPPED_IDX     48      // reports dropped on a full queue so far (2 bytes, saturates)
+#define TWR_RPT_RANGE_LEN       50
+
+#define TWR_RPT_MAX_FRAME       (TWR_RPT_HDR_LEN + TWR_RPT_RANGE_LEN + TWR_RPT_CHECK_LEN)
+
+/* Trace payload, totals since twr_trace_reset() */
+#define TWR_RPT_TR_PHASE_IDX    0       // TWR_TRACE_xxx, byte 1 is 0
+#define TWR_RPT_TR_COUNT_IDX    2       // phases recorded (4 bytes)
+#define TWR_RPT_TR_CPU_HZ_IDX   6       // rate of the cycle counter, Hz (4 bytes)
+#define TWR_RPT_TR_CYCLES_IDX   10      // cycles of a phase: min, mean, max (4 bytes each)
+#define TWR_RPT_TR_DEVICE_IDX   22      // DW1000 time of a phase, mean, 256 DTU units (4 bytes)
+#define TWR_RPT_TR_SPI_IDX      26      // SPI transactions, then SPI bytes, of all phases (4 bytes each)
+#define TWR_RPT_TR_POLLS_IDX    34      // status register polls of all phases (4 bytes)
+#define TWR_RPT_TR_HIST_IDX     38      // phases per duration bucket (4 bytes each), see TWR_RPT_TR_BUCKETS
+#define TWR_RPT_TRACE_LEN       (TWR_RPT_TR_HIST_IDX + 4 * TWR_RPT_TR_BUCKETS)
+
+/* Duration buckets: bucket k > 0 holds the phases of 2^(k-1) to 2^k - 1 us, bucket 0 those under 1 us, the last one all
+ * those longer */
+#define TWR_RPT_TR_BUCKETS      16
+
+#define TWR_RPT_TRACE_FRAME     (TWR_RPT_HDR_LEN + TWR_RPT_TRACE_LEN + TWR_RPT_CHECK_LEN)
+
+/* Telemetry payload */
+#define TWR_RPT_TM_NODE_IDX     0       // "DIST" label of the anchor, 0 for a tag; byte 1 is 0
+#define TWR_RPT_TM_SEQ_IDX      2       // sample number (2 bytes), a gap means samples were lost
+#define TWR_RPT_TM_MS_IDX       4       // length of the sample period, ms (4 bytes)
+#define TWR_RPT_TM_COUNTS_IDX   8       // events of the period, TWR_RPT_TM_xxx order (2 bytes each)
+#define TWR_RPT_TELEMETRY_LEN   (TWR_RPT_TM_COUNTS_IDX + 2 * TWR_RPT_TM_NUM_COUNTS)
+
+/* Event counts, the counters of dwt_deviceentcnts_t */
+#define TWR_RPT_TM_PHE          0       // PHY header errors
+#define TWR_RPT_TM_RSL          1       // Reed Solomon sync losses
+#define TWR_RPT_TM_CRCG         2       // frames with a good CRC
+#define TWR_RPT_TM_CRCB         3       // frames with a CRC error
+#define TWR_RPT_TM_ARFE         4       // frames rejected by the address filter
+#define TWR_RPT_TM_OVER         5       // receiver overruns
+#define TWR_RPT_TM_SFDTO        6       // SFD timeouts
+#define TWR_RPT_TM_PTO          7       // preamble detection timeouts
+#define TWR_RPT_TM_RTO          8       // RX frame wait timeouts
+#define TWR_RPT_TM_TXF          9       // frames sent
+#define TWR_RPT_TM_HPW          10      // half period warnings, delayed TRX started late
+#define TWR_RPT_TM_TXW          11      // TX power up warnings
+#define TWR_RPT_TM_NUM_COUNTS   12
+
+#define TWR_RPT_TELEMETRY_FRAME (TWR_RPT_HDR_LEN + TWR_RPT_TELEMETRY_LEN + TWR_RPT_CHECK_LEN)
+
+/* CIR payload, one piece of the accumulator window of a capture */
+#define TWR_RPT_CIR_NODE_IDX    0       // "DIST" label of the anchor, 0 for a tag
+#define TWR_RPT_CIR_PIECE_IDX   1       // number of this piece, from 0
+#define TWR_RPT_CIR_PIECES_IDX  2       // pieces of the capture
+#define TWR_RPT_CIR_COUNT_IDX   3       // samples in this piece, up to TWR_RPT_CIR_MAX_SAMPLES
+#define TWR_RPT_CIR_SEQ_IDX     4       // seq of the range report of the frame captured (2 bytes)
+#define TWR_RPT_CIR_FP_IDX      6       // first path index of the frame, 10.6 fixed point (2 bytes)
+#define TWR_RPT_CIR_START_IDX   8       // accumulator index of the first sample of this piece (2 bytes)
+#define TWR_RPT_CIR_DATA_IDX    10      // samples, delta coded, see below
+#define TWR_RPT_CIR_MAX_SAMPLES 40
+
+/* Each sample is a real and an imaginary int16, as read from the accumulator. Each of them is coded as the difference
+ * to the same part of the sample before, 0 before the first: one signed byte from -127 to 127, else the escape byte
+ * followed by the value itself (2 bytes). Noise and slow slopes take 1 byte, the edges of the paths 3. */
+#define TWR_RPT_CIR_ESCAPE      0x80
+#define TWR_RPT_CIR_MAX_LEN(n)  (TWR_RPT_CIR_DATA_IDX + 6 * (n))    // payload of n samples, at worst
+#define TWR_RPT_CIR_FRAME(n)    (TWR_RPT_HDR_LEN + TWR_RPT_CIR_MAX_LEN(n) + TWR_RPT_CHECK_LEN)
+#define TWR_RPT_MAX_PAYLOAD     255     // of any type, newer types may be longer than a range
+
+/* Kinds of range, and the timestamps they carry */
+#define TWR_RPT_KIND_DS         0       // anchor, DS: poll TX, response RX, final TX (tag), poll RX, response TX, final RX
+#define TWR_RPT_KIND_SS         1       // tag, SS: poll TX, response RX (tag), poll RX, response TX (anchor)
+#define TWR_RPT_KIND_RELAY      2       // master anchor, distance relayed by another anchor in cm: no timestamps or quality
+
+#define TWR_RPT_N_TS            6
+
+/* Bytes of the transmit queue, a power of 2 */
+#ifndef TWR_REPORT_QUEUE_SIZE
+#define TWR_REPORT_QUEUE_SIZE   2048
+#endif
+
+/* Report streams, one per USB port; the host simulator gives each node its own, see twr_report_select() */
+#ifndef TWR_REPORT_NUM_STREAMS
+#define TWR_REPORT_NUM_STREAMS  1
+#endif
+
+/* Largest CDC_Transmit_FS() of a flush, 8 full speed packets */
+#ifndef TWR_REPORT_BATCH_MAX
+#define TWR_REPORT_BATCH_MAX    512
+#endif
+
+/* twr_report_poll() sends the queue once it holds this many bytes, 4 range reports... */
+#ifndef TWR_REPORT_FLUSH_BYTES
+#define TWR_REPORT_FLUSH_BYTES  (4 * TWR_RPT_MAX_FRAME)
+#endif
+
+/* ...or once its first report has waited this long. 0 sends every report as soon as the USB is free. */
+#ifndef TWR_REPORT_FLUSH_MS
+#define TWR_REPORT_FLUSH_MS     100
+#endif
+
+typedef struct
+{
+    uint16  fp_index;       // first path index, 10.6 fixed point
+    uint16  fp_amp1;        // first path amplitudes
+    uint16  fp_amp2;
+    uint16  fp_amp3;
+    uint16  cir_power;      // maxGrowthCIR
+    uint16  std_noise;
+    uint16  rx_pacc;        // preamble symbols accumulated
+} twr_rpt_quality_t;
+
+typedef struct
+{
+    uint16              seq;
+    uint8               anchor;
+    uint8               exchange;
+    uint8               kind;
+    int32               distance_mm;
+    uint32              ts[TWR_RPT_N_TS];
+    twr_rpt_quality_t   quality;
+    uint16              dropped;
+} twr_range_report_t;
+
+/* Timing of one phase, see twr_trace.h */
+typedef struct
+{
+    uint8               phase;          // TWR_TRACE_xxx
+    uint32              count;
+    uint32              cpu_hz;
+    uint32              cycles_min;
+    uint32              cycles_mean;
+    uint32              cycles_max;
+    uint32              device_mean;    // 256 DTU units, as dwt_readsystimestamphi32()
+    uint32              spi_xfers;
+    uint32              spi_bytes;
+    uint32              polls;
+    uint32              hist[TWR_RPT_TR_BUCKETS];
+} twr_trace_report_t;
+
+typedef void (*twr_report_trace_cb_t)(void *ctx, const twr_trace_report_t *t);
+
+/* DW1000 events of one sample period, see twr_telemetry.h */
+typedef struct
+{
+    uint8               node;           // anchor label, 0 for a tag
+    uint16              seq;
+    uint32              period_ms;
+    uint16              counts[TWR_RPT_TM_NUM_COUNTS];  // TWR_RPT_TM_xxx
+} twr_telemetry_report_t;
+
+typedef void (*twr_report_telemetry_cb_t)(void *ctx, const twr_telemetry_report_t *t);
+
+/* Piece of a channel impulse response, see twr_cir.h */
+typedef struct
+{
+    uint8               node;           // anchor label, 0 for a tag
+    uint8               piece;
+    uint8               pieces;
+    uint8               count;          // samples
+    uint16              seq;            // range report of the frame
+    uint16              fp_index;       // 10.6 fixed point
+    uint16              start;          // accumulator index of re[0], im[0]
+    int16               re[TWR_RPT_CIR_MAX_SAMPLES];
+    int16               im[TWR_RPT_CIR_MAX_SAMPLES];
+} twr_cir_report_t;
+
+typedef void (*twr_report_cir_cb_t)(void *ctx, const twr_cir_report_t *c);
+
+typedef struct
+{
+    uint32  queued;         // reports queued
+    uint32  dropped;        // reports lost to a full queue
+    uint32  transfers;      // CDC_Transmit_FS() calls accepted
+    uint32  busy;           // flushes put off by a busy USB
+    uint32  bytes;          // bytes sent
+} twr_report_stats_t;
+
+/* Stream decoder state, see twr_report_decode() */
+typedef struct
+{
+    uint8   buf[TWR_RPT_HDR_LEN + TWR_RPT_MAX_PAYLOAD + TWR_RPT_CHECK_LEN];
+    uint16  len;
+    uint32  frames;         // good frames
+    uint32  errors;         // bytes skipped to find the next frame
+    twr_report_trace_cb_t trace_cb;     // trace frames, skipped if NULL
+    void   *trace_ctx;                  // passed to trace_cb
+    twr_report_telemetry_cb_t telemetry_cb; // telemetry frames, skipped if NULL
+    void   *telemetry_ctx;              // passed to telemetry_cb
+    twr_report_cir_cb_t cir_cb;         // CIR frames, skipped if NULL
+    void   *cir_ctx;                    // passed to cir_cb
+} twr_report_decoder_t;
+
+typedef void (*twr_report_cb_t)(void *ctx, const twr_range_report_t *r);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_report_range()
+ *
+ * @brief Queue a range report. r->seq and r->dropped are filled in here. May be called from the DW1000 interrupt; only
+ *        one context may queue reports. If the queue is full the report is dropped and counted, nothing waits for the
+ *        USB.
+ *
+ * input parameters
+ * @param r - report
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS, or DWT_ERROR if the report was dropped
+ */
+int twr_report_range(twr_range_report_t *r);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_report_flush()
+ *
+ * @brief Send what is queued, up to TWR_REPORT_BATCH_MAX bytes, with one CDC_Transmit_FS(). Does nothing while the
+ *        previous transfer is in flight (CDC_Transmit_FS() returns USBD_BUSY), the reports then go with the next
+ *        call. Call it from the main loop only.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS if the queue was sent or empty, DWT_ERROR if the USB was busy
+ */
+int twr_report_flush(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_report_poll()
+ *
+ * @brief Call twr_report_flush() once the queue holds TWR_REPORT_FLUSH_BYTES, or TWR_REPORT_FLUSH_MS after a call
+ *        first found it not empty. Until then the reports wait, so that several share a USB transfer. Call it from
+ *        the main loop only, as often as convenient.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS, or DWT_ERROR if the queue was due and the USB was busy
+ */
+int twr_report_poll(void);
+
+/* Queue a trace frame, as twr_report_range() but outside the report stats. Returns DWT_SUCCESS, or DWT_ERROR if it was
+ * dropped. */
+int twr_report_trace(const twr_trace_report_t *t);
+
+/* Queue a telemetry frame, as twr_report_trace() */
+int twr_report_telemetry(const twr_telemetry_report_t *t);
+
+/* Queue a CIR frame, as twr_report_trace() */
+int twr_report_cir(const twr_cir_report_t *c);
+
+/* Make stream index (< TWR_REPORT_NUM_STREAMS) the one used by the functions above, as dwt_setlocaldataptr() does for
+ * the driver. Returns DWT_SUCCESS, or DWT_ERROR if there is no such stream. */
+int twr_report_select(unsigned int index);
+
+/* Bytes waiting in the queue */
+int twr_report_pending(void);
+
+void twr_report_get_stats(twr_report_stats_t *stats);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_report_encode()
+ *
+ * @brief Build the frame of a range report.
+ *
+ * input parameters
+ * @param r   - report
+ *
+ * output parameters
+ * @param buf - TWR_RPT_MAX_FRAME bytes
+ *
+ * returns the frame length
+ */
+uint16 twr_report_encode(const twr_range_report_t *r, uint8 *buf);
+
+/* Build the frame of a trace report in buf, TWR_RPT_TRACE_FRAME bytes. Returns the frame length. */
+uint16 twr_report_encode_trace(const twr_trace_report_t *t, uint8 *buf);
+
+/* Build the frame of a telemetry report in buf, TWR_RPT_TELEMETRY_FRAME bytes. Returns the frame length. */
+uint16 twr_report_encode_telemetry(const twr_telemetry_report_t *t, uint8 *buf);
+
+/* Build the frame of a CIR piece in buf, TWR_RPT_CIR_FRAME(c->count) bytes. Returns the frame length, which depends on
+ * the samples. */
+uint16 twr_report_encode_cir(const twr_cir_report_t *c, uint8 *buf);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_report_decode()
+ *
+ * @brief Decode a byte stream in pieces of any size. Each good range frame is passed to cb, bytes that do not start a
+ *        good frame are skipped (counted in d->errors), so the decoder finds its way after lost or corrupted bytes.
+ *        Trace, telemetry and CIR frames go to d->trace_cb, d->telemetry_cb and d->cir_cb if set. Frames of unknown
+ *        types, and CIR frames whose samples do not fill the payload exactly, are skipped whole.
+ *
+ * input parameters
+ * @param d   - decoder, zero initialised before the first call
+ * @param buf - next bytes of the stream
+ * @param len - number of bytes
+ * @param cb  - called for each range report
+ * @param ctx - passed to cb
+ *
+ * no return value
+ */
+void twr_report_decode(twr_report_decoder_t *d, const uint8 *buf, uint32 len, twr_report_cb_t cb, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TWR_REPORT_H_ */
@@ -0,0 +1,195 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_report_queue.c
+ * @brief   Queue of the range reports and their batched USB transfers, see twr_report.h
+ */
+
+#include <string.h>
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+#include "twr_report.h"
+#include "twr_trace.h"
+
+#include "port.h"
+
+#include "usbd_cdc_if.h"
+
+#if (TWR_REPORT_QUEUE_SIZE & (TWR_REPORT_QUEUE_SIZE - 1)) != 0
+#error "TWR_REPORT_QUEUE_SIZE must be a power of 2"
+#endif
+
+typedef struct
+{
+    /* Queue of encoded frames. The producer (twr_report_range(), maybe in the DW1000 interrupt) only moves head, the
+     * consumer (twr_report_flush(), main loop) only moves tail, so neither needs to mask interrupts. */
+    char                buf[TWR_REPORT_QUEUE_SIZE];
+    struct circ_buf     circ;           // head and tail of buf, circ.buf is not used
+    /* A transfer is sent from one buffer while the next flush fills the other, the USB reads it after
+     * CDC_Transmit_FS() has returned */
+    uint8               tx_buf[2][TWR_REPORT_BATCH_MAX];
+    uint8               tx_cur;
+    uint8               waiting;        // twr_report_poll() has found the queue not empty...
+    uint32              since_ms;       // ...at this portGetTickCnt()
+    uint16              seq;
+    twr_report_stats_t  stats;
+} report_stream_t;
+
+static report_stream_t streams[TWR_REPORT_NUM_STREAMS];
+static report_stream_t *rs = &streams[0];
+
+/* head and tail are changed by the other context */
+#define CIRC_HEAD()     (*(volatile int *)&rs->circ.head)
+#define CIRC_TAIL()     (*(volatile int *)&rs->circ.tail)
+
+/* Copy a frame into the queue in up to two pieces, then publish it. The caller has checked the space. */
+static void queue_frame(const uint8 *frame, uint16 len)
+{
+    int head = rs->circ.head;
+    int tail = CIRC_TAIL();
+    uint16 done;
+    int n;
+
+    for (done = 0; done < len; done += n)
+    {
+        n = CIRC_SPACE_TO_END(head, tail, TWR_REPORT_QUEUE_SIZE);
+        if (n > len - done)
+        {
+            n = len - done;
+        }
+        memcpy(&rs->buf[head], &frame[done], n);
+        head = (head + n) & (TWR_REPORT_QUEUE_SIZE - 1);
+    }
+    CIRC_HEAD() = head;
+}
+
+int twr_report_range(twr_range_report_t *r)
+{
+    uint8 frame[TWR_RPT_MAX_FRAME];
+
+    if (CIRC_SPACE(rs->circ.head, CIRC_TAIL(), TWR_REPORT_QUEUE_SIZE) < TWR_RPT_MAX_FRAME)
+    {
+        rs->stats.dropped++;
+        return DWT_ERROR;
+    }
+
+    r->seq = rs->seq++;
+    r->dropped = (rs->stats.dropped > 0xFFFF) ? 0xFFFF : (uint16)rs->stats.dropped;
+    queue_frame(frame, twr_report_encode(r, frame));
+    rs->stats.queued++;
+    return DWT_SUCCESS;
+}
+
+/* Queue a frame other than a range report, outside the report stats */
+static int queue_other(const uint8 *frame, uint16 len)
+{
+    if (CIRC_SPACE(rs->circ.head, CIRC_TAIL(), TWR_REPORT_QUEUE_SIZE) < len)
+    {
+        return DWT_ERROR;
+    }
+    queue_frame(frame, len);
+    return DWT_SUCCESS;
+}
+
+int twr_report_trace(const twr_trace_report_t *t)
+{
+    uint8 frame[TWR_RPT_TRACE_FRAME];
+
+    return queue_other(frame, twr_report_encode_trace(t, frame));
+}
+
+int twr_report_telemetry(const twr_telemetry_report_t *t)
+{
+    uint8 frame[TWR_RPT_TELEMETRY_FRAME];
+
+    return queue_other(frame, twr_report_encode_telemetry(t, frame));
+}
+
+int twr_report_cir(const twr_cir_report_t *c)
+{
+    uint8 frame[TWR_RPT_CIR_FRAME(TWR_RPT_CIR_MAX_SAMPLES)];
+
+    return queue_other(frame, twr_report_encode_cir(c, frame));
+}
+
+int twr_report_flush(void)
+{
+    int head = CIRC_HEAD();
+    int tail = rs->circ.tail;
+    int count = CIRC_CNT(head, tail, TWR_REPORT_QUEUE_SIZE);
+    int first;
+
+    if (count == 0)
+    {
+        return DWT_SUCCESS;
+    }
+    TWR_TRACE_BEGIN(TWR_TRACE_USB);
+    if (count > TWR_REPORT_BATCH_MAX)
+    {
+        count = TWR_REPORT_BATCH_MAX;
+    }
+
+    first = CIRC_CNT_TO_END(head, tail, TWR_REPORT_QUEUE_SIZE);
+    if (first > count)
+    {
+        first = count;
+    }
+    memcpy(rs->tx_buf[rs->tx_cur], &rs->buf[tail], first);
+    memcpy(&rs->tx_buf[rs->tx_cur][first], rs->buf, count - first);
+
+    if (CDC_Transmit_FS(rs->tx_buf[rs->tx_cur], (uint16_t)count) != USBD_OK)
+    {
+        rs->stats.busy++;
+        TWR_TRACE_END(TWR_TRACE_USB);
+        return DWT_ERROR;
+    }
+    CIRC_TAIL() = (tail + count) & (TWR_REPORT_QUEUE_SIZE - 1);
+    rs->waiting = 0;
+    rs->tx_cur ^= 1;
+    rs->stats.transfers++;
+    rs->stats.bytes += count;
+    TWR_TRACE_END(TWR_TRACE_USB);
+    return DWT_SUCCESS;
+}
+
+int twr_report_poll(void)
+{
+    int count = CIRC_CNT(CIRC_HEAD(), rs->circ.tail, TWR_REPORT_QUEUE_SIZE);
+    uint32 ms;
+
+    if (count == 0)
+    {
+        return DWT_SUCCESS;
+    }
+    ms = portGetTickCnt();
+    if (!rs->waiting)
+    {
+        rs->waiting = 1;
+        rs->since_ms = ms;
+    }
+    if (count < TWR_REPORT_FLUSH_BYTES && (int32)(ms - rs->since_ms) < TWR_REPORT_FLUSH_MS)
+    {
+        return DWT_SUCCESS;
+    }
+    return twr_report_flush();
+}
+
+int twr_report_select(unsigned int index)
+{
+    if (index >= TWR_REPORT_NUM_STREAMS)
+    {
+        return DWT_ERROR;
+    }
+    rs = &streams[index];
+    return DWT_SUCCESS;
+}
+
+int twr_report_pending(void)
+{
+    return CIRC_CNT(CIRC_HEAD(), CIRC_TAIL(), TWR_REPORT_QUEUE_SIZE);
+}
+
+void twr_report_get_stats(twr_report_stats_t *stats)
+{
+    *stats = rs->stats;
+}
+
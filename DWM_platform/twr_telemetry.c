@@ -0,0 +1,67 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_telemetry.c
+ * @brief   DW1000 event counters sent with the range reports, see twr_telemetry.h
+ */
+
+#include <string.h>
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+#include "twr_report.h"
+#include "twr_telemetry.h"
+
+#include "port.h"
+
+/* Events since 'last' of a 12-bit counter */
+#define EVC_DELTA(now, last)    ((uint16)(((now) - (last)) & 0x0FFF))
+
+void twr_telemetry_start(twr_telemetry_t *t)
+{
+    dwt_configeventcounters(1);
+    memset(&t->last, 0, sizeof(t->last));
+    t->last_ms = portGetTickCnt();
+    t->started = 1;
+}
+
+int twr_telemetry_poll(twr_telemetry_t *t, uint8 node)
+{
+    twr_telemetry_report_t r;
+    dwt_deviceentcnts_t now;
+    decaIrqStatus_t stat;
+    uint32 ms = portGetTickCnt();
+
+    if (!t->started || ms - t->last_ms < TWR_TELEMETRY_PERIOD_MS)
+    {
+        return DWT_SUCCESS;
+    }
+
+    /* May run between the events of an engine driven by the interrupt */
+    stat = decamutexon();
+    dwt_readeventcounters(&now);
+    decamutexoff(stat);
+
+    r.node = node;
+    r.seq = t->seq;
+    r.period_ms = ms - t->last_ms;
+    r.counts[TWR_RPT_TM_PHE] = EVC_DELTA(now.PHE, t->last.PHE);
+    r.counts[TWR_RPT_TM_RSL] = EVC_DELTA(now.RSL, t->last.RSL);
+    r.counts[TWR_RPT_TM_CRCG] = EVC_DELTA(now.CRCG, t->last.CRCG);
+    r.counts[TWR_RPT_TM_CRCB] = EVC_DELTA(now.CRCB, t->last.CRCB);
+    r.counts[TWR_RPT_TM_ARFE] = EVC_DELTA(now.ARFE, t->last.ARFE);
+    r.counts[TWR_RPT_TM_OVER] = EVC_DELTA(now.OVER, t->last.OVER);
+    r.counts[TWR_RPT_TM_SFDTO] = EVC_DELTA(now.SFDTO, t->last.SFDTO);
+    r.counts[TWR_RPT_TM_PTO] = EVC_DELTA(now.PTO, t->last.PTO);
+    r.counts[TWR_RPT_TM_RTO] = EVC_DELTA(now.RTO, t->last.RTO);
+    r.counts[TWR_RPT_TM_TXF] = EVC_DELTA(now.TXF, t->last.TXF);
+    r.counts[TWR_RPT_TM_HPW] = EVC_DELTA(now.HPW, t->last.HPW);
+    r.counts[TWR_RPT_TM_TXW] = EVC_DELTA(now.TXW, t->last.TXW);
+    if (twr_report_telemetry(&r) == DWT_ERROR)
+    {
+        return DWT_ERROR;
+    }
+
+    t->last = now;
+    t->last_ms = ms;
+    t->seq++;
+    return DWT_SUCCESS;
+}
@@ -0,0 +1,69 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_telemetry.h
+ * @brief   DW1000 event counters sent with the range reports
+ *
+ *          The DW1000 counts its receiver and transmitter events: header
+ *          errors, sync losses, good and bad CRCs, overruns, SFD, preamble
+ *          and frame wait timeouts, frames sent (dwt_deviceentcnts_t). They
+ *          tell whether lost exchanges come from timeouts set too short,
+ *          from a weak link, or from frames arriving while busy.
+ *
+ *          An engine with TWR_FLAG_TELEMETRY enables the counters after
+ *          every full initialisation of its DW1000 and, between exchanges,
+ *          reads them every TWR_TELEMETRY_PERIOD_MS. The events of the
+ *          period go out on the report stream as a telemetry frame (see
+ *          twr_report.h). Host/telemetry_stats.c adds them up and prints
+ *          the rates.
+ *
+ *          The counters are 12 bits wide and wrap: a period must see fewer
+ *          than 4096 events of each kind. At 1 s that is room for around
+ *          4000 frames per second.
+ */
+
+#ifndef TWR_TELEMETRY_H_
+#define TWR_TELEMETRY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+
+#ifndef TWR_TELEMETRY_PERIOD_MS
+#define TWR_TELEMETRY_PERIOD_MS     1000
+#endif
+
+typedef struct
+{
+    uint8               started;
+    uint16              seq;        // number of the next sample
+    uint32              last_ms;    // portGetTickCnt() of the last sample
+    dwt_deviceentcnts_t last;       // counters at the last sample
+} twr_telemetry_t;
+
+/* Clear and enable the event counters of the DW1000, and start the first period */
+void twr_telemetry_start(twr_telemetry_t *t);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_telemetry_poll()
+ *
+ * @brief Once TWR_TELEMETRY_PERIOD_MS have passed since the last sample, read the counters and queue the events since
+ *        then as a telemetry frame. If the report queue is full, the events are kept for the next call. Does nothing
+ *        before twr_telemetry_start().
+ *
+ * input parameters
+ * @param t    - telemetry state of the DW1000
+ * @param node - anchor label, 0 for a tag
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS, or DWT_ERROR if a frame was due and the queue was full
+ */
+int twr_telemetry_poll(twr_telemetry_t *t, uint8 node);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TWR_TELEMETRY_H_ */
@@ -0,0 +1,85 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_timing.c
+ * @brief   Frame durations and the TWR delays and timeouts they call for, see twr_timing.h
+ */
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+#include "twr_timing.h"
+
+uint16 twr_plen_symbols(uint8 txPreambLength)
+{
+    switch (txPreambLength)
+    {
+    case DWT_PLEN_4096: return 4096;
+    case DWT_PLEN_2048: return 2048;
+    case DWT_PLEN_1536: return 1536;
+    case DWT_PLEN_1024: return 1024;
+    case DWT_PLEN_512:  return 512;
+    case DWT_PLEN_256:  return 256;
+    case DWT_PLEN_128:  return 128;
+    case DWT_PLEN_64:   return 64;
+    default:            return 0;
+    }
+}
+
+uint16 twr_pac_symbols(uint8 rxPAC)
+{
+    switch (rxPAC)
+    {
+    case DWT_PAC8:  return 8;
+    case DWT_PAC16: return 16;
+    case DWT_PAC32: return 32;
+    default:        return 64;
+    }
+}
+
+uint32 twr_shr_clk(const dwt_config_t *config)
+{
+    return TWR_SHR_CLK(config->prf, twr_plen_symbols(config->txPreambLength), config->dataRate, config->nsSFD);
+}
+
+uint32 twr_payload_clk(const dwt_config_t *config, uint16 len)
+{
+    return TWR_PAYLOAD_CLK(config->dataRate, len);
+}
+
+uint32 twr_frame_clk(const dwt_config_t *config, uint16 len)
+{
+    return twr_shr_clk(config) + twr_payload_clk(config, len);
+}
+
+uint32 twr_frame_uus(const dwt_config_t *config, uint16 len)
+{
+    return TWR_CLK_TO_UUS(twr_frame_clk(config, len));
+}
+
+uint16 twr_sfd_timeout(const dwt_config_t *config)
+{
+    return TWR_SFD_TIMEOUT(twr_plen_symbols(config->txPreambLength), config->dataRate, config->nsSFD,
+                           twr_pac_symbols(config->rxPAC));
+}
+
+void twr_turn_timing(const dwt_config_t *config, uint16 req_len, uint16 ans_len, uint32 turnaround, uint32 margin,
+                     twr_turn_t *turn)
+{
+    uint32 shr = twr_shr_clk(config);
+    uint32 req = twr_payload_clk(config, req_len);
+    uint32 pac = twr_pac_symbols(config->rxPAC) * TWR_PRE_SYM_CLK(config->prf);
+    uint32 gap, wait, timeout;
+
+    /* The responder may only start its preamble once its delayed TX is armed */
+    turn->replyUus = TWR_CLK_TO_UUS(req + shr) + turnaround;
+
+    /* End of the request to the answer's preamble, then receiver on margin ahead of it, in whole UUS */
+    gap = turn->replyUus * TWR_CLK_PER_UUS - req - shr;
+    margin *= TWR_CLK_PER_UUS;
+    turn->rxAfterTxUus = (gap > margin) ? (gap - margin) / TWR_CLK_PER_UUS : 0;
+
+    /* Receiver on to the answer's preamble */
+    wait = gap - turn->rxAfterTxUus * TWR_CLK_PER_UUS;
+
+    timeout = TWR_CLK_TO_UUS(wait + shr + twr_payload_clk(config, ans_len) + margin);
+    turn->rxTimeoutUus = (uint16)((timeout > 0xFFFF) ? 0xFFFF : timeout);
+    turn->preambleTimeout = (uint16)((wait + pac - 1) / pac + TWR_PRE_DETECT_PACS);
+}
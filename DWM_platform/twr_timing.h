@@ -0,0 +1,150 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_timing.h
+ * @brief   Frame durations and the TWR delays and timeouts they call for
+ *
+ *          The delays and timeouts of the examples were tuned by hand on the
+ *          board, and any slack costs time on every exchange. Here they come
+ *          from the frame durations of the radio configuration instead:
+ *           - preamble: PLEN symbols of 496 (16 MHz PRF) or 508 (64 MHz PRF)
+ *             periods of the 499.2 MHz clock
+ *           - SFD: 64 symbols at 110 kb/s, 8 at 6.8 Mb/s, 8 at 850 kb/s or
+ *             16 with the Decawave SFD
+ *           - PHR: 21 bits at 110 kb/s, or 850 kb/s for the faster rates
+ *           - data: 8 bits per byte, FCS included, plus 48 Reed-Solomon
+ *             parity bits per block of 330, at 4096, 512 or 64 periods a bit
+ *          Every duration is a whole number of 499.2 MHz periods ("clk"):
+ *          512 make a UUS and 128 DTU make one, so the results are exact.
+ *
+ *          A turn is a request and its answer: the poll and the response,
+ *          or the response and the final of DS TWR. Given the time the
+ *          responder needs between the end of the request and its delayed
+ *          TX armed (turnaround, measured on the board), and a margin, the
+ *          turn gives:
+ *           - reply: request RX timestamp to answer TX timestamp, the
+ *             smallest delay that dwt_starttx() does not refuse
+ *           - RX after TX: end of the request to the initiator's receiver
+ *             on, margin ahead of the answer's preamble
+ *           - RX timeout: receiver on to margin after the end of the answer
+ *           - preamble timeout: receiver on to 2 PACs into the preamble
+ *
+ *          The macros give the same results at compile time, for #defines,
+ *          from the dwt_config_t fields: plen in symbols, the rest as the
+ *          DWT_xxx codes. Host/timing_check.c compares them with the
+ *          functions, and the durations with the DW1000 emulator.
+ */
+
+#ifndef TWR_TIMING_H_
+#define TWR_TIMING_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+
+#define TWR_CLK_PER_UUS         512
+#define TWR_DTU_PER_CLK         128
+#define TWR_PHR_BITS            21
+#define TWR_RS_BLOCK_BITS       330
+#define TWR_RS_PARITY_BITS      48
+#define TWR_PRE_DETECT_PACS     2       // preamble acquired within this many PACs, see twr_turn_timing()
+
+/* Symbol and bit durations, clk */
+#define TWR_PRE_SYM_CLK(prf)    (((prf) == DWT_PRF_64M) ? 508u : 496u)
+#define TWR_BIT_CLK(br)         (((br) == DWT_BR_110K) ? 4096u : ((br) == DWT_BR_850K) ? 512u : 64u)
+#define TWR_PHR_BIT_CLK(br)     (((br) == DWT_BR_110K) ? 4096u : 512u)
+#define TWR_SFD_SYMBOLS(br, nsSFD)  (((br) == DWT_BR_110K) ? 64u : ((nsSFD) && (br) == DWT_BR_850K) ? 16u : 8u)
+
+/* Data bits of a frame of len bytes, FCS included */
+#define TWR_DATA_BITS(len)      ((uint32)(len) * 8u + ((uint32)(len) * 8u + TWR_RS_BLOCK_BITS - 1) / TWR_RS_BLOCK_BITS * TWR_RS_PARITY_BITS)
+
+/* Preamble and SFD, from the first symbol to the RX/TX timestamp, clk */
+#define TWR_SHR_CLK(prf, plen, br, nsSFD)   (((uint32)(plen) + TWR_SFD_SYMBOLS(br, nsSFD)) * TWR_PRE_SYM_CLK(prf))
+
+/* PHR and data, from the timestamp to the end of the frame, clk */
+#define TWR_PAYLOAD_CLK(br, len)    (TWR_PHR_BITS * TWR_PHR_BIT_CLK(br) + TWR_DATA_BITS(len) * TWR_BIT_CLK(br))
+
+#define TWR_FRAME_CLK(prf, plen, br, nsSFD, len)    (TWR_SHR_CLK(prf, plen, br, nsSFD) + TWR_PAYLOAD_CLK(br, len))
+
+/* clk to UUS rounded up, and to ns rounded (1000 / 499.2 = 625 / 312) */
+#define TWR_CLK_TO_UUS(clk)     (((uint32)(clk) + TWR_CLK_PER_UUS - 1) / TWR_CLK_PER_UUS)
+#define TWR_CLK_TO_NS(clk)      ((uint32)(((uint64_t)(clk) * 625u + 156u) / 312u))
+
+/* Turn timing, see twr_turn_timing(): turnaround and margin in UUS. TWR_RX_TIMEOUT_UUS() does not saturate. */
+#define TWR_REPLY_UUS(prf, plen, br, nsSFD, req_len, turnaround) \
+    (TWR_CLK_TO_UUS(TWR_PAYLOAD_CLK(br, req_len) + TWR_SHR_CLK(prf, plen, br, nsSFD)) + (turnaround))
+
+/* Clk of the end of the request to the answer's preamble, for a reply of 'reply' UUS */
+#define TWR_GAP_CLK(prf, plen, br, nsSFD, req_len, reply) \
+    ((int32)(reply) * TWR_CLK_PER_UUS - (int32)TWR_PAYLOAD_CLK(br, req_len) - (int32)TWR_SHR_CLK(prf, plen, br, nsSFD))
+
+#define TWR_RX_AFTER_TX_UUS(prf, plen, br, nsSFD, req_len, reply, margin) \
+    ((TWR_GAP_CLK(prf, plen, br, nsSFD, req_len, reply) > (int32)(margin) * TWR_CLK_PER_UUS) ? \
+     (uint32)(TWR_GAP_CLK(prf, plen, br, nsSFD, req_len, reply) - (int32)(margin) * TWR_CLK_PER_UUS) / TWR_CLK_PER_UUS : 0u)
+
+#define TWR_RX_TIMEOUT_UUS(prf, plen, br, nsSFD, req_len, ans_len, reply, margin) \
+    TWR_CLK_TO_UUS(TWR_GAP_CLK(prf, plen, br, nsSFD, req_len, reply) - \
+                   (int32)TWR_RX_AFTER_TX_UUS(prf, plen, br, nsSFD, req_len, reply, margin) * TWR_CLK_PER_UUS + \
+                   (int32)TWR_FRAME_CLK(prf, plen, br, nsSFD, ans_len) + (int32)(margin) * TWR_CLK_PER_UUS)
+
+#define TWR_PREAMBLE_TIMEOUT_PACS(prf, plen, br, nsSFD, pac, req_len, reply, margin) \
+    (((uint32)(TWR_GAP_CLK(prf, plen, br, nsSFD, req_len, reply) - \
+               (int32)TWR_RX_AFTER_TX_UUS(prf, plen, br, nsSFD, req_len, reply, margin) * TWR_CLK_PER_UUS) + \
+      (pac) * TWR_PRE_SYM_CLK(prf) - 1) / ((pac) * TWR_PRE_SYM_CLK(prf)) + TWR_PRE_DETECT_PACS)
+
+/* SFD timeout of dwt_config_t: preamble length + 1 + SFD length - PAC size, in symbols */
+#define TWR_SFD_TIMEOUT(plen, br, nsSFD, pac)   ((uint16)((plen) + 1 + TWR_SFD_SYMBOLS(br, nsSFD) - (pac)))
+
+/* Timing of one turn, see above */
+typedef struct
+{
+    uint32  replyUus;           // responder: request RX timestamp to answer TX timestamp
+    uint32  rxAfterTxUus;       // initiator: see dwt_setrxaftertxdelay()
+    uint16  rxTimeoutUus;       // initiator: see dwt_setrxtimeout()
+    uint16  preambleTimeout;    // initiator: PACs, see dwt_setpreambledetecttimeout()
+} twr_turn_t;
+
+/* Preamble symbols of a DWT_PLEN_xxx code, 0 if unknown */
+uint16 twr_plen_symbols(uint8 txPreambLength);
+
+/* PAC symbols of a DWT_PACxx code */
+uint16 twr_pac_symbols(uint8 rxPAC);
+
+/* TWR_SHR_CLK(), TWR_PAYLOAD_CLK() and TWR_FRAME_CLK() of a configuration */
+uint32 twr_shr_clk(const dwt_config_t *config);
+uint32 twr_payload_clk(const dwt_config_t *config, uint16 len);
+uint32 twr_frame_clk(const dwt_config_t *config, uint16 len);
+
+/* Time on air of a frame of len bytes, FCS included, UUS rounded up */
+uint32 twr_frame_uus(const dwt_config_t *config, uint16 len);
+
+/* TWR_SFD_TIMEOUT() of a configuration, the value for its sfdTO field */
+uint16 twr_sfd_timeout(const dwt_config_t *config);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn twr_turn_timing()
+ *
+ * @brief Shortest reply delay of the responder and the RX settings of the initiator that go with it, for one turn: the
+ *        request of req_len bytes and its answer of ans_len bytes, both sent with config.
+ *
+ * input parameters
+ * @param config     - radio configuration of both frames
+ * @param req_len    - request frame length, FCS included
+ * @param ans_len    - answer frame length, FCS included
+ * @param turnaround - responder: end of the request to its answer's delayed TX armed, UUS
+ * @param margin     - initiator receiver on this long before the answer, and kept on this long after it, UUS
+ *
+ * output parameters
+ * @param turn       - timing of the turn. The RX timeout saturates at 65535 UUS.
+ *
+ * no return value
+ */
+void twr_turn_timing(const dwt_config_t *config, uint16 req_len, uint16 ans_len, uint32 turnaround, uint32 margin,
+                     twr_turn_t *turn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TWR_TIMING_H_ */
@@ -0,0 +1,219 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_trace.c
+ * @brief   Timing of the phases of the ranging exchanges, see twr_trace.h
+ */
+
+#include <string.h>
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+#include "twr_report.h"
+#include "twr_trace.h"
+
+#include "port.h"
+
+#ifdef TWR_TRACE
+
+typedef struct
+{
+    uint32      count;
+    uint32      cycles_min;
+    uint32      cycles_max;
+    uint64_t    cycles_sum;
+    uint64_t    device_sum;
+    uint32      spi_xfers;
+    uint32      spi_bytes;
+    uint32      polls;
+    uint32      hist[TWR_RPT_TR_BUCKETS];
+} phase_total_t;
+
+/* Counters at the begin of an open phase */
+typedef struct
+{
+    uint32  cycles;
+    uint32  device;
+    uint32  spi_xfers;
+    uint32  spi_bytes;
+    uint32  polls;
+    uint8   open;
+} phase_start_t;
+
+typedef struct
+{
+    phase_total_t   total[TWR_TRACE_NUM_PHASES];
+    phase_start_t   start[TWR_TRACE_NUM_PHASES];
+    /* Running counters, the phases keep their difference */
+    uint32          spi_xfers;
+    uint32          spi_bytes;
+    uint32          polls;
+    uint32          exchanges;      // since the last trace frames, for TWR_TRACE_PERIOD
+    uint8           quiet;          // the trace's own SPI reads, not counted
+} trace_state_t;
+
+static trace_state_t states[TWR_TRACE_NUM_STREAMS];
+static trace_state_t *ts = &states[0];
+static uint8 cycles_started = 0;
+
+/* The DW1000 time, without counting its SPI read */
+static uint32 device_time(void)
+{
+#if TWR_TRACE_DEVICE_TIME
+    uint32 t;
+
+    ts->quiet = 1;
+    t = dwt_readsystimestamphi32();
+    ts->quiet = 0;
+    return t;
+#else
+    return 0;
+#endif
+}
+
+/* Histogram bucket of a phase of cycles, see TWR_RPT_TR_BUCKETS */
+static int duration_bucket(uint32 cycles)
+{
+    uint32 per_us = port_cycles_hz() / 1000000;
+    uint32 us = (per_us != 0) ? cycles / per_us : cycles;
+    int k = 0;
+
+    while (us != 0 && k < TWR_RPT_TR_BUCKETS - 1)
+    {
+        us >>= 1;
+        k++;
+    }
+    return k;
+}
+
+void twr_trace_begin(uint8 phase)
+{
+    phase_start_t *s;
+
+    if (phase >= TWR_TRACE_NUM_PHASES)
+    {
+        return;
+    }
+    if (!cycles_started)
+    {
+        port_cycles_init();
+        cycles_started = 1;
+    }
+    s = &ts->start[phase];
+    s->device = device_time();
+    s->spi_xfers = ts->spi_xfers;
+    s->spi_bytes = ts->spi_bytes;
+    s->polls = ts->polls;
+    s->open = 1;
+    s->cycles = port_cycles();
+}
+
+void twr_trace_end(uint8 phase)
+{
+    uint32 cycles = port_cycles();
+    phase_start_t *s;
+    phase_total_t *t;
+
+    if (phase >= TWR_TRACE_NUM_PHASES || !ts->start[phase].open)
+    {
+        return;
+    }
+    s = &ts->start[phase];
+    t = &ts->total[phase];
+    s->open = 0;
+
+    cycles -= s->cycles;
+    if (t->count == 0 || cycles < t->cycles_min)
+    {
+        t->cycles_min = cycles;
+    }
+    if (cycles > t->cycles_max)
+    {
+        t->cycles_max = cycles;
+    }
+    t->count++;
+    t->cycles_sum += cycles;
+    t->spi_xfers += ts->spi_xfers - s->spi_xfers;
+    t->spi_bytes += ts->spi_bytes - s->spi_bytes;
+    t->polls += ts->polls - s->polls;
+    t->hist[duration_bucket(cycles)]++;
+    t->device_sum += device_time() - s->device;
+
+#if TWR_TRACE_PERIOD > 0
+    if (phase == TWR_TRACE_EXCHANGE && ++ts->exchanges >= TWR_TRACE_PERIOD && twr_trace_send() == DWT_SUCCESS)
+    {
+        twr_trace_reset();
+    }
+#endif
+}
+
+void twr_trace_poll(void)
+{
+    ts->polls++;
+}
+
+void twr_trace_spi(uint32 header, uint32 tx, uint32 rx)
+{
+    if (!ts->quiet)
+    {
+        ts->spi_xfers++;
+        ts->spi_bytes += header + tx + rx;
+    }
+}
+
+void twr_trace_select(unsigned int index)
+{
+    ts = &states[(index < TWR_TRACE_NUM_STREAMS) ? index : 0];
+}
+
+void twr_trace_reset(void)
+{
+    memset(ts->total, 0, sizeof(ts->total));
+    ts->exchanges = 0;
+}
+
+void twr_trace_get(uint8 phase, twr_trace_report_t *r)
+{
+    const phase_total_t *t = &ts->total[phase];
+    int i;
+
+    r->phase = phase;
+    r->count = t->count;
+    r->cpu_hz = port_cycles_hz();
+    r->cycles_min = t->cycles_min;
+    r->cycles_mean = (t->count != 0) ? (uint32)(t->cycles_sum / t->count) : 0;
+    r->cycles_max = t->cycles_max;
+    r->device_mean = (t->count != 0) ? (uint32)(t->device_sum / t->count) : 0;
+    r->spi_xfers = t->spi_xfers;
+    r->spi_bytes = t->spi_bytes;
+    r->polls = t->polls;
+    for (i = 0; i < TWR_RPT_TR_BUCKETS; i++)
+    {
+        r->hist[i] = t->hist[i];
+    }
+}
+
+int twr_trace_send(void)
+{
+    twr_trace_report_t r;
+    int phase, n = 0;
+
+    for (phase = 0; phase < TWR_TRACE_NUM_PHASES; phase++)
+    {
+        n += (ts->total[phase].count != 0);
+    }
+    /* All or none, so a batch is never half sent twice */
+    if (TWR_REPORT_QUEUE_SIZE - 1 - twr_report_pending() < n * TWR_RPT_TRACE_FRAME)
+    {
+        return DWT_ERROR;
+    }
+    for (phase = 0; phase < TWR_TRACE_NUM_PHASES; phase++)
+    {
+        if (ts->total[phase].count != 0)
+        {
+            twr_trace_get((uint8)phase, &r);
+            twr_report_trace(&r);
+        }
+    }
+    return DWT_SUCCESS;
+}
+
+#endif /* TWR_TRACE */
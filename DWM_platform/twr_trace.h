@@ -0,0 +1,115 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_trace.h
+ * @brief   Timing of the phases of the ranging exchanges
+ *
+ *          The only insight into a round used to be the k1/k2 counters
+ *          commented out in the simple examples. Built with TWR_TRACE, the
+ *          ranging engine marks the begin and end of each phase below, and
+ *          every phase records:
+ *           - the CPU cycles, from the DWT cycle counter (port_cycles())
+ *           - the DW1000 system time, dwt_readsystimestamphi32()
+ *           - the SPI transactions and bytes, counted by deca_spi.c
+ *           - the polls of the status register in the engine's busy waits
+ *          and adds its duration to a histogram of TWR_RPT_TR_BUCKETS
+ *          power of 2 buckets. The totals go out on the report stream as
+ *          trace frames of twr_report.h, every TWR_TRACE_PERIOD exchanges or
+ *          on twr_trace_send(). Host/report_decode.c -t prints them.
+ *
+ *          Phases may nest: an exchange holds the others. The DW1000 time
+ *          costs 1 SPI transaction at each end of a phase. The SPI counts
+ *          leave it out, but the durations of the phases around it include
+ *          it. Set TWR_TRACE_DEVICE_TIME to 0 to skip it.
+ *
+ *          Without TWR_TRACE the macros are empty and twr_trace.c compiles
+ *          to nothing. On the host, the cycle counter follows the time of the
+ *          DW1000 emulator (host_port.c), and the simulator skips most of the
+ *          status polls, see uwb_sim.h.
+ */
+
+#ifndef TWR_TRACE_H_
+#define TWR_TRACE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+#include "twr_report.h"
+
+/* Phases */
+#define TWR_TRACE_EXCHANGE      0       // tag: poll to the end of the exchange; anchor: request read to the end
+#define TWR_TRACE_POLL_TX       1       // tag: poll written and sent
+#define TWR_TRACE_RESP_RX       2       // tag: poll sent (or slot opened) to response read
+#define TWR_TRACE_FINAL_TX      3       // DS tag: response read to final armed
+#define TWR_TRACE_RESP_TX       4       // anchor: poll read to response armed
+#define TWR_TRACE_FINAL_RX      5       // DS anchor: response armed to final read
+#define TWR_TRACE_COMPUTE       6       // time of flight and distance
+#define TWR_TRACE_REPORT        7       // range report encoded and queued
+#define TWR_TRACE_USB           8       // twr_report_flush() of a non-empty queue
+#define TWR_TRACE_NUM_PHASES    9
+
+/* Names of the phases, for the host tools */
+#define TWR_TRACE_PHASE_NAMES   { "exchange", "poll tx", "resp rx", "final tx", "resp tx", "final rx", "compute", \
+                                  "report", "usb" }
+
+/* Trace frames are queued every this many exchanges, 0 for only on twr_trace_send() */
+#ifndef TWR_TRACE_PERIOD
+#define TWR_TRACE_PERIOD        1000
+#endif
+
+#ifndef TWR_TRACE_DEVICE_TIME
+#define TWR_TRACE_DEVICE_TIME   1
+#endif
+
+/* Trace states, one per report stream, see twr_trace_select() */
+#ifndef TWR_TRACE_NUM_STREAMS
+#define TWR_TRACE_NUM_STREAMS   TWR_REPORT_NUM_STREAMS
+#endif
+
+#ifdef TWR_TRACE
+
+#define TWR_TRACE_BEGIN(phase)          twr_trace_begin(phase)
+#define TWR_TRACE_END(phase)            twr_trace_end(phase)
+#define TWR_TRACE_POLL()                twr_trace_poll()
+#define TWR_TRACE_SPI(hdr, tx, rx)      twr_trace_spi((hdr), (tx), (rx))
+#define TWR_TRACE_SELECT(index)         twr_trace_select(index)
+
+/* Start phase, restarting it if it was open */
+void twr_trace_begin(uint8 phase);
+
+/* End phase and record it, if it was open */
+void twr_trace_end(uint8 phase);
+
+/* One read of the status register in a busy wait */
+void twr_trace_poll(void);
+
+/* One SPI transaction, from writetospi()/readfromspi() */
+void twr_trace_spi(uint32 header, uint32 tx, uint32 rx);
+
+/* Make state index the one used by the functions above, as twr_report_select(). Index 0 if there is no such state. */
+void twr_trace_select(unsigned int index);
+
+/* Clear the totals of the current state */
+void twr_trace_reset(void);
+
+/* Totals of one phase, in the form of the trace frames */
+void twr_trace_get(uint8 phase, twr_trace_report_t *t);
+
+/* Queue a trace frame for each phase recorded. Returns DWT_SUCCESS, or DWT_ERROR if a frame did not fit. */
+int twr_trace_send(void);
+
+#else
+
+#define TWR_TRACE_BEGIN(phase)          do { } while (0)
+#define TWR_TRACE_END(phase)            do { } while (0)
+#define TWR_TRACE_POLL()                do { } while (0)
+#define TWR_TRACE_SPI(hdr, tx, rx)      do { } while (0)
+#define TWR_TRACE_SELECT(index)         do { } while (0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TWR_TRACE_H_ */
@@ -0,0 +1,62 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_ts.c
+ * @brief   40 bit DW1000 timestamps, see twr_ts.h
+ */
+
+#include "deca_types.h"
+#include "twr_ts.h"
+
+/* The delayed TX/RX time register holds bits 8 to 39 of the time, bit 0 of the register (bit 8 of the time) ignored */
+#define DX_TIME_SHIFT           8
+#define DX_TIME_MASK            0xFFFFFFFEUL
+
+twr_ts_t twr_ts_add(twr_ts_t ts, int64_t dtu)
+{
+    return (ts + (uint64_t)dtu) & TWR_TS_MASK;
+}
+
+uint64_t twr_ts_elapsed(twr_ts_t later, twr_ts_t earlier)
+{
+    return (later - earlier) & TWR_TS_MASK;
+}
+
+int64_t twr_ts_diff(twr_ts_t a, twr_ts_t b)
+{
+    uint64_t d = (a - b) & TWR_TS_MASK;
+
+    /* Sign extend bit 39 */
+    return (d & ((uint64_t)1 << (TWR_TS_BITS - 1))) ? (int64_t)(d | ~TWR_TS_MASK) : (int64_t)d;
+}
+
+uint32 twr_ts_dx_time(twr_ts_t ts)
+{
+    return (uint32)((ts & TWR_TS_MASK) >> DX_TIME_SHIFT);
+}
+
+twr_ts_t twr_ts_dx_tx(uint32 dx_time, uint16 txAntDly)
+{
+    return twr_ts_add((twr_ts_t)(dx_time & DX_TIME_MASK) << DX_TIME_SHIFT, txAntDly);
+}
+
+void twr_ts_put(uint8 *field, twr_ts_t ts)
+{
+    int i;
+
+    for (i = 0; i < TWR_TS_LEN; i++)
+    {
+        field[i] = (uint8)ts;
+        ts >>= 8;
+    }
+}
+
+twr_ts_t twr_ts_get(const uint8 *field)
+{
+    twr_ts_t ts = 0;
+    int i;
+
+    for (i = TWR_TS_LEN - 1; i >= 0; i--)
+    {
+        ts = (ts << 8) | field[i];
+    }
+    return ts;
+}
@@ -0,0 +1,68 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_ts.h
+ * @brief   40 bit DW1000 timestamps: wrap-aware arithmetic and frame fields
+ *
+ *          The DW1000 system time counts DTU (1 / (128 * 499.2 MHz), about
+ *          15.65 ps) on 40 bits, and wraps every 17.2 s. The examples carried
+ *          the timestamps of the final message on 4 bytes and computed the
+ *          intervals with 32 bit subtractions: wrap-safe, but only for
+ *          intervals under 2^32 DTU, 67.1 ms. A twr_ts_t keeps all 40 bits:
+ *           - intervals are taken modulo 2^40, so any interval under 17.2 s
+ *             is exact across the wrap of the system time
+ *           - the frame fields hold 5 bytes, least significant first as the
+ *             4 byte fields of the examples
+ *           - a delayed TX or RX time (dwt_setdelayedtrxtime()) is bits 8 to
+ *             39 of the time, and the TX timestamp that results is known
+ *             before the frame is sent
+ *
+ *          The TX and RX timestamps come from get_tx_timestamp_u64() and
+ *          get_rx_timestamp_u64() of deca_timestamps.h.
+ */
+
+#ifndef TWR_TS_H_
+#define TWR_TS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+
+#define TWR_TS_BITS             40
+#define TWR_TS_MASK             ((((uint64_t)1) << TWR_TS_BITS) - 1)
+#define TWR_TS_LEN              5       // bytes of a timestamp field
+
+/* DTU of one UUS (512 / 499.2 us) */
+#define TWR_TS_DTU_PER_UUS      65536
+
+/* DTU of uus UUS, for twr_ts_add() */
+#define TWR_TS_UUS(uus)         ((int64_t)(uus) * TWR_TS_DTU_PER_UUS)
+
+/* System time in DTU, 40 bits */
+typedef uint64_t twr_ts_t;
+
+/* ts + dtu, modulo 2^40. dtu may be negative. */
+twr_ts_t twr_ts_add(twr_ts_t ts, int64_t dtu);
+
+/* Interval from earlier to later, DTU modulo 2^40: exact for any interval under 17.2 s, across the wrap */
+uint64_t twr_ts_elapsed(twr_ts_t later, twr_ts_t earlier);
+
+/* a - b the shortest way round, DTU, from -2^39 to 2^39 - 1: negative if a is before b */
+int64_t twr_ts_diff(twr_ts_t a, twr_ts_t b);
+
+/* dwt_setdelayedtrxtime() value for the time ts, whose lowest 9 bits the DW1000 ignores */
+uint32 twr_ts_dx_time(twr_ts_t ts);
+
+/* TX timestamp of a frame sent at dwt_setdelayedtrxtime(dx_time): the time the DW1000 sends at, plus the TX antenna
+ * delay */
+twr_ts_t twr_ts_dx_tx(uint32 dx_time, uint16 txAntDly);
+
+/* Timestamp field of a frame, TWR_TS_LEN bytes, least significant first */
+void twr_ts_put(uint8 *field, twr_ts_t ts);
+twr_ts_t twr_ts_get(const uint8 *field);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TWR_TS_H_ */
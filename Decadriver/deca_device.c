@@ -13,6 +13,7 @@
 #include <assert.h>
 #include <DWM_functions.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "deca_types.h"
 #include "deca_param_types.h"
@@ -51,8 +52,6 @@ static volatile uint32 devid;
 
 // Enable and Configure specified clocks
 void _dwt_enableclocks(int clocks) ;
-// Configure the ucode (FP algorithm) parameters
-void _dwt_configlde(int prf);
 // Load ucode from OTP/ROM
 void _dwt_loaducodefromrom(void);
 // Read non-volatile memory
@@ -63,6 +62,50 @@ uint32 _dwt_otpprogword32(uint32 data, uint16 address);
 void _dwt_aonarrayupload(void);
 // -------------------------------------------------------------------------------------------------------------------
 
+// -------------------------------------------------------------------------------------------------------------------
+// Register shadow cache
+//
+// Configuration registers that the driver reads back to modify, or rewrites with the same value, are mirrored per
+// device. dwt_writetodevice() and dwt_readfromdevice() keep the copy up to date on every access to them. A read of
+// bytes already known is answered from the copy, and a write that changes none of them is not sent. The chip only
+// changes these registers on reset, LDE/OPS loads and wake up, where the driver forgets them (dwt_shadowinvalidate()).
+// Build with DWT_NO_REG_SHADOW to go back to plain SPI accesses.
+// -------------------------------------------------------------------------------------------------------------------
+#ifndef DWT_NO_REG_SHADOW
+
+#define SHADOW_MASKED   0x01    // GPIO_DIR/GPIO_DOUT: each byte is 4 mask bits (high nibble) enabling 4 value bits
+
+typedef struct
+{
+    uint8   regFileID;
+    uint16  offset;
+    uint8   len;                // up to 4 bytes
+    uint8   flags;
+    uint8   alwaysWrite;        // byte mask: writes to these bytes have side effects, they are never skipped
+} dwt_shadow_reg_t;
+
+static const dwt_shadow_reg_t shadow_regs[] =
+{
+    { PMSC_ID,      PMSC_CTRL0_OFFSET,  4,  0,              0x08 },    // clocks; byte 3 is SOFTRESET
+    { PMSC_ID,      PMSC_CTRL1_OFFSET,  4,  0,              0x00 },
+    { SYS_MASK_ID,  0,                  4,  0,              0x00 },
+    { ACK_RESP_T_ID, 0,                 4,  0,              0x00 },
+    { TX_ANTD_ID,   0,                  2,  0,              0x00 },
+    { LDE_IF_ID,    LDE_RXANTD_OFFSET,  2,  0,              0x00 },
+    { GPIO_CTRL_ID, GPIO_MODE_OFFSET,   4,  0,              0x00 },
+    { GPIO_CTRL_ID, GPIO_DIR_OFFSET,    GPIO_DIR_LEN,  SHADOW_MASKED, 0x00 },
+    { GPIO_CTRL_ID, GPIO_DOUT_OFFSET,   GPIO_DOUT_LEN, SHADOW_MASKED, 0x00 },
+};
+
+#define SHADOW_NUM_REGS     (sizeof(shadow_regs) / sizeof(shadow_regs[0]))
+
+// Register files holding a shadowed register, accesses to the others skip the lookup
+#define SHADOW_FILE(id)     (1ULL << (id))
+#define SHADOW_FILES        (SHADOW_FILE(PMSC_ID) | SHADOW_FILE(SYS_MASK_ID) | SHADOW_FILE(ACK_RESP_T_ID) | \
+                             SHADOW_FILE(TX_ANTD_ID) | SHADOW_FILE(LDE_IF_ID) | SHADOW_FILE(GPIO_CTRL_ID))
+
+#endif
+
 /*!
  * Static data for DW1000 DecaWave Transceiver control
  */
@@ -88,6 +131,10 @@ typedef struct
     dwt_cb_t    cbRxOk;             // Callback for RX good frame event
     dwt_cb_t    cbRxTo;             // Callback for RX timeout events
     dwt_cb_t    cbRxErr;            // Callback for RX error events
+#ifndef DWT_NO_REG_SHADOW
+    uint8       shadow[SHADOW_NUM_REGS][4];         // Register shadow cache: last value of each shadowed register
+    uint8       shadowKnown[SHADOW_NUM_REGS][4];    // bits of shadow[][] that match the chip
+#endif
 } dwt_local_data_t ;
 
 static dwt_local_data_t dw1000local[DWT_NUM_DW_DEV] ; // Static local device data, can be an array to support multiple DW1000 testing applications/platforms
@@ -119,6 +166,164 @@ int dwt_setlocaldataptr(unsigned int index)
     return DWT_SUCCESS ;
 }
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_shadowinvalidate()
+ *
+ * @brief This function makes the driver forget the register values it mirrors, so that the next access to each of
+ *        them goes to the DW1000. The driver does it itself on soft reset, initialisation, sleep and wake up; call it
+ *        after resetting or waking the chip by other means (e.g. deca_reset() not followed by dwt_initialise()).
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_shadowinvalidate(void)
+{
+#ifndef DWT_NO_REG_SHADOW
+    memset(pdw1000local->shadowKnown, 0, sizeof(pdw1000local->shadowKnown));
+#endif
+}
+
+#ifndef DWT_NO_REG_SHADOW
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_shadowwrite()
+ *
+ * @brief Updates the shadow cache with a write about to be made, see dwt_writetodevice()
+ *
+ * input parameters
+ * @param recordNumber  - ID of register file being written
+ * @param index         - byte index into register file
+ * @param length        - number of bytes being written
+ * @param buffer        - the bytes
+ *
+ * output parameters
+ *
+ * returns 1 if the write changes nothing on the chip and can be skipped, 0 if it must be made
+ */
+static int _dwt_shadowwrite(uint16 recordNumber, uint16 index, uint32 length, const uint8 *buffer)
+{
+    uint32 covered = 0;
+    int same = 1;
+    uint32 i, k, first, last;
+    uint8 b, m;
+
+    for (i = 0; i < SHADOW_NUM_REGS; i++)
+    {
+        const dwt_shadow_reg_t *r = &shadow_regs[i];
+        uint8 *val = pdw1000local->shadow[i];
+        uint8 *known = pdw1000local->shadowKnown[i];
+
+        if ((r->regFileID != recordNumber) || (index >= r->offset + r->len) || (index + length <= r->offset))
+        {
+            continue;
+        }
+        first = (index > r->offset) ? index : r->offset;
+        last = (index + length < (uint32)r->offset + r->len) ? index + length : (uint32)r->offset + r->len;
+        for (k = first - r->offset; k < last - r->offset; k++)
+        {
+            b = buffer[r->offset + k - index];
+            if (r->flags & SHADOW_MASKED)
+            {
+                // Only the value bits whose mask bit is set are written
+                m = (b >> 4) & 0x0f;
+                same = same && ((known[k] & m) == m) && ((val[k] & m) == (b & m));
+                val[k] = (val[k] & ~m) | (b & m);
+                known[k] |= m;
+            }
+            else
+            {
+                same = same && (known[k] == 0xff) && (val[k] == b) && !(r->alwaysWrite & (1 << k));
+                val[k] = b;
+                known[k] = 0xff;
+            }
+        }
+        covered += last - first;
+    }
+    return same && (covered == length);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_shadowread()
+ *
+ * @brief Answers a read from the shadow cache if all its bytes are known, see dwt_readfromdevice()
+ *
+ * input parameters
+ * @param recordNumber  - ID of register file being read
+ * @param index         - byte index into register file
+ * @param length        - number of bytes being read
+ *
+ * output parameters
+ * @param buffer        - the bytes, if the function returns 1
+ *
+ * returns 1 if the read was answered, 0 if it must be made
+ */
+static int _dwt_shadowread(uint16 recordNumber, uint16 index, uint32 length, uint8 *buffer)
+{
+    uint32 i, k;
+
+    for (i = 0; i < SHADOW_NUM_REGS; i++)
+    {
+        const dwt_shadow_reg_t *r = &shadow_regs[i];
+
+        if ((r->regFileID != recordNumber) || (r->flags & SHADOW_MASKED) ||
+            (index < r->offset) || (index + length > (uint32)r->offset + r->len))
+        {
+            continue;
+        }
+        for (k = index - r->offset; k < index - r->offset + length; k++)
+        {
+            if (pdw1000local->shadowKnown[i][k] != 0xff)
+            {
+                return 0;
+            }
+        }
+        memcpy(buffer, &pdw1000local->shadow[i][index - r->offset], length);
+        return 1;
+    }
+    return 0;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_shadowlearn()
+ *
+ * @brief Copies the shadowed bytes of a read from the chip into the shadow cache, see dwt_readfromdevice()
+ *
+ * input parameters
+ * @param recordNumber  - ID of register file read
+ * @param index         - byte index into register file
+ * @param length        - number of bytes read
+ * @param buffer        - the bytes
+ *
+ * output parameters
+ *
+ * no return value
+ */
+static void _dwt_shadowlearn(uint16 recordNumber, uint16 index, uint32 length, const uint8 *buffer)
+{
+    uint32 i, k, first, last;
+
+    for (i = 0; i < SHADOW_NUM_REGS; i++)
+    {
+        const dwt_shadow_reg_t *r = &shadow_regs[i];
+
+        if ((r->regFileID != recordNumber) || (r->flags & SHADOW_MASKED) ||
+            (index >= r->offset + r->len) || (index + length <= r->offset))
+        {
+            continue;
+        }
+        first = (index > r->offset) ? index : r->offset;
+        last = (index + length < (uint32)r->offset + r->len) ? index + length : (uint32)r->offset + r->len;
+        for (k = first - r->offset; k < last - r->offset; k++)
+        {
+            pdw1000local->shadow[i][k] = buffer[r->offset + k - index];
+            pdw1000local->shadowKnown[i][k] = 0xff;
+        }
+    }
+}
+#endif
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_initialise()
  *
@@ -175,6 +380,8 @@ int dwt_initialise(int config)
     pdw1000local->cbRxTo = NULL;
     pdw1000local->cbRxErr = NULL;
 
+    dwt_shadowinvalidate(); // Nothing is known of a chip just reset or woken up
+
 #if DWT_API_ERROR_CHECK
     pdw1000local->otp_mask = config ; // Save the READ_OTP config mask
 #endif
@@ -639,29 +846,81 @@ void dwt_configurefor64plen(int prf)
 
 
 /*! ------------------------------------------------------------------------------------------------------------------
- * @fn dwt_configure()
+ * @fn _dwt_regimageadd()
  *
- * @brief This function provides the main API for the configuration of the
- * DW1000 and this low-level driver.  The input is a pointer to the data structure
- * of type dwt_config_t that holds all the configurable items.
- * The dwt_config_t structure shows which ones are supported
+ * @brief Appends a register write to a compiled configuration, see dwt_compileconfig(). A write that starts where the
+ *        last one ended, in the same register file, extends it so that both go out in one SPI transaction.
  *
  * input parameters
- * @param config    -   pointer to the configuration structure, which contains the device configuration data.
+ * @param image     - the image being compiled
+ * @param regFileID - ID of register file to write
+ * @param offset    - byte index into register file
+ * @param len       - number of bytes, 1 to 4
+ * @param value     - the value, written least significant byte first
  *
  * output parameters
  *
- * no return value
+ * returns DWT_SUCCESS for success, or DWT_ERROR if the image is full
  */
-void dwt_configure(dwt_config_t *config)
+static int _dwt_regimageadd(dwt_regimage_t *image, uint8 regFileID, uint16 offset, uint8 len, uint32 value)
+{
+    dwt_regpatch_t *last = (image->numPatches > 0) ? &image->patch[image->numPatches - 1] : NULL;
+    int j;
+
+    if(image->numBytes + len > DWT_REGIMAGE_MAX_BYTES)
+    {
+        return DWT_ERROR;
+    }
+
+    if((last == NULL) || (last->regFileID != regFileID) || (last->offset + last->len != offset))
+    {
+        if(image->numPatches == DWT_REGIMAGE_MAX_PATCHES)
+        {
+            return DWT_ERROR;
+        }
+        last = &image->patch[image->numPatches++];
+        last->regFileID = regFileID;
+        last->offset = offset;
+        last->len = 0;
+        last->pos = image->numBytes;
+    }
+
+    for(j = 0; j < len; j++)
+    {
+        image->data[image->numBytes++] = (uint8)(value >> (8 * j));
+    }
+    last->len += len;
+
+    return DWT_SUCCESS;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_compileconfig()
+ *
+ * @brief This function computes the register writes of dwt_configure() for a configuration, without accessing the
+ * device. Writes to adjacent registers of the same register file are merged, so that the DRX tuning, PLL and RF
+ * blocks each take one SPI transaction. The image holds no pointer: it can be compiled once at start up, or on a PC
+ * and stored as a const initialiser, and written with dwt_applyconfig() or dwt_switchconfig().
+ *
+ * input parameters
+ * @param config    -   pointer to the configuration structure, as for dwt_configure(). An sfdTO of 0 compiles as
+ *                      DWT_SFDTOC_DEF.
+ *
+ * output parameters
+ * @param image     -   the compiled register image
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR for a configuration outside the parameter tables
+ */
+int dwt_compileconfig(const dwt_config_t *config, dwt_regimage_t *image)
 {
     uint8 nsSfd_result  = 0;
     uint8 useDWnsSFD = 0;
     uint8 chan = config->chan ;
     uint32 regval ;
-    uint16 reg16 = lde_replicaCoeff[config->rxCode];
+    uint16 reg16;
     uint8 prfIndex = config->prf - DWT_PRF_16M;
     uint8 bw = ((chan == 4) || (chan == 7)) ? 1 : 0 ; // Select wide or narrow band
+    int err = DWT_SUCCESS;
 
 #ifdef DWT_API_ERROR_CHECK
     assert(config->dataRate <= DWT_BR_6M8);
@@ -677,84 +936,72 @@ void dwt_configure(dwt_config_t *config)
     assert((config->phrMode == DWT_PHRMODE_STD) || (config->phrMode == DWT_PHRMODE_EXT));
 #endif
 
+    // The table lookups below must stay in bounds even without DWT_API_ERROR_CHECK
+    if((config->dataRate >= NUM_BR) || (config->rxPAC >= NUM_PACS) || (prfIndex >= NUM_PRF) || (chan >= NUM_CH_SUPPORTED)
+       || (config->rxCode >= PCODES) || (config->nsSFD >= NUM_SFD))
+    {
+        return DWT_ERROR;
+    }
+
+    image->numPatches = 0;
+    image->numBytes = 0;
+
     // For 110 kbps we need a special setup
+    reg16 = lde_replicaCoeff[config->rxCode];
+    image->sysCFG = SYS_CFG_PHR_MODE_11 & ((uint32)config->phrMode << SYS_CFG_PHR_MODE_SHFT);
     if(DWT_BR_110K == config->dataRate)
     {
-        pdw1000local->sysCFGreg |= SYS_CFG_RXM110K ;
+        image->sysCFG |= SYS_CFG_RXM110K ;
         reg16 >>= 3; // lde_replicaCoeff must be divided by 8
     }
-    else
-    {
-        pdw1000local->sysCFGreg &= (~SYS_CFG_RXM110K) ;
-    }
+    image->longFrames = config->phrMode ;
 
-    pdw1000local->longFrames = config->phrMode ;
-
-    pdw1000local->sysCFGreg &= ~SYS_CFG_PHR_MODE_11;
-    pdw1000local->sysCFGreg |= (SYS_CFG_PHR_MODE_11 & ((uint32)config->phrMode << SYS_CFG_PHR_MODE_SHFT));
-
-    dwt_write32bitreg(SYS_CFG_ID,pdw1000local->sysCFGreg) ;
-    // Set the lde_replicaCoeff
-    dwt_write16bitoffsetreg(LDE_IF_ID, LDE_REPC_OFFSET, reg16) ;
-
-    _dwt_configlde(prfIndex);
+    // Set the lde_replicaCoeff, and configure the LDE algorithm parameters
+    err |= _dwt_regimageadd(image, LDE_IF_ID, LDE_REPC_OFFSET, 2, reg16);
+    err |= _dwt_regimageadd(image, LDE_IF_ID, LDE_CFG1_OFFSET, 1, LDE_PARAM1);
+    err |= _dwt_regimageadd(image, LDE_IF_ID, LDE_CFG2_OFFSET, 2, prfIndex ? LDE_PARAM3_64 : LDE_PARAM3_16);
 
     // Configure PLL2/RF PLL block CFG/TUNE (for a given channel)
-    dwt_write32bitoffsetreg(FS_CTRL_ID, FS_PLLCFG_OFFSET, fs_pll_cfg[chan_idx[chan]]);
-    dwt_write8bitoffsetreg(FS_CTRL_ID, FS_PLLTUNE_OFFSET, fs_pll_tune[chan_idx[chan]]);
+    err |= _dwt_regimageadd(image, FS_CTRL_ID, FS_PLLCFG_OFFSET, 4, fs_pll_cfg[chan_idx[chan]]);
+    err |= _dwt_regimageadd(image, FS_CTRL_ID, FS_PLLTUNE_OFFSET, 1, fs_pll_tune[chan_idx[chan]]);
 
-    // Configure RF RX blocks (for specified channel/bandwidth)
-    dwt_write8bitoffsetreg(RF_CONF_ID, RF_RXCTRLH_OFFSET, rx_config[bw]);
-
-    // Configure RF TX blocks (for specified channel and PRF)
-    // Configure RF TX control
-    dwt_write32bitoffsetreg(RF_CONF_ID, RF_TXCTRL_OFFSET, tx_config[chan_idx[chan]]);
-
-    // Configure the baseband parameters (for specified PRF, bit rate, PAC, and SFD settings)
-    // DTUNE0
-    dwt_write16bitoffsetreg(DRX_CONF_ID, DRX_TUNE0b_OFFSET, sftsh[config->dataRate][config->nsSFD]);
-
-    // DTUNE1
-    dwt_write16bitoffsetreg(DRX_CONF_ID, DRX_TUNE1a_OFFSET, dtune1[prfIndex]);
+    // Configure RF RX blocks (for specified channel/bandwidth) and RF TX control (for specified channel and PRF)
+    err |= _dwt_regimageadd(image, RF_CONF_ID, RF_RXCTRLH_OFFSET, 1, rx_config[bw]);
+    err |= _dwt_regimageadd(image, RF_CONF_ID, RF_TXCTRL_OFFSET, 4, tx_config[chan_idx[chan]]);
 
+    // Configure the baseband parameters (for specified PRF, bit rate, PAC, and SFD settings): DTUNE0, DTUNE1, DTUNE2
+    err |= _dwt_regimageadd(image, DRX_CONF_ID, DRX_TUNE0b_OFFSET, 2, sftsh[config->dataRate][config->nsSFD]);
+    err |= _dwt_regimageadd(image, DRX_CONF_ID, DRX_TUNE1a_OFFSET, 2, dtune1[prfIndex]);
     if(config->dataRate == DWT_BR_110K)
     {
-        dwt_write16bitoffsetreg(DRX_CONF_ID, DRX_TUNE1b_OFFSET, DRX_TUNE1b_110K);
+        err |= _dwt_regimageadd(image, DRX_CONF_ID, DRX_TUNE1b_OFFSET, 2, DRX_TUNE1b_110K);
     }
     else
     {
-        if(config->txPreambLength == DWT_PLEN_64)
-        {
-            dwt_write16bitoffsetreg(DRX_CONF_ID, DRX_TUNE1b_OFFSET, DRX_TUNE1b_6M8_PRE64);
-            dwt_write8bitoffsetreg(DRX_CONF_ID, DRX_TUNE4H_OFFSET, DRX_TUNE4H_PRE64);
-        }
-        else
-        {
-            dwt_write16bitoffsetreg(DRX_CONF_ID, DRX_TUNE1b_OFFSET, DRX_TUNE1b_850K_6M8);
-            dwt_write8bitoffsetreg(DRX_CONF_ID, DRX_TUNE4H_OFFSET, DRX_TUNE4H_PRE128PLUS);
-        }
+        err |= _dwt_regimageadd(image, DRX_CONF_ID, DRX_TUNE1b_OFFSET, 2,
+                                (config->txPreambLength == DWT_PLEN_64) ? DRX_TUNE1b_6M8_PRE64 : DRX_TUNE1b_850K_6M8);
     }
-
-    // DTUNE2
-    dwt_write32bitoffsetreg(DRX_CONF_ID, DRX_TUNE2_OFFSET, digital_bb_config[prfIndex][config->rxPAC]);
+    err |= _dwt_regimageadd(image, DRX_CONF_ID, DRX_TUNE2_OFFSET, 4, digital_bb_config[prfIndex][config->rxPAC]);
 
     // DTUNE3 (SFD timeout)
     // Don't allow 0 - SFD timeout will always be enabled
-    if(config->sfdTO == 0)
+    err |= _dwt_regimageadd(image, DRX_CONF_ID, DRX_SFDTOC_OFFSET, 2, (config->sfdTO == 0) ? DWT_SFDTOC_DEF : config->sfdTO);
+
+    if(config->dataRate != DWT_BR_110K)
     {
-        config->sfdTO = DWT_SFDTOC_DEF;
+        err |= _dwt_regimageadd(image, DRX_CONF_ID, DRX_TUNE4H_OFFSET, 1,
+                                (config->txPreambLength == DWT_PLEN_64) ? DRX_TUNE4H_PRE64 : DRX_TUNE4H_PRE128PLUS);
     }
-    dwt_write16bitoffsetreg(DRX_CONF_ID, DRX_SFDTOC_OFFSET, config->sfdTO);
 
     // Configure AGC parameters
-    dwt_write32bitoffsetreg( AGC_CFG_STS_ID, 0xC, agc_config.lo32);
-    dwt_write16bitoffsetreg( AGC_CFG_STS_ID, 0x4, agc_config.target[prfIndex]);
+    err |= _dwt_regimageadd(image, AGC_CFG_STS_ID, 0xC, 4, agc_config.lo32);
+    err |= _dwt_regimageadd(image, AGC_CFG_STS_ID, 0x4, 2, agc_config.target[prfIndex]);
 
     // Set (non-standard) user SFD for improved performance,
     if(config->nsSFD)
     {
         // Write non standard (DW) SFD length
-        dwt_write8bitoffsetreg(USR_SFD_ID, 0x00, dwnsSFDlen[config->dataRate]);
+        err |= _dwt_regimageadd(image, USR_SFD_ID, 0x00, 1, dwnsSFDlen[config->dataRate]);
         nsSfd_result = 3 ;
         useDWnsSFD = 1 ;
     }
@@ -766,17 +1013,138 @@ void dwt_configure(dwt_config_t *config)
               (CHAN_CTRL_TX_PCOD_MASK & ((uint32)config->txCode << CHAN_CTRL_TX_PCOD_SHIFT)) | // TX Preamble Code
               (CHAN_CTRL_RX_PCOD_MASK & ((uint32)config->rxCode << CHAN_CTRL_RX_PCOD_SHIFT)) ; // RX Preamble Code
 
-    dwt_write32bitreg(CHAN_CTRL_ID,regval) ;
+    err |= _dwt_regimageadd(image, CHAN_CTRL_ID, 0, 4, regval);
 
     // Set up TX Preamble Size, PRF and Data Rate
-    pdw1000local->txFCTRL = ((uint32)(config->txPreambLength | config->prf) << TX_FCTRL_TXPRF_SHFT) | ((uint32)config->dataRate << TX_FCTRL_TXBR_SHFT);
-    dwt_write32bitreg(TX_FCTRL_ID, pdw1000local->txFCTRL);
+    image->txFCTRL = ((uint32)(config->txPreambLength | config->prf) << TX_FCTRL_TXPRF_SHFT) | ((uint32)config->dataRate << TX_FCTRL_TXBR_SHFT);
+    err |= _dwt_regimageadd(image, TX_FCTRL_ID, 0, 4, image->txFCTRL);
+
+    return err ? DWT_ERROR : DWT_SUCCESS;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_writeconfig()
+ *
+ * @brief Writes the SYS_CFG bits and the patches of a compiled configuration, skipping those already on the device
+ *        as part of the configuration from, then initialises the SFD. See dwt_applyconfig() and dwt_switchconfig().
+ *
+ * input parameters
+ * @param from  - the configuration the device holds, or NULL to write everything
+ * @param to    - the configuration to write
+ *
+ * output parameters
+ *
+ * no return value
+ */
+static void _dwt_writeconfig(const dwt_regimage_t *from, const dwt_regimage_t *to)
+{
+    const dwt_regpatch_t *p, *q;
+    int i, k;
+
+    pdw1000local->longFrames = to->longFrames ;
+    pdw1000local->txFCTRL = to->txFCTRL ;
+    if((from == NULL) || (from->sysCFG != to->sysCFG))
+    {
+        pdw1000local->sysCFGreg &= ~(SYS_CFG_RXM110K | SYS_CFG_PHR_MODE_11);
+        pdw1000local->sysCFGreg |= to->sysCFG;
+        dwt_write32bitreg(SYS_CFG_ID, pdw1000local->sysCFGreg) ;
+    }
+
+    for(i = 0; i < to->numPatches; i++)
+    {
+        p = &to->patch[i];
+        for(k = 0; (from != NULL) && (k < from->numPatches); k++)
+        {
+            q = &from->patch[k];
+            if((q->regFileID == p->regFileID) && (q->offset == p->offset) && (q->len == p->len)
+               && (memcmp(&from->data[q->pos], &to->data[p->pos], p->len) == 0))
+            {
+                break;
+            }
+        }
+        if((from == NULL) || (k == from->numPatches))
+        {
+            dwt_writetodevice(p->regFileID, p->offset, p->len, &to->data[p->pos]);
+        }
+    }
 
     // The SFD transmit pattern is initialised by the DW1000 upon a user TX request, but (due to an IC issue) it is not done for an auto-ACK TX. The
     // SYS_CTRL write below works around this issue, by simultaneously initiating and aborting a transmission, which correctly initialises the SFD
     // after its configuration or reconfiguration.
     // This issue is not documented at the time of writing this code. It should be in next release of DW1000 User Manual (v2.09, from July 2016).
     dwt_write8bitoffsetreg(SYS_CTRL_ID, SYS_CTRL_OFFSET, SYS_CTRL_TXSTRT | SYS_CTRL_TRXOFF); // Request TX start and TRX off at the same time
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_applyconfig()
+ *
+ * @brief This function configures the DW1000 and this low-level driver from a configuration compiled by
+ * dwt_compileconfig(), with one SPI transaction per patch of the image. It has the same effect as dwt_configure().
+ *
+ * input parameters
+ * @param image     -   the compiled configuration
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_applyconfig(const dwt_regimage_t *image)
+{
+    _dwt_writeconfig(NULL, image);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_switchconfig()
+ *
+ * @brief This function moves the DW1000 from one compiled configuration to another, e.g. to change the channel or the
+ * data rate. Only the patches of the new image that differ from the old one are written. The device must
+ * hold the old configuration: no other write, e.g. dwt_configurefor64plen(), may have changed the registers of the
+ * image since it was applied.
+ *
+ * input parameters
+ * @param from      -   the configuration last applied to the device
+ * @param to        -   the configuration to apply
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_switchconfig(const dwt_regimage_t *from, const dwt_regimage_t *to)
+{
+    _dwt_writeconfig(from, to);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_configure()
+ *
+ * @brief This function provides the main API for the configuration of the
+ * DW1000 and this low-level driver.  The input is a pointer to the data structure
+ * of type dwt_config_t that holds all the configurable items.
+ * The dwt_config_t structure shows which ones are supported
+ * It compiles the configuration with dwt_compileconfig() and writes it with dwt_applyconfig(): a caller that switches
+ * between a few configurations can compile them once and save the computation.
+ *
+ * input parameters
+ * @param config    -   pointer to the configuration structure, which contains the device configuration data.
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_configure(dwt_config_t *config)
+{
+    dwt_regimage_t image;
+
+    // Don't allow 0 - SFD timeout will always be enabled
+    if(config->sfdTO == 0)
+    {
+        config->sfdTO = DWT_SFDTOC_DEF;
+    }
+
+    if(dwt_compileconfig(config, &image) == DWT_SUCCESS)
+    {
+        dwt_applyconfig(&image);
+    }
 } // end dwt_configure()
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -1002,6 +1370,81 @@ void dwt_readdiagnostics(dwt_rxdiag_t *diagnostics)
     diagnostics->rxPreamCount = (dwt_read32bitreg(RX_FINFO_ID) & RX_FINFO_RXPACC_MASK) >> RX_FINFO_RXPACC_SHIFT  ;
 }
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_readrxsnapshot()
+ *
+ * @brief This is used after a good frame to read what a ranging exchange needs of it in as few SPI transactions as
+ *        possible: the frame info and the frame, the RX timestamp, the diagnostics and the carrier integrator, as
+ *        flags asks. The RX timestamp, first path index and first path amplitude 1 follow each other in RX_TIME and
+ *        take one read, and the preamble count comes from the frame info. Everything takes 6 SPI transactions, where
+ *        dwt_readrxtimestamp(), dwt_readdiagnostics() and dwt_readcarrierintegrator() after the frame take 9. The
+ *        parts can be read in several calls on the same snap, the diagnostics after or with the frame info.
+ *
+ * input parameters
+ * @param buffer - DWT_RXSNAP_FRAME: the frame is read here if its length is from 1 to maxLen bytes, NULL not to read it
+ * @param maxLen - size of buffer
+ * @param flags  - DWT_RXSNAP_xxx
+ *
+ * output parameters
+ * @param snap - the parts asked, the others are left as they were
+ *
+ * returns the frame length, FCS included, as read by this or an earlier call
+ */
+uint16 dwt_readrxsnapshot(dwt_rxsnapshot_t *snap, uint8 *buffer, uint16 maxLen, uint8 flags)
+{
+    uint8   rxtime[RX_TIME_FP_RAWST_OFFSET] ;   // timestamp, first path index and amplitude 1
+    uint8   ci[DRX_CARRIER_INT_LEN] ;
+    uint32  regval = 0 ;
+    int     j ;
+
+    if(flags & DWT_RXSNAP_FRAME)
+    {
+        snap->finfo = dwt_read32bitreg(RX_FINFO_ID) ;
+
+        // Standard frame length up to 127, extended frame length up to 1023 bytes
+        snap->length = (uint16)(snap->finfo & RX_FINFO_RXFL_MASK_1023) ;
+        if(pdw1000local->longFrames == 0)
+        {
+            snap->length &= RX_FINFO_RXFLEN_MASK ;
+        }
+        if((buffer != NULL) && (snap->length > 0) && (snap->length <= maxLen))
+        {
+            dwt_readfromdevice(RX_BUFFER_ID, 0, snap->length, buffer) ;
+        }
+    }
+
+    if(flags & (DWT_RXSNAP_TIME | DWT_RXSNAP_DIAG))
+    {
+        dwt_readfromdevice(RX_TIME_ID, RX_TIME_RX_STAMP_OFFSET,
+                           (flags & DWT_RXSNAP_DIAG) ? RX_TIME_FP_RAWST_OFFSET : RX_TIME_RX_STAMP_LEN, rxtime) ;
+        memcpy(snap->rxStamp, rxtime, RX_TIME_RX_STAMP_LEN) ;
+    }
+
+    if(flags & DWT_RXSNAP_DIAG)
+    {
+        snap->diag.firstPath = (uint16)(rxtime[RX_TIME_FP_INDEX_OFFSET] | (rxtime[RX_TIME_FP_INDEX_OFFSET + 1] << 8)) ;
+        snap->diag.firstPathAmp1 = (uint16)(rxtime[RX_TIME_FP_AMPL1_OFFSET] | (rxtime[RX_TIME_FP_AMPL1_OFFSET + 1] << 8)) ;
+        snap->diag.maxNoise = dwt_read16bitoffsetreg(LDE_IF_ID, LDE_THRESH_OFFSET) ;
+        dwt_readfromdevice(RX_FQUAL_ID, 0x0, RX_FQUAL_LEN, (uint8*)&snap->diag.stdNoise) ;
+        snap->diag.rxPreamCount = (uint16)((snap->finfo & RX_FINFO_RXPACC_MASK) >> RX_FINFO_RXPACC_SHIFT) ;
+    }
+
+    if(flags & DWT_RXSNAP_CI)
+    {
+        // Same sign extension of the 21-bit value as dwt_readcarrierintegrator()
+        dwt_readfromdevice(DRX_CONF_ID, DRX_CARRIER_INT_OFFSET, DRX_CARRIER_INT_LEN, ci) ;
+        for (j = 2 ; j >= 0 ; j --)
+        {
+            regval = (regval << 8) + ci[j] ;
+        }
+        if (regval & B20_SIGN_EXTEND_TEST) regval |= B20_SIGN_EXTEND_MASK ;
+        else regval &= DRX_CARRIER_INT_MASK ;
+        snap->carrierInt = (int32) regval ;
+    }
+
+    return snap->length ;
+}
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_readtxtimestamp()
  *
@@ -1194,6 +1637,13 @@ void dwt_writetodevice
         }
     }
 
+#ifndef DWT_NO_REG_SHADOW
+    if ((SHADOW_FILES & SHADOW_FILE(recordNumber)) && _dwt_shadowwrite(recordNumber, index, length, buffer))
+    {
+        return; // The chip already holds these bytes
+    }
+#endif
+
     // Write it to the SPI
     writetospi(cnt,header,length,buffer);
 } // end dwt_writetodevice()
@@ -1258,6 +1708,19 @@ void dwt_readfromdevice
         }
     }
 
+#ifndef DWT_NO_REG_SHADOW
+    if (SHADOW_FILES & SHADOW_FILE(recordNumber))
+    {
+        if (_dwt_shadowread(recordNumber, index, length, buffer))
+        {
+            return;
+        }
+        readfromspi(cnt, header, length, buffer);
+        _dwt_shadowlearn(recordNumber, index, length, buffer);
+        return;
+    }
+#endif
+
     // Do the read from the SPI
     readfromspi(cnt, header, length, buffer);  // result is stored in the buffer
 } // end dwt_readfromdevice()
@@ -1889,6 +2352,8 @@ void dwt_entersleep(void)
 {
     // Copy config to AON - upload the new configuration
     _dwt_aonarrayupload();
+
+    dwt_shadowinvalidate(); // Registers not saved in AON come back with their reset values
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -2104,6 +2569,8 @@ int dwt_spicswakeup(uint8 *buff, uint16 length)
         // Need 5ms for XTAL to start and stabilise (could wait for PLL lock IRQ status bit !!!)
         // NOTE: Polling of the STATUS register is not possible unless frequency is < 3MHz
         deca_sleep(5);
+
+        dwt_shadowinvalidate();
     }
     else
     {
@@ -2118,33 +2585,6 @@ int dwt_spicswakeup(uint8 *buff, uint16 length)
     return DWT_SUCCESS;
 }
 
-/*! ------------------------------------------------------------------------------------------------------------------
- * @fn _dwt_configlde()
- *
- * @brief configure LDE algorithm parameters
- *
- * input parameters
- * @param prf   -   this is the PRF index (0 or 1) 0 corresponds to 16 and 1 to 64 PRF
- *
- * output parameters
- *
- * no return value
- */
-void _dwt_configlde(int prfIndex)
-{
-    dwt_write8bitoffsetreg(LDE_IF_ID, LDE_CFG1_OFFSET, LDE_PARAM1); // 8-bit configuration register
-
-    if(prfIndex)
-    {
-        dwt_write16bitoffsetreg( LDE_IF_ID, LDE_CFG2_OFFSET, (uint16) LDE_PARAM3_64); // 16-bit LDE configuration tuning register
-    }
-    else
-    {
-        dwt_write16bitoffsetreg( LDE_IF_ID, LDE_CFG2_OFFSET, (uint16) LDE_PARAM3_16);
-    }
-}
-
-
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn _dwt_loaducodefromrom()
  *
@@ -2166,6 +2606,8 @@ void _dwt_loaducodefromrom(void)
 
     deca_sleep(1); // Allow time for code to upload (should take up to 120 us)
 
+    dwt_shadowinvalidate(); // The load writes LDE registers
+
     // Default clocks (ENABLE_ALL_SEQ)
     _dwt_enableclocks(ENABLE_ALL_SEQ); // Enable clocks for sequencing
 }
@@ -2194,6 +2636,8 @@ void dwt_loadopsettabfromotp(uint8 ops_sel)
 
     dwt_write16bitoffsetreg(OTP_IF_ID, OTP_SF, reg);
 
+    dwt_shadowinvalidate(); // The load writes receiver and LDE registers
+
     // Default clocks (ENABLE_ALL_SEQ)
     _dwt_enableclocks(ENABLE_ALL_SEQ); // Enable clocks for sequencing
 
@@ -3264,6 +3708,8 @@ void dwt_softreset(void)
     // Could also have polled the PLL lock flag, but then the SPI needs to be < 3MHz !! So a simple delay is easier
     deca_sleep(1);
 
+    dwt_shadowinvalidate(); // All registers are back to their reset values
+
     // Clear the reset bits
     dwt_write8bitoffsetreg(PMSC_ID, PMSC_CTRL0_SOFTRESET_OFFSET, PMSC_CTRL0_RESET_CLEAR);
 
@@ -18,47 +18,7 @@ extern "C" {
 #endif
 
 
-#ifndef uint8
-#ifndef _DECA_UINT8_
-#define _DECA_UINT8_
-typedef unsigned char uint8;
-#endif
-#endif
-
-#ifndef uint16
-#ifndef _DECA_UINT16_
-#define _DECA_UINT16_
-typedef unsigned short uint16;
-#endif
-#endif
-
-#ifndef uint32
-#ifndef _DECA_UINT32_
-#define _DECA_UINT32_
-typedef unsigned long uint32;
-#endif
-#endif
-
-#ifndef int8
-#ifndef _DECA_INT8_
-#define _DECA_INT8_
-typedef signed char int8;
-#endif
-#endif
-
-#ifndef int16
-#ifndef _DECA_INT16_
-#define _DECA_INT16_
-typedef signed short int16;
-#endif
-#endif
-
-#ifndef int32
-#ifndef _DECA_INT32_
-#define _DECA_INT32_
-typedef signed long int32;
-#endif
-#endif
+#include "deca_types.h"
 
 #ifndef DWT_NUM_DW_DEV
 #define DWT_NUM_DW_DEV (1)
@@ -255,6 +215,42 @@ typedef struct
 }
 dwt_txconfig_t ;
 
+#define DWT_REGIMAGE_MAX_PATCHES    16      // register writes of a compiled configuration, see dwt_compileconfig()
+#define DWT_REGIMAGE_MAX_BYTES      64      // bytes of those writes
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Structure typedef: dwt_regpatch_t
+ *
+ * One burst write of a compiled configuration: len bytes from data[pos] of the image to register file regFileID,
+ * starting at byte offset
+ *
+ */
+typedef struct
+{
+    uint8   regFileID;
+    uint8   len;
+    uint16  offset;
+    uint8   pos;
+} dwt_regpatch_t ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Structure typedef: dwt_regimage_t
+ *
+ * A dwt_config_t compiled by dwt_compileconfig() into the register writes of dwt_configure(), in the order they are
+ * made. It holds no pointer, so it can be copied, compared, or stored as a const initialiser.
+ *
+ */
+typedef struct
+{
+    uint32  sysCFG;             //!< SYS_CFG_RXM110K and SYS_CFG_PHR_MODE_11 bits of the configuration
+    uint32  txFCTRL;            //!< TX_FCTRL preamble length, PRF and data rate
+    uint8   longFrames;         //!< phrMode of the configuration
+    uint8   numPatches;
+    uint8   numBytes;
+    dwt_regpatch_t patch[DWT_REGIMAGE_MAX_PATCHES];
+    uint8   data[DWT_REGIMAGE_MAX_BYTES];
+} dwt_regimage_t ;
+
 
 typedef struct
 {
@@ -269,6 +265,28 @@ typedef struct
     uint16      firstPath ;         // First path index (10.6 bits fixed point integer)
 }dwt_rxdiag_t ;
 
+// dwt_readrxsnapshot() flags
+#define DWT_RXSNAP_FRAME    0x01    // read the frame info, and the frame into the buffer given
+#define DWT_RXSNAP_TIME     0x02    // read the RX timestamp
+#define DWT_RXSNAP_DIAG     0x04    // read the diagnostics, as dwt_readdiagnostics(), with DWT_RXSNAP_TIME
+#define DWT_RXSNAP_CI       0x08    // read the carrier integrator, as dwt_readcarrierintegrator()
+#define DWT_RXSNAP_ALL      (DWT_RXSNAP_FRAME | DWT_RXSNAP_TIME | DWT_RXSNAP_DIAG | DWT_RXSNAP_CI)
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Structure typedef: dwt_rxsnapshot_t
+ *
+ * What a ranging exchange needs of a good frame, read by dwt_readrxsnapshot()
+ *
+ */
+typedef struct
+{
+    uint32      finfo ;             //!< DWT_RXSNAP_FRAME: RX_FINFO register, frame length, ranging bit, preamble count
+    uint16      length ;            //!< DWT_RXSNAP_FRAME: frame length, FCS included
+    uint8       rxStamp[5] ;        //!< DWT_RXSNAP_TIME: RX timestamp, as dwt_readrxtimestamp()
+    int32       carrierInt ;        //!< DWT_RXSNAP_CI: as dwt_readcarrierintegrator()
+    dwt_rxdiag_t diag ;             //!< DWT_RXSNAP_DIAG: as dwt_readdiagnostics()
+} dwt_rxsnapshot_t ;
+
 
 typedef struct
 {
@@ -352,6 +370,22 @@ typedef struct
  */
 int dwt_setlocaldataptr(unsigned int index);
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_shadowinvalidate()
+ *
+ * @brief This function makes the driver forget the register values it mirrors (clock control, interrupt mask, antenna
+ *        delays, GPIO set up...), so that the next access to each of them goes to the DW1000. The driver does it itself
+ *        on soft reset, initialisation, sleep and wake up; call it after resetting or waking the chip by other means.
+ *        Without effect when the driver is built with DWT_NO_REG_SHADOW.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_shadowinvalidate(void);
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_geticrefvolt()
  *
@@ -589,6 +623,8 @@ void dwt_configurefor64plen(int prf);
  * DW1000 and this low-level driver.  The input is a pointer to the data structure
  * of type dwt_config_t that holds all the configurable items.
  * The dwt_config_t structure shows which ones are supported
+ * It compiles the configuration with dwt_compileconfig() and writes it with dwt_applyconfig(): a caller that switches
+ * between a few configurations can compile them once and save the computation.
  *
  * input parameters
  * @param config    -   pointer to the configuration structure, which contains the device configuration data.
@@ -599,6 +635,58 @@ void dwt_configurefor64plen(int prf);
  */
 void dwt_configure(dwt_config_t *config) ;
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_compileconfig()
+ *
+ * @brief This function computes the register writes of dwt_configure() for a configuration, without accessing the
+ * device. Writes to adjacent registers of the same register file are merged, so that the DRX tuning, PLL and RF
+ * blocks each take one SPI transaction. The image holds no pointer: it can be compiled once at start up, or on a PC
+ * and stored as a const initialiser, and written with dwt_applyconfig() or dwt_switchconfig().
+ *
+ * input parameters
+ * @param config    -   pointer to the configuration structure, as for dwt_configure(). An sfdTO of 0 compiles as
+ *                      DWT_SFDTOC_DEF.
+ *
+ * output parameters
+ * @param image     -   the compiled register image
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR for a configuration outside the parameter tables
+ */
+int dwt_compileconfig(const dwt_config_t *config, dwt_regimage_t *image) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_applyconfig()
+ *
+ * @brief This function configures the DW1000 and this low-level driver from a configuration compiled by
+ * dwt_compileconfig(), with one SPI transaction per patch of the image. It has the same effect as dwt_configure().
+ *
+ * input parameters
+ * @param image     -   the compiled configuration
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_applyconfig(const dwt_regimage_t *image) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_switchconfig()
+ *
+ * @brief This function moves the DW1000 from one compiled configuration to another, e.g. to change the channel or the
+ * data rate. Only the patches of the new image that differ from the old one are written. The device must hold the
+ * old configuration: no other write, e.g. dwt_configurefor64plen(), may have changed the registers of the image
+ * since it was applied.
+ *
+ * input parameters
+ * @param from      -   the configuration last applied to the device
+ * @param to        -   the configuration to apply
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_switchconfig(const dwt_regimage_t *from, const dwt_regimage_t *to) ;
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_configuretxrf()
  *
@@ -1455,6 +1543,27 @@ int32 dwt_readcarrierintegrator(void) ;
  */
 void dwt_readdiagnostics(dwt_rxdiag_t * diagnostics);
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_readrxsnapshot()
+ *
+ * @brief This is used after a good frame to read what a ranging exchange needs of it in as few SPI transactions as
+ *        possible: the frame info and the frame, the RX timestamp, the diagnostics and the carrier integrator, as
+ *        flags asks. Fields of one register file that follow each other are read together. The parts can be read in
+ *        several calls on the same snap, e.g. the frame first and the rest once the frame is known to be wanted. The
+ *        diagnostics take the preamble count from the frame info, read in the same or an earlier call.
+ *
+ * input parameters
+ * @param buffer - DWT_RXSNAP_FRAME: the frame is read here if its length is from 1 to maxLen bytes, NULL not to read it
+ * @param maxLen - size of buffer
+ * @param flags  - DWT_RXSNAP_xxx
+ *
+ * output parameters
+ * @param snap - the parts asked, the others are left as they were
+ *
+ * returns the frame length, FCS included, as read by this or an earlier call
+ */
+uint16 dwt_readrxsnapshot(dwt_rxsnapshot_t *snap, uint8 *buffer, uint16 maxLen, uint8 flags);
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_loadopsettabfromotp()
  *
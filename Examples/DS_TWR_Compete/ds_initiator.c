@@ -28,11 +28,8 @@
 #include <DWM_functions.h>
 #include "main.h"
 #include "deca_device_api.h"
-#include "deca_regs.h"
-#include "deca_timestamps.h"
-#include "port.h"
-
-#include "usbd_cdc_if.h"
+#include "twr_engine.h"
+#include "twr_timing.h"
 
 //#define RNG_DELAY_MS 1000 // Original
 //#define RNG_DELAY_MS 1000
@@ -58,190 +55,182 @@ static dwt_config_t config = {
 #define TX_ANT_DLY     16505
 #define RX_ANT_DLY     16505
 
-/* Length of the common part of the message (up to and including the function code, see NOTE 2 below). */
-#define ALL_MSG_COMMON_LEN            10
-
-/* Indexes to access some of the fields in the frames defined above. */
-#define ALL_MSG_SN_IDX                2
-#define FINAL_MSG_TS_LEN              4
-#define FINAL_MSG_POLL_TX_TS_IDX      10
-#define FINAL_MSG_RESP_RX_TS_IDX      14
-#define FINAL_MSG_FINAL_TX_TS_IDX     18
+/* Set to 1 to choose, exchange by exchange, between the long range settings below and the fast ones further down, from the RX level of the
+ * responses. The anchors must be built with the same setting. See NOTE 14 below. */
+#ifndef TWR_USE_PROFILES
+#define TWR_USE_PROFILES 0
+#endif
 
-/* Frame sequence number, incremented after each transmission. */
-static uint8_t frame_seq_nb = 0;
+/* Delays between frames, in UWB microseconds, derived from the frame durations of the above configuration. See NOTE 4 and 15 below.
+ * TURNAROUND_UUS is the time a device needs from the end of a frame to its answer armed for delayed TX, MARGIN_UUS how early the receiver
+ * goes on ahead of an answer and how long it waits after its end. The anchors must be built with the same values. */
+#define TURNAROUND_UUS 300
+#define MARGIN_UUS 20
 
-/* UWB microsecond (uus) to device time unit (dtu, around 15.65 ps) conversion factor.
- * 1 uus = 512 / 499.2 ms and 1 ms = 499.2 * 128 dtu. */
-#define UUS_TO_DWT_TIME   65536
+/* Length of the poll, with the profile byte of TWR_USE_PROFILES. At 110 kb/s a byte lasts longer than the margin. */
+#define POLL_FRAME_LEN (TWR_POLL_LEN + (TWR_USE_PROFILES ? TWR_PROFILE_LEN : 0))
 
-/* Speed of light in air, in metres per second. */
-#define SPEED_OF_LIGHT  299702547
+/* This is the delay from Frame RX timestamp to TX reply timestamp of the anchors, as set in ds_responder.c. */
+#define POLL_RX_TO_RESP_TX_DLY_UUS TWR_REPLY_UUS(DWT_PRF_64M, 1024, DWT_BR_110K, 1, POLL_FRAME_LEN, TURNAROUND_UUS)
 
-#define POLL_TX_TO_RESP_RX_DLY_UUS  300  // Arxiki timi
-//#define POLL_TX_TO_RESP_RX_DLY_UUS 150 // it works
+/* This is the delay from the end of the frame transmission to the enable of the receiver, as programmed for the DW1000's wait for response feature. */
+#define POLL_TX_TO_RESP_RX_DLY_UUS TWR_RX_AFTER_TX_UUS(DWT_PRF_64M, 1024, DWT_BR_110K, 1, POLL_FRAME_LEN, \
+                                                       POLL_RX_TO_RESP_TX_DLY_UUS, MARGIN_UUS)
 
 /* This is the delay from Frame RX timestamp to TX reply timestamp used for calculating/setting the DW1000's delayed TX function. This includes the
- * frame length of approximately 2.66 ms with above configuration. */
-//#define RESP_RX_TO_FINAL_TX_DLY_UUS 3100  // Arxiki timi
-#define RESP_RX_TO_FINAL_TX_DLY_UUS 3500
+ * response frame length of approximately 2.6 ms with above configuration. */
+#define RESP_RX_TO_FINAL_TX_DLY_UUS TWR_REPLY_UUS(DWT_PRF_64M, 1024, DWT_BR_110K, 1, TWR_DS_RESP_LEN, TURNAROUND_UUS)
 
 /* Receive response timeout. See NOTE 5 below. */
-//#define RESP_RX_TIMEOUT_UUS 2700
-#define RESP_RX_TIMEOUT_UUS 3500
+#define RESP_RX_TIMEOUT_UUS TWR_RX_TIMEOUT_UUS(DWT_PRF_64M, 1024, DWT_BR_110K, 1, POLL_FRAME_LEN, TWR_DS_RESP_LEN, \
+                                               POLL_RX_TO_RESP_TX_DLY_UUS, MARGIN_UUS)
 
 /* Preamble timeout, in multiple of PAC size. See NOTE 6 below. */
-//#define PRE_TIMEOUT 8
-#define PRE_TIMEOUT 30
+#define PRE_TIMEOUT TWR_PREAMBLE_TIMEOUT_PACS(DWT_PRF_64M, 1024, DWT_BR_110K, 1, 32, POLL_FRAME_LEN, \
+                                              POLL_RX_TO_RESP_TX_DLY_UUS, MARGIN_UUS)
+
+/* Broadcast ranging (ds_twr_init_all()): delay from poll RX to the response of the first anchor, the reply delay for the longer broadcast
+ * poll of the anchors of table, and spacing of the anchor slots. A slot holds one response (or relay) frame, around 2.5 ms with the above
+ * configuration, plus the receiver turn around. */
+#define POLL_RX_TO_FIRST_RESP_DLY_UUS TWR_REPLY_UUS(DWT_PRF_64M, 1024, DWT_BR_110K, 1, \
+                                                    TWR_BCAST_POLL_LEN(sizeof(table)) + POLL_FRAME_LEN - TWR_POLL_LEN, TURNAROUND_UUS)
+#ifndef SLOT_UUS
+#define SLOT_UUS 4000
+#endif
+
+/* Set to 1 to run the exchanges from the DW1000 interrupt, the MCU sleeping between the radio events, instead of polling the status register.
+ * The EXTI line of the DW1000 IRQ pin must be enabled, see port.c. */
+#ifndef TAG_USE_IRQ
+#define TAG_USE_IRQ 0
+#endif
+
+/* Set to 1 to send the DW1000 event counts with the range reports. See NOTE 16 below. */
+#ifndef TWR_USE_TELEMETRY
+#define TWR_USE_TELEMETRY 0
+#endif
 
 uint8_t table[] = {'1','2','3'};
 
-/* Buffer to store received response message.
- * Its size is adjusted to longest frame that this example code is supposed to handle. */
-#define RX_BUF_LEN  20
-static uint8_t rx_buffer[RX_BUF_LEN];
+/* Tag settings, kept across rounds. As this example only handles one incoming frame with always the same delay and timeout, those values
+ * can be set once for all. See NOTE 1, 4, 5, 6 and 10 below. */
+static const twr_cfg_t tag_cfg = {
+    TWR_ROLE_TAG,
+    TWR_MODE_DS,
+    0,
+    (TAG_USE_IRQ ? TWR_FLAG_IRQ : 0) | (TWR_USE_TELEMETRY ? TWR_FLAG_TELEMETRY : 0),
+    { &config, TX_ANT_DLY, RX_ANT_DLY, POLL_TX_TO_RESP_RX_DLY_UUS, RESP_RX_TIMEOUT_UUS, PRE_TIMEOUT },
+    RESP_RX_TO_FINAL_TX_DLY_UUS,
+    0,
+    POLL_RX_TO_FIRST_RESP_DLY_UUS,
+    SLOT_UUS
+};
 
-/* Time-stamps of frames transmission/reception, expressed in device time units.
-* As they are 40-bit wide, we need to define a 64-bit int type to handle them. */
-uint32_t frameLen, final_tx_time;
-uint64_t poll_tx_ts, resp_rx_ts, final_tx_ts;
+#if TWR_USE_PROFILES
+/* Fast profile: 6.8 Mb/s with a 128 symbol preamble, frames of around 0.2 ms. Same channel and preamble codes as above. */
+static dwt_config_t config_fast = {
+    2,               /* Channel number. */
+    DWT_PRF_64M,     /* Pulse repetition frequency. */
+    DWT_PLEN_128,    /* Preamble length. Used in TX only. */
+    DWT_PAC8,        /* Preamble acquisition chunk size. Used in RX only. */
+    9,               /* TX preamble code. Used in TX only. */
+    9,               /* RX preamble code. Used in RX only. */
+    0,               /* 0 to use standard SFD, 1 to use non-standard SFD. */
+    DWT_BR_6M8,      /* Data rate. */
+    DWT_PHRMODE_STD, /* PHY header mode. */
+    (129 + 8 - 8)    /* SFD timeout (preamble length + 1 + SFD length - PAC size). Used in RX only. */
+};
 
-/* Hold copy of status register state here for reference so that it can be examined at a debug breakpoint. */
-static uint32_t status = 0;
+/* Delays and timeouts of the fast profile, as above, derived from its frame durations. See NOTE 15 below. */
+#define FAST_POLL_RX_TO_RESP_TX_DLY_UUS TWR_REPLY_UUS(DWT_PRF_64M, 128, DWT_BR_6M8, 0, TWR_POLL_LEN + TWR_PROFILE_LEN, TURNAROUND_UUS)
+#define FAST_POLL_TX_TO_RESP_RX_DLY_UUS TWR_RX_AFTER_TX_UUS(DWT_PRF_64M, 128, DWT_BR_6M8, 0, TWR_POLL_LEN + TWR_PROFILE_LEN, \
+                                                            FAST_POLL_RX_TO_RESP_TX_DLY_UUS, MARGIN_UUS)
+#define FAST_RESP_RX_TIMEOUT_UUS TWR_RX_TIMEOUT_UUS(DWT_PRF_64M, 128, DWT_BR_6M8, 0, TWR_POLL_LEN + TWR_PROFILE_LEN, TWR_DS_RESP_LEN, \
+                                                    FAST_POLL_RX_TO_RESP_TX_DLY_UUS, MARGIN_UUS)
+#define FAST_PRE_TIMEOUT TWR_PREAMBLE_TIMEOUT_PACS(DWT_PRF_64M, 128, DWT_BR_6M8, 0, 8, TWR_POLL_LEN + TWR_PROFILE_LEN, \
+                                                   FAST_POLL_RX_TO_RESP_TX_DLY_UUS, MARGIN_UUS)
+#define FAST_RESP_RX_TO_FINAL_TX_DLY_UUS TWR_REPLY_UUS(DWT_PRF_64M, 128, DWT_BR_6M8, 0, TWR_DS_RESP_LEN, TURNAROUND_UUS)
+
+/* Broadcast ranging: the first anchor answers the broadcast poll as above, and slots hold a 0.2 ms frame */
+#define FAST_POLL_RX_TO_FIRST_RESP_DLY_UUS TWR_REPLY_UUS(DWT_PRF_64M, 128, DWT_BR_6M8, 0, TWR_BCAST_POLL_LEN(sizeof(table)) + TWR_PROFILE_LEN, \
+                                                         TURNAROUND_UUS)
+#define FAST_SLOT_UUS 600
+
+/* Responses stronger than FAST_ENTER_DBM for FAST_ENTER_COUNT exchanges in a row take the tag to the fast profile. A response weaker than
+ * FAST_LEAVE_DBM, or FAST_MAX_FAILS failed exchanges in a row, take it back. */
+#define FAST_ENTER_DBM -84
+#define FAST_LEAVE_DBM -88
+#define FAST_ENTER_COUNT 3
+#define FAST_MAX_FAILS 2
+
+static const twr_cfg_t tag_cfg_fast = {
+    TWR_ROLE_TAG,
+    TWR_MODE_DS,
+    0,
+    (TAG_USE_IRQ ? TWR_FLAG_IRQ : 0) | (TWR_USE_TELEMETRY ? TWR_FLAG_TELEMETRY : 0),
+    { &config_fast, TX_ANT_DLY, RX_ANT_DLY, FAST_POLL_TX_TO_RESP_RX_DLY_UUS, FAST_RESP_RX_TIMEOUT_UUS, FAST_PRE_TIMEOUT },
+    FAST_RESP_RX_TO_FINAL_TX_DLY_UUS,
+    0,
+    FAST_POLL_RX_TO_FIRST_RESP_DLY_UUS,
+    FAST_SLOT_UUS
+};
+
+static const twr_profiles_t tag_profiles = {
+    { &tag_cfg, &tag_cfg_fast },
+    { FAST_ENTER_DBM, FAST_LEAVE_DBM, FAST_ENTER_COUNT, FAST_MAX_FAILS, 0 }
+};
+#endif
+
+static twr_engine_t tag;
+
+/* Initialise and configure the DW1000 on the first round only, later rounds reuse the configured device. See twr_engine_init() and NOTE 7
+ * below. */
+static void tag_init(void)
+{
+#if TWR_USE_PROFILES
+	if (twr_engine_init_profiles(&tag, &tag_profiles) == DWT_ERROR)
+#else
+	if (twr_engine_init(&tag, &tag_cfg) == DWT_ERROR)
+#endif
+	{
+		while (1){};
+	}
+}
 
 /*! ------------------------------------------------------------------------------------------------------------------
- * @fn main()
+ * @fn ds_twr_init()
  *
- * @brief Application entry point.
+ * @brief Range with anchor x (0 for A, 1 for B, ...), retrying until the exchange completes. The anchor computes the distance.
  *
- * @param  none
+ * @param  x  anchor number
  *
  * @return none
  */
 void ds_twr_init(int x)
 {
-	/* Frames used in the ranging process. See NOTE 2 below. */
-	uint8_t tx_poll_msg[]  = {0x41, 0x88, 0, 0xCA, 0xDE, 'W', 'A', table[x], 'E', 0x21, 0, 0};  // 0x21 = Ranging Tag initial Poll Response
-	uint8_t rx_resp_msg[]  = {0x41, 0x88, 0, 0xCA, 0xDE, 'V', 'E', table[x], 'A', 0x10, 0x02, 0, 0, 0, 0}; // 0x10 = Activity control from infrastructure  // 0x02 = something its not finish
-	uint8_t tx_final_msg[] = {0x41, 0x88, 0, 0xCA, 0xDE, 'W', 'A', table[x], 'E', 0x23, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};  // 0x32 = Ranging Tag Final response message with embedded Tx time
+	tag_init();
 
-	/* Reset and initialise DW1000.
-	 * For initialisation, DW1000 clocks must be temporarily set to crystal speed. After initialisation SPI rate can be increased for optimum
-	 * performance. */
-	deca_reset(); /* Target specific drive of RSTn line into DW1000 low for a period. */
-
-	port_set_dw1000_slowrate();
-
-	if (dwt_initialise(DWT_LOADUCODE) == DWT_ERROR)
+    /* Poll, then send the final message. See NOTE 8 to 12 below. */
+	while (twr_tag_range(&tag, table[x]) != DWT_SUCCESS)
 	{
-		while (1){};
+        /* Execute a delay between ranging exchanges. */
+		Sleep(RNG_DELAY_MS);
 	}
+}
 
-	port_set_dw1000_fastrate();
-
-    /* Configure DW1000. See NOTE 7 below. */
-	dwt_configure(&config);
-
-    /* Apply default antenna delay value. See NOTE 1 below. */
-	dwt_settxantennadelay(TX_ANT_DLY);
-	dwt_setrxantennadelay(RX_ANT_DLY);
-
-	/* Set expected response's delay and timeout. See NOTE 4, 5 and 6 below.
-	 * As this example only handles one incoming frame with always the same delay and timeout, those values can be set here once for all. */
-	dwt_setrxaftertxdelay(POLL_TX_TO_RESP_RX_DLY_UUS);
-	dwt_setrxtimeout(RESP_RX_TIMEOUT_UUS);
-
-    dwt_setpreambledetecttimeout(PRE_TIMEOUT);    // to evala tora
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ds_twr_init_all()
+ *
+ * @brief Range with all the anchors of table at once: one broadcast poll, a response from each anchor in its slot and one final
+ *        message, retrying until at least one anchor answered. Each anchor heard computes its distance. See twr_tag_range_all().
+ *
+ * @return none
+ */
+void ds_twr_init_all(void)
+{
+	tag_init();
 
-    /* Loop forever initiating ranging exchanges. */
-	while(1)
+	while (twr_tag_range_all(&tag, table, sizeof(table)) == 0)
 	{
-        /* Write frame data to DW1000 and prepare transmission. See NOTE 8 below. */
-		tx_poll_msg[ALL_MSG_COMMON_LEN] = frame_seq_nb;
-		dwt_writetxdata(sizeof(tx_poll_msg), tx_poll_msg, 0);
-		dwt_writetxfctrl(sizeof(tx_poll_msg), 0, 1);
-
-		/* Start transmission, indicating that a response is expected so that reception is enabled automatically after the frame is sent and the delay
-		 * set by dwt_setrxaftertxdelay() has elapsed. */
-		dwt_starttx(DWT_START_TX_IMMEDIATE | DWT_RESPONSE_EXPECTED);
-
-		/* We assume that the transmission is achieved correctly, poll for reception of a frame or error/timeout. See NOTE 9 below. */
-		do {
-	    	status = dwt_read32bitreg(SYS_STATUS_ID);
-		} while (!(status & (SYS_STATUS_RXFCG | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR)));
-
-        /* Increment frame sequence number after transmission of the poll message (modulo 256). */
-		frame_seq_nb ++;
-
-		if(status & SYS_STATUS_RXFCG)
-		{
-	        /* Increment frame sequence number after transmission of the poll message (modulo 256). */
-			dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_RXFCG | SYS_STATUS_TXFRS);
-
-			memset(rx_buffer, 0, RX_BUF_LEN);
-			// A frame has been received, copy it to our local buffer.
-			frameLen = dwt_read32bitreg(RX_FINFO_ID) & 0x0000007FUL;  // RX_FINFO_RXFLEN_MASK = 0x0000007FUL
-			if ( frameLen <= RX_BUF_LEN)
-			{
-				dwt_readrxdata(rx_buffer, frameLen, 0);
-			}
-
-            /* Check that the frame is the expected response from the companion "DS TWR responder" example.
-             * As the sequence number field of the frame is not relevant, it is cleared to simplify the validation of the frame. */
-			rx_buffer[ALL_MSG_SN_IDX] = 0;
-			if (memcmp(rx_buffer, rx_resp_msg, ALL_MSG_COMMON_LEN) == 0)
-			{
-				int ret;
-
-				poll_tx_ts = get_tx_timestamp_u64();
-				resp_rx_ts = get_rx_timestamp_u64();
-
-                /* Compute final message transmission time. See NOTE 10 below. */
-				final_tx_time = (resp_rx_ts + (RESP_RX_TO_FINAL_TX_DLY_UUS * UUS_TO_DWT_TIME)) >> 8;
-
-				dwt_setdelayedtrxtime(final_tx_time);
-
-				/* Final TX timestamp is the transmission time we programmed plus the TX antenna delay. */
-				final_tx_ts = (((uint64_t)(final_tx_time & 0xFFFFFFFEUL)) << 8) + TX_ANT_DLY;
-
-                /* Write all timestamps in the final message. See NOTE 11 below. */
-				final_msg_set_ts(&tx_final_msg[FINAL_MSG_POLL_TX_TS_IDX], poll_tx_ts);
-				final_msg_set_ts(&tx_final_msg[FINAL_MSG_RESP_RX_TS_IDX], resp_rx_ts);
-				final_msg_set_ts(&tx_final_msg[FINAL_MSG_FINAL_TX_TS_IDX], final_tx_ts);
-
-                /* Write and send final message. See NOTE 8 below. */
-				tx_final_msg[ALL_MSG_SN_IDX] = frame_seq_nb;
-				dwt_writetxdata(sizeof(tx_final_msg), tx_final_msg, 0);
-				dwt_writetxfctrl(sizeof(tx_final_msg), 0, 1);
-
-				/* If dwt_starttx() returns an error, abandon this ranging exchange and proceed to the next one. See NOTE 12 below. */
-				ret = dwt_starttx(DWT_START_TX_DELAYED);
-
-				if (ret == DWT_SUCCESS)
-				{
-                    /* Poll DW1000 until TX frame sent event set. See NOTE 9 below. */
-					while (!(dwt_read32bitreg(SYS_STATUS_ID) & SYS_STATUS_TXFRS)) {};
-
-                    /* Clear TXFRS event. */
-					dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_TXFRS);
-
-					/* Increment frame sequence number after transmission of the final message (modulo 256). */
-					frame_seq_nb ++;
-
-					break; // If i have good transaction
-				}
-			}
-		}
-		else
-		{
-            /* Clear RX error/timeout events in the DW1000 status register. */
-			dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR);
-
-			/* Reset RX to properly re-initialise LDE operation. */
-			dwt_rxreset();
-		}
-
-        /* Execute a delay between ranging exchanges. */
 		Sleep(RNG_DELAY_MS);
 	}
 }
@@ -272,9 +261,10 @@ void ds_twr_init(int x)
  *     - byte 10: activity code (0x02 to tell the initiator to go on with the ranging exchange).
  *     - byte 11/12: activity parameter, not used here for activity code 0x02.
  *    Final message:
- *     - byte 10 -> 13: poll message transmission timestamp.
- *     - byte 14 -> 17: response message reception timestamp.
- *     - byte 18 -> 21: final message transmission timestamp.
+ *     - byte 10 -> 14: poll message transmission timestamp.
+ *     - byte 15 -> 19: response message reception timestamp.
+ *     - byte 20 -> 24: final message transmission timestamp.
+ *    Timestamps are 40 bits, least significant byte first, see TWR_FINAL_*_TS_IDX in twr_engine.h and twr_ts.h.
  *    All messages end with a 2-byte checksum automatically set by DW1000.
  * 3. Source and destination addresses are hard coded constants in this example to keep it simple but for a real product every device should have a
  *    unique ID. Here, 16-bit addressing is used to keep the messages as short as possible but, in an actual application, this should be done only
@@ -283,8 +273,7 @@ void ds_twr_init(int x)
  *    and the responder and to ensure a correct accuracy of the computed distance. The user is referred to DecaRanging ARM Source Code Guide for more
  *    details about the timings involved in the ranging process.
  * 5. This timeout is for complete reception of a frame, i.e. timeout duration must take into account the length of the expected frame. Here the value
- *    is arbitrary but chosen large enough to make sure that there is enough time to receive the complete response frame sent by the responder at the
- *    110k data rate used (around 3 ms).
+ *    is computed from the length of the response frame at the 110k data rate used (around 3 ms), with a margin, see NOTE 15.
  * 6. The preamble timeout allows the receiver to stop listening in situations where preamble is not starting (which might be because the responder is
  *    out of range or did not receive the message to respond to). This saves the power waste of listening for a message that is not coming. We
  *    recommend a minimum preamble timeout of 5 PACs for short range applications and a larger value (e.g. in the range of 50% to 80% of the preamble
@@ -303,9 +292,9 @@ void ds_twr_init(int x)
  *     response RX timestamp to get final transmission time. The delayed transmission time resolution is 512 device time units which means that the
  *     lower 9 bits of the obtained value must be zeroed. This also allows to encode the 40-bit value in a 32-bit words by shifting the all-zero lower
  *     8 bits.
- * 11. In this operation, the high order byte of each 40-bit timestamps is discarded. This is acceptable as those time-stamps are not separated by
- *     more than 2**32 device time units (which is around 67 ms) which means that the calculation of the round-trip delays (needed in the
- *     time-of-flight computation) can be handled by a 32-bit subtraction.
+ * 11. The final message carries the full 40-bit timestamps, 5 bytes each, least significant byte first (see twr_ts.h). The responder computes the
+ *     round-trip delays (needed in the time-of-flight computation) with 40-bit subtractions, so the time-stamps may be up to 17.2 s apart instead of
+ *     the 2**32 device time units (around 67 ms) of 32-bit ones: a broadcast round may use long slots.
  * 12. When running this example on the EVB1000 platform with the RESP_RX_TO_FINAL_TX_DLY response delay provided, the dwt_starttx() is always
  *     successful. However, in cases where the delay is too short (or something else interrupts the code flow), then the dwt_starttx() might be issued
  *     too late for the configured start time. The code below provides an example of how to handle this condition: In this case it abandons the
@@ -314,4 +303,13 @@ void ds_twr_init(int x)
  *     awaiting the "final" and proceed to have its receiver on ready to poll of the following exchange.
  * 13. The user is referred to DecaRanging ARM application (distributed with EVK1000 product) for additional practical example of usage, and to the
  *     DW1000 API Guide for more details on the DW1000 driver functions.
+ * 14. With TWR_USE_PROFILES each poll announces the profile of the tag's next exchanges, and all the anchors that hear it follow, see
+ *     twr_profile.h. A fast exchange is around 10 times shorter on air, but the 6.8 Mb/s frames need a stronger signal: the tag falls back to
+ *     the long range settings as it moves away from the anchors.
+ * 15. The delays and timeouts of both profiles are computed from their frame durations by the macros of twr_timing.h, not tuned by hand. Each
+ *     device needs TURNAROUND_UUS from the end of a frame to its answer armed for delayed TX; measure it on the board (frame RX to
+ *     dwt_starttx() returning) and add some slack. The receiver of the tag goes on MARGIN_UUS ahead of the response and gives up MARGIN_UUS
+ *     after its end. The anchors must be built with the same values. Host/timing_check prints the derivation for both profiles.
+ * 16. With TWR_USE_TELEMETRY the tag enables the event counters of the DW1000 and sends what they counted every second, sampled while it waits
+ *     for the end of its final: response timeouts and errors tell a tag out of range from timeouts set too short. See twr_telemetry.h.
  ****************************************************************************************************************************************************/
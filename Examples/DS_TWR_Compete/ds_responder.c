@@ -0,0 +1,295 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    main.c
+ *  @brief   Double-sided two-way ranging (DS TWR) responder example code
+ *
+ *           This is a simple code example which acts as the responder in a DS TWR distance measurement exchange. This application waits for a "poll"
+ *           message (recording the RX time-stamp of the poll) expected from the "DS TWR initiator" example code (companion to this application), and
+ *           then sends a "response" message recording its TX time-stamp, after which it waits for a "final" message from the initiator to complete
+ *           the exchange. The final message contains the remote initiator's time-stamps of poll TX, response RX and final TX. With this data and the
+ *           local time-stamps, (of poll RX, response TX and final RX), this example application works out a value for the time-of-flight over-the-air
+ *           and, thus, the estimated distance between the two devices, which it writes to the LCD.
+ *
+ * @attention
+ *
+ * Copyright 2015 (c) Decawave Ltd, Dublin, Ireland.
+ *
+ * All rights reserved.
+ *
+ * @author Decawave
+ */
+
+/*
+ * ds_responder.c
+ *
+ * 	The anchors of my RTLS. Anchor '1' (A) is the Master Anchor: the other anchors send the estimated distance to
+ * 	this anchor and the Master Anchor sends it to PC via serial USB port. One source serves every anchor, the
+ * 	address is chosen at run time, see twr_engine.h.
+ *
+ *  Created on: Mar 6, 2021
+ *      Author: kostasdeligiorgis
+ */
+#include <DWM_functions.h>
+#include "main.h"
+#include "deca_device_api.h"
+#include "twr_engine.h"
+#include "twr_timing.h"
+
+/* Default antenna delay values for 64 MHz PRF. See NOTE 1 below. */
+#define TX_ANT_DLY 16505
+#define RX_ANT_DLY 16505
+
+/* Default communication configuration. We use here EVK1000's default mode (mode 3). See NOTE 7 below. */
+static dwt_config_t config = {
+    2,               /* Channel number. */
+    DWT_PRF_64M,     /* Pulse repetition frequency. */
+    DWT_PLEN_1024,   /* Preamble length. Used in TX only. */
+    DWT_PAC32,       /* Preamble acquisition chunk size. Used in RX only. */
+    9,               /* TX preamble code. Used in TX only. */
+    9,               /* RX preamble code. Used in RX only. */
+    1,               /* 0 to use standard SFD, 1 to use non-standard SFD. */
+    DWT_BR_110K,     /* Data rate. */
+    DWT_PHRMODE_STD, /* PHY header mode. */
+    (1024 + 1 + 64 - 32) /* SFD timeout (preamble length + 1 + SFD length - PAC size). Used in RX only. */
+};
+
+/* Delays between frames, in UWB microseconds, derived from the frame durations of the above configuration with the tag's turnaround and
+ * margin. See NOTE 4 and 15 below. */
+#define TURNAROUND_UUS 300
+#define MARGIN_UUS 20
+
+/* Length of the poll, with the profile byte of TWR_USE_PROFILES (see below), as the tag's */
+#define POLL_FRAME_LEN (TWR_POLL_LEN + (TWR_USE_PROFILES ? TWR_PROFILE_LEN : 0))
+
+/* This is the delay from Frame RX timestamp to TX reply timestamp used for calculating/setting the DW1000's delayed TX function. This includes the
+ * poll frame length of approximately 2.46 ms with above configuration. */
+#define POLL_RX_TO_RESP_TX_DLY_UUS TWR_REPLY_UUS(DWT_PRF_64M, 1024, DWT_BR_110K, 1, POLL_FRAME_LEN, TURNAROUND_UUS)
+
+/* This is the delay from Frame RX timestamp to TX reply timestamp of the tag, as set in ds_initiator.c. */
+#define RESP_RX_TO_FINAL_TX_DLY_UUS TWR_REPLY_UUS(DWT_PRF_64M, 1024, DWT_BR_110K, 1, TWR_DS_RESP_LEN, TURNAROUND_UUS)
+
+/* This is the delay from the end of the frame transmission to the enable of the receiver, as programmed for the DW1000's wait for response feature. */
+#define RESP_TX_TO_FINAL_RX_DLY_UUS TWR_RX_AFTER_TX_UUS(DWT_PRF_64M, 1024, DWT_BR_110K, 1, TWR_DS_RESP_LEN, RESP_RX_TO_FINAL_TX_DLY_UUS, \
+                                                        MARGIN_UUS)
+
+/* Length of the longest final, the broadcast one of a round of TWR_MAX_ANCHORS anchors */
+#define FINAL_FRAME_LEN TWR_BFINAL_LEN(TWR_MAX_ANCHORS)
+
+/* Receive final timeout. See NOTE 5 below. */
+#define FINAL_RX_TIMEOUT_UUS TWR_RX_TIMEOUT_UUS(DWT_PRF_64M, 1024, DWT_BR_110K, 1, TWR_DS_RESP_LEN, FINAL_FRAME_LEN, \
+                                                RESP_RX_TO_FINAL_TX_DLY_UUS, MARGIN_UUS)
+
+/* Preamble timeout, in multiple of PAC size. See NOTE 6 below. Not derived: it also runs while the anchor waits for polls, where each expiry
+ * costs a receiver restart. The final RX timeout above bounds the wait for the final. */
+#define PRE_TIMEOUT 15
+
+/* Set to 1 to keep listening while a frame is handled, with the two RX buffers of the DW1000. See NOTE 16 below. */
+#ifndef ANCHOR_DBL_RX
+#define ANCHOR_DBL_RX 0
+#endif
+
+/* Set to 1 to send the DW1000 event counts with the range reports. See NOTE 17 below. */
+#ifndef TWR_USE_TELEMETRY
+#define TWR_USE_TELEMETRY 0
+#endif
+
+/* Set to 1 to send the channel impulse response of every 10th final received with the range reports. See NOTE 18 below. */
+#ifndef TWR_USE_CIR
+#define TWR_USE_CIR 0
+#endif
+
+/* Set to 1 to follow the tag between the above long range settings and the fast ones below, see NOTE 14 below. The tag must be built with the
+ * same setting. */
+#ifndef TWR_USE_PROFILES
+#define TWR_USE_PROFILES 0
+#endif
+
+#if TWR_USE_PROFILES
+/* Fast profile: 6.8 Mb/s with a 128 symbol preamble, as the tag's */
+static dwt_config_t config_fast = {
+    2,               /* Channel number. */
+    DWT_PRF_64M,     /* Pulse repetition frequency. */
+    DWT_PLEN_128,    /* Preamble length. Used in TX only. */
+    DWT_PAC8,        /* Preamble acquisition chunk size. Used in RX only. */
+    9,               /* TX preamble code. Used in TX only. */
+    9,               /* RX preamble code. Used in RX only. */
+    0,               /* 0 to use standard SFD, 1 to use non-standard SFD. */
+    DWT_BR_6M8,      /* Data rate. */
+    DWT_PHRMODE_STD, /* PHY header mode. */
+    (129 + 8 - 8)    /* SFD timeout (preamble length + 1 + SFD length - PAC size). Used in RX only. */
+};
+
+/* Delays and timeouts of the fast profile, as above, derived from its frame durations. See NOTE 15 below. */
+#define FAST_POLL_RX_TO_RESP_TX_DLY_UUS TWR_REPLY_UUS(DWT_PRF_64M, 128, DWT_BR_6M8, 0, TWR_POLL_LEN + TWR_PROFILE_LEN, TURNAROUND_UUS)
+#define FAST_RESP_RX_TO_FINAL_TX_DLY_UUS TWR_REPLY_UUS(DWT_PRF_64M, 128, DWT_BR_6M8, 0, TWR_DS_RESP_LEN, TURNAROUND_UUS)
+#define FAST_RESP_TX_TO_FINAL_RX_DLY_UUS TWR_RX_AFTER_TX_UUS(DWT_PRF_64M, 128, DWT_BR_6M8, 0, TWR_DS_RESP_LEN, \
+                                                             FAST_RESP_RX_TO_FINAL_TX_DLY_UUS, MARGIN_UUS)
+#define FAST_FINAL_RX_TIMEOUT_UUS TWR_RX_TIMEOUT_UUS(DWT_PRF_64M, 128, DWT_BR_6M8, 0, TWR_DS_RESP_LEN, FINAL_FRAME_LEN, \
+                                                     FAST_RESP_RX_TO_FINAL_TX_DLY_UUS, MARGIN_UUS)
+
+/* Not derived, as PRE_TIMEOUT above */
+#define FAST_PRE_TIMEOUT 64
+
+/* Back to the long range settings after this long without a poll from the tag, around 1.5 s. More than the tag's pause after a failed
+ * exchange. */
+#define FAST_HOLD_UUS 1500000
+#endif
+
+/* Anchor addresses, the index is the anchor number x of ds_twr_anchor(). See NOTE 3 below. */
+static const uint8 table[] = {'1', '2', '3'};
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ds_twr_anchor()
+ *
+ * @brief Run anchor x forever: anchor 0 (A) is the master anchor, the others relay their distance to it.
+ *
+ * @param  x  anchor number, 0 for A, 1 for B, ...
+ *
+ * @return none
+ */
+void ds_twr_anchor(int x)
+{
+	twr_cfg_t cfg = {
+		TWR_ROLE_ANCHOR,
+		TWR_MODE_DS,
+		table[x],
+		((x == 0) ? TWR_FLAG_MASTER : TWR_FLAG_RELAY) | (ANCHOR_DBL_RX ? TWR_FLAG_DBL_RX : 0) |
+			(TWR_USE_TELEMETRY ? TWR_FLAG_TELEMETRY : 0) | (TWR_USE_CIR ? TWR_FLAG_CIR : 0),
+		/* radio, antenna delays (NOTE 1), final RX delay (NOTE 4), no RX timeout while waiting for a poll, preamble timeout (NOTE 6) */
+		{ &config, TX_ANT_DLY, RX_ANT_DLY, RESP_TX_TO_FINAL_RX_DLY_UUS, 0, PRE_TIMEOUT },
+		POLL_RX_TO_RESP_TX_DLY_UUS,
+		FINAL_RX_TIMEOUT_UUS,
+		/* broadcast slots, set by the tag */
+		0,
+		0
+	};
+	twr_engine_t engine = {0};
+#if TWR_USE_PROFILES
+	twr_cfg_t cfg_fast = {
+		TWR_ROLE_ANCHOR,
+		TWR_MODE_DS,
+		table[x],
+		((x == 0) ? TWR_FLAG_MASTER : TWR_FLAG_RELAY) | (ANCHOR_DBL_RX ? TWR_FLAG_DBL_RX : 0) |
+			(TWR_USE_TELEMETRY ? TWR_FLAG_TELEMETRY : 0) | (TWR_USE_CIR ? TWR_FLAG_CIR : 0),
+		{ &config_fast, TX_ANT_DLY, RX_ANT_DLY, FAST_RESP_TX_TO_FINAL_RX_DLY_UUS, 0, FAST_PRE_TIMEOUT },
+		FAST_POLL_RX_TO_RESP_TX_DLY_UUS,
+		FAST_FINAL_RX_TIMEOUT_UUS,
+		/* broadcast slots, set by the tag */
+		0,
+		0
+	};
+	twr_profiles_t profiles = {
+		{ &cfg, &cfg_fast },
+		{ 0, 0, 0, 0, FAST_HOLD_UUS }
+	};
+#endif
+
+	/* Reset, initialise and configure the DW1000. */
+#if TWR_USE_PROFILES
+	if (twr_engine_init_profiles(&engine, &profiles) == DWT_ERROR)
+#else
+	if (twr_engine_init(&engine, &cfg) == DWT_ERROR)
+#endif
+	{
+		while (1){};
+	}
+
+    /* Loop forever responding to ranging requests. See NOTE 8, 9, 11 and 12 below. */
+	twr_anchor_run(&engine);
+}
+
+/* Master anchor A */
+void twr_resp_9m_1(void)
+{
+	ds_twr_anchor(0);
+}
+
+void ds_twr_resp_b(void)
+{
+	ds_twr_anchor(1);
+}
+
+void ds_twr_resp_c(void)
+{
+	ds_twr_anchor(2);
+}
+
+/*****************************************************************************************************************************************************
+ * NOTES:
+ *
+ * 1. The sum of the values is the TX to RX antenna delay, experimentally determined by a calibration process. Here we use a hard coded typical value
+ *    but, in a real application, each device should have its own antenna delay properly calibrated to get the best possible precision when performing
+ *    range measurements.
+ * 2. The messages here are similar to those used in the DecaRanging ARM application (shipped with EVK1000 kit). They comply with the IEEE
+ *    802.15.4 standard MAC data frame encoding and they are following the ISO/IEC:24730-62:2013 standard. The messages used are:
+ *     - a poll message sent by the initiator to trigger the ranging exchange.
+ *     - a response message sent by the responder allowing the initiator to go on with the process
+ *     - a final message sent by the initiator to complete the exchange and provide all information needed by the responder to compute the
+ *       time-of-flight (distance) estimate.
+ *    The first 10 bytes of those frame are common and are composed of the following fields:
+ *     - byte 0/1: frame control (0x8841 to indicate a data frame using 16-bit addressing).
+ *     - byte 2: sequence number, incremented for each new frame.
+ *     - byte 3/4: PAN ID (0xDECA).
+ *     - byte 5/6: destination address, see NOTE 3 below.
+ *     - byte 7/8: source address, see NOTE 3 below.
+ *     - byte 9: function code (specific values to indicate which message it is in the ranging process).
+ *    The remaining bytes are specific to each message as follows:
+ *    Poll message:
+ *     - no more data
+ *    Response message:
+ *     - byte 10: activity code (0x02 to tell the initiator to go on with the ranging exchange).
+ *     - byte 11/12: activity parameter, not used for activity code 0x02.
+ *    Final message:
+ *     - byte 10 -> 14: poll message transmission timestamp.
+ *     - byte 15 -> 19: response message reception timestamp.
+ *     - byte 20 -> 24: final message transmission timestamp.
+ *    Timestamps are 40 bits, least significant byte first, see TWR_FINAL_*_TS_IDX in twr_engine.h and twr_ts.h.
+ *    All messages end with a 2-byte checksum automatically set by DW1000.
+ * 3. Source and destination addresses are hard coded constants in this example to keep it simple but for a real product every device should have a
+ *    unique ID. Here, 16-bit addressing is used to keep the messages as short as possible but, in an actual application, this should be done only
+ *    after an exchange of specific messages used to define those short addresses for each device participating to the ranging exchange.
+ * 4. Delays between frames have been chosen here to ensure proper synchronisation of transmission and reception of the frames between the initiator
+ *    and the responder and to ensure a correct accuracy of the computed distance. The user is referred to DecaRanging ARM Source Code Guide for more
+ *    details about the timings involved in the ranging process.
+ * 5. This timeout is for complete reception of a frame, i.e. timeout duration must take into account the length of the expected frame. Here the value
+ *    is computed from the length of the longest final frame, a broadcast one, at the 110k data rate used (around 6.3 ms), with a margin, see
+ *    NOTE 15.
+ * 6. The preamble timeout allows the receiver to stop listening in situations where preamble is not starting (which might be because the responder is
+ *    out of range or did not receive the message to respond to). This saves the power waste of listening for a message that is not coming. We
+ *    recommend a minimum preamble timeout of 5 PACs for short range applications and a larger value (e.g. in the range of 50% to 80% of the preamble
+ *    length) for more challenging longer range, NLOS or noisy environments.
+ * 7. In a real application, for optimum performance within regulatory limits, it may be necessary to set TX pulse bandwidth and TX power, (using
+ *    the dwt_configuretxrf API call) to per device calibrated values saved in the target system or the DW1000 OTP memory.
+ * 8. We use polled mode of operation here to keep the example as simple as possible but all status events can be used to generate interrupts. Please
+ *    refer to DW1000 User Manual for more details on "interrupts". It is also to be noted that STATUS register is 5 bytes long but, as the event we
+ *    use are all in the first bytes of the register, we can use the simple dwt_read32bitreg() API call to access it instead of reading the whole 5
+ *    bytes.
+ * 9. Timestamps and delayed transmission time are both expressed in device time units so we just have to add the desired response delay to poll RX
+ *    timestamp to get response transmission time. The delayed transmission time resolution is 512 device time units which means that the lower 9 bits
+ *    of the obtained value must be zeroed. This also allows to encode the 40-bit value in a 32-bit words by shifting the all-zero lower 8 bits.
+ * 10. dwt_writetxdata() takes the full size of the message as a parameter but only copies (size - 2) bytes as the check-sum at the end of the frame is
+ *     automatically appended by the DW1000. This means that our variable could be two bytes shorter without losing any data (but the sizeof would not
+ *     work anymore then as we would still have to indicate the full length of the frame to dwt_writetxdata()).
+ * 11. When running this example on the EVB1000 platform with the POLL_RX_TO_RESP_TX_DLY response delay provided, the dwt_starttx() is always
+ *     successful. However, in cases where the delay is too short (or something else interrupts the code flow), then the dwt_starttx() might be issued
+ *     too late for the configured start time. The code below provides an example of how to handle this condition: In this case it abandons the
+ *     ranging exchange and simply goes back to awaiting another poll message. If this error handling code was not here, a late dwt_starttx() would
+ *     result in the code flow getting stuck waiting subsequent RX event that will will never come. The companion "initiator" example (ex_05a) should
+ *     timeout from awaiting the "response" and proceed to send another poll in due course to initiate another ranging exchange.
+ * 12. The time-stamps keep all their 40 bits, in the final message too (5 bytes each), and the round-trip and reply delays are 40-bit subtractions,
+ *     see twr_ts.h. They are correct when the clock wraps, for delays up to 17.2 s instead of the 2**32 device time units (around 67 ms) of 32-bit
+ *     time-stamps, so the broadcast slot plans of the initiator can be longer.
+ * 13. The user is referred to DecaRanging ARM application (distributed with EVK1000 product) for additional practical example of usage, and to the
+ *     DW1000 API Guide for more details on the DW1000 driver functions.
+ * 14. With TWR_USE_PROFILES the anchor takes the profile announced by every tag poll it hears, also those for the other anchors, so that all of
+ *     them change together and the relays reach anchor A. See twr_profile.h.
+ * 15. The reply delays and final RX settings of both profiles are computed from their frame durations by the macros of twr_timing.h, with
+ *     the same TURNAROUND_UUS and MARGIN_UUS as the tag, see NOTE 15 of the DS initiator.
+ * 16. With ANCHOR_DBL_RX the anchor turns its receiver back on as soon as a frame has arrived, into the second RX buffer, and only then reads and
+ *     handles the frame: polls for the other anchors and relays that follow each other closely are not missed while the previous one is handled.
+ *     The DW1000 could re-enable the receiver by itself (RXAUTR), but the driver no longer supports it. See twr_engine.h.
+ * 17. With TWR_USE_TELEMETRY the anchor enables the event counters of the DW1000 and, between exchanges, sends what they counted every second:
+ *     preamble, SFD and frame wait timeouts, header and CRC errors, overruns, frames sent. Host/telemetry_stats.c prints their rates. See
+ *     twr_telemetry.h.
+ * 18. With TWR_USE_CIR the anchor reads the accumulator around the first path of the final, once the exchange has ended, and sends it delta
+ *     coded after the range report it belongs to. Host/cir_store.c keeps the captures in a file for NLOS analysis. See twr_cir.h.
+ ****************************************************************************************************************************************************/
@@ -76,6 +76,23 @@ extern int ss_resp_main_C(void);   //
 #define  RNG_DELAY_MS  800 // If they want faster data!! => 500
 /******************/
 
+/******************/
+// DS_INIT-RESP_Complete broadcast: build with Examples/DS_TWR_Compete in place of
+// the SS sources and set to 1 to range the three anchors with one broadcast poll
+// per round, see ds_twr_init_all(). The anchors run twr_resp_9m_1(),
+// ds_twr_resp_b() and ds_twr_resp_c().
+#ifndef TWR_USE_BROADCAST
+#define TWR_USE_BROADCAST 0
+#endif
+
+#if TWR_USE_BROADCAST
+extern void ds_twr_init_all(void);
+extern void twr_resp_9m_1(void);
+extern void ds_twr_resp_b(void);
+extern void ds_twr_resp_c(void);
+#endif
+/******************/
+
 /* USER CODE END 0 */
 
 /**
@@ -116,6 +133,11 @@ int main(void)
 //  ss_resp_main_A();   
 //  ss_resp_main_B();  
 //  ss_resp_main_C();  
+#if TWR_USE_BROADCAST
+//  twr_resp_9m_1();
+//  ds_twr_resp_b();
+//  ds_twr_resp_c();
+#endif
   /******************/
 
   /* USER CODE END 2 */
@@ -127,6 +149,12 @@ int main(void)
     /* USER CODE END WHILE */
 
 	  /****************/
+#if TWR_USE_BROADCAST
+//	  DS_Complete, one broadcast round for the three anchors
+
+	  ds_twr_init_all();
+	  HAL_Delay(RNG_DELAY_MS);
+#else
 //	  SS_Complete
 
 	  ss_init_main(0);
@@ -137,6 +165,7 @@ int main(void)
 
 	  ss_init_main(2);
 	  Sleep(RNG_DELAY_MS);
+#endif
 	  /****************/
 
     /* USER CODE BEGIN 3 */
@@ -23,18 +23,10 @@
  *  Created on: Jan 25, 2021
  *      Author: kostasdeligiorgis
  */
-#include <stdio.h>
-#include <string.h>
-
-#include "deca_device_api.h"
-#include "deca_regs.h"
-#include "stdio.h"
-
 #include <DWM_functions.h>
 #include "main.h"
-
-
-#include "usbd_cdc_if.h"
+#include "deca_device_api.h"
+#include "twr_engine.h"
 
 /* Inter-ranging delay period, in milliseconds. */
 #define RNG_DELAY_MS 1000
@@ -57,28 +49,6 @@ static dwt_config_t config = {
 #define TX_ANT_DLY 16505
 #define RX_ANT_DLY 16505
 
-/* Length of the common part of the message (up to and including the function code, see NOTE 3 below). */
-#define ALL_MSG_COMMON_LEN 10
-/* Indexes to access some of the fields in the frames defined above. */
-#define ALL_MSG_SN_IDX 2
-#define RESP_MSG_POLL_RX_TS_IDX 10
-#define RESP_MSG_RESP_TX_TS_IDX 14
-#define RESP_MSG_TS_LEN 4
-/* Frame sequence number, incremented after each transmission. */
-static uint8 frame_seq_nb = 0;
-
-/* Buffer to store received response message.
- * Its size is adjusted to longest frame that this example code is supposed to handle. */
-#define RX_BUF_LEN 20
-static uint8 rx_buffer[RX_BUF_LEN];
-
-/* Hold copy of status register state here for reference so that it can be examined at a debug breakpoint. */
-static uint32 status_reg = 0;
-
-/* UWB microsecond (uus) to device time unit (dtu, around 15.65 ps) conversion factor.
- * 1 uus = 512 / 499.2 Βs and 1 Βs = 499.2 * 128 dtu. */
-#define UUS_TO_DWT_TIME 65536
-
 /* Delay between frames, in UWB microseconds. See NOTE 1 below. */
 #define POLL_TX_TO_RESP_RX_DLY_UUS 140
 
@@ -86,188 +56,51 @@ static uint32 status_reg = 0;
 //#define RESP_RX_TIMEOUT_UUS 210
 #define RESP_RX_TIMEOUT_UUS 600  // it works good 08/03
 
-/* Speed of light in air, in metres per second. */
-#define SPEED_OF_LIGHT 299702547
-
-/* Hold copies of computed time of flight and distance here for reference so that it can be examined at a debug breakpoint. */
-static double tof;
-static double distance;
-
-uint8_t dist[30];
-
 uint8_t table[] = {'1','2','3'};
 
-/* Declaration of static functions. */
-static void resp_msg_get_ts(uint8 *ts_field, uint32 *ts);
+/* Tag settings, kept across rounds. As this example only handles one incoming frame with always the same delay and timeout, those values
+ * can be set once for all. See NOTE 1, 2 and 5 below. */
+static const twr_cfg_t tag_cfg = {
+    TWR_ROLE_TAG,
+    TWR_MODE_SS,
+    0,
+    0,
+    /* No preamble detection timeout. */
+    { &config, TX_ANT_DLY, RX_ANT_DLY, POLL_TX_TO_RESP_RX_DLY_UUS, RESP_RX_TIMEOUT_UUS, 0 },
+    0,
+    0,
+    /* No broadcast polls in SS mode. */
+    0,
+    0
+};
+
+static twr_engine_t tag;
 
 /*! ------------------------------------------------------------------------------------------------------------------
- * @fn main()
+ * @fn ss_init_main()
  *
- * @brief Application entry point.
+ * @brief Range with anchor x (0 for A, 1 for B, ...), retrying until the exchange completes. The distance is sent to the
+ *        PC as a range report of anchor 'A' (see twr_report.h) and kept in tag.distance_mm.
  *
- * @param  none
+ * @param  x  anchor number
  *
  * @return none
  */
-
-//int ss_init_main(void)
 void ss_init_main(int x)
 {
-	/* Frames used in the ranging process. See NOTE 3 below. */
-	uint8 tx_poll_msg[] = {0x41, 0x88, 0, 0xCA, 0xDE, 'W', 'A', table[x], 'E', 0xE0, 0, 0};
-	uint8 rx_resp_msg[] = {0x41, 0x88, 0, 0xCA, 0xDE, 'V', 'E', table[x], 'A', 0xE1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-
-    /* Reset and initialise DW1000.
-     * For initialisation, DW1000 clocks must be temporarily set to crystal speed. After initialisation SPI rate can be increased for optimum
-     * performance. */
-	deca_reset();/* Target specific drive of RSTn line into DW1000 low for a period. */
-
-	port_set_dw1000_slowrate();
-
-    if (dwt_initialise(DWT_LOADUCODE) == DWT_ERROR)
+    /* Initialise and configure the DW1000 on the first round only, later rounds reuse the configured device.
+     * See twr_engine_init() and NOTE 6 below. */
+    if (twr_engine_init(&tag, &tag_cfg) == DWT_ERROR)
     {
         while (1)
         { };
     }
 
-    port_set_dw1000_fastrate();
-
-    /* Configure DW1000. See NOTE 6 below. */
-    dwt_configure(&config);
-
-    /* Apply default antenna delay value. See NOTE 2 below. */
-    dwt_setrxantennadelay(RX_ANT_DLY);
-    dwt_settxantennadelay(TX_ANT_DLY);
-
-    /* Set expected response's delay and timeout. See NOTE 1 and 5 below.
-     * As this example only handles one incoming frame with always the same delay and timeout, those values can be set here once for all. */
-    dwt_setrxaftertxdelay(POLL_TX_TO_RESP_RX_DLY_UUS);
-    dwt_setrxtimeout(RESP_RX_TIMEOUT_UUS);
-
-    /****Debug Counters****/
-//    int k1 = 0;   // received a frame
-//    int k2 = 0;   // the received frame is correct
-//    int k3 = 0;   // receive fails
-    /**********************/
-
-    /* Loop forever initiating ranging exchanges. */
-    while (1)
+    /* Poll and compute the distance from the response. See NOTE 7 to 11 below. */
+    while (twr_tag_range(&tag, table[x]) != DWT_SUCCESS)
     {
-        /* Write frame data to DW1000 and prepare transmission. See NOTE 7 below. */
-        tx_poll_msg[ALL_MSG_SN_IDX] = frame_seq_nb;
-        dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_TXFRS);
-        dwt_writetxdata(sizeof(tx_poll_msg), tx_poll_msg, 0); /* Zero offset in TX buffer. */
-        dwt_writetxfctrl(sizeof(tx_poll_msg), 0, 1); /* Zero offset in TX buffer, ranging. */
-
-        /* Start transmission, indicating that a response is expected so that reception is enabled automatically after the frame is sent and the delay
-         * set by dwt_setrxaftertxdelay() has elapsed. */
-        dwt_starttx(DWT_START_TX_IMMEDIATE | DWT_RESPONSE_EXPECTED);
-
-        /* We assume that the transmission is achieved correctly, poll for reception of a frame or error/timeout. See NOTE 8 below. */
-        while (!((status_reg = dwt_read32bitreg(SYS_STATUS_ID)) & (SYS_STATUS_RXFCG | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR)))
-        { };
-
-        /* Increment frame sequence number after transmission of the poll message (modulo 256). */
-        frame_seq_nb++;
-
-        if (status_reg & SYS_STATUS_RXFCG)
-        {
-//        	k1++;
-            uint32 frame_len;
-
-            /* Clear good RX frame event in the DW1000 status register. */
-            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_RXFCG);
-
-            /* A frame has been received, read it into the local buffer. */
-            frame_len = dwt_read32bitreg(RX_FINFO_ID) & RX_FINFO_RXFLEN_MASK;
-            if (frame_len <= RX_BUF_LEN)
-            {
-                dwt_readrxdata(rx_buffer, frame_len, 0);
-            }
-
-            /* Check that the frame is the expected response from the companion "SS TWR responder" example.
-             * As the sequence number field of the frame is not relevant, it is cleared to simplify the validation of the frame. */
-            rx_buffer[ALL_MSG_SN_IDX] = 0;
-            if (memcmp(rx_buffer, rx_resp_msg, ALL_MSG_COMMON_LEN) == 0)
-            {
-//            	k2++;
-
-                uint32 poll_tx_ts, resp_rx_ts, poll_rx_ts, resp_tx_ts;
-                int32 rtd_init, rtd_resp;
-                float clockOffsetRatio ;
-
-                /* Retrieve poll transmission and response reception timestamps. See NOTE 9 below. */
-                poll_tx_ts = dwt_readtxtimestamplo32();
-                resp_rx_ts = dwt_readrxtimestamplo32();
-
-                /* Read carrier integrator value and calculate clock offset ratio. See NOTE 11 below. */
-                clockOffsetRatio = dwt_readcarrierintegrator() * (FREQ_OFFSET_MULTIPLIER * HERTZ_TO_PPM_MULTIPLIER_CHAN_2 / 1.0e6) ;
-
-                /* Get timestamps embedded in response message. */
-                resp_msg_get_ts(&rx_buffer[RESP_MSG_POLL_RX_TS_IDX], &poll_rx_ts);
-                resp_msg_get_ts(&rx_buffer[RESP_MSG_RESP_TX_TS_IDX], &resp_tx_ts);
-
-                /* Compute time of flight and distance, using clock offset ratio to correct for differing local and remote clock rates */
-                rtd_init = resp_rx_ts - poll_tx_ts;
-                rtd_resp = resp_tx_ts - poll_rx_ts;
-
-                tof = ((rtd_init - rtd_resp * (1 - clockOffsetRatio)) / 2.0) * DWT_TIME_UNITS;
-                distance = tof * SPEED_OF_LIGHT;
-
-                memset(dist, 0, 18);
-                if (x == 0)
-                {
-                	sprintf(dist, "DIST A: %3.2f m \r\n", distance);
-                }
-                else if (x == 1)
-                {
-                	sprintf(dist, "DIST B: %3.2f m \r\n", distance);
-                }
-                else if (x== 2)
-                {
-                	sprintf(dist, "DIST C: %3.2f m \r\n", distance);
-                }
-
-                CDC_Transmit_FS(dist, sizeof(dist));
-
-				break;  /* For SS Complete Code */
-
-            }
-        }
-        else
-        {
-//        	k3++;
-            /* Clear RX error/timeout events in the DW1000 status register. */
-            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR);
-
-            /* Reset RX to properly reinitialise LDE operation. */
-            dwt_rxreset();
-        }
-
         /* Execute a delay between ranging exchanges. */
         Sleep(RNG_DELAY_MS);
-
-    }
-}
-
-/*! ------------------------------------------------------------------------------------------------------------------
- * @fn resp_msg_get_ts()
- *
- * @brief Read a given timestamp value from the response message. In the timestamp fields of the response message, the
- *        least significant byte is at the lower address.
- *
- * @param  ts_field  pointer on the first byte of the timestamp field to get
- *         ts  timestamp value
- *
- * @return none
- */
-static void resp_msg_get_ts(uint8 *ts_field, uint32 *ts)
-{
-    int i;
-    *ts = 0;
-    for (i = 0; i < RESP_MSG_TS_LEN; i++)
-    {
-        *ts += ts_field[i] << (i * 8);
     }
 }
 
@@ -298,8 +131,9 @@ static void resp_msg_get_ts(uint8 *ts_field, uint32 *ts)
  *    Poll message:
  *     - no more data
  *    Response message:
- *     - byte 10 -> 13: poll message reception timestamp.
- *     - byte 14 -> 17: response message transmission timestamp.
+ *     - byte 10 -> 14: poll message reception timestamp.
+ *     - byte 15 -> 19: response message transmission timestamp.
+ *    Timestamps are 40 bits, least significant byte first, see TWR_RESP_*_TS_IDX in twr_engine.h and twr_ts.h.
  *    All messages end with a 2-byte checksum automatically set by DW1000.
  * 4. Source and destination addresses are hard coded constants in this example to keep it simple but for a real product every device should have a
  *    unique ID. Here, 16-bit addressing is used to keep the messages as short as possible but, in an actual application, this should be done only
@@ -316,9 +150,8 @@ static void resp_msg_get_ts(uint8 *ts_field, uint32 *ts)
  *    refer to DW1000 User Manual for more details on "interrupts". It is also to be noted that STATUS register is 5 bytes long but, as the event we
  *    use are all in the first bytes of the register, we can use the simple dwt_read32bitreg() API call to access it instead of reading the whole 5
  *    bytes.
- * 9. The high order byte of each 40-bit time-stamps is discarded here. This is acceptable as, on each device, those time-stamps are not separated by
- *    more than 2**32 device time units (which is around 67 ms) which means that the calculation of the round-trip delays can be handled by a 32-bit
- *    subtraction.
+ * 9. The time-stamps keep all their 40 bits, and the round-trip delays are 40-bit subtractions (see twr_ts.h): correct when the clock wraps, for
+ *    delays up to 17.2 s instead of the 2**32 device time units (around 67 ms) of 32-bit time-stamps.
  * 10. The user is referred to DecaRanging ARM application (distributed with EVK1000 product) for additional practical example of usage, and to the
  *     DW1000 API Guide for more details on the DW1000 driver functions.
  * 11. The use of the carrier integrator value to correct the TOF calculation, was added Feb 2017 for v1.3 of this example.  This significantly
@@ -17,22 +17,20 @@
  * @author Decawave
  */
 
+
 /*
- * ss_responder_C.c
+ * ss_responder.c
+ *
+ *  One source for every SS TWR anchor, the address is chosen at run time, see twr_engine.h.
  *
  *  Created on: Jan 25, 2021
  *      Author: kostasdeligiorgis
  */
 
-#include <stdio.h>
-#include <string.h>
-
 #include <DWM_functions.h>
 #include "main.h"
 #include "deca_device_api.h"
-#include "deca_regs.h"
-
-#include "usbd_cdc_if.h"
+#include "twr_engine.h"
 
 
 /* Default communication configuration. We use here EVK1000's mode 4. See NOTE 1 below. */
@@ -53,31 +51,6 @@ static dwt_config_t config = {
 #define TX_ANT_DLY 16505
 #define RX_ANT_DLY 16505
 
-/* Frames used in the ranging process. See NOTE 3 below. */
-static uint8 rx_poll_msg[] = {0x41, 0x88, 0, 0xCA, 0xDE, 'W', 'A', '3', 'E', 0xE0, 0, 0};
-static uint8 tx_resp_msg[] = {0x41, 0x88, 0, 0xCA, 0xDE, 'V', 'E', '3', 'A', 0xE1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-/* Length of the common part of the message (up to and including the function code, see NOTE 3 below). */
-#define ALL_MSG_COMMON_LEN 10
-/* Index to access some of the fields in the frames involved in the process. */
-#define ALL_MSG_SN_IDX 2
-#define RESP_MSG_POLL_RX_TS_IDX 10
-#define RESP_MSG_RESP_TX_TS_IDX 14
-#define RESP_MSG_TS_LEN 4
-/* Frame sequence number, incremented after each transmission. */
-static uint8 frame_seq_nb = 0;
-
-/* Buffer to store received messages.
- * Its size is adjusted to longest frame that this example code is supposed to handle. */
-#define RX_BUF_LEN 12
-static uint8 rx_buffer[RX_BUF_LEN];
-
-/* Hold copy of status register state here for reference so that it can be examined at a debug breakpoint. */
-static uint32 status_reg = 0;
-
-/* UWB microsecond (uus) to device time unit (dtu, around 15.65 ps) conversion factor.
- * 1 uus = 512 / 499.2 Βs and 1 Βs = 499.2 * 128 dtu. */
-#define UUS_TO_DWT_TIME 65536
-
 /* Delay between frames, in UWB microseconds. See NOTE 1 below. */
 //#define POLL_RX_TO_RESP_TX_DLY_UUS 330
 //#define POLL_RX_TO_RESP_TX_DLY_UUS 500
@@ -85,179 +58,62 @@ static uint32 status_reg = 0;
 //#define POLL_RX_TO_RESP_TX_DLY_UUS 850  // it works
 #define POLL_RX_TO_RESP_TX_DLY_UUS 715
 
-
-/* Timestamps of frames transmission/reception.
- * As they are 40-bit wide, we need to define a 64-bit int type to handle them. */
-typedef unsigned long long uint64;
-static uint64 poll_rx_ts;
-static uint64 resp_tx_ts;
-
-/* Declaration of static functions. */
-static uint64 get_rx_timestamp_u64(void);
-static void resp_msg_set_ts(uint8 *ts_field, const uint64 ts);
+/* Anchor addresses, the index is the anchor number x of ss_resp_anchor(). See NOTE 4 below. */
+static const uint8 table[] = {'1', '2', '3'};
 
 /*! ------------------------------------------------------------------------------------------------------------------
- * @fn main()
+ * @fn ss_resp_anchor()
  *
- * @brief Application entry point.
+ * @brief Answer the SS TWR polls addressed to anchor x forever.
  *
- * @param  none
+ * @param  x  anchor number, 0 for A, 1 for B, ...
  *
  * @return none
  */
-int ss_resp_main_C(void)
+void ss_resp_anchor(int x)
 {
-    /* Reset and initialise DW1000.
-     * For initialisation, DW1000 clocks must be temporarily set to crystal speed. After initialisation SPI rate can be increased for optimum
-     * performance. */
-    deca_reset();
-    port_set_dw1000_slowrate();
-    if (dwt_initialise(DWT_LOADUCODE) == DWT_ERROR)
+    twr_cfg_t cfg = {
+        TWR_ROLE_ANCHOR,
+        TWR_MODE_SS,
+        table[x],
+        0,
+        /* radio (NOTE 5), antenna delays (NOTE 2), no RX timeouts */
+        { &config, TX_ANT_DLY, RX_ANT_DLY, 0, 0, 0 },
+        POLL_RX_TO_RESP_TX_DLY_UUS,
+        0,
+        /* broadcast slots, set by the tag */
+        0,
+        0
+    };
+    twr_engine_t engine = {0};
+
+    /* Reset, initialise and configure the DW1000. */
+    if (twr_engine_init(&engine, &cfg) == DWT_ERROR)
     {
         while (1)
         { };
     }
-    port_set_dw1000_fastrate();
-
-    /* Configure DW1000. See NOTE 5 below. */
-    dwt_configure(&config);
-
-    /* Apply default antenna delay value. See NOTE 2 below. */
-    dwt_setrxantennadelay(RX_ANT_DLY);
-    dwt_settxantennadelay(TX_ANT_DLY);
-
-
-    /****Debug Counters****/
-//    int k1 = 0;   // start_tx_delayed failed
-//    int k2 = 0;   // start_tx_delayed successed
-    /**********************/
-
-    /* Loop forever responding to ranging requests. */
-    while (1)
-    {
-        /* Activate reception immediately. */
-        dwt_rxenable(DWT_START_RX_IMMEDIATE);
-
-        /* Poll for reception of a frame or error/timeout. See NOTE 6 below. */
-        while (!((status_reg = dwt_read32bitreg(SYS_STATUS_ID)) & (SYS_STATUS_RXFCG | SYS_STATUS_ALL_RX_ERR)))
-        { };
-
-        if (status_reg & SYS_STATUS_RXFCG)
-        {
-            uint32 frame_len;
-
-            /* Clear good RX frame event in the DW1000 status register. */
-            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_RXFCG);
-
-            /* A frame has been received, read it into the local buffer. */
-            frame_len = dwt_read32bitreg(RX_FINFO_ID) & RX_FINFO_RXFL_MASK_1023;
-            if (frame_len <= RX_BUFFER_LEN)
-            {
-                dwt_readrxdata(rx_buffer, frame_len, 0);
-            }
-
-            /* Check that the frame is a poll sent by "SS TWR initiator" example.
-             * As the sequence number field of the frame is not relevant, it is cleared to simplify the validation of the frame. */
-            rx_buffer[ALL_MSG_SN_IDX] = 0;
-            if (memcmp(rx_buffer, rx_poll_msg, ALL_MSG_COMMON_LEN) == 0)
-            {
-                uint32 resp_tx_time;
-                int ret;
-
-                /* Retrieve poll reception timestamp. */
-                poll_rx_ts = get_rx_timestamp_u64();
-
-                /* Compute final message transmission time. See NOTE 7 below. */
-                resp_tx_time = (poll_rx_ts + (POLL_RX_TO_RESP_TX_DLY_UUS * UUS_TO_DWT_TIME)) >> 8;
-                dwt_setdelayedtrxtime(resp_tx_time);
 
-                /* Response TX timestamp is the transmission time we programmed plus the antenna delay. */
-                resp_tx_ts = (((uint64)(resp_tx_time & 0xFFFFFFFEUL)) << 8) + TX_ANT_DLY;
-
-                /* Write all timestamps in the final message. See NOTE 8 below. */
-                resp_msg_set_ts(&tx_resp_msg[RESP_MSG_POLL_RX_TS_IDX], poll_rx_ts);
-                resp_msg_set_ts(&tx_resp_msg[RESP_MSG_RESP_TX_TS_IDX], resp_tx_ts);
-
-                /* Write and send the response message. See NOTE 9 below. */
-                tx_resp_msg[ALL_MSG_SN_IDX] = frame_seq_nb;
-                dwt_writetxdata(sizeof(tx_resp_msg), tx_resp_msg, 0); /* Zero offset in TX buffer. */
-                dwt_writetxfctrl(sizeof(tx_resp_msg), 0, 1); /* Zero offset in TX buffer, ranging. */
-                ret = dwt_starttx(DWT_START_TX_DELAYED);
-
-//                if (ret == DWT_ERROR)
-//                {
-//                	k1++;
-//                }
-
-                /* If dwt_starttx() returns an error, abandon this ranging exchange and proceed to the next one. See NOTE 10 below. */
-                if (ret == DWT_SUCCESS)
-                {
-//                	k2++;
-                    /* Poll DW1000 until TX frame sent event set. See NOTE 6 below. */
-                    while (!(dwt_read32bitreg(SYS_STATUS_ID) & SYS_STATUS_TXFRS))
-                    { };
-
-                    /* Clear TXFRS event. */
-                    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_TXFRS);
-
-                    /* Increment frame sequence number after transmission of the poll message (modulo 256). */
-                    frame_seq_nb++;
-                }
-            }
-        }
-        else
-        {
-            /* Clear RX error events in the DW1000 status register. */
-            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_ERR);
+    /* Loop forever responding to ranging requests. See NOTE 6 to 10 below. */
+    twr_anchor_run(&engine);
+}
 
-            /* Reset RX to properly reinitialise LDE operation. */
-            dwt_rxreset();
-        }
-    }
+int ss_resp_main_A(void)
+{
+    ss_resp_anchor(0);
+    return 0;
 }
 
-/*! ------------------------------------------------------------------------------------------------------------------
- * @fn get_rx_timestamp_u64()
- *
- * @brief Get the RX time-stamp in a 64-bit variable.
- *        /!\ This function assumes that length of time-stamps is 40 bits, for both TX and RX!
- *
- * @param  none
- *
- * @return  64-bit value of the read time-stamp.
- */
-static uint64 get_rx_timestamp_u64(void)
+int ss_resp_main_B(void)
 {
-    uint8 ts_tab[5];
-    uint64 ts = 0;
-    int i;
-    dwt_readrxtimestamp(ts_tab);
-    for (i = 4; i >= 0; i--)
-    {
-        ts <<= 8;
-        ts |= ts_tab[i];
-    }
-    return ts;
+    ss_resp_anchor(1);
+    return 0;
 }
 
-/*! ------------------------------------------------------------------------------------------------------------------
- * @fn final_msg_set_ts()
- *
- * @brief Fill a given timestamp field in the response message with the given value. In the timestamp fields of the
- *        response message, the least significant byte is at the lower address.
- *
- * @param  ts_field  pointer on the first byte of the timestamp field to fill
- *         ts  timestamp value
- *
- * @return none
- */
-static void resp_msg_set_ts(uint8 *ts_field, const uint64 ts)
+int ss_resp_main_C(void)
 {
-    int i;
-    for (i = 0; i < RESP_MSG_TS_LEN; i++)
-    {
-        ts_field[i] = (ts >> (i * 8)) & 0xFF;
-    }
+    ss_resp_anchor(2);
+    return 0;
 }
 
 /*****************************************************************************************************************************************************
@@ -287,8 +143,9 @@ static void resp_msg_set_ts(uint8 *ts_field, const uint64 ts)
  *    Poll message:
  *     - no more data
  *    Response message:
- *     - byte 10 -> 13: poll message reception timestamp.
- *     - byte 14 -> 17: response message transmission timestamp.
+ *     - byte 10 -> 14: poll message reception timestamp.
+ *     - byte 15 -> 19: response message transmission timestamp.
+ *    Timestamps are 40 bits, least significant byte first, see TWR_RESP_*_TS_IDX in twr_engine.h and twr_ts.h.
  *    All messages end with a 2-byte checksum automatically set by DW1000.
  * 4. Source and destination addresses are hard coded constants in this example to keep it simple but for a real product every device should have a
  *    unique ID. Here, 16-bit addressing is used to keep the messages as short as possible but, in an actual application, this should be done only
@@ -304,9 +161,8 @@ static void resp_msg_set_ts(uint8 *ts_field, const uint64 ts)
  *    response RX timestamp to get final transmission time. The delayed transmission time resolution is 512 device time units which means that the
  *    lower 9 bits of the obtained value must be zeroed. This also allows to encode the 40-bit value in a 32-bit words by shifting the all-zero lower
  *    8 bits.
- * 8. In this operation, the high order byte of each 40-bit timestamps is discarded. This is acceptable as those time-stamps are not separated by
- *    more than 2**32 device time units (which is around 67 ms) which means that the calculation of the round-trip delays (needed in the
- *    time-of-flight computation) can be handled by a 32-bit subtraction.
+ * 8. The response message carries the full 40-bit timestamps, 5 bytes each, least significant byte first (see twr_ts.h). The initiator computes the
+ *    round-trip delays (needed in the time-of-flight computation) with 40-bit subtractions, correct for delays up to 17.2 s.
  * 9. dwt_writetxdata() takes the full size of the message as a parameter but only copies (size - 2) bytes as the check-sum at the end of the frame is
  *    automatically appended by the DW1000. This means that our variable could be two bytes shorter without losing any data (but the sizeof would not
  *    work anymore then as we would still have to indicate the full length of the frame to dwt_writetxdata()).
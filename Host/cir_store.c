@@ -0,0 +1,555 @@
+/*! ----------------------------------------------------------------------------
+ * @file    cir_store.c
+ * @brief   Columnar file of the channel impulse responses sent by the boards
+ *
+ *          Reads report streams (see DWM_platform/twr_report.h) of boards
+ *          built with TWR_USE_CIR, from files or the serial device, puts the
+ *          CIR frames of each capture back together (see
+ *          DWM_platform/twr_cir.h), joins each capture with the range report
+ *          of its frame, and appends it as one row of a columnar file. The
+ *          file is memory mapped and grows by doubling; each column is one
+ *          contiguous array, so a batch analysis reads only the columns it
+ *          uses, straight from the page cache.
+ *
+ *          File layout, little endian:
+ *           - header (CIR_FILE_HDR_LEN bytes): magic, samples per capture,
+ *             number of columns, rows, then per column its name, numpy type
+ *             string, offset in the file, bytes per row and values per row
+ *           - the columns, each at a 64 byte aligned offset
+ *          In numpy: np.memmap(path, dtype=type, offset=offset, shape=(rows, count))
+ *
+ *          usage: cir_store [-n rows] out.cir stream...
+ *                 cir_store -a file.cir
+ *          -n sets the rows first mapped (default 1024).
+ *          -a prints, per node, how far the strongest path lies behind the
+ *          first path, and its power over that of the first path: a blocked
+ *          direct path (NLOS) shows as a late peak well above the first path.
+ *          Set a serial device to raw mode first: stty -F /dev/ttyACM0 raw
+ */
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "twr_report.h"
+
+#define CIR_FILE_MAGIC      "TWRCIR01"
+#define CIR_FILE_HDR_LEN    4096
+#define CIR_MAX_WINDOW      1016        // accumulator samples at 64 MHz PRF
+#define CIR_MAX_NODES       256         // node labels are one byte
+#define RANGE_HISTORY       64          // range reports kept to join the captures that follow them
+
+/* NLOS flag of the analysis: peak this many samples (about 30 cm each) or dB behind the first path */
+#define NLOS_DELAY_SAMPLES  3
+#define NLOS_PEAK_DB        6.0
+
+typedef struct
+{
+    char        name[16];
+    char        type[8];        // numpy dtype
+    uint64_t    offset;         // from the start of the file
+    uint32_t    width;          // bytes per row
+    uint32_t    count;          // values per row
+} cir_column_t;
+
+/* Columns */
+enum
+{
+    COL_NODE, COL_SEQ, COL_FP_INDEX, COL_START, COL_DISTANCE, COL_FP_AMP1, COL_CIR_POWER, COL_STD_NOISE, COL_RX_PACC,
+    COL_RE, COL_IM, NUM_COLUMNS
+};
+
+typedef struct
+{
+    char        magic[8];
+    uint32_t    window;         // samples per capture
+    uint32_t    columns;
+    uint64_t    rows;
+    uint64_t    capacity;       // rows the columns have room for
+    cir_column_t col[NUM_COLUMNS];
+} cir_file_header_t;
+
+typedef struct
+{
+    int                 fd;
+    uint8_t            *base;
+    size_t              size;
+    cir_file_header_t  *hdr;
+} cir_file_t;
+
+/* A capture being put back together, and the row it becomes */
+typedef struct
+{
+    uint8       busy;
+    uint8       pieces;
+    uint32_t    have;           // bit per piece received
+    uint16      seq;
+    uint16      fp_index;
+    uint16      start;
+    uint32_t    samples;
+    int16       re[CIR_MAX_WINDOW];
+    int16       im[CIR_MAX_WINDOW];
+} capture_t;
+
+typedef struct
+{
+    cir_file_t          file;
+    capture_t           cap[CIR_MAX_NODES];
+    twr_range_report_t  ranges[RANGE_HISTORY];  // by seq % RANGE_HISTORY
+    uint8               range_ok[RANGE_HISTORY];
+    const char         *path;           // of the file, created with the window of the first capture
+    uint64_t            capacity;       // rows mapped at first
+    unsigned long       rows, unmatched, incomplete, other_window;
+} store_ctx_t;
+
+static const struct
+{
+    const char *name;
+    const char *type;
+    uint32_t    size;
+} column_defs[NUM_COLUMNS] = {
+    { "node", "|u1", 1 }, { "seq", "<u2", 2 }, { "fp_index", "<u2", 2 }, { "start", "<u2", 2 },
+    { "distance_mm", "<i4", 4 }, { "fp_amp1", "<u2", 2 }, { "cir_power", "<u2", 2 }, { "std_noise", "<u2", 2 },
+    { "rx_pacc", "<u2", 2 }, { "re", "<i2", 2 }, { "im", "<i2", 2 },
+};
+
+/*
+ * Columnar file
+ */
+
+/* Lay the columns out for 'capacity' rows, returns the file size */
+static size_t layout(cir_file_header_t *h, cir_column_t *col, uint64_t capacity)
+{
+    uint64_t off = CIR_FILE_HDR_LEN;
+    int k;
+
+    for (k = 0; k < NUM_COLUMNS; k++)
+    {
+        col[k].offset = off;
+        off = (off + capacity * h->col[k].width + 63) & ~(uint64_t)63;
+    }
+    return (size_t)off;
+}
+
+static int file_map(cir_file_t *f, size_t size)
+{
+    if (f->base != NULL)
+    {
+        munmap(f->base, f->size);
+    }
+    f->base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, f->fd, 0);
+    if (f->base == MAP_FAILED)
+    {
+        f->base = NULL;
+        return -1;
+    }
+    f->size = size;
+    f->hdr = (cir_file_header_t *)f->base;
+    return 0;
+}
+
+/* Move the columns to the layout of 'capacity' rows. Growing, the columns move up and are moved last first; shrinking,
+ * they move down and are moved first first, so that none overwrites one not moved yet. */
+static int file_resize(cir_file_t *f, uint64_t capacity)
+{
+    cir_column_t col[NUM_COLUMNS];
+    cir_file_header_t *h = f->hdr;
+    size_t size = layout(h, col, capacity);
+    int grow = capacity > h->capacity;
+    int k, i;
+
+    if (grow && (ftruncate(f->fd, (off_t)size) != 0 || file_map(f, size) != 0))
+    {
+        return -1;
+    }
+    h = f->hdr;
+    for (i = 0; i < NUM_COLUMNS; i++)
+    {
+        k = grow ? NUM_COLUMNS - 1 - i : i;
+        memmove(f->base + col[k].offset, f->base + h->col[k].offset, h->rows * h->col[k].width);
+        h->col[k].offset = col[k].offset;
+    }
+    h->capacity = capacity;
+    if (!grow &&
+        (msync(f->base, f->size, MS_SYNC) != 0 || ftruncate(f->fd, (off_t)size) != 0 || file_map(f, size) != 0))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int file_create(cir_file_t *f, const char *path, uint32_t window, uint64_t capacity)
+{
+    cir_file_header_t h;
+    size_t size;
+    int k;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CIR_FILE_MAGIC, sizeof(h.magic));
+    h.window = window;
+    h.columns = NUM_COLUMNS;
+    h.capacity = capacity;
+    for (k = 0; k < NUM_COLUMNS; k++)
+    {
+        strcpy(h.col[k].name, column_defs[k].name);
+        strcpy(h.col[k].type, column_defs[k].type);
+        h.col[k].count = (k == COL_RE || k == COL_IM) ? window : 1;
+        h.col[k].width = column_defs[k].size * h.col[k].count;
+    }
+    size = layout(&h, h.col, capacity);
+
+    f->base = NULL;
+    f->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (f->fd < 0 || ftruncate(f->fd, (off_t)size) != 0 || file_map(f, size) != 0)
+    {
+        return -1;
+    }
+    memcpy(f->hdr, &h, sizeof(h));
+    return 0;
+}
+
+/* Append a row, values[k] holding the width of column k */
+static int file_append(cir_file_t *f, const void *const *values)
+{
+    cir_file_header_t *h = f->hdr;
+    int k;
+
+    if (h->rows == h->capacity && file_resize(f, h->capacity * 2) != 0)
+    {
+        return -1;
+    }
+    h = f->hdr;
+    for (k = 0; k < NUM_COLUMNS; k++)
+    {
+        memcpy(f->base + h->col[k].offset + h->rows * h->col[k].width, values[k], h->col[k].width);
+    }
+    h->rows++;
+    return 0;
+}
+
+/* Drop the room left, so that the file holds exactly its rows */
+static int file_close(cir_file_t *f)
+{
+    int err = (f->hdr->rows != f->hdr->capacity) ? file_resize(f, f->hdr->rows) : 0;
+
+    if (f->base != NULL)
+    {
+        err |= msync(f->base, f->size, MS_SYNC);
+        munmap(f->base, f->size);
+    }
+    close(f->fd);
+    return err;
+}
+
+static int file_open_read(cir_file_t *f, const char *path)
+{
+    struct stat st;
+
+    f->fd = open(path, O_RDONLY);
+    if (f->fd < 0 || fstat(f->fd, &st) != 0 || (size_t)st.st_size < sizeof(cir_file_header_t))
+    {
+        return -1;
+    }
+    f->size = (size_t)st.st_size;
+    f->base = mmap(NULL, f->size, PROT_READ, MAP_SHARED, f->fd, 0);
+    if (f->base == MAP_FAILED)
+    {
+        return -1;
+    }
+    f->hdr = (cir_file_header_t *)f->base;
+    if (memcmp(f->hdr->magic, CIR_FILE_MAGIC, sizeof(f->hdr->magic)) != 0 || f->hdr->columns != NUM_COLUMNS ||
+        f->hdr->col[NUM_COLUMNS - 1].offset + f->hdr->rows * f->hdr->col[NUM_COLUMNS - 1].width > f->size)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Stream side
+ */
+
+static void on_range(void *ctx, const twr_range_report_t *r)
+{
+    store_ctx_t *s = (store_ctx_t *)ctx;
+
+    s->ranges[r->seq % RANGE_HISTORY] = *r;
+    s->range_ok[r->seq % RANGE_HISTORY] = 1;
+}
+
+static void store_capture(store_ctx_t *s, uint8 node, const capture_t *c)
+{
+    const twr_range_report_t *r = &s->ranges[c->seq % RANGE_HISTORY];
+    const void *values[NUM_COLUMNS];
+
+    if (!s->range_ok[c->seq % RANGE_HISTORY] || r->seq != c->seq)
+    {
+        s->unmatched++;
+        return;
+    }
+    if (s->file.base == NULL && file_create(&s->file, s->path, c->samples, s->capacity) != 0)
+    {
+        perror(s->path);
+        exit(1);
+    }
+    if (c->samples != s->file.hdr->window)
+    {
+        s->other_window++;
+        return;
+    }
+    values[COL_NODE] = &node;
+    values[COL_SEQ] = &c->seq;
+    values[COL_FP_INDEX] = &c->fp_index;
+    values[COL_START] = &c->start;
+    values[COL_DISTANCE] = &r->distance_mm;
+    values[COL_FP_AMP1] = &r->quality.fp_amp1;
+    values[COL_CIR_POWER] = &r->quality.cir_power;
+    values[COL_STD_NOISE] = &r->quality.std_noise;
+    values[COL_RX_PACC] = &r->quality.rx_pacc;
+    values[COL_RE] = c->re;
+    values[COL_IM] = c->im;
+    if (file_append(&s->file, values) != 0)
+    {
+        perror("cir_store");
+        exit(1);
+    }
+    s->rows++;
+}
+
+static void on_cir(void *ctx, const twr_cir_report_t *p)
+{
+    store_ctx_t *s = (store_ctx_t *)ctx;
+    capture_t *c = &s->cap[p->node];
+    uint32_t at;
+
+    /* A new capture: the first piece, or another frame */
+    if (p->piece == 0 || !c->busy || p->seq != c->seq)
+    {
+        if (c->busy)
+        {
+            s->incomplete++;
+        }
+        c->busy = (p->piece == 0 && p->pieces <= 32);
+        c->pieces = p->pieces;
+        c->have = 0;
+        c->seq = p->seq;
+        c->fp_index = p->fp_index;
+        c->start = p->start;
+        c->samples = 0;
+        if (!c->busy)
+        {
+            s->incomplete++;
+            return;
+        }
+    }
+
+    at = (uint32_t)(p->start - c->start);
+    if (p->piece >= c->pieces || at + p->count > CIR_MAX_WINDOW)
+    {
+        c->busy = 0;
+        s->incomplete++;
+        return;
+    }
+    memcpy(&c->re[at], p->re, p->count * sizeof(int16));
+    memcpy(&c->im[at], p->im, p->count * sizeof(int16));
+    c->have |= 1UL << p->piece;
+    if (at + p->count > c->samples)
+    {
+        c->samples = at + p->count;
+    }
+    if (c->have == (1UL << c->pieces) - 1)
+    {
+        c->busy = 0;
+        store_capture(s, p->node, c);
+    }
+}
+
+static int store_stream(store_ctx_t *s, const char *path)
+{
+    twr_report_decoder_t decoder;
+    uint8 buf[4096];
+    size_t n;
+    FILE *in = fopen(path, "rb");
+    int k;
+
+    if (in == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    memset(&decoder, 0, sizeof(decoder));
+    memset(s->range_ok, 0, sizeof(s->range_ok));
+    decoder.cir_cb = on_cir;
+    decoder.cir_ctx = s;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+    {
+        twr_report_decode(&decoder, buf, (uint32)n, on_range, s);
+    }
+    for (k = 0; k < CIR_MAX_NODES; k++)
+    {
+        if (s->cap[k].busy)
+        {
+            s->incomplete++;
+            s->cap[k].busy = 0;
+        }
+    }
+    fclose(in);
+    return 0;
+}
+
+/*
+ * Analysis
+ */
+
+typedef struct
+{
+    unsigned long   rows;
+    unsigned long   nlos;
+    double          delay_sum;      // samples from the first path to the peak
+    double          peak_db_sum;    // peak over first path power
+    double          distance_sum;   // m
+} node_summary_t;
+
+static const char *node_name(int node, char *buf)
+{
+    if (node == 0)
+    {
+        return "tag";
+    }
+    sprintf(buf, "%c", node);
+    return buf;
+}
+
+static int analyse(const char *path)
+{
+    static node_summary_t sum[CIR_MAX_NODES];
+    cir_file_t f;
+    const cir_file_header_t *h;
+    const uint8 *node;
+    const uint16 *fp_index, *start;
+    const int32 *distance;
+    const int16 *re, *im;
+    uint32_t w, i, peak, fp;
+    uint64_t row;
+    double p, best, fp_pow;
+    char name[2];
+    int k;
+
+    if (file_open_read(&f, path) != 0)
+    {
+        fprintf(stderr, "%s: not a CIR file\n", path);
+        return 1;
+    }
+    h = f.hdr;
+    w = h->window;
+    node = (const uint8 *)(f.base + h->col[COL_NODE].offset);
+    fp_index = (const uint16 *)(f.base + h->col[COL_FP_INDEX].offset);
+    start = (const uint16 *)(f.base + h->col[COL_START].offset);
+    distance = (const int32 *)(f.base + h->col[COL_DISTANCE].offset);
+    re = (const int16 *)(f.base + h->col[COL_RE].offset);
+    im = (const int16 *)(f.base + h->col[COL_IM].offset);
+
+    for (row = 0; row < h->rows; row++, re += w, im += w)
+    {
+        node_summary_t *n = &sum[node[row]];
+
+        /* First path: strongest of the three samples after its index, as FP_AMPL1..3 */
+        fp = (uint32_t)(fp_index[row] >> 6) - start[row];
+        fp_pow = 0.0;
+        for (i = fp + 1; i <= fp + 3 && i < w; i++)
+        {
+            p = (double)re[i] * re[i] + (double)im[i] * im[i];
+            fp_pow = (p > fp_pow) ? p : fp_pow;
+        }
+        best = 0.0;
+        peak = 0;
+        for (i = 0; i < w; i++)
+        {
+            p = (double)re[i] * re[i] + (double)im[i] * im[i];
+            if (p > best)
+            {
+                best = p;
+                peak = i;
+            }
+        }
+        p = (fp_pow > 0.0) ? 10.0 * log10(best / fp_pow) : 0.0;
+        n->rows++;
+        n->delay_sum += (peak > fp + 1) ? peak - fp - 1 : 0;
+        n->peak_db_sum += p;
+        n->distance_sum += distance[row] / 1000.0;
+        if (peak > fp + NLOS_DELAY_SAMPLES || p > NLOS_PEAK_DB)
+        {
+            n->nlos++;
+        }
+    }
+
+    printf("%s: %llu captures of %u samples\n", path, (unsigned long long)h->rows, w);
+    printf("node  captures  distance m  peak delay  peak/fp dB   nlos\n");
+    for (k = 0; k < CIR_MAX_NODES; k++)
+    {
+        node_summary_t *n = &sum[k];
+
+        if (n->rows == 0)
+        {
+            continue;
+        }
+        printf("%-4s %9lu %11.3f %11.2f %11.2f %5.1f %%\n", node_name(k, name), n->rows,
+               n->distance_sum / n->rows, n->delay_sum / n->rows, n->peak_db_sum / n->rows, 100.0 * n->nlos / n->rows);
+    }
+    munmap(f.base, f.size);
+    close(f.fd);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static store_ctx_t ctx;
+    int c;
+
+    if (argc == 3 && strcmp(argv[1], "-a") == 0)
+    {
+        return analyse(argv[2]);
+    }
+    ctx.capacity = 1024;
+    for (c = 1; c < argc && argv[c][0] == '-'; c++)
+    {
+        if (strcmp(argv[c], "-n") == 0 && c + 1 < argc)
+        {
+            ctx.capacity = strtoull(argv[++c], NULL, 0);
+            ctx.capacity = (ctx.capacity != 0) ? ctx.capacity : 1;
+        }
+    }
+    if (c + 2 > argc)
+    {
+        fprintf(stderr, "usage: cir_store [-n rows] out.cir stream...\n       cir_store -a file.cir\n");
+        return 1;
+    }
+    ctx.path = argv[c++];
+    for (; c < argc; c++)
+    {
+        if (store_stream(&ctx, argv[c]) != 0)
+        {
+            return 1;
+        }
+    }
+
+    if (ctx.file.base == NULL)
+    {
+        fprintf(stderr, "no complete capture, is the board built with TWR_USE_CIR?\n");
+        return 1;
+    }
+    printf("%lu captures stored, %lu without their range report, %lu incomplete, %lu of another window\n",
+           ctx.rows, ctx.unmatched, ctx.incomplete, ctx.other_window);
+    if (file_close(&ctx.file) != 0)
+    {
+        perror(ctx.path);
+        return 1;
+    }
+    return 0;
+}
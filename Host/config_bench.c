@@ -0,0 +1,264 @@
+/*! ----------------------------------------------------------------------------
+ * @file    config_bench.c
+ * @brief   Cost of switching the DW1000 between two radio configurations
+ *
+ *          Alternates the DW1000 emulator between the 110 kb/s, 1024 symbol
+ *          preamble configuration of the examples and a 6.8 Mb/s, 128 symbol
+ *          one, in three ways:
+ *          - configure: dwt_configure(), which compiles and applies every time
+ *          - apply:     dwt_applyconfig() of images compiled beforehand
+ *          - switch:    dwt_switchconfig() from the current image to the other
+ *          It prints the SPI transactions and bytes, the on-board time (from
+ *          the emulated 8 MHz SPI clock) and the host time per switch, and checks
+ *          that the three leave the same register contents. Build with
+ *          DWM_SPI_STATS, see Host/README.md.
+ *
+ *          With -c it prints the two compiled images as C initialisers
+ *          instead, to be stored as const data on the board.
+ *
+ *          usage: config_bench [switches] | config_bench -c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "deca_device_api.h"
+#include "deca_regs.h"
+#include "DWM_functions.h"
+#include "dw1000_emu.h"
+#include "host_port.h"
+
+#ifndef DWM_SPI_STATS
+#error "config_bench needs the SPI counters, build with -DDWM_SPI_STATS"
+#endif
+
+/* Same settings as Examples/DS_TWR_Compete/ds_initiator.c */
+static dwt_config_t config_110k = {
+    2,               /* Channel number. */
+    DWT_PRF_64M,     /* Pulse repetition frequency. */
+    DWT_PLEN_1024,   /* Preamble length. Used in TX only. */
+    DWT_PAC32,       /* Preamble acquisition chunk size. Used in RX only. */
+    9,               /* TX preamble code. Used in TX only. */
+    9,               /* RX preamble code. Used in RX only. */
+    1,               /* 0 to use standard SFD, 1 to use non-standard SFD. */
+    DWT_BR_110K,     /* Data rate. */
+    DWT_PHRMODE_STD, /* PHY header mode. */
+    (1025 + 64 - 32) /* SFD timeout (preamble length + 1 + SFD length - PAC size). Used in RX only. */
+};
+
+/* Short range, short frames: same channel and codes */
+static dwt_config_t config_6m8 = {
+    2,               /* Channel number. */
+    DWT_PRF_64M,     /* Pulse repetition frequency. */
+    DWT_PLEN_128,    /* Preamble length. Used in TX only. */
+    DWT_PAC8,        /* Preamble acquisition chunk size. Used in RX only. */
+    9,               /* TX preamble code. Used in TX only. */
+    9,               /* RX preamble code. Used in RX only. */
+    0,               /* 0 to use standard SFD, 1 to use non-standard SFD. */
+    DWT_BR_6M8,      /* Data rate. */
+    DWT_PHRMODE_STD, /* PHY header mode. */
+    (129 + 8 - 8)    /* SFD timeout (preamble length + 1 + SFD length - PAC size). Used in RX only. */
+};
+
+typedef enum { BY_CONFIGURE, BY_APPLY, BY_SWITCH } method_t;
+
+static const char *method_name[] = { "configure", "apply", "switch" };
+
+typedef struct
+{
+    dwm_spi_stats_t spi;
+    uint64_t        device_dtu;
+    double          wall_s;
+} switch_cost_t;
+
+/* The register ranges dwt_configure() writes, as file, offset, length */
+static const uint16 config_regs[][3] = {
+    { SYS_CFG_ID,     0,                 4 },
+    { LDE_IF_ID,      LDE_CFG1_OFFSET,   1 },
+    { LDE_IF_ID,      LDE_CFG2_OFFSET,   2 },
+    { LDE_IF_ID,      LDE_REPC_OFFSET,   2 },
+    { FS_CTRL_ID,     FS_PLLCFG_OFFSET,  5 },
+    { RF_CONF_ID,     RF_RXCTRLH_OFFSET, 5 },
+    { DRX_CONF_ID,    0,                 0x28 },
+    { AGC_CFG_STS_ID, 0,                 0x10 },
+    { USR_SFD_ID,     0,                 1 },
+    { CHAN_CTRL_ID,   0,                 4 },
+    { TX_FCTRL_ID,    0,                 4 },
+};
+
+#define NUM_CONFIG_REGS     (sizeof(config_regs) / sizeof(config_regs[0]))
+#define CONFIG_SNAPSHOT_LEN 128
+
+static dw1000_emu_t *emu;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Copies the configuration registers of the emulator to buf, returns the number of bytes */
+static int snapshot(uint8 *buf)
+{
+    int n = 0;
+    size_t i;
+
+    for (i = 0; i < NUM_CONFIG_REGS; i++)
+    {
+        dw1000_emu_peek(emu, config_regs[i][0], config_regs[i][1], config_regs[i][2], &buf[n]);
+        n += config_regs[i][2];
+    }
+    return n;
+}
+
+static void print_image(const char *name, const dwt_regimage_t *image)
+{
+    int i;
+
+    printf("/* %d SPI transactions */\n", image->numPatches + 2);
+    printf("static const dwt_regimage_t %s = {\n", name);
+    printf("    0x%08lX, 0x%08lX, %u, %u, %u,\n", (unsigned long)image->sysCFG, (unsigned long)image->txFCTRL,
+           image->longFrames, image->numPatches, image->numBytes);
+    printf("    {\n");
+    for (i = 0; i < image->numPatches; i++)
+    {
+        printf("        { 0x%02X, %2u, 0x%04X, %2u },\n", image->patch[i].regFileID, image->patch[i].len,
+               image->patch[i].offset, image->patch[i].pos);
+    }
+    printf("    },\n    {");
+    for (i = 0; i < image->numBytes; i++)
+    {
+        printf("%s0x%02X,", (i % 12) ? " " : "\n        ", image->data[i]);
+    }
+    printf("\n    }\n};\n\n");
+}
+
+/* Switches between the two configurations the given way, starting from and ending on the 110 kb/s one */
+static void measure(method_t method, int switches, const dwt_regimage_t images[2], switch_cost_t *cost)
+{
+    dwt_config_t *configs[2] = { &config_110k, &config_6m8 };
+    uint64_t t0;
+    double w0;
+    int i, to;
+
+    dwt_configure(&config_110k);
+
+    dwm_spi_stats_reset();
+    t0 = dw1000_emu_time(emu);
+    w0 = now();
+    for (i = 0; i < switches; i++)
+    {
+        to = (i + 1) % 2;
+        switch (method)
+        {
+        case BY_CONFIGURE:
+            dwt_configure(configs[to]);
+            break;
+        case BY_APPLY:
+            dwt_applyconfig(&images[to]);
+            break;
+        case BY_SWITCH:
+            dwt_switchconfig(&images[1 - to], &images[to]);
+            break;
+        }
+    }
+    cost->wall_s = now() - w0;
+    cost->device_dtu = dw1000_emu_time(emu) - t0;
+    dwm_spi_stats_get(&cost->spi);
+}
+
+static void print_cost(const char *name, const switch_cost_t *c, int switches)
+{
+    printf("%-10s %8.1f %10.1f %10.1f %12.2f %10.3f\n", name,
+           (double)c->spi.transactions / switches,
+           (double)c->spi.header_bytes / switches,
+           (double)c->spi.tx_bytes / switches,
+           c->device_dtu / (double)switches / (1e-6 / DWT_TIME_UNITS),
+           c->wall_s / switches * 1e6);
+}
+
+int main(int argc, char **argv)
+{
+    uint8 reference[2][CONFIG_SNAPSHOT_LEN], regs[CONFIG_SNAPSHOT_LEN];
+    dwt_regimage_t images[2];
+    switch_cost_t cost[3];
+    int switches, len, m, failed = 0;
+
+    if (dwt_compileconfig(&config_110k, &images[0]) != DWT_SUCCESS ||
+        dwt_compileconfig(&config_6m8, &images[1]) != DWT_SUCCESS)
+    {
+        fprintf(stderr, "dwt_compileconfig() failed\n");
+        return 1;
+    }
+    if (argc > 1 && strcmp(argv[1], "-c") == 0)
+    {
+        print_image("config_110k_image", &images[0]);
+        print_image("config_6m8_image", &images[1]);
+        return 0;
+    }
+
+    /* An even count ends every run on the 110 kb/s configuration */
+    switches = (argc > 1) ? atoi(argv[1]) : 100000;
+    switches += switches % 2;
+    if (switches <= 0)
+    {
+        fprintf(stderr, "usage: config_bench [switches] | config_bench -c\n");
+        return 1;
+    }
+
+    emu = dw1000_emu_create();
+    host_port_attach(emu);
+    if (dwt_initialise(DWT_LOADUCODE) == DWT_ERROR)
+    {
+        fprintf(stderr, "dwt_initialise() failed\n");
+        return 1;
+    }
+    port_set_dw1000_fastrate();
+
+    /* What dwt_configure() leaves in each configuration, coming from the other one */
+    dwt_configure(&config_110k);
+    dwt_configure(&config_6m8);
+    snapshot(reference[1]);
+    dwt_configure(&config_110k);
+    len = snapshot(reference[0]);
+
+    for (m = BY_CONFIGURE; m <= BY_SWITCH; m++)
+    {
+        measure((method_t)m, switches, images, &cost[m]);
+        snapshot(regs);
+        if (memcmp(regs, reference[0], len) != 0)
+        {
+            printf("%s: registers differ from dwt_configure()\n", method_name[m]);
+            failed = 1;
+        }
+        /* One more switch, to check the other configuration as well */
+        if (m == BY_SWITCH)
+        {
+            dwt_switchconfig(&images[0], &images[1]);
+        }
+        else
+        {
+            dwt_applyconfig(&images[1]);
+        }
+        snapshot(regs);
+        if (memcmp(regs, reference[1], len) != 0)
+        {
+            printf("%s: 6.8 Mb/s registers differ from dwt_configure()\n", method_name[m]);
+            failed = 1;
+        }
+    }
+
+    printf("per switch  spi xfers  hdr bytes   tx bytes  on-board us    host us\n");
+    for (m = BY_CONFIGURE; m <= BY_SWITCH; m++)
+    {
+        print_cost(method_name[m], &cost[m], switches);
+    }
+
+    host_port_attach(NULL);
+    dw1000_emu_destroy(emu);
+    return failed;
+}
@@ -0,0 +1,1393 @@
+/*! ----------------------------------------------------------------------------
+ * @file    dw1000_emu.c
+ * @brief   Host side emulation of the DW1000 register file
+ *
+ *          See dw1000_emu.h for what is modelled. Register files are plain
+ *          memory; the few that have side effects (SYS_CTRL, SYS_STATUS,
+ *          PMSC soft reset, SYS_TIME) are handled on access, and the radio is a
+ *          small event machine driven by the device time.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deca_types.h"
+#include "deca_regs.h"
+#include "deca_device_api.h"
+#include "deca_param_types.h"
+#include "dw1000_emu.h"
+
+#define MASK40                  (0xFFFFFFFFFFULL)
+#define HALF_PERIOD             (0x8000000000ULL)
+#define DX_TIME_RESOLUTION_MASK (~0x1FFULL)     // DX_TIME ignores the low 9 bits
+
+#define REG_FILES               (64)
+#define REG_FILE_SPAN           (64)            // ordinary register files are at most 58 bytes
+#define LDE_IF_SPAN             (LDE_REPC_OFFSET + 2)
+#define MAX_INCOMING            (8)
+
+#define TXPUTE_BIT              (SYS_STATUS_TXPUTE)
+
+/* Symbol and bit durations in device time units */
+#define PRE_SYM_PRF16           (496ULL * 128)  // 993.59 ns
+#define PRE_SYM_PRF64           (508ULL * 128)  // 1017.63 ns
+#define BIT_110K                (4096ULL * 128) // 8205.13 ns
+#define BIT_850K                (512ULL * 128)  // 1025.64 ns
+#define BIT_6M8                 (64ULL * 128)   // 128.21 ns
+
+#define PHR_BITS                (21)
+#define RS_BLOCK_BITS           (330)
+#define RS_PARITY_BITS          (48)
+
+/* RX power estimation constants of the DW1000 user manual (section 4.7) */
+#define RX_POWER_A_PRF16        (113.77)
+#define RX_POWER_A_PRF64        (121.74)
+
+#define ACC_FP_INDEX            (745)           // first path of every frame in the accumulator
+#define ACC_DECAY               (8.0)           // reflections: amplitude falls by e every this many samples
+#define ACC_TAPS                (96)            // reflections after the first path
+
+enum
+{
+    ST_IDLE = 0,
+    ST_TX,
+    ST_RX
+};
+
+typedef struct
+{
+    uint8   finfo[RX_FINFO_LEN];
+    uint8   buffer[RX_BUFFER_LEN];
+    uint8   fqual[RX_FQUAL_LEN];
+    uint8   ttcki[RX_TTCKI_LEN];
+    uint8   ttcko[RX_TTCKO_LEN];
+    uint8   time[RX_TIME_LLEN];
+} rx_set_t;
+
+typedef struct
+{
+    dw1000_emu_frame_t  f;
+    uint8               data[DW1000_EMU_MAX_FRAME];
+    uint8               used;
+    uint8               seen;       // already considered by the receiver
+} incoming_t;
+
+struct dw1000_emu
+{
+    uint8               regs[REG_FILES][REG_FILE_SPAN];
+    uint8               tx_buffer[TX_BUFFER_LEN];
+    rx_set_t            rx[2];
+    uint8               acc_mem[ACC_MEM_LEN + 1];
+    uint8               lde_if[LDE_IF_SPAN];
+    int                 host_set;   // RX buffer set visible to the host (HSRBP)
+    int                 ic_set;     // RX buffer set the IC fills next (ICRBP)
+    int                 held;       // double buffering: good frames not yet released with HRBT, 0 to 2
+
+    uint64_t            now;
+    uint32              spi_hz;
+
+    int                 state;
+
+    /* transmitter */
+    dw1000_emu_frame_t  tx;
+    uint8               tx_data[DW1000_EMU_MAX_FRAME];
+    uint8               tx_announced;
+    uint8               wait4resp;
+
+    /* receiver */
+    uint64_t            rx_on;      // receiver listening from this time
+    uint64_t            pto_deadline;
+    uint64_t            fwto_deadline;
+    int                 locked;     // index in incoming[] being received, or -1
+    uint64_t            locked_pacc;
+    incoming_t          incoming[MAX_INCOMING];
+
+    /* busy wait detection, see dw1000_emu_idle_polls() */
+    uint32              idle_polls;
+    uint32              last_poll_index;
+    uint32              last_poll_len;
+    uint64_t            last_poll_value;
+    uint32              pending_polls;  // idle_polls if the transaction in progress repeats that read
+
+    /* accumulator of the last frame, built by rx_cir() when first read */
+    uint8               acc_stale;
+    uint8               acc_prf;
+    double              acc_fp;
+    double              acc_energy;
+    uint32              rng;        // accumulator noise and phases
+
+    int                 irq_level;
+    dw1000_emu_hooks_t  hooks;
+    dw1000_emu_stats_t  stats;
+    deca_spi_backend_t  backend;
+};
+
+static void emu_run(dw1000_emu_t *e, uint64_t until);
+
+/****************************************************************************************************************************************************
+ *
+ * Register helpers
+ *
+ ****************************************************************************************************************************************************/
+
+static uint8 *reg_base(dw1000_emu_t *e, uint16 id, uint32 *span)
+{
+    rx_set_t *hs = &e->rx[e->host_set];
+
+    switch (id)
+    {
+    case TX_BUFFER_ID:  *span = TX_BUFFER_LEN;      return e->tx_buffer;
+    case RX_FINFO_ID:   *span = RX_FINFO_LEN;       return hs->finfo;
+    case RX_BUFFER_ID:  *span = RX_BUFFER_LEN;      return hs->buffer;
+    case RX_FQUAL_ID:   *span = RX_FQUAL_LEN;       return hs->fqual;
+    case RX_TTCKI_ID:   *span = RX_TTCKI_LEN;       return hs->ttcki;
+    case RX_TTCKO_ID:   *span = RX_TTCKO_LEN;       return hs->ttcko;
+    case RX_TIME_ID:    *span = RX_TIME_LLEN;       return hs->time;
+    case ACC_MEM_ID:    *span = sizeof(e->acc_mem); return e->acc_mem;
+    case LDE_IF_ID:     *span = LDE_IF_SPAN;        return e->lde_if;
+    default:            *span = REG_FILE_SPAN;      return e->regs[id & 0x3F];
+    }
+}
+
+static void reg_read(dw1000_emu_t *e, uint16 id, uint32 index, uint32 len, uint8 *out)
+{
+    uint32 span;
+    uint8 *base = reg_base(e, id, &span);
+    uint32 i;
+
+    for (i = 0; i < len; i++)
+    {
+        out[i] = (index + i < span) ? base[index + i] : 0;
+    }
+}
+
+static void reg_write(dw1000_emu_t *e, uint16 id, uint32 index, uint32 len, const uint8 *in)
+{
+    uint32 span;
+    uint8 *base = reg_base(e, id, &span);
+    uint32 i;
+
+    for (i = 0; i < len && index + i < span; i++)
+    {
+        base[index + i] = in[i];
+    }
+}
+
+static uint64_t get_le(const uint8 *p, int n)
+{
+    uint64_t v = 0;
+
+    while (n-- > 0)
+    {
+        v = (v << 8) | p[n];
+    }
+    return v;
+}
+
+static void put_le(uint8 *p, uint64_t v, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        p[i] = (uint8)v;
+        v >>= 8;
+    }
+}
+
+static uint32 reg32(dw1000_emu_t *e, uint16 id, uint16 index)
+{
+    uint8 b[4];
+
+    reg_read(e, id, index, 4, b);
+    return (uint32)get_le(b, 4);
+}
+
+static uint16 reg16(dw1000_emu_t *e, uint16 id, uint16 index)
+{
+    uint8 b[2];
+
+    reg_read(e, id, index, 2, b);
+    return (uint16)get_le(b, 2);
+}
+
+static uint64_t status_get(dw1000_emu_t *e)
+{
+    return get_le(e->regs[SYS_STATUS_ID], SYS_STATUS_LEN);
+}
+
+static void status_put(dw1000_emu_t *e, uint64_t status)
+{
+    uint32 mask = (uint32)get_le(e->regs[SYS_MASK_ID], SYS_MASK_LEN);
+    int level;
+
+    status &= ~(uint64_t)SYS_STATUS_IRQS;
+    level = ((status & mask) != 0);
+    if (level)
+    {
+        status |= SYS_STATUS_IRQS;
+    }
+    put_le(e->regs[SYS_STATUS_ID], status, SYS_STATUS_LEN);
+
+    if (level != e->irq_level)
+    {
+        e->irq_level = level;
+        if (e->hooks.irq != NULL)
+        {
+            e->hooks.irq(e->hooks.ctx, e, level);
+        }
+    }
+}
+
+static void status_set(dw1000_emu_t *e, uint64_t bits)
+{
+    status_put(e, status_get(e) | bits);
+}
+
+static void evc_inc(dw1000_emu_t *e, uint16 offset)
+{
+    uint8 *p = &e->regs[DIG_DIAG_ID][offset];
+    uint16 v;
+
+    if ((e->regs[DIG_DIAG_ID][EVC_CTRL_OFFSET] & EVC_EN) == 0)
+    {
+        return;
+    }
+    v = (uint16)((get_le(p, 2) + 1) & 0x0FFF);
+    put_le(p, v, 2);
+}
+
+/****************************************************************************************************************************************************
+ *
+ * Frame timing
+ *
+ ****************************************************************************************************************************************************/
+
+static uint16 plen_symbols(uint32 psr_pe)
+{
+    switch (psr_pe)
+    {
+    case DWT_PLEN_64:   return 64;
+    case DWT_PLEN_128:  return 128;
+    case DWT_PLEN_256:  return 256;
+    case DWT_PLEN_512:  return 512;
+    case DWT_PLEN_1024: return 1024;
+    case DWT_PLEN_1536: return 1536;
+    case DWT_PLEN_2048: return 2048;
+    default:            return 4096;
+    }
+}
+
+static uint32 finfo_plen(uint16 plen)
+{
+    switch (plen)
+    {
+    case 64:    return RX_FINFO_RXPEL_64;
+    case 128:   return RX_FINFO_RXPEL_128;
+    case 256:   return RX_FINFO_RXPEL_256;
+    case 512:   return RX_FINFO_RXPEL_512;
+    case 1024:  return RX_FINFO_RXPEL_1024;
+    case 1536:  return RX_FINFO_RXPEL_1536;
+    case 2048:  return RX_FINFO_RXPEL_2048;
+    default:    return RX_FINFO_RXPEL_4096;
+    }
+}
+
+static uint64_t symbol_dtu(uint8 prf)
+{
+    return (prf == DWT_PRF_64M) ? PRE_SYM_PRF64 : PRE_SYM_PRF16;
+}
+
+static uint64_t bit_dtu(uint8 dataRate)
+{
+    return (dataRate == DWT_BR_110K) ? BIT_110K : (dataRate == DWT_BR_850K) ? BIT_850K : BIT_6M8;
+}
+
+static uint16 sfd_symbols(dw1000_emu_t *e, uint8 dataRate)
+{
+    uint32 chan_ctrl = (uint32)get_le(e->regs[CHAN_CTRL_ID], CHAN_CTRL_LEN);
+
+    if (chan_ctrl & CHAN_CTRL_DWSFD)
+    {
+        return e->regs[USR_SFD_ID][0];
+    }
+    return (dataRate == DWT_BR_110K) ? 64 : 8;
+}
+
+static void durations(dw1000_emu_t *e, uint8 prf, uint8 dataRate, uint16 plen, uint16 length,
+                      uint64_t *shr, uint64_t *payload)
+{
+    uint32 bits = (uint32)length * 8;
+    uint32 blocks = (bits + RS_BLOCK_BITS - 1) / RS_BLOCK_BITS;
+    uint64_t phr_bit = (dataRate == DWT_BR_110K) ? BIT_110K : BIT_850K;
+
+    *shr = (uint64_t)(plen + sfd_symbols(e, dataRate)) * symbol_dtu(prf);
+    *payload = PHR_BITS * phr_bit + (uint64_t)(bits + blocks * RS_PARITY_BITS) * bit_dtu(dataRate);
+}
+
+static void tx_frame_config(dw1000_emu_t *e, uint8 *prf, uint8 *dataRate, uint16 *plen)
+{
+    uint32 fctrl = (uint32)get_le(e->regs[TX_FCTRL_ID], 4);
+
+    *prf = (uint8)((fctrl & TX_FCTRL_TXPRF_MASK) >> TX_FCTRL_TXPRF_SHFT);
+    *dataRate = (uint8)((fctrl & TX_FCTRL_TXBR_MASK) >> TX_FCTRL_TXBR_SHFT);
+    *plen = plen_symbols((fctrl & TX_FCTRL_TXPSR_PE_MASK) >> TX_FCTRL_TXPRF_SHFT);
+}
+
+void dw1000_emu_frame_durations(const dw1000_emu_t *emu, uint16 length, uint64_t *shr, uint64_t *payload)
+{
+    dw1000_emu_t *e = (dw1000_emu_t *)emu;
+    uint8 prf, br;
+    uint16 plen;
+
+    tx_frame_config(e, &prf, &br, &plen);
+    durations(e, prf, br, plen, length, shr, payload);
+}
+
+/* PAC size from the DRX_TUNE2 value programmed by dwt_configure() */
+static uint16 rx_pac(dw1000_emu_t *e)
+{
+    static const uint16 pac_size[NUM_PACS] = { 8, 16, 32, 64 };
+    uint32 tune2 = (uint32)get_le(&e->regs[DRX_CONF_ID][DRX_TUNE2_OFFSET], 4);
+    int prf, pac;
+
+    for (prf = 0; prf < NUM_PRF; prf++)
+    {
+        for (pac = 0; pac < NUM_PACS; pac++)
+        {
+            if (digital_bb_config[prf][pac] == tune2)
+            {
+                return pac_size[pac];
+            }
+        }
+    }
+    return 8;
+}
+
+static uint8 rx_prf(dw1000_emu_t *e)
+{
+    uint32 chan_ctrl = (uint32)get_le(e->regs[CHAN_CTRL_ID], CHAN_CTRL_LEN);
+
+    return (uint8)((chan_ctrl & CHAN_CTRL_RXFPRF_MASK) >> CHAN_CTRL_RXFPRF_SHIFT);
+}
+
+/* xorshift32, uniform in [0, 1) */
+static double rng_uniform(dw1000_emu_t *e)
+{
+    e->rng ^= e->rng << 13;
+    e->rng ^= e->rng >> 17;
+    e->rng ^= e->rng << 5;
+    return (e->rng >> 8) / 16777216.0;
+}
+
+/* Roughly Gaussian, mean 0 and standard deviation 1 */
+static double rng_gauss(dw1000_emu_t *e)
+{
+    double sum = 0.0;
+    int i;
+
+    for (i = 0; i < 12; i++)
+    {
+        sum += rng_uniform(e);
+    }
+    return sum - 6.0;
+}
+
+static void acc_put(dw1000_emu_t *e, int index, double re, double im)
+{
+    uint8 *p = &e->acc_mem[4 * index];
+
+    re = (re > 32767.0) ? 32767.0 : (re < -32768.0) ? -32768.0 : re;
+    im = (im > 32767.0) ? 32767.0 : (im < -32768.0) ? -32768.0 : im;
+    put_le(p, (uint16)(int16)lround(re), 2);
+    put_le(p + 2, (uint16)(int16)lround(im), 2);
+}
+
+/* Channel impulse response of the last frame received, built on the first accumulator read after it, as most are never
+ * read: noise of std_noise, the first path at ACC_FP_INDEX with amplitude acc_fp over three samples (FP_AMPL1..3), then
+ * reflections decaying exponentially that carry the rest of the power, energy being (F1^2 + F2^2 + F3^2) for the first
+ * path and CIR_PWR * 2^17 (acc_energy) in all. A weak first path (NLOS) leaves the peak behind it. Samples saturate at
+ * 16 bits. */
+static void rx_cir(dw1000_emu_t *e, double std_noise)
+{
+    int len = (e->acc_prf == DWT_PRF_64M) ? 1016 : 992;
+    double fp = e->acc_fp;
+    double r = exp(-2.0 / ACC_DECAY);
+    double rest = e->acc_energy - 3.0 * fp * fp;
+    double m = (rest > 0.0) ? sqrt(rest * (1.0 - r) / r) : 0.0;
+    double a, phase;
+    int i, k;
+
+    for (i = 0; i < len; i++)
+    {
+        a = 0.0;
+        if (i > ACC_FP_INDEX && i <= ACC_FP_INDEX + 3)
+        {
+            a = fp;
+        }
+        else if (i == ACC_FP_INDEX)
+        {
+            a = 0.3 * fp;
+        }
+        else if (i > ACC_FP_INDEX + 3 && (k = i - ACC_FP_INDEX - 3) <= ACC_TAPS)
+        {
+            a = m * exp(-k / ACC_DECAY) * (1.0 + 0.3 * rng_gauss(e));
+        }
+        phase = 2.0 * M_PI * rng_uniform(e);
+        acc_put(e, i, a * cos(phase) + std_noise * rng_gauss(e), a * sin(phase) + std_noise * rng_gauss(e));
+    }
+}
+
+/* 802.15.4 FCS: CRC-16 ITU-T, reflected, zero initial value */
+static uint16 fcs16(const uint8 *data, uint32 len)
+{
+    uint16 crc = 0;
+    uint32 i;
+    int b;
+
+    for (i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for (b = 0; b < 8; b++)
+        {
+            crc = (crc & 1) ? (uint16)((crc >> 1) ^ 0x8408) : (uint16)(crc >> 1);
+        }
+    }
+    return crc;
+}
+
+/****************************************************************************************************************************************************
+ *
+ * Radio
+ *
+ ****************************************************************************************************************************************************/
+
+static void rx_stop(dw1000_emu_t *e)
+{
+    e->state = ST_IDLE;
+    e->locked = -1;
+    e->pto_deadline = DW1000_EMU_NO_EVENT;
+    e->fwto_deadline = DW1000_EMU_NO_EVENT;
+}
+
+static void trx_off(dw1000_emu_t *e)
+{
+    rx_stop(e);
+    e->wait4resp = 0;
+    e->tx_announced = 1;
+}
+
+/* Receiver on from time t, with the frame wait and preamble detection timeouts counted from there */
+static void rx_start_at(dw1000_emu_t *e, uint64_t t)
+{
+    uint32 sys_cfg = (uint32)get_le(e->regs[SYS_CFG_ID], SYS_CFG_LEN);
+    uint16 fwto = reg16(e, RX_FWTO_ID, RX_FWTO_OFFSET);
+    uint16 pretoc = reg16(e, DRX_CONF_ID, DRX_PRETOC_OFFSET);
+    int i;
+
+    e->state = ST_RX;
+    e->rx_on = t;
+    e->locked = -1;
+    e->fwto_deadline = DW1000_EMU_NO_EVENT;
+    e->pto_deadline = DW1000_EMU_NO_EVENT;
+
+    if ((sys_cfg & SYS_CFG_RXWTOE) && fwto != 0)
+    {
+        e->fwto_deadline = t + (uint64_t)fwto * DW1000_EMU_DTU_PER_UUS;
+    }
+    if (pretoc != 0)
+    {
+        e->pto_deadline = t + (uint64_t)pretoc * rx_pac(e) * symbol_dtu(rx_prf(e));
+    }
+
+    for (i = 0; i < MAX_INCOMING; i++)
+    {
+        e->incoming[i].seen = 0;
+    }
+}
+
+static void tx_start(dw1000_emu_t *e, int delayed, int wait4resp)
+{
+    uint32 fctrl = (uint32)get_le(e->regs[TX_FCTRL_ID], 4);
+    uint16 length = (uint16)(fctrl & TX_FCTRL_FLE_MASK);
+    uint16 offset = (uint16)((fctrl & TX_FCTRL_TXBOFFS_MASK) >> TX_FCTRL_TXBOFFS_SHFT);
+    uint64_t shr, payload;
+    uint16 fcs;
+
+    if (length < 2 || offset + length - 2 > TX_BUFFER_LEN)
+    {
+        status_set(e, SYS_STATUS_TXBERR);
+        return;
+    }
+
+    rx_stop(e);     // a TX request aborts a reception in progress
+
+    memset(&e->tx, 0, sizeof(e->tx));
+    tx_frame_config(e, &e->tx.prf, &e->tx.dataRate, &e->tx.preambleLength);
+    e->tx.ranging = (fctrl & TX_FCTRL_TR) ? 1 : 0;
+    e->tx.length = length;
+    e->tx.data = e->tx_data;
+    memcpy(e->tx_data, &e->tx_buffer[offset], length - 2);
+    fcs = fcs16(e->tx_data, length - 2);
+    e->tx_data[length - 2] = (uint8)fcs;
+    e->tx_data[length - 1] = (uint8)(fcs >> 8);
+
+    durations(e, e->tx.prf, e->tx.dataRate, e->tx.preambleLength, length, &shr, &payload);
+
+    if (delayed)
+    {
+        uint64_t dx = get_le(e->regs[DX_TIME_ID], DX_TIME_LEN) & DX_TIME_RESOLUTION_MASK;
+        uint64_t diff = (dx - (e->now & MASK40)) & MASK40;
+
+        e->tx.rmarker = e->now + diff;
+        if (diff > HALF_PERIOD)
+        {
+            // Already in the past: the chip would wait for the counter to wrap
+            status_set(e, SYS_STATUS_HPDWARN);
+            e->stats.late_delayed++;
+            evc_inc(e, EVC_HPW_OFFSET);
+        }
+        else if (diff < shr)
+        {
+            // Not enough time left to send the preamble: TX power-up error, sent late
+            status_set(e, TXPUTE_BIT);
+            e->stats.late_delayed++;
+            evc_inc(e, EVC_TPW_OFFSET);
+            e->tx.rmarker = e->now + shr;
+        }
+        e->tx.start = e->tx.rmarker - shr;
+    }
+    else
+    {
+        e->tx.start = e->now;
+        e->tx.rmarker = e->tx.start + shr;
+    }
+    e->tx.end = e->tx.rmarker + payload;
+
+    e->state = ST_TX;
+    e->tx_announced = 0;
+    e->wait4resp = (uint8)wait4resp;
+}
+
+static void tx_done(dw1000_emu_t *e)
+{
+    uint16 antd = reg16(e, TX_ANTD_ID, 0);
+    uint8 *tt = e->regs[TX_TIME_ID];
+
+    put_le(&tt[TX_TIME_TX_STAMP_OFFSET], (e->tx.rmarker + antd) & MASK40, 5);
+    put_le(&tt[TX_TIME_TX_RAWST_OFFSET], e->tx.rmarker & MASK40, 5);
+
+    e->stats.tx_frames++;
+    evc_inc(e, EVC_TXFS_OFFSET);
+    status_set(e, SYS_STATUS_TXPRS | SYS_STATUS_TXPHS | SYS_STATUS_TXFRS);
+
+    e->state = ST_IDLE;
+    if (e->wait4resp)
+    {
+        uint32 w4r = reg32(e, ACK_RESP_T_ID, ACK_RESP_T_W4R_TIM_OFFSET) & ACK_RESP_T_W4R_TIM_MASK;
+
+        e->wait4resp = 0;
+        rx_start_at(e, e->tx.end + (uint64_t)w4r * DW1000_EMU_DTU_PER_UUS);
+    }
+}
+
+/* Double RX buffering, SYS_CFG DIS_DRXB clear */
+static int rx_double_buffered(dw1000_emu_t *e)
+{
+    return ((uint32)get_le(e->regs[SYS_CFG_ID], SYS_CFG_LEN) & SYS_CFG_DIS_DRXB) == 0;
+}
+
+/* Fill the RX buffer set and diagnostics for a completed frame. With double buffering a good frame moves the IC to the
+ * other set, and a frame that completes while the host still holds both sets is lost (RXOVRR). */
+static void rx_done(dw1000_emu_t *e, incoming_t *in)
+{
+    const dw1000_emu_frame_t *f = &in->f;
+    rx_set_t *rs = &e->rx[e->ic_set];
+    uint16 antd = (uint16)get_le(&e->lde_if[LDE_RXANTD_OFFSET], 2);
+    uint32 chan = (uint32)get_le(e->regs[CHAN_CTRL_ID], CHAN_CTRL_LEN) & CHAN_CTRL_TX_CHAN_MASK;
+    double a = (f->prf == DWT_PRF_64M) ? RX_POWER_A_PRF64 : RX_POWER_A_PRF16;
+    double n = (double)e->locked_pacc;
+    double cir, fp, hz_to_ppm, ci;
+    uint32 finfo, ttcki;
+    int good = !f->corrupt && fcs16(in->data, f->length - 2) == (uint16)get_le(&in->data[f->length - 2], 2);
+    int dbl = rx_double_buffered(e);
+
+    if (dbl && e->held == 2)
+    {
+        rx_stop(e);
+        e->stats.rx_overruns++;
+        evc_inc(e, EVC_OVR_OFFSET);
+        status_set(e, SYS_STATUS_RXOVRR);
+        return;
+    }
+
+    memcpy(rs->buffer, in->data, f->length);
+
+    finfo = (f->length & RX_FINFO_RXFL_MASK_1023)
+          | ((uint32)f->dataRate << RX_FINFO_RXBR_SHIFT)
+          | ((uint32)f->ranging << RX_FINFO_RNG_SHIFT)
+          | ((uint32)f->prf << RX_FINFO_RXPRF_SHIFT)
+          | finfo_plen(f->preambleLength)
+          | ((uint32)e->locked_pacc << RX_FINFO_RXPACC_SHIFT);
+    put_le(rs->finfo, finfo, RX_FINFO_LEN);
+
+    put_le(&rs->time[RX_TIME_RX_STAMP_OFFSET], (f->rmarker - antd) & MASK40, 5);
+    put_le(&rs->time[RX_TIME_FP_INDEX_OFFSET], ACC_FP_INDEX << 6, 2);
+    put_le(&rs->time[RX_TIME_FP_RAWST_OFFSET], f->rmarker & MASK40, 5);
+
+    // RX power = 10 log10(C * 2^17 / N^2) - A, first path = 10 log10((F1^2 + F2^2 + F3^2) / N^2) - A
+    cir = pow(10.0, (f->rxPower + a) / 10.0) * n * n / 131072.0;
+    fp = sqrt(pow(10.0, (f->fpPower + a) / 10.0) * n * n / 3.0);
+    e->acc_stale = 1;
+    e->acc_prf = f->prf;
+    e->acc_fp = fp;
+    e->acc_energy = cir * 131072.0;
+    cir = (cir > 65535.0) ? 65535.0 : cir;
+    fp = (fp > 65535.0) ? 65535.0 : fp;
+    put_le(&rs->time[RX_TIME_FP_AMPL1_OFFSET], (uint16)fp, 2);
+    put_le(&rs->fqual[0], 40, 2);           // STD_NOISE, that of rx_cir()
+    put_le(&rs->fqual[2], (uint16)fp, 2);   // FP_AMPL2
+    put_le(&rs->fqual[4], (uint16)fp, 2);   // FP_AMPL3
+    put_le(&rs->fqual[6], (uint16)cir, 2);  // CIR_PWR
+    put_le(&e->lde_if[LDE_THRESH_OFFSET], 1200, 2);
+
+    // Carrier integrator and time tracking for the clock offset, see dwt_readcarrierintegrator()
+    switch (chan)
+    {
+    case 1:  hz_to_ppm = HERTZ_TO_PPM_MULTIPLIER_CHAN_1; break;
+    case 3:  hz_to_ppm = HERTZ_TO_PPM_MULTIPLIER_CHAN_3; break;
+    case 5:  hz_to_ppm = HERTZ_TO_PPM_MULTIPLIER_CHAN_5; break;
+    default: hz_to_ppm = HERTZ_TO_PPM_MULTIPLIER_CHAN_2; break;
+    }
+    ci = f->clockOffset / (((f->dataRate == DWT_BR_110K) ? FREQ_OFFSET_MULTIPLIER_110KB : FREQ_OFFSET_MULTIPLIER) * hz_to_ppm / 1.0e6);
+    put_le(&e->regs[DRX_CONF_ID][DRX_CARRIER_INT_OFFSET], (uint32)(int32)lround(ci) & DRX_CARRIER_INT_MASK, DRX_CARRIER_INT_LEN);
+    ttcki = (f->prf == DWT_PRF_64M) ? 0x01FC0000UL : 0x01F00000UL;
+    put_le(rs->ttcki, ttcki, RX_TTCKI_LEN);
+    put_le(rs->ttcko, (uint32)(int32)lround(f->clockOffset * ttcki) & RX_TTCKO_RXTOFS_MASK, RX_TTCKO_LEN);
+
+    rx_stop(e);
+    if (good)
+    {
+        e->stats.rx_good++;
+        evc_inc(e, EVC_FCG_OFFSET);
+        if (dbl)
+        {
+            e->held++;
+            e->ic_set ^= 1;
+            status_put(e, status_get(e) ^ SYS_STATUS_ICRBP);
+        }
+        status_set(e, SYS_STATUS_ALL_RX_GOOD);
+    }
+    else
+    {
+        e->stats.rx_errors++;
+        evc_inc(e, EVC_FCE_OFFSET);
+        status_set(e, SYS_STATUS_RXPRD | SYS_STATUS_RXSFDD | SYS_STATUS_LDEDONE | SYS_STATUS_RXPHD |
+                      SYS_STATUS_RXDFR | SYS_STATUS_RXFCE);
+    }
+}
+
+/* Time at which the receiver would detect the preamble of a frame, or NO_EVENT if it can't */
+static uint64_t acquisition_time(dw1000_emu_t *e, const dw1000_emu_frame_t *f)
+{
+    uint64_t sym = symbol_dtu(f->prf);
+    uint64_t from = (f->start > e->rx_on) ? f->start : e->rx_on;
+    uint64_t acq = from + (uint64_t)rx_pac(e) * sym;
+    uint64_t sfd_start = f->rmarker - (uint64_t)sfd_symbols(e, f->dataRate) * sym;
+    uint32 sys_cfg = (uint32)get_le(e->regs[SYS_CFG_ID], SYS_CFG_LEN);
+    uint8 rx_110k = (sys_cfg & SYS_CFG_RXM110K) ? 1 : 0;
+
+    if (f->prf != rx_prf(e) || rx_110k != (f->dataRate == DWT_BR_110K))
+    {
+        return DW1000_EMU_NO_EVENT;
+    }
+    if (acq >= sfd_start)
+    {
+        return DW1000_EMU_NO_EVENT;
+    }
+    return acq;
+}
+
+static int next_incoming(dw1000_emu_t *e, uint64_t *when)
+{
+    int i, best = -1;
+
+    *when = DW1000_EMU_NO_EVENT;
+    for (i = 0; i < MAX_INCOMING; i++)
+    {
+        incoming_t *in = &e->incoming[i];
+        uint64_t t;
+
+        if (!in->used || in->seen)
+        {
+            continue;
+        }
+        t = acquisition_time(e, &in->f);
+        if (t == DW1000_EMU_NO_EVENT)
+        {
+            t = in->f.end;  // only to retire it
+        }
+        if (t < *when)
+        {
+            *when = t;
+            best = i;
+        }
+    }
+    return best;
+}
+
+uint64_t dw1000_emu_next_event(const dw1000_emu_t *emu)
+{
+    dw1000_emu_t *e = (dw1000_emu_t *)emu;
+    uint64_t next = DW1000_EMU_NO_EVENT;
+    uint64_t t;
+
+    if (e->state == ST_TX)
+    {
+        next = e->tx_announced ? e->tx.end : e->tx.start;
+    }
+    else if (e->state == ST_RX)
+    {
+        if (e->locked >= 0)
+        {
+            next = e->incoming[e->locked].f.end;
+        }
+        else
+        {
+            next_incoming(e, &t);
+            next = t;
+            if (e->pto_deadline < next)
+            {
+                next = e->pto_deadline;
+            }
+        }
+        if (e->fwto_deadline < next)
+        {
+            next = e->fwto_deadline;
+        }
+        if (e->rx_on > e->now && e->rx_on < next)
+        {
+            next = e->rx_on;
+        }
+    }
+    return next;
+}
+
+static void retire_old(dw1000_emu_t *e)
+{
+    int i;
+
+    for (i = 0; i < MAX_INCOMING; i++)
+    {
+        incoming_t *in = &e->incoming[i];
+
+        if (in->used && i != e->locked && in->f.end <= e->now)
+        {
+            if (!in->seen)
+            {
+                e->stats.rx_missed++;
+            }
+            in->used = 0;
+        }
+    }
+}
+
+/* Process every event due up to and including time 'until' */
+static void emu_run(dw1000_emu_t *e, uint64_t until)
+{
+    for (;;)
+    {
+        uint64_t next = dw1000_emu_next_event(e);
+
+        if (next > until)
+        {
+            break;
+        }
+        if (next > e->now)
+        {
+            e->now = next;
+        }
+
+        if (e->state == ST_TX)
+        {
+            if (!e->tx_announced)
+            {
+                e->tx_announced = 1;
+                status_set(e, SYS_STATUS_TXFRB);
+                if (e->hooks.tx_frame != NULL)
+                {
+                    e->hooks.tx_frame(e->hooks.ctx, e, &e->tx);
+                }
+            }
+            else
+            {
+                tx_done(e);
+            }
+        }
+        else if (e->state == ST_RX)
+        {
+            if (e->now >= e->fwto_deadline)
+            {
+                rx_stop(e);
+                e->stats.rx_frame_timeouts++;
+                evc_inc(e, EVC_FWTO_OFFSET);
+                status_set(e, SYS_STATUS_RXRFTO);
+            }
+            else if (e->locked >= 0)
+            {
+                incoming_t *in = &e->incoming[e->locked];
+
+                rx_done(e, in);
+                in->used = 0;
+            }
+            else if (e->now >= e->pto_deadline)
+            {
+                rx_stop(e);
+                e->stats.rx_preamble_timeouts++;
+                evc_inc(e, EVC_PTO_OFFSET);
+                status_set(e, SYS_STATUS_RXPTO);
+            }
+            else if (e->now >= e->rx_on)
+            {
+                uint64_t when;
+                int i = next_incoming(e, &when);
+
+                if (i >= 0 && when <= e->now)
+                {
+                    incoming_t *in = &e->incoming[i];
+                    uint64_t sym = symbol_dtu(in->f.prf);
+                    uint64_t from = (in->f.start > e->rx_on) ? in->f.start : e->rx_on;
+                    uint64_t sfd = (uint64_t)sfd_symbols(e, in->f.dataRate) * sym;
+
+                    in->seen = 1;
+                    if (acquisition_time(e, &in->f) == e->now)
+                    {
+                        e->locked = i;
+                        e->locked_pacc = (in->f.rmarker - sfd - from) / sym;
+                        if (e->locked_pacc > 0xFFF)
+                        {
+                            e->locked_pacc = 0xFFF;
+                        }
+                        e->pto_deadline = DW1000_EMU_NO_EVENT;
+                        status_set(e, SYS_STATUS_RXPRD);
+                    }
+                    else
+                    {
+                        e->stats.rx_missed++;
+                    }
+                }
+            }
+        }
+        retire_old(e);
+    }
+
+    if (until > e->now)
+    {
+        e->now = until;
+    }
+    retire_old(e);
+}
+
+int dw1000_emu_receive(dw1000_emu_t *e, const dw1000_emu_frame_t *frame)
+{
+    int i, j;
+
+    if (frame->length < 2 || frame->length > DW1000_EMU_MAX_FRAME)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < MAX_INCOMING; i++)
+    {
+        if (!e->incoming[i].used)
+        {
+            incoming_t *in = &e->incoming[i];
+
+            in->f = *frame;
+            memcpy(in->data, frame->data, frame->length);
+            in->f.data = in->data;
+            in->used = 1;
+            in->seen = 0;
+
+            // Overlapping frames of comparable power collide
+            for (j = 0; j < MAX_INCOMING; j++)
+            {
+                incoming_t *o = &e->incoming[j];
+
+                if (j != i && o->used && o->f.start < in->f.end && in->f.start < o->f.end &&
+                    fabs(o->f.rxPower - in->f.rxPower) < 10.0)
+                {
+                    o->f.corrupt = 1;
+                    in->f.corrupt = 1;
+                }
+            }
+            return 0;
+        }
+    }
+    e->stats.rx_missed++;
+    return -1;
+}
+
+/****************************************************************************************************************************************************
+ *
+ * Register side effects
+ *
+ ****************************************************************************************************************************************************/
+
+static void emu_defaults(dw1000_emu_t *e)
+{
+    memset(e->regs, 0, sizeof(e->regs));
+    memset(e->tx_buffer, 0, sizeof(e->tx_buffer));
+    memset(e->rx, 0, sizeof(e->rx));
+    memset(e->acc_mem, 0, sizeof(e->acc_mem));
+    e->acc_stale = 0;
+    memset(e->lde_if, 0, sizeof(e->lde_if));
+    memset(e->incoming, 0, sizeof(e->incoming));
+
+    put_le(e->regs[DEV_ID_ID], DWT_DEVICE_ID, DEV_ID_LEN);
+    put_le(e->regs[SYS_CFG_ID], 0x00001200UL, SYS_CFG_LEN);
+    put_le(e->regs[TX_FCTRL_ID], 0x0015400CUL, TX_FCTRL_LEN);
+    put_le(e->regs[CHAN_CTRL_ID], 0x00000055UL, CHAN_CTRL_LEN);
+    put_le(&e->regs[DRX_CONF_ID][DRX_TUNE2_OFFSET], digital_bb_config[0][0], 4);
+    put_le(&e->regs[PMSC_ID][0], 0xF0300200UL, 4);
+    put_le(e->regs[SYS_STATUS_ID], SYS_STATUS_CPLOCK, SYS_STATUS_LEN);
+
+    e->host_set = 0;
+    e->ic_set = 0;
+    e->held = 0;
+    e->state = ST_IDLE;
+    e->wait4resp = 0;
+    e->tx_announced = 1;
+    e->locked = -1;
+    e->pto_deadline = DW1000_EMU_NO_EVENT;
+    e->fwto_deadline = DW1000_EMU_NO_EVENT;
+
+    status_put(e, status_get(e));
+}
+
+static void sys_ctrl_write(dw1000_emu_t *e, uint32 index, uint32 len, const uint8 *in)
+{
+    uint8 b[SYS_CTRL_LEN] = { 0 };
+    uint32 ctrl;
+    uint32 i;
+
+    for (i = 0; i < len && index + i < SYS_CTRL_LEN; i++)
+    {
+        b[index + i] = in[i];
+    }
+    ctrl = (uint32)get_le(b, SYS_CTRL_LEN);
+
+    if (ctrl & SYS_CTRL_TRXOFF)
+    {
+        trx_off(e);     // wins over a simultaneous TXSTRT, see dwt_configure()
+        return;
+    }
+    if (ctrl & SYS_CTRL_HRBT)
+    {
+        uint64_t status = status_get(e) ^ SYS_STATUS_HSRBP;
+
+        e->host_set ^= 1;
+        if (rx_double_buffered(e) && e->held > 0)
+        {
+            // Release the set left. The RX events follow the sets: those of a frame waiting in the new one show again.
+            if (--e->held > 0)
+            {
+                status |= SYS_STATUS_ALL_RX_GOOD;
+            }
+        }
+        status_put(e, status);
+    }
+    if (ctrl & SYS_CTRL_TXSTRT)
+    {
+        tx_start(e, (ctrl & SYS_CTRL_TXDLYS) != 0, (ctrl & SYS_CTRL_WAIT4RESP) != 0);
+    }
+    else if (ctrl & SYS_CTRL_RXENAB)
+    {
+        if (ctrl & SYS_CTRL_RXDLYE)
+        {
+            uint64_t dx = get_le(e->regs[DX_TIME_ID], DX_TIME_LEN) & DX_TIME_RESOLUTION_MASK;
+            uint64_t diff = (dx - (e->now & MASK40)) & MASK40;
+
+            if (diff > HALF_PERIOD)
+            {
+                status_set(e, SYS_STATUS_HPDWARN);
+                e->stats.late_delayed++;
+                evc_inc(e, EVC_HPW_OFFSET);
+            }
+            rx_start_at(e, e->now + diff);
+        }
+        else
+        {
+            rx_start_at(e, e->now);
+        }
+    }
+    // SYS_CTRL bits are self clearing
+}
+
+static void sys_status_write(dw1000_emu_t *e, uint32 index, uint32 len, const uint8 *in)
+{
+    uint8 b[SYS_STATUS_LEN] = { 0 };
+    uint64_t clear;
+    uint32 i;
+
+    for (i = 0; i < len && index + i < SYS_STATUS_LEN; i++)
+    {
+        b[index + i] = in[i];
+    }
+    // Write one to clear, the buffer pointer and IRQ bits are read only
+    clear = get_le(b, SYS_STATUS_LEN) & ~(uint64_t)(SYS_STATUS_IRQS | SYS_STATUS_HSRBP | SYS_STATUS_ICRBP);
+    status_put(e, status_get(e) & ~clear);
+}
+
+static void pmsc_write(dw1000_emu_t *e, uint32 index, uint32 len, const uint8 *in)
+{
+    uint8 softreset;
+
+    reg_write(e, PMSC_ID, index, len, in);
+    if (index > PMSC_CTRL0_SOFTRESET_OFFSET || index + len <= PMSC_CTRL0_SOFTRESET_OFFSET)
+    {
+        return;
+    }
+
+    softreset = in[PMSC_CTRL0_SOFTRESET_OFFSET - index];
+    if (softreset == PMSC_CTRL0_RESET_ALL)
+    {
+        emu_defaults(e);
+        e->regs[PMSC_ID][PMSC_CTRL0_SOFTRESET_OFFSET] = softreset;
+    }
+    else if (softreset == PMSC_CTRL0_RESET_RX)
+    {
+        rx_stop(e);
+    }
+}
+
+static void evc_write(dw1000_emu_t *e, uint32 index, uint32 len, const uint8 *in)
+{
+    reg_write(e, DIG_DIAG_ID, index, len, in);
+    if (e->regs[DIG_DIAG_ID][EVC_CTRL_OFFSET] & EVC_CLR)
+    {
+        memset(&e->regs[DIG_DIAG_ID][EVC_PHE_OFFSET], 0, EVC_TPW_OFFSET + 2 - EVC_PHE_OFFSET);
+        e->regs[DIG_DIAG_ID][EVC_CTRL_OFFSET] &= (uint8)~EVC_CLR;
+    }
+}
+
+/****************************************************************************************************************************************************
+ *
+ * SPI
+ *
+ ****************************************************************************************************************************************************/
+
+static void spi_tick(dw1000_emu_t *e, uint32 bytes)
+{
+    e->stats.spi_transactions++;
+    e->stats.spi_bytes += bytes;
+
+    if (e->hooks.spi_access != NULL)
+    {
+        e->hooks.spi_access(e->hooks.ctx, e, bytes);    // advances time through dw1000_emu_advance()
+    }
+    else
+    {
+        emu_run(e, e->now + dw1000_emu_spi_duration(e, bytes));
+    }
+}
+
+/* Count back to back reads of SYS_STATUS returning the same value */
+static void poll_track(dw1000_emu_t *e, uint16 id, uint32 index, uint32 len, const uint8 *data)
+{
+    uint64_t value;
+
+    if (id != SYS_STATUS_ID || len == 0 || len > 8)
+    {
+        e->idle_polls = 0;
+        e->last_poll_len = 0;
+        return;
+    }
+    value = get_le(data, (int)len);
+    if (index == e->last_poll_index && len == e->last_poll_len && value == e->last_poll_value)
+    {
+        e->idle_polls++;
+    }
+    else
+    {
+        e->idle_polls = 0;
+        e->last_poll_index = index;
+        e->last_poll_len = len;
+        e->last_poll_value = value;
+    }
+}
+
+/* Decode a 1 to 3 byte transaction header. As on the chip, an extended sub-index whose
+ * second byte is not part of the header takes it from the first byte clocked after it. */
+static int parse_header(uint16 hlen, const uint8 *h, uint16 *id, uint32 *index, int *skip)
+{
+    *skip = 0;
+    *id = h[0] & 0x3F;
+    *index = 0;
+
+    if (hlen == 0)
+    {
+        return -1;
+    }
+    if (h[0] & 0x40)
+    {
+        if (hlen < 2)
+        {
+            return -1;
+        }
+        *index = h[1] & 0x7F;
+        if (h[1] & 0x80)
+        {
+            if (hlen >= 3)
+            {
+                *index |= (uint32)h[2] << 7;
+            }
+            else
+            {
+                *skip = 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int emu_writetospi(void *ctx, uint16 headerLength, const uint8 *headerBuffer, uint32 bodyLength, const uint8 *bodyBuffer)
+{
+    dw1000_emu_t *e = (dw1000_emu_t *)ctx;
+    uint16 id;
+    uint32 index;
+    int skip;
+
+    e->pending_polls = 0;
+    e->idle_polls = 0;
+    e->last_poll_len = 0;
+    spi_tick(e, headerLength + bodyLength);
+    if (parse_header(headerLength, headerBuffer, &id, &index, &skip) != 0 || (headerBuffer[0] & 0x80) == 0)
+    {
+        return DWT_ERROR;
+    }
+    if (skip)
+    {
+        if (bodyLength == 0)
+        {
+            return DWT_SUCCESS;
+        }
+        index |= (uint32)bodyBuffer[0] << 7;
+        bodyBuffer++;
+        bodyLength--;
+    }
+
+    switch (id)
+    {
+    case SYS_CTRL_ID:
+        sys_ctrl_write(e, index, bodyLength, bodyBuffer);
+        break;
+    case SYS_STATUS_ID:
+        sys_status_write(e, index, bodyLength, bodyBuffer);
+        break;
+    case SYS_MASK_ID:
+        reg_write(e, id, index, bodyLength, bodyBuffer);
+        status_put(e, status_get(e));
+        break;
+    case PMSC_ID:
+        pmsc_write(e, index, bodyLength, bodyBuffer);
+        break;
+    case DIG_DIAG_ID:
+        evc_write(e, index, bodyLength, bodyBuffer);
+        break;
+    case DEV_ID_ID:
+    case SYS_TIME_ID:
+    case RX_FINFO_ID:
+    case RX_BUFFER_ID:
+    case RX_FQUAL_ID:
+    case RX_TTCKI_ID:
+    case RX_TTCKO_ID:
+    case RX_TIME_ID:
+    case TX_TIME_ID:
+    case SYS_STATE_ID:
+    case ACC_MEM_ID:
+        break;  // read only
+    default:
+        reg_write(e, id, index, bodyLength, bodyBuffer);
+        break;
+    }
+    return DWT_SUCCESS;
+}
+
+static int emu_readfromspi(void *ctx, uint16 headerLength, const uint8 *headerBuffer, uint32 readLength, uint8 *readBuffer)
+{
+    dw1000_emu_t *e = (dw1000_emu_t *)ctx;
+    uint16 id;
+    uint32 index;
+    int skip;
+
+    if (parse_header(headerLength, headerBuffer, &id, &index, &skip) != 0 || (headerBuffer[0] & 0x80) != 0)
+    {
+        spi_tick(e, headerLength + readLength);
+        return DWT_ERROR;
+    }
+
+    e->pending_polls = (id == SYS_STATUS_ID && !skip && index == e->last_poll_index && readLength == e->last_poll_len) ? e->idle_polls : 0;
+    spi_tick(e, headerLength + readLength);
+    e->pending_polls = 0;
+
+    if (skip && readLength != 0)
+    {
+        // MOSI is 0 while reading, so the extension is 0 and the first byte returned is garbage
+        readBuffer[0] = 0xFF;
+        readBuffer++;
+        readLength--;
+    }
+
+    if (id == ACC_MEM_ID && readLength != 0)
+    {
+        if (e->acc_stale)
+        {
+            rx_cir(e, 40.0);
+            e->acc_stale = 0;
+        }
+        // The first byte of an accumulator read is a dummy, see dwt_readaccdata()
+        readBuffer[0] = 0;
+        readBuffer++;
+        readLength--;
+    }
+
+    if (id == SYS_TIME_ID)
+    {
+        uint8 b[SYS_TIME_LEN];
+
+        put_le(b, e->now & MASK40 & DX_TIME_RESOLUTION_MASK, SYS_TIME_LEN);
+        memcpy(e->regs[SYS_TIME_ID], b, SYS_TIME_LEN);
+    }
+    reg_read(e, id, index, readLength, readBuffer);
+    poll_track(e, id, index, readLength, readBuffer);
+    return 0;
+}
+
+/****************************************************************************************************************************************************
+ *
+ * Public API
+ *
+ ****************************************************************************************************************************************************/
+
+dw1000_emu_t *dw1000_emu_create(void)
+{
+    dw1000_emu_t *e = (dw1000_emu_t *)calloc(1, sizeof(*e));
+
+    if (e == NULL)
+    {
+        return NULL;
+    }
+    e->spi_hz = 2000000;
+    e->rng = 0x2545F491UL;
+    e->backend.name = "dw1000_emu";
+    e->backend.write = emu_writetospi;
+    e->backend.read = emu_readfromspi;
+    e->backend.ctx = e;
+    emu_defaults(e);
+    return e;
+}
+
+void dw1000_emu_destroy(dw1000_emu_t *emu)
+{
+    free(emu);
+}
+
+void dw1000_emu_reset(dw1000_emu_t *emu)
+{
+    emu_defaults(emu);
+}
+
+void dw1000_emu_set_hooks(dw1000_emu_t *emu, const dw1000_emu_hooks_t *hooks)
+{
+    if (hooks != NULL)
+    {
+        emu->hooks = *hooks;
+    }
+    else
+    {
+        memset(&emu->hooks, 0, sizeof(emu->hooks));
+    }
+}
+
+void dw1000_emu_set_spi_rate(dw1000_emu_t *emu, uint32 hz)
+{
+    emu->spi_hz = hz;
+}
+
+const deca_spi_backend_t *dw1000_emu_spi_backend(dw1000_emu_t *emu)
+{
+    return &emu->backend;
+}
+
+uint64_t dw1000_emu_spi_duration(const dw1000_emu_t *emu, uint32 bytes)
+{
+    return (emu->spi_hz != 0) ? (uint64_t)bytes * 8 * (DW1000_EMU_DTU_PER_MS * 1000) / emu->spi_hz : 0;
+}
+
+uint32 dw1000_emu_idle_polls(const dw1000_emu_t *emu)
+{
+    return emu->pending_polls;
+}
+
+uint64_t dw1000_emu_time(const dw1000_emu_t *emu)
+{
+    return emu->now;
+}
+
+void dw1000_emu_set_time(dw1000_emu_t *emu, uint64_t t)
+{
+    emu->now = t;
+}
+
+void dw1000_emu_advance(dw1000_emu_t *emu, uint64_t dtu)
+{
+    emu_run(emu, emu->now + dtu);
+}
+
+void dw1000_emu_advance_to(dw1000_emu_t *emu, uint64_t t)
+{
+    if (t > emu->now)
+    {
+        emu_run(emu, t);
+    }
+    else
+    {
+        emu_run(emu, emu->now);
+    }
+}
+
+int dw1000_emu_irq_level(const dw1000_emu_t *emu)
+{
+    return emu->irq_level;
+}
+
+void dw1000_emu_get_stats(const dw1000_emu_t *emu, dw1000_emu_stats_t *stats)
+{
+    *stats = emu->stats;
+}
+
+int dw1000_emu_peek(const dw1000_emu_t *emu, uint16 regFileID, uint16 index, uint32 length, uint8 *buffer)
+{
+    if (regFileID >= REG_FILES)
+    {
+        return DWT_ERROR;
+    }
+    reg_read((dw1000_emu_t *)emu, regFileID, index, length, buffer);
+    return DWT_SUCCESS;
+}
+
+int dw1000_emu_poke(dw1000_emu_t *emu, uint16 regFileID, uint16 index, uint32 length, const uint8 *buffer)
+{
+    if (regFileID >= REG_FILES)
+    {
+        return DWT_ERROR;
+    }
+    reg_write(emu, regFileID, index, length, buffer);
+    if (regFileID == SYS_STATUS_ID || regFileID == SYS_MASK_ID)
+    {
+        status_put(emu, status_get(emu));
+    }
+    return DWT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+/*! ----------------------------------------------------------------------------
+ * @file    dw1000_emu.h
+ * @brief   Host side emulation of the DW1000 register file
+ *
+ *          The emulator sits behind the SPI backend interface (deca_spi.h), so
+ *          the decadriver runs on Linux unchanged: dwt_initialise(),
+ *          dwt_configure(), dwt_starttx(), dwt_rxenable() and the status polling
+ *          loops of the examples all work against it.
+ *
+ *          Modelled:
+ *          - the register map of deca_regs.h as plain memory, with defaults after reset
+ *          - SYS_CTRL commands: immediate/delayed TX, immediate/delayed RX, wait for
+ *            response, TRXOFF and the host side RX buffer toggle
+ *          - SYS_STATUS events, write-one-to-clear, SYS_MASK and the IRQ line
+ *          - TX/RX buffers, RX_FINFO, RX_FQUAL, RX_TIME, TX_TIME, SYS_TIME, DX_TIME
+ *          - double RX buffering (SYS_CFG DIS_DRXB clear): the IC and host side
+ *            buffer pointers, the RX events of the set shown to the host, and
+ *            receiver overruns (RXOVRR). The receiver is never re-enabled
+ *            automatically (RXAUTR), as with the driver.
+ *          - frame wait (RX_FWTO) and preamble detection (DRX_PRETOC) timeouts,
+ *            half period (HPDWARN) and TX power-up (TXPUTE) errors for late delayed commands
+ *          - TX/RX antenna delays, and the carrier integrator for a given clock offset
+ *          - the accumulator (ACC_MEM) of each frame received: the first path at the
+ *            FP_INDEX of RX_TIME and reflections carrying the rest of the power, in noise
+ *
+ *          Time is the device's own 63.8976 GHz time base (DWT_TIME_UNITS), kept
+ *          unwrapped in 64 bits; registers show the low 40 bits. It only moves when
+ *          told to: by dw1000_emu_advance(), by SPI traffic (bytes at the configured
+ *          SPI rate) and by HAL_Delay() through Host/host_port.c.
+ *
+ *          Frames leave through the tx_frame hook and enter with dw1000_emu_receive(),
+ *          which is how the air channel simulator (uwb_sim.c) connects several devices.
+ */
+
+#ifndef DW1000_EMU_H_
+#define DW1000_EMU_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "deca_types.h"
+#include "deca_spi.h"
+
+#define DW1000_EMU_MAX_FRAME        (1023 + 2)
+#define DW1000_EMU_NO_EVENT         UINT64_MAX
+
+#define DW1000_EMU_DTU_PER_US       (63897.6)       // 1 / DWT_TIME_UNITS / 1e6
+#define DW1000_EMU_DTU_PER_UUS      (65536)         // 512/499.2MHz, the unit of the driver timeouts
+#define DW1000_EMU_DTU_PER_MS       (63897600ULL)
+
+typedef struct dw1000_emu dw1000_emu_t;
+
+/* A frame on the air, all times in the time base of the device it is handed to */
+typedef struct
+{
+    const uint8    *data;           // PSDU including the 2 FCS bytes
+    uint16          length;
+    uint64_t        start;          // first preamble symbol
+    uint64_t        rmarker;        // ranging marker (end of SFD), what the timestamps refer to
+    uint64_t        end;            // last bit of the PSDU
+    uint8           prf;            // DWT_PRF_16M / DWT_PRF_64M
+    uint8           dataRate;       // DWT_BR_110K / DWT_BR_850K / DWT_BR_6M8
+    uint16          preambleLength; // preamble symbols
+    uint8           ranging;        // ranging bit of the PHR
+    uint8           corrupt;        // deliver with FCS error
+    double          rxPower;        // dBm, used for the RX_FQUAL/RX_TIME diagnostics
+    double          fpPower;        // dBm, first path power
+    double          clockOffset;    // (f_remote - f_local) / f_local, reported via the carrier integrator
+} dw1000_emu_frame_t;
+
+typedef struct
+{
+    /* The device starts transmitting, times are in its own time base */
+    void (*tx_frame)(void *ctx, dw1000_emu_t *emu, const dw1000_emu_frame_t *frame);
+    /* IRQ line changed */
+    void (*irq)(void *ctx, dw1000_emu_t *emu, int level);
+    /* An SPI transaction of the given size is about to be processed. When set, the hook is in charge
+     * of advancing time (e.g. the simulator schedules the node); otherwise the emulator advances by itself. */
+    void (*spi_access)(void *ctx, dw1000_emu_t *emu, uint32 bytes);
+    void *ctx;
+} dw1000_emu_hooks_t;
+
+typedef struct
+{
+    uint32  spi_transactions;
+    uint32  spi_bytes;
+    uint32  tx_frames;
+    uint32  rx_good;            // RXFCG
+    uint32  rx_errors;          // RXFCE / RXPHE
+    uint32  rx_frame_timeouts;  // RXRFTO
+    uint32  rx_preamble_timeouts; // RXPTO
+    uint32  rx_missed;          // frames on air while the receiver was off or busy
+    uint32  rx_overruns;        // RXOVRR, good frames lost with both RX buffer sets held by the host
+    uint32  late_delayed;       // HPDWARN / TXPUTE
+} dw1000_emu_stats_t;
+
+dw1000_emu_t   *dw1000_emu_create(void);
+void            dw1000_emu_destroy(dw1000_emu_t *emu);
+
+/* Hard reset (RSTn): registers back to their defaults, time keeps running */
+void            dw1000_emu_reset(dw1000_emu_t *emu);
+
+void            dw1000_emu_set_hooks(dw1000_emu_t *emu, const dw1000_emu_hooks_t *hooks);
+void            dw1000_emu_set_spi_rate(dw1000_emu_t *emu, uint32 hz);
+
+/* Device time taken by an SPI transaction of 'bytes' bytes at the current rate */
+uint64_t        dw1000_emu_spi_duration(const dw1000_emu_t *emu, uint32 bytes);
+
+/* From the spi_access hook: non-zero if the transaction about to run is a SYS_STATUS read repeating reads that
+ * already returned the same value that many times, i.e. the host is busy waiting and will see no change
+ * before dw1000_emu_next_event(). 0 otherwise. */
+uint32          dw1000_emu_idle_polls(const dw1000_emu_t *emu);
+
+/* SPI backend talking to this device, see deca_spi_set_backend() */
+const deca_spi_backend_t *dw1000_emu_spi_backend(dw1000_emu_t *emu);
+
+/* Time */
+uint64_t        dw1000_emu_time(const dw1000_emu_t *emu);
+void            dw1000_emu_set_time(dw1000_emu_t *emu, uint64_t t);
+void            dw1000_emu_advance(dw1000_emu_t *emu, uint64_t dtu);
+void            dw1000_emu_advance_to(dw1000_emu_t *emu, uint64_t t);
+uint64_t        dw1000_emu_next_event(const dw1000_emu_t *emu);
+
+/* Offer a frame to the receiver. Returns 0 if it was queued, -1 if there was no room */
+int             dw1000_emu_receive(dw1000_emu_t *emu, const dw1000_emu_frame_t *frame);
+
+/* Duration of the preamble + SFD and of the PHR + PSDU for the current TX configuration */
+void            dw1000_emu_frame_durations(const dw1000_emu_t *emu, uint16 length, uint64_t *shr, uint64_t *payload);
+
+int             dw1000_emu_irq_level(const dw1000_emu_t *emu);
+void            dw1000_emu_get_stats(const dw1000_emu_t *emu, dw1000_emu_stats_t *stats);
+
+/* Direct register access bypassing SPI (no time advance, no side effects) */
+int             dw1000_emu_peek(const dw1000_emu_t *emu, uint16 regFileID, uint16 index, uint32 length, uint8 *buffer);
+int             dw1000_emu_poke(dw1000_emu_t *emu, uint16 regFileID, uint16 index, uint32 length, const uint8 *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DW1000_EMU_H_ */
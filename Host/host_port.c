@@ -0,0 +1,186 @@
+/*! ----------------------------------------------------------------------------
+ * @file    host_port.c
+ * @brief   Board port functions for Linux builds, see host_port.h
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+#include "deca_spi.h"
+#include "port.h"
+#include "usbd_cdc_if.h"
+#include "dw1000_emu.h"
+#include "host_port.h"
+
+static dw1000_emu_t *device = NULL;
+static host_port_hooks_t hooks;
+static port_deca_isr_t deca_isr = NULL;
+static int in_isr = 0;
+
+void host_port_attach(dw1000_emu_t *emu)
+{
+    device = emu;
+    deca_spi_set_backend((emu != NULL) ? dw1000_emu_spi_backend(emu) : NULL);
+}
+
+dw1000_emu_t *host_port_device(void)
+{
+    return device;
+}
+
+void host_port_set_hooks(const host_port_hooks_t *h)
+{
+    if (h != NULL)
+    {
+        hooks = *h;
+    }
+    else
+    {
+        memset(&hooks, 0, sizeof(hooks));
+    }
+}
+
+void host_port_service_irq(void)
+{
+    // Same as process_deca_irq(): call the ISR until the line drops
+    if (in_isr || deca_isr == NULL || device == NULL)
+    {
+        return;
+    }
+    in_isr = 1;
+    while (dw1000_emu_irq_level(device))
+    {
+        deca_isr();
+    }
+    in_isr = 0;
+}
+
+void process_deca_irq(void)
+{
+    host_port_service_irq();
+}
+
+void port_set_deca_isr(port_deca_isr_t isr)
+{
+    deca_isr = isr;
+}
+
+void port_wait_for_irq(void)
+{
+    uint64_t next;
+
+    // WFI: may return without an interrupt, the caller checks its state again
+    if (device == NULL)
+    {
+        return;
+    }
+    if (!dw1000_emu_irq_level(device))
+    {
+        if (hooks.idle != NULL)
+        {
+            hooks.idle(hooks.ctx);
+        }
+        else if ((next = dw1000_emu_next_event(device)) != DW1000_EMU_NO_EVENT)
+        {
+            dw1000_emu_advance_to(device, next);
+        }
+    }
+    host_port_service_irq();
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+    if (hooks.delay != NULL)
+    {
+        hooks.delay(hooks.ctx, Delay);
+    }
+    else if (device != NULL)
+    {
+        dw1000_emu_advance(device, (uint64_t)Delay * DW1000_EMU_DTU_PER_MS);
+    }
+}
+
+uint32_t HAL_GetTick(void)
+{
+    return (device != NULL) ? (uint32_t)(dw1000_emu_time(device) / DW1000_EMU_DTU_PER_MS) : 0;
+}
+
+unsigned long portGetTickCnt(void)
+{
+    return HAL_GetTick();
+}
+
+void port_cycles_init(void)
+{
+}
+
+/* Cycles of a HOST_PORT_CPU_HZ core over the attached device's time, whole ms and the rest apart not to overflow */
+uint32_t port_cycles(void)
+{
+    uint64_t t = (device != NULL) ? dw1000_emu_time(device) : 0;
+
+    return (uint32_t)((t / DW1000_EMU_DTU_PER_MS) * (HOST_PORT_CPU_HZ / 1000) +
+                      (t % DW1000_EMU_DTU_PER_MS) * (HOST_PORT_CPU_HZ / 1000) / DW1000_EMU_DTU_PER_MS);
+}
+
+uint32_t port_cycles_hz(void)
+{
+    return HOST_PORT_CPU_HZ;
+}
+
+void deca_sleep(unsigned int time_ms)
+{
+    HAL_Delay(time_ms);
+}
+
+void deca_reset(void)
+{
+    if (device != NULL)
+    {
+        dw1000_emu_reset(device);
+        HAL_Delay(2);
+    }
+}
+
+void port_set_dw1000_slowrate(void)
+{
+    if (device != NULL)
+    {
+        dw1000_emu_set_spi_rate(device, HOST_PORT_SLOW_SPI_HZ);
+    }
+}
+
+void port_set_dw1000_fastrate(void)
+{
+    if (device != NULL)
+    {
+        dw1000_emu_set_spi_rate(device, HOST_PORT_FAST_SPI_HZ);
+    }
+}
+
+/* Single threaded: the ISR only runs from host_port_service_irq() */
+decaIrqStatus_t decamutexon(void)
+{
+    return 0;
+}
+
+void decamutexoff(decaIrqStatus_t s)
+{
+    (void)s;
+}
+
+uint8_t CDC_Transmit_FS(uint8_t *Buf, uint16_t Len)
+{
+    if (hooks.cdc != NULL)
+    {
+        return hooks.cdc(hooks.ctx, Buf, Len);
+    }
+    else
+    {
+        // The examples send whole sprintf buffers, stop at the terminator
+        fwrite(Buf, 1, strnlen((const char *)Buf, Len), stdout);
+    }
+    return USBD_OK;
+}
@@ -0,0 +1,63 @@
+/*! ----------------------------------------------------------------------------
+ * @file    host_port.h
+ * @brief   Board port functions for Linux builds, on top of the DW1000 emulator
+ *
+ *          Provides what DWM_functions.c, port.c and the USB stack provide on
+ *          the board: HAL_Delay()/HAL_GetTick(), deca_sleep(), deca_reset(),
+ *          decamutexon()/decamutexoff(), the SPI rate switches, port_set_deca_isr(),
+ *          port_wait_for_irq(), port_cycles() and CDC_Transmit_FS(). Time is the attached emulator's time, so a
+ *          delay simply advances the device, and the cycle counter only runs with SPI transfers and delays.
+ */
+
+#ifndef HOST_PORT_H_
+#define HOST_PORT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+#include "dw1000_emu.h"
+
+#define HOST_PORT_SLOW_SPI_HZ   (625000)    // SPI_BAUDRATEPRESCALER_128
+#define HOST_PORT_FAST_SPI_HZ   (8000000)   // SPI_BAUDRATEPRESCALER_8
+#define HOST_PORT_CPU_HZ        (64000000)  // SystemCoreClock of the board, for port_cycles()
+
+typedef struct
+{
+    /* HAL_Delay(), default advances the attached device by 'ms' */
+    void (*delay)(void *ctx, uint32 ms);
+    /* CDC_Transmit_FS(), returns USBD_OK or USBD_BUSY. Default writes the text up to the first NUL to stdout */
+    uint8 (*cdc)(void *ctx, const uint8 *buf, uint16 len);
+    /* port_wait_for_irq() with the IRQ line low: sleep until it rises. Default advances the attached device to its
+     * next event */
+    void (*idle)(void *ctx);
+    void *ctx;
+} host_port_hooks_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn host_port_attach()
+ *
+ * @brief Make emu the device seen by the driver: selects its SPI backend, routes its IRQ line to the handler
+ *        installed with port_set_deca_isr(), and uses its time for HAL_Delay()/HAL_GetTick().
+ *        Several devices can share a process by attaching the one whose code is about to run.
+ *
+ * input parameters
+ * @param emu - device to attach, NULL to detach
+ *
+ * no return value
+ */
+void host_port_attach(dw1000_emu_t *emu);
+
+dw1000_emu_t *host_port_device(void);
+
+void host_port_set_hooks(const host_port_hooks_t *hooks);
+
+/* Run the installed DW1000 ISR while the attached device holds its IRQ line high */
+void host_port_service_irq(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_PORT_H_ */
@@ -0,0 +1,11 @@
+/*! ----------------------------------------------------------------------------
+ * @file    deca_reset.h
+ * @brief   Included by some examples, deca_reset() itself is declared in DWM_functions.h
+ */
+
+#ifndef DECA_RESET_H_
+#define DECA_RESET_H_
+
+void deca_reset(void);
+
+#endif /* DECA_RESET_H_ */
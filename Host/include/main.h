@@ -0,0 +1,30 @@
+/*! ----------------------------------------------------------------------------
+ * @file    main.h
+ * @brief   Host stand-in for the CubeMX main.h included by the examples
+ *
+ *          Only what the driver and the ranging examples use off the board.
+ *          HAL_Delay()/HAL_GetTick() are implemented in Host/host_port.c.
+ */
+
+#ifndef __MAIN_H
+#define __MAIN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef __INLINE
+#define __INLINE            inline
+#endif
+
+void HAL_Delay(uint32_t Delay);
+uint32_t HAL_GetTick(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MAIN_H */
@@ -0,0 +1,78 @@
+/*! ----------------------------------------------------------------------------
+ * @file    port.h
+ * @brief   Host stand-in for DWM_platform/porτ.h
+ *
+ *          Declares the port functions the examples call; Host/host_port.c
+ *          implements them on top of the DW1000 emulator. Also carries the
+ *          circ_buf macros of the board header.
+ */
+
+#ifndef PORT_H_
+#define PORT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+typedef void (*port_deca_isr_t)(void);
+
+void port_set_deca_isr(port_deca_isr_t deca_isr);
+
+unsigned long portGetTickCnt(void);
+
+void port_cycles_init(void);
+uint32_t port_cycles(void);
+uint32_t port_cycles_hz(void);
+
+void port_set_dw1000_slowrate(void);
+void port_set_dw1000_fastrate(void);
+
+void process_deca_irq(void);
+void port_wait_for_irq(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PORT_H_ */
+/*
+ * Taken from the Linux Kernel
+ *
+ */
+
+#ifndef _LINUX_CIRC_BUF_H
+#define _LINUX_CIRC_BUF_H 1
+
+struct circ_buf {
+    char *buf;
+    int head;
+    int tail;
+};
+
+/* Return count in buffer.  */
+#define CIRC_CNT(head,tail,size) (((head) - (tail)) & ((size)-1))
+
+/* Return space available, 0..size-1.  We always leave one free char
+   as a completely full buffer has head == tail, which is the same as
+   empty.  */
+#define CIRC_SPACE(head,tail,size) CIRC_CNT((tail),((head)+1),(size))
+
+/* Return count up to the end of the buffer.  Carefully avoid
+   accessing head and tail more than once, so they can change
+   underneath us without returning inconsistent results.  */
+#define CIRC_CNT_TO_END(head,tail,size) \
+    ({int end = (size) - (tail); \
+      int n = ((head) + end) & ((size)-1); \
+      n < end ? n : end;})
+
+/* Return space available up to the end of the buffer.  */
+#define CIRC_SPACE_TO_END(head,tail,size) \
+    ({int end = (size) - 1 - (head); \
+      int n = (end + (tail)) & ((size)-1); \
+      n <= end ? n : end+1;})
+
+#endif /* _LINUX_CIRC_BUF_H  */
+
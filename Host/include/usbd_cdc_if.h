@@ -0,0 +1,24 @@
+/*! ----------------------------------------------------------------------------
+ * @file    usbd_cdc_if.h
+ * @brief   Host stand-in for the USB CDC interface, see host_port_set_hooks()
+ */
+
+#ifndef __USBD_CDC_IF_H__
+#define __USBD_CDC_IF_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define USBD_OK             0U
+#define USBD_BUSY           1U  // previous transfer still in flight
+
+uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_CDC_IF_H__ */
@@ -0,0 +1,172 @@
+/*! ----------------------------------------------------------------------------
+ * @file    report_decode.c
+ * @brief   Decoder of the binary range reports sent over USB by the boards
+ *
+ *          Reads the report stream (see DWM_platform/twr_report.h) from a file
+ *          or the board's serial device and prints one line per report:
+ *          - default: "DIST A: 1.234 m", the lines the boards used to send,
+ *            which Trilateration.ipynb reads
+ *          - -c: CSV with every field, and the first path and RX power
+ *            estimates of the DW1000 user manual (section 4.7)
+ *          With -t it also prints the trace frames of a board built with
+ *          TWR_TRACE (see DWM_platform/twr_trace.h), one "TRACE" line per
+ *          phase with its duration histogram, on stderr so CSV stays clean.
+ *          At the end it prints to stderr the frames decoded, the bytes
+ *          skipped, and the reports missing from the report numbers.
+ *
+ *          usage: report_decode [-c] [-t] [-p 16|64] [file]
+ *          -p is the PRF of the radio configuration, 64 MHz by default.
+ *          Set a serial device to raw mode first: stty -F /dev/ttyACM0 raw
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "twr_report.h"
+#include "twr_trace.h"
+
+/* Power estimate constant A of the user manual, dBm */
+#define RX_LEVEL_A_PRF16    113.77
+#define RX_LEVEL_A_PRF64    121.74
+
+typedef struct
+{
+    int     csv;
+    double  a;
+    int     started;
+    uint16  next_seq;
+    unsigned long missing;
+    unsigned long reports;
+} decode_ctx_t;
+
+static const char *kind_name(uint8 kind)
+{
+    switch (kind)
+    {
+    case TWR_RPT_KIND_DS:       return "ds";
+    case TWR_RPT_KIND_SS:       return "ss";
+    case TWR_RPT_KIND_RELAY:    return "relay";
+    default:                    return "?";
+    }
+}
+
+static void on_trace(void *ctx, const twr_trace_report_t *t)
+{
+    static const char *const names[TWR_TRACE_NUM_PHASES] = TWR_TRACE_PHASE_NAMES;
+    double us_per_cycle = (t->cpu_hz != 0) ? 1e6 / t->cpu_hz : 0.0;
+    int i;
+
+    (void)ctx;
+    fprintf(stderr, "TRACE %s: %lu, min %.1f us, mean %.1f us, max %.1f us, device %.1f us, %.2f spi, %.1f bytes, "
+            "%.2f polls, us log2 histogram",
+            (t->phase < TWR_TRACE_NUM_PHASES) ? names[t->phase] : "?", (unsigned long)t->count,
+            t->cycles_min * us_per_cycle, t->cycles_mean * us_per_cycle, t->cycles_max * us_per_cycle,
+            t->device_mean * 256.0 / 63897.6, (t->count != 0) ? (double)t->spi_xfers / t->count : 0.0,
+            (t->count != 0) ? (double)t->spi_bytes / t->count : 0.0,
+            (t->count != 0) ? (double)t->polls / t->count : 0.0);
+    for (i = 0; i < TWR_RPT_TR_BUCKETS; i++)
+    {
+        fprintf(stderr, " %lu", (unsigned long)t->hist[i]);
+    }
+    fprintf(stderr, "\n");
+}
+
+static void on_report(void *ctx, const twr_range_report_t *r)
+{
+    decode_ctx_t *c = (decode_ctx_t *)ctx;
+    const twr_rpt_quality_t *q = &r->quality;
+    double n2 = (double)q->rx_pacc * q->rx_pacc;
+    double fp_power = NAN, rx_power = NAN;
+    int i;
+
+    if (c->started && r->seq != c->next_seq)
+    {
+        c->missing += (uint16)(r->seq - c->next_seq);
+    }
+    c->started = 1;
+    c->next_seq = (uint16)(r->seq + 1);
+    c->reports++;
+
+    if (!c->csv)
+    {
+        printf("DIST %c: %.3f m\n", r->anchor, r->distance_mm / 1000.0);
+        return;
+    }
+
+    if (r->kind != TWR_RPT_KIND_RELAY && n2 > 0.0)
+    {
+        fp_power = 10.0 * log10(((double)q->fp_amp1 * q->fp_amp1 + (double)q->fp_amp2 * q->fp_amp2 +
+                                 (double)q->fp_amp3 * q->fp_amp3) / n2) - c->a;
+        rx_power = 10.0 * log10((double)q->cir_power * 131072.0 / n2) - c->a;
+    }
+    printf("%u,%c,%u,%s,%ld", (unsigned)r->seq, r->anchor, (unsigned)r->exchange, kind_name(r->kind),
+           (long)r->distance_mm);
+    for (i = 0; i < TWR_RPT_N_TS; i++)
+    {
+        printf(",%lu", (unsigned long)r->ts[i]);
+    }
+    printf(",%.2f,%u,%u,%u,%u,%u,%u,%.1f,%.1f,%u\n", q->fp_index / 64.0, (unsigned)q->fp_amp1, (unsigned)q->fp_amp2,
+           (unsigned)q->fp_amp3, (unsigned)q->cir_power, (unsigned)q->std_noise, (unsigned)q->rx_pacc, fp_power,
+           rx_power, (unsigned)r->dropped);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    decode_ctx_t ctx = { 0, RX_LEVEL_A_PRF64, 0, 0, 0, 0 };
+    twr_report_decoder_t decoder;
+    const char *path = NULL;
+    uint8 buf[512];
+    size_t n;
+    FILE *in;
+    int c;
+
+    memset(&decoder, 0, sizeof(decoder));
+    for (c = 1; c < argc; c++)
+    {
+        if (strcmp(argv[c], "-c") == 0)
+        {
+            ctx.csv = 1;
+        }
+        else if (strcmp(argv[c], "-t") == 0)
+        {
+            decoder.trace_cb = on_trace;
+        }
+        else if (strcmp(argv[c], "-p") == 0 && c + 1 < argc)
+        {
+            ctx.a = (atoi(argv[++c]) == 16) ? RX_LEVEL_A_PRF16 : RX_LEVEL_A_PRF64;
+        }
+        else
+        {
+            path = argv[c];
+        }
+    }
+
+    in = (path != NULL) ? fopen(path, "rb") : stdin;
+    if (in == NULL)
+    {
+        perror(path);
+        return 1;
+    }
+
+    if (ctx.csv)
+    {
+        printf("seq,anchor,exchange,kind,distance_mm,ts0,ts1,ts2,ts3,ts4,ts5,"
+               "fp_index,fp_amp1,fp_amp2,fp_amp3,cir_power,std_noise,rx_pacc,fp_power_dbm,rx_power_dbm,dropped\n");
+    }
+
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+    {
+        twr_report_decode(&decoder, buf, (uint32)n, on_report, &ctx);
+    }
+
+    fprintf(stderr, "%lu reports in %lu frames, %lu bytes skipped, %lu reports missing\n", ctx.reports,
+            (unsigned long)decoder.frames, (unsigned long)decoder.errors, ctx.missing);
+    if (in != stdin)
+    {
+        fclose(in);
+    }
+    return 0;
+}
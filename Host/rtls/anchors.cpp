@@ -0,0 +1,157 @@
+/*! ----------------------------------------------------------------------------
+ * @file    anchors.cpp
+ * @brief   Anchor positions, see anchors.hpp
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "anchors.hpp"
+
+namespace rtls
+{
+
+anchor_set::anchor_set() : n_(0)
+{
+    memset(index_, -1, sizeof(index_));
+}
+
+bool anchor_set::set(char label, double x, double y, double z)
+{
+    int i = find(label);
+
+    if (i < 0)
+    {
+        if (n_ == RTLS_MAX_ANCHORS)
+        {
+            return false;
+        }
+        i = n_++;
+        index_[(unsigned char)label] = (signed char)i;
+    }
+    anchors_[i].label = label;
+    anchors_[i].pos[0] = x;
+    anchors_[i].pos[1] = y;
+    anchors_[i].pos[2] = z;
+    return true;
+}
+
+bool anchor_set::parse(const char *spec)
+{
+    double v[3] = { 0.0, 0.0, 0.0 };
+    const char *p;
+    char *end;
+    int k;
+
+    if (spec[0] == '\0' || spec[1] != '=')
+    {
+        return false;
+    }
+    p = &spec[2];
+    for (k = 0; k < 3; k++)
+    {
+        v[k] = strtod(p, &end);
+        if (end == p)
+        {
+            return false;
+        }
+        p = end;
+        if (*p != ',')
+        {
+            break;
+        }
+        p++;
+    }
+    if (*p != '\0' || k < 1)
+    {
+        return false;
+    }
+    return set(spec[0], v[0], v[1], v[2]);
+}
+
+bool anchor_set::load(const char *path, int *bad_line)
+{
+    char line[256];
+    char label[2];
+    double x, y, z;
+    FILE *f;
+    char *hash;
+    int n, num = 0;
+
+    *bad_line = 0;
+    f = fopen(path, "r");
+    if (f == NULL)
+    {
+        return false;
+    }
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        num++;
+        hash = strchr(line, '#');
+        if (hash != NULL)
+        {
+            *hash = '\0';
+        }
+        z = 0.0;
+        n = sscanf(line, " %1s %lf %lf %lf", label, &x, &y, &z);
+        if (n == EOF || n == 0)
+        {
+            continue;
+        }
+        if (n < 3 || !set(label[0], x, y, z))
+        {
+            *bad_line = num;
+            fclose(f);
+            return false;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+bool anchor_set::preset(const char *name)
+{
+    if (strcmp(name, "lab") == 0)
+    {
+        return set('A', 0.0, 0.0) && set('B', 8.7, 1.0) && set('C', 9.7, 5.0);
+    }
+    if (strcmp(name, "living") == 0)
+    {
+        return set('A', 0.0, 0.0) && set('B', 4.36, 1.22) && set('C', 4.34, -1.04);
+    }
+    return false;
+}
+
+int anchor_set::option(const char *opt, const char *arg)
+{
+    int bad_line;
+
+    if (strcmp(opt, "-s") != 0 && strcmp(opt, "-a") != 0 && strcmp(opt, "-f") != 0)
+    {
+        return 0;
+    }
+    if (arg == NULL)
+    {
+        fprintf(stderr, "%s needs an argument\n", opt);
+        return -1;
+    }
+    if (opt[1] == 's' && !preset(arg))
+    {
+        fprintf(stderr, "unknown room %s, lab or living\n", arg);
+        return -1;
+    }
+    if (opt[1] == 'a' && !parse(arg))
+    {
+        fprintf(stderr, "bad anchor %s, A=x,y[,z]\n", arg);
+        return -1;
+    }
+    if (opt[1] == 'f' && !load(arg, &bad_line))
+    {
+        fprintf(stderr, "%s: %s %d\n", arg, bad_line ? "bad anchor on line" : "cannot read", bad_line);
+        return -1;
+    }
+    return 1;
+}
+
+} // namespace rtls
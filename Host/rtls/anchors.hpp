@@ -0,0 +1,79 @@
+/*! ----------------------------------------------------------------------------
+ * @file    anchors.hpp
+ * @brief   Anchor positions, by the label of their DIST records
+ *
+ *          Trilateration.ipynb hard-codes A, B and C in base_pos, with the
+ *          living room as a commented-out copy. Here the anchors are a table
+ *          filled from the command line, a file of "A 0 0 [z]" lines, or the
+ *          notebook's two rooms as presets.
+ */
+
+#ifndef RTLS_ANCHORS_HPP_
+#define RTLS_ANCHORS_HPP_
+
+#include "mat.hpp"
+
+namespace rtls
+{
+
+/* Anchors of a set, the labels are 'A', 'B', ... in the boards (TWR_LABEL) but any printable character works */
+#define RTLS_MAX_ANCHORS    32
+
+struct anchor
+{
+    char        label;
+    vec<3>      pos;        // m, z is 0 for a 2D set
+};
+
+class anchor_set
+{
+public:
+    anchor_set();
+
+    /* Add or move an anchor; false if the set is full */
+    bool set(char label, double x, double y, double z = 0.0);
+
+    /* Index of an anchor, -1 if the label is unknown */
+    int find(char label) const { return index_[(unsigned char)label]; }
+
+    int size() const { return n_; }
+    const anchor &operator[](int i) const { return anchors_[i]; }
+
+    /* Position in D dimensions (the first D coordinates) */
+    template <int D>
+    vec<D> pos(int i) const
+    {
+        vec<D> p;
+
+        for (int k = 0; k < D; k++)
+        {
+            p[k] = anchors_[i].pos[k];
+        }
+        return p;
+    }
+
+    /* Parse "A=x,y[,z]"; false if malformed */
+    bool parse(const char *spec);
+
+    /* Read "A x y [z]" lines, '#' starts a comment; false, with the line number in *bad_line, if a line is malformed or
+     * the file cannot be read (*bad_line is then 0) */
+    bool load(const char *path, int *bad_line);
+
+    /* The rooms of Trilateration.ipynb, "lab" or "living"; false if the name is unknown */
+    bool preset(const char *name);
+
+    /*
+     * Command line options of the tools: -s room, -a A=x,y[,z], -f file. Returns 1 if opt is one of them (arg used),
+     * 0 if not, -1 after printing an error to stderr if arg is bad or missing (NULL).
+     */
+    int option(const char *opt, const char *arg);
+
+private:
+    anchor          anchors_[RTLS_MAX_ANCHORS];
+    signed char     index_[256];
+    int             n_;
+};
+
+} // namespace rtls
+
+#endif /* RTLS_ANCHORS_HPP_ */
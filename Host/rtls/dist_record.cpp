@@ -0,0 +1,93 @@
+/*! ----------------------------------------------------------------------------
+ * @file    dist_record.cpp
+ * @brief   "DIST A: 1.23 m" records, see dist_record.hpp
+ */
+
+#include <cstring>
+
+#include "dist_record.hpp"
+
+namespace rtls
+{
+
+/* Decimals kept of a distance, more than the boards ever send */
+#define DIST_MAX_DIGITS     15
+
+static const double pow10_tab[DIST_MAX_DIGITS + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+};
+
+static bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\0';
+}
+
+bool parse_dist_line(const char *line, size_t len, dist_record &rec)
+{
+    const char *p = line;
+    const char *end = line + len;
+    unsigned long long mant = 0;
+    int digits = 0, decimals = 0;
+    bool neg = false, point = false;
+
+    /* Captures of the text reports may start with NUL bytes, as Living_Room.txt does */
+    while (p < end && is_blank(*p))
+    {
+        p++;
+    }
+    if (end - p < 8 || memcmp(p, "DIST ", 5) != 0 || is_blank(p[5]) || p[6] != ':')
+    {
+        return false;
+    }
+    rec.label = p[5];
+    p += 7;
+    while (p < end && *p == ' ')
+    {
+        p++;
+    }
+
+    /* [-]digits[.digits], the mantissa as an integer: m / 10^k is then correctly rounded */
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        neg = (*p == '-');
+        p++;
+    }
+    for (; p < end; p++)
+    {
+        if (*p >= '0' && *p <= '9')
+        {
+            if (digits < DIST_MAX_DIGITS)
+            {
+                mant = mant * 10 + (unsigned)(*p - '0');
+                digits++;
+                decimals += point;
+            }
+            else if (!point)
+            {
+                return false;
+            }
+        }
+        else if (*p == '.' && !point)
+        {
+            point = true;
+        }
+        else
+        {
+            break;
+        }
+    }
+    if (digits == 0)
+    {
+        return false;
+    }
+    rec.distance = (double)mant / pow10_tab[decimals];
+    rec.distance = neg ? -rec.distance : rec.distance;
+
+    while (p < end && *p == ' ')
+    {
+        p++;
+    }
+    return p < end && *p == 'm';
+}
+
+} // namespace rtls
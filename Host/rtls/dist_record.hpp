@@ -0,0 +1,107 @@
+/*! ----------------------------------------------------------------------------
+ * @file    dist_record.hpp
+ * @brief   "DIST A: 1.23 m" records, and their grouping into ranging rounds
+ *
+ *          The lines come from the boards' old text reports, the captures in
+ *          "Measurements and Results", or Host/report_decode. Captures may
+ *          carry NUL bytes and a CR around the line. dist_stream.hpp cuts a
+ *          byte stream into lines.
+ *
+ *          The notebook pairs the n-th distance of each anchor, so one lost
+ *          report shifts every fix after it. A tag ranges its anchors in the
+ *          order of their ids, and the labels follow it ('A' + id, see
+ *          TWR_LABEL), in turn and in broadcast slots alike. round_builder
+ *          therefore closes a round when a label does not come after the
+ *          last one: a lost report costs its round one distance, nothing
+ *          more.
+ */
+
+#ifndef RTLS_DIST_RECORD_HPP_
+#define RTLS_DIST_RECORD_HPP_
+
+#include <cstddef>
+
+#include "anchors.hpp"
+#include "multilat.hpp"
+
+namespace rtls
+{
+
+struct dist_record
+{
+    char    label;
+    double  distance;       // m
+};
+
+/* Parse one line of len bytes, in place (no terminator needed); false if it is not a DIST record */
+bool parse_dist_line(const char *line, size_t len, dist_record &rec);
+
+template <int D>
+class round_builder
+{
+public:
+    explicit round_builder(const anchor_set &anchors) : anchors_(anchors), n_(0), last_(0) {}
+
+    /*
+     * Add a record. Returns true if it closed the current round, whose ranges are then in ranges()/size() until the
+     * next call. Records of unknown anchors are ignored and counted.
+     */
+    bool add(const dist_record &rec)
+    {
+        int a = anchors_.find(rec.label);
+
+        if (a < 0)
+        {
+            unknown_++;
+            return false;
+        }
+        closed_ = 0;
+        if (n_ > 0 && (unsigned char)rec.label <= last_)
+        {
+            close();
+        }
+        r_[n_].anchor = anchors_.pos<D>(a);
+        r_[n_].distance = rec.distance;
+        n_++;
+        last_ = (unsigned char)rec.label;
+        return closed_ != 0;
+    }
+
+    /* Close the round in progress, at the end of the input; false if it is empty */
+    bool flush()
+    {
+        closed_ = 0;
+        if (n_ > 0)
+        {
+            close();
+        }
+        return closed_ != 0;
+    }
+
+    const range<D> *ranges() const { return out_; }
+    int size() const { return closed_; }
+    unsigned long unknown() const { return unknown_; }
+
+private:
+    void close()
+    {
+        for (int i = 0; i < n_; i++)
+        {
+            out_[i] = r_[i];
+        }
+        closed_ = n_;
+        n_ = 0;
+    }
+
+    const anchor_set   &anchors_;
+    range<D>            r_[RTLS_MAX_ANCHORS];
+    range<D>            out_[RTLS_MAX_ANCHORS];
+    int                 n_;
+    int                 closed_ = 0;
+    unsigned char       last_;      // label of the last range of the round in progress
+    unsigned long       unknown_ = 0;
+};
+
+} // namespace rtls
+
+#endif /* RTLS_DIST_RECORD_HPP_ */
@@ -0,0 +1,158 @@
+/*! ----------------------------------------------------------------------------
+ * @file    dist_stream.cpp
+ * @brief   Streaming reader of DIST records, see dist_stream.hpp
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+#include "dist_stream.hpp"
+
+namespace rtls
+{
+
+dist_stream::dist_stream(record_cb cb, void *ctx) : cb_(cb), ctx_(ctx), held_len_(0), overlong_(false)
+{
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+/* Index of the first CR or LF of p[0..len), len if none. The lines are short, a byte loop beats two memchr() calls */
+static size_t line_end(const char *p, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        if ((unsigned char)p[i] <= '\r' && (p[i] == '\n' || p[i] == '\r'))
+        {
+            break;
+        }
+    }
+    return i;
+}
+
+void dist_stream::line(const char *p, size_t len)
+{
+    dist_record rec;
+    size_t i;
+
+    for (i = 0; i < len && (p[i] == ' ' || p[i] == '\t' || p[i] == '\0'); i++)
+    {
+    }
+    if (i == len)
+    {
+        stats_.padding++;
+        return;
+    }
+    stats_.lines++;
+    if (!parse_dist_line(p + i, len - i, rec))
+    {
+        stats_.bad++;
+        return;
+    }
+    stats_.records++;
+    cb_(ctx_, rec);
+}
+
+void dist_stream::feed(const char *buf, size_t len)
+{
+    size_t n;
+
+    stats_.bytes += len;
+
+    /* Complete the line held from the previous chunk */
+    if (held_len_ > 0 || overlong_)
+    {
+        n = line_end(buf, len);
+        if (!overlong_ && held_len_ + n <= RTLS_LINE_MAX)
+        {
+            memcpy(&held_[held_len_], buf, n);
+            held_len_ += n;
+        }
+        else
+        {
+            overlong_ = true;
+        }
+        if (n == len)
+        {
+            return;
+        }
+        if (overlong_)
+        {
+            stats_.lines++;
+            stats_.bad++;
+        }
+        else
+        {
+            line(held_, held_len_);
+        }
+        held_len_ = 0;
+        overlong_ = false;
+        buf += n + 1;
+        len -= n + 1;
+    }
+
+    /* Whole lines are parsed where they are; a CR LF is a line and a blank one */
+    while (len > 0)
+    {
+        n = line_end(buf, len);
+        if (n == len)
+        {
+            break;
+        }
+        line(buf, n);
+        buf += n + 1;
+        len -= n + 1;
+    }
+
+    if (len > RTLS_LINE_MAX)
+    {
+        overlong_ = true;
+    }
+    else
+    {
+        memcpy(held_, buf, len);
+        held_len_ = len;
+    }
+}
+
+void dist_stream::finish()
+{
+    if (overlong_)
+    {
+        stats_.lines++;
+        stats_.bad++;
+    }
+    else if (held_len_ > 0)
+    {
+        line(held_, held_len_);
+    }
+    held_len_ = 0;
+    overlong_ = false;
+}
+
+int dist_stream::read_fd(int fd)
+{
+    char buf[RTLS_READ_CHUNK];
+    ssize_t n;
+
+    for (;;)
+    {
+        n = read(fd, buf, sizeof(buf));
+        if (n > 0)
+        {
+            feed(buf, (size_t)n);
+        }
+        else if (n == 0)
+        {
+            return 0;
+        }
+        else if (errno != EINTR)
+        {
+            return -1;
+        }
+    }
+}
+
+} // namespace rtls
@@ -0,0 +1,123 @@
+/*! ----------------------------------------------------------------------------
+ * @file    dist_stream.hpp
+ * @brief   Streaming reader of DIST records, without allocation per line
+ *
+ *          The notebook reads a whole capture with split() before it groups
+ *          anything, and that cannot follow the CDC streams of many tags live.
+ *          dist_stream takes bytes in chunks of any size, from a file, a pipe
+ *          or a tty, and parses each line in place in the chunk. Only a line
+ *          cut by the end of a chunk is copied, into a fixed buffer.
+ *
+ *          Line ends are LF, CR or both. The old boards sent
+ *          CDC_Transmit_FS(dist_str, sizeof(dist_str)) of an 18 byte sprintf
+ *          buffer, so a short line ends with a NUL, which shows up at the
+ *          start of the next one, and some capture tools turn the CR LF into
+ *          a blank line. NULs count as spaces and blank lines as padding.
+ *
+ *          dist_pipeline adds the grouping of round_builder and calls a
+ *          solver callback once per round.
+ */
+
+#ifndef RTLS_DIST_STREAM_HPP_
+#define RTLS_DIST_STREAM_HPP_
+
+#include <cstddef>
+
+#include "dist_record.hpp"
+
+namespace rtls
+{
+
+/* Longest line kept, longer ones are not DIST records and are skipped */
+#define RTLS_LINE_MAX       128
+
+/* Bytes of a read() in dist_stream::read_fd() */
+#define RTLS_READ_CHUNK     65536
+
+struct dist_stream_stats
+{
+    unsigned long long  bytes;
+    unsigned long long  lines;      // non blank lines
+    unsigned long long  records;    // DIST records
+    unsigned long long  padding;    // blank lines
+    unsigned long long  bad;        // lines that are not DIST records, overlong ones included
+};
+
+class dist_stream
+{
+public:
+    typedef void (*record_cb)(void *ctx, const dist_record &rec);
+
+    dist_stream(record_cb cb, void *ctx);
+
+    /* Parse the next len bytes of the stream */
+    void feed(const char *buf, size_t len);
+
+    /* End of the stream: parse the last line if it has no line end */
+    void finish();
+
+    /* Read fd to its end (or an error, when it returns -1 with errno set) and feed what is read; a tty must be raw */
+    int read_fd(int fd);
+
+    const dist_stream_stats &stats() const { return stats_; }
+
+private:
+    void line(const char *p, size_t len);
+
+    record_cb           cb_;
+    void               *ctx_;
+    char                held_[RTLS_LINE_MAX];   // start of a line cut by the end of a chunk
+    size_t              held_len_;
+    bool                overlong_;              // the held line went past RTLS_LINE_MAX
+    dist_stream_stats   stats_;
+};
+
+template <int D>
+class dist_pipeline
+{
+public:
+    /* Called with each round of at least one known anchor; the ranges are valid during the call only */
+    typedef void (*round_cb)(void *ctx, const range<D> *r, int n);
+
+    dist_pipeline(const anchor_set &anchors, round_cb cb, void *ctx)
+        : rounds_(anchors), stream_(on_record, this), cb_(cb), ctx_(ctx)
+    {
+    }
+
+    void feed(const char *buf, size_t len) { stream_.feed(buf, len); }
+
+    int read_fd(int fd) { return stream_.read_fd(fd); }
+
+    /* End of the stream: the round in progress is passed on too */
+    void finish()
+    {
+        stream_.finish();
+        if (rounds_.flush())
+        {
+            cb_(ctx_, rounds_.ranges(), rounds_.size());
+        }
+    }
+
+    const dist_stream_stats &stats() const { return stream_.stats(); }
+    unsigned long unknown() const { return rounds_.unknown(); }
+
+private:
+    static void on_record(void *ctx, const dist_record &rec)
+    {
+        dist_pipeline *p = static_cast<dist_pipeline *>(ctx);
+
+        if (p->rounds_.add(rec))
+        {
+            p->cb_(p->ctx_, p->rounds_.ranges(), p->rounds_.size());
+        }
+    }
+
+    round_builder<D>    rounds_;
+    dist_stream         stream_;
+    round_cb            cb_;
+    void               *ctx_;
+};
+
+} // namespace rtls
+
+#endif /* RTLS_DIST_STREAM_HPP_ */
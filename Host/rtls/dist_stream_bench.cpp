@@ -0,0 +1,288 @@
+/*! ----------------------------------------------------------------------------
+ * @file    dist_stream_bench.cpp
+ * @brief   Throughput of the DIST record stream of dist_stream.cpp
+ *
+ *          Builds a synthetic capture of the lab: tag rounds of A, B and C as
+ *          the old boards sent them, an 18 byte buffer per line with its NUL
+ *          padding, 1 % of the lines lost and a few lines of other text. The
+ *          block is fed again and again, in read() sized chunks, until the
+ *          requested size has gone through:
+ *          - parse: lines and records only
+ *          - pipeline: records grouped into rounds and solved (multilat.hpp)
+ *          and each pass prints GB/s, records/s and, for the pipeline, fixes/s.
+ *          The record and round counts are checked against the generator.
+ *
+ *          usage: dist_stream_bench [GB] [-w file] [-r file]
+ *          -w writes GB of the synthetic capture to a file instead, e.g. for
+ *          "time ./locate file"; -r times the pipeline on a file read with
+ *          read(), page cache included.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+#include "anchors.hpp"
+#include "dist_stream.hpp"
+#include "multilat.hpp"
+
+using namespace rtls;
+
+/* Bytes of the synthetic block */
+#define BENCH_BLOCK         (64 << 20)
+
+/* Bytes of the old boards' dist_str, sent whole whatever sprintf wrote */
+#define BENCH_DIST_STR      18
+
+static unsigned long long rng = 0x9E3779B97F4A7C15ULL;
+
+static double uniform(double lo, double hi)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return lo + (hi - lo) * (double)(rng >> 11) / (double)(1ULL << 53);
+}
+
+struct block
+{
+    std::vector<char>   data;
+    unsigned long long  records;
+    unsigned long long  breaks;     // records that close a round: label not after the previous one
+    char                first;      // first and last labels, for the break between two blocks
+    char                last;
+};
+
+static void make_block(block &b, const anchor_set &anchors)
+{
+    char line[BENCH_DIST_STR + 1];
+    double x, y, d;
+    int i;
+
+    b.data.reserve(BENCH_BLOCK + 256);
+    b.records = 0;
+    b.breaks = 0;
+    b.first = 0;
+    b.last = 0;
+    while (b.data.size() < BENCH_BLOCK)
+    {
+        x = uniform(0.5, 9.5);
+        y = uniform(0.5, 4.5);
+        for (i = 0; i < anchors.size(); i++)
+        {
+            if (uniform(0.0, 1.0) < 0.01)
+            {
+                continue;
+            }
+            d = std::hypot(x - anchors[i].pos[0], y - anchors[i].pos[1]) + uniform(-0.1, 0.1);
+            memset(line, 0, sizeof(line));
+            snprintf(line, sizeof(line), "DIST %c: %3.2f m \r\n", anchors[i].label, d);
+            b.data.insert(b.data.end(), line, line + BENCH_DIST_STR);
+            b.records++;
+            if (b.first == 0)
+            {
+                b.first = anchors[i].label;
+            }
+            else if (anchors[i].label <= b.last)
+            {
+                b.breaks++;
+            }
+            b.last = anchors[i].label;
+        }
+        if (uniform(0.0, 1.0) < 0.001)
+        {
+            static const char other[] = "Ranging started\r\n";
+
+            b.data.insert(b.data.end(), other, other + sizeof(other) - 1);
+        }
+    }
+}
+
+static void count_record(void *ctx, const dist_record &rec)
+{
+    (void)rec;
+    (*static_cast<unsigned long long *>(ctx))++;
+}
+
+struct solve_ctx
+{
+    unsigned long long rounds;
+    unsigned long long fixes;
+    double sink;
+};
+
+static void solve_round(void *ctx, const range<2> *r, int n)
+{
+    solve_ctx &c = *static_cast<solve_ctx *>(ctx);
+    fix<2> f;
+
+    c.rounds++;
+    if (n >= 3)
+    {
+        f = multilaterate(r, n);
+        c.fixes++;
+        c.sink += f.pos[0];
+    }
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* Feed the block until total bytes have gone through, in read() sized chunks; returns the number of blocks */
+template <typename S>
+static unsigned long feed_blocks(S &s, const block &b, unsigned long long total)
+{
+    unsigned long long done = 0;
+    unsigned long blocks = 0;
+    size_t off, n;
+
+    while (done < total)
+    {
+        for (off = 0; off < b.data.size(); off += n)
+        {
+            n = b.data.size() - off;
+            n = (n < RTLS_READ_CHUNK) ? n : RTLS_READ_CHUNK;
+            s.feed(&b.data[off], n);
+        }
+        done += b.data.size();
+        blocks++;
+    }
+    return blocks;
+}
+
+static int write_file(const char *path, const block &b, unsigned long long total)
+{
+    unsigned long long done;
+    FILE *f = fopen(path, "wb");
+
+    if (f == NULL)
+    {
+        perror(path);
+        return 1;
+    }
+    for (done = 0; done < total; done += b.data.size())
+    {
+        if (fwrite(b.data.data(), 1, b.data.size(), f) != b.data.size())
+        {
+            perror(path);
+            fclose(f);
+            return 1;
+        }
+    }
+    fclose(f);
+    printf("%s: %.2f GB, %llu records\n", path, done / 1e9, b.records * (done / b.data.size()));
+    return 0;
+}
+
+static int read_file(const char *path, const anchor_set &anchors)
+{
+    solve_ctx c = { 0, 0, 0.0 };
+    dist_pipeline<2> p(anchors, solve_round, &c);
+    double t;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        perror(path);
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    if (p.read_fd(fd) < 0)
+    {
+        perror(path);
+    }
+    p.finish();
+    t = seconds_since(start);
+    close(fd);
+
+    printf("%s: %.2f GB in %.2f s, %.2f GB/s, %.1f M records/s, %.1f M fixes/s\n", path, p.stats().bytes / 1e9, t,
+           p.stats().bytes / 1e9 / t, p.stats().records / 1e6 / t, c.fixes / 1e6 / t);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    double gb = 2.0;
+    const char *wpath = NULL, *rpath = NULL;
+    unsigned long long total, records = 0, rounds;
+    unsigned long blocks;
+    anchor_set anchors;
+    block b;
+    double t;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+        {
+            wpath = argv[++i];
+        }
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+        {
+            rpath = argv[++i];
+        }
+        else if (atof(argv[i]) > 0.0)
+        {
+            gb = atof(argv[i]);
+        }
+        else
+        {
+            fprintf(stderr, "usage: dist_stream_bench [GB] [-w file] [-r file]\n");
+            return 1;
+        }
+    }
+    anchors.preset("lab");
+    if (rpath != NULL)
+    {
+        return read_file(rpath, anchors);
+    }
+
+    make_block(b, anchors);
+    total = (unsigned long long)(gb * 1e9);
+    if (wpath != NULL)
+    {
+        return write_file(wpath, b, total);
+    }
+
+    /* Parse only */
+    dist_stream s(count_record, &records);
+    auto start = std::chrono::steady_clock::now();
+    blocks = feed_blocks(s, b, total);
+    s.finish();
+    t = seconds_since(start);
+    printf("parse:    %.2f GB in %.2f s, %.2f GB/s, %.1f M lines/s, %.1f M records/s\n", s.stats().bytes / 1e9, t,
+           s.stats().bytes / 1e9 / t, (s.stats().lines + s.stats().padding) / 1e6 / t, records / 1e6 / t);
+
+    /* Parse, group and solve */
+    solve_ctx c = { 0, 0, 0.0 };
+    dist_pipeline<2> p(anchors, solve_round, &c);
+    start = std::chrono::steady_clock::now();
+    feed_blocks(p, b, total);
+    p.finish();
+    t = seconds_since(start);
+    printf("pipeline: %.2f GB in %.2f s, %.2f GB/s, %.1f M records/s, %.1f M fixes/s (%llu rounds of 3 anchors)%s\n",
+           p.stats().bytes / 1e9, t, p.stats().bytes / 1e9 / t, p.stats().records / 1e6 / t, c.fixes / 1e6 / t,
+           c.fixes, (c.sink == 0.0) ? " " : "");
+
+    if (records != b.records * blocks || p.stats().records != records)
+    {
+        printf("record count mismatch: %llu and %llu, expected %llu\n", records, p.stats().records,
+               b.records * blocks);
+        return 1;
+    }
+    /* The last round is closed by the end of the stream */
+    rounds = 1 + b.breaks * blocks + ((b.first <= b.last) ? blocks - 1 : 0);
+    if (c.rounds != rounds)
+    {
+        printf("round count mismatch: %llu, expected %llu\n", c.rounds, rounds);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,201 @@
+/*! ----------------------------------------------------------------------------
+ * @file    lanes.hpp
+ * @brief   Float SIMD lanes for the batch solvers
+ *
+ *          lanes holds RTLS_LANES floats, one per tag, and lane_mask one flag
+ *          per lane. The width comes from the compiler flags:
+ *          - -mavx512f: 16 lanes in a __m512
+ *          - -mavx2 -mfma: 8 lanes in a __m256
+ *          - otherwise 8 lanes in a plain array, which the compiler may still
+ *            vectorise with whatever it is allowed to use
+ *          Only the operations the solvers need are here. A branch on lane
+ *          data becomes a mask and a select, and loops over lanes stop when
+ *          none() or all() of a mask says so.
+ */
+
+#ifndef RTLS_LANES_HPP_
+#define RTLS_LANES_HPP_
+
+#include <cmath>
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define RTLS_LANES          16
+#define RTLS_LANES_ISA      "avx512"
+#elif defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define RTLS_LANES          8
+#define RTLS_LANES_ISA      "avx2"
+#else
+#define RTLS_LANES          8
+#define RTLS_LANES_ISA      "scalar"
+#endif
+
+namespace rtls
+{
+
+#if defined(__AVX512F__)
+
+struct lane_mask
+{
+    __mmask16 m;
+};
+
+struct alignas(64) lanes
+{
+    __m512 v;
+
+    static lanes of(float x) { return lanes{ _mm512_set1_ps(x) }; }
+    static lanes load(const float *p) { return lanes{ _mm512_load_ps(p) }; }
+    void store(float *p) const { _mm512_store_ps(p, v); }
+};
+
+inline lanes operator+(lanes a, lanes b) { return lanes{ _mm512_add_ps(a.v, b.v) }; }
+inline lanes operator-(lanes a, lanes b) { return lanes{ _mm512_sub_ps(a.v, b.v) }; }
+inline lanes operator*(lanes a, lanes b) { return lanes{ _mm512_mul_ps(a.v, b.v) }; }
+inline lanes operator/(lanes a, lanes b) { return lanes{ _mm512_div_ps(a.v, b.v) }; }
+inline lanes fma(lanes a, lanes b, lanes c) { return lanes{ _mm512_fmadd_ps(a.v, b.v, c.v) }; }
+inline lanes sqrt(lanes a) { return lanes{ _mm512_maskz_sqrt_ps((__mmask16)0xFFFF, a.v) }; }
+
+inline lane_mask operator<(lanes a, lanes b) { return lane_mask{ _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ) }; }
+inline lane_mask operator>(lanes a, lanes b) { return lane_mask{ _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ) }; }
+inline lane_mask operator&(lane_mask a, lane_mask b) { return lane_mask{ (__mmask16)(a.m & b.m) }; }
+inline lane_mask operator|(lane_mask a, lane_mask b) { return lane_mask{ (__mmask16)(a.m | b.m) }; }
+inline lane_mask operator~(lane_mask a) { return lane_mask{ (__mmask16)~a.m }; }
+inline bool none(lane_mask a) { return a.m == 0; }
+inline bool all(lane_mask a) { return a.m == 0xFFFF; }
+inline bool lane(lane_mask a, int i) { return (a.m >> i) & 1; }
+
+/* m ? a : b per lane */
+inline lanes select(lane_mask m, lanes a, lanes b) { return lanes{ _mm512_mask_blend_ps(m.m, b.v, a.v) }; }
+
+#elif defined(__AVX2__) && defined(__FMA__)
+
+struct lane_mask
+{
+    __m256 m;
+};
+
+struct alignas(32) lanes
+{
+    __m256 v;
+
+    static lanes of(float x) { return lanes{ _mm256_set1_ps(x) }; }
+    static lanes load(const float *p) { return lanes{ _mm256_load_ps(p) }; }
+    void store(float *p) const { _mm256_store_ps(p, v); }
+};
+
+inline lanes operator+(lanes a, lanes b) { return lanes{ _mm256_add_ps(a.v, b.v) }; }
+inline lanes operator-(lanes a, lanes b) { return lanes{ _mm256_sub_ps(a.v, b.v) }; }
+inline lanes operator*(lanes a, lanes b) { return lanes{ _mm256_mul_ps(a.v, b.v) }; }
+inline lanes operator/(lanes a, lanes b) { return lanes{ _mm256_div_ps(a.v, b.v) }; }
+inline lanes fma(lanes a, lanes b, lanes c) { return lanes{ _mm256_fmadd_ps(a.v, b.v, c.v) }; }
+inline lanes sqrt(lanes a) { return lanes{ _mm256_sqrt_ps(a.v) }; }
+
+inline lane_mask operator<(lanes a, lanes b) { return lane_mask{ _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline lane_mask operator>(lanes a, lanes b) { return lane_mask{ _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline lane_mask operator&(lane_mask a, lane_mask b) { return lane_mask{ _mm256_and_ps(a.m, b.m) }; }
+inline lane_mask operator|(lane_mask a, lane_mask b) { return lane_mask{ _mm256_or_ps(a.m, b.m) }; }
+inline lane_mask operator~(lane_mask a) { return lane_mask{ _mm256_xor_ps(a.m, _mm256_castsi256_ps(_mm256_set1_epi32(-1))) }; }
+inline bool none(lane_mask a) { return _mm256_movemask_ps(a.m) == 0; }
+inline bool all(lane_mask a) { return _mm256_movemask_ps(a.m) == 0xFF; }
+inline bool lane(lane_mask a, int i) { return (_mm256_movemask_ps(a.m) >> i) & 1; }
+
+/* m ? a : b per lane */
+inline lanes select(lane_mask m, lanes a, lanes b) { return lanes{ _mm256_blendv_ps(b.v, a.v, m.m) }; }
+
+#else
+
+struct lane_mask
+{
+    bool m[RTLS_LANES];
+};
+
+struct alignas(16) lanes
+{
+    float v[RTLS_LANES];
+
+    static lanes of(float x)
+    {
+        lanes r;
+
+        for (int i = 0; i < RTLS_LANES; i++)
+        {
+            r.v[i] = x;
+        }
+        return r;
+    }
+    static lanes load(const float *p)
+    {
+        lanes r;
+
+        for (int i = 0; i < RTLS_LANES; i++)
+        {
+            r.v[i] = p[i];
+        }
+        return r;
+    }
+    void store(float *p) const
+    {
+        for (int i = 0; i < RTLS_LANES; i++)
+        {
+            p[i] = v[i];
+        }
+    }
+};
+
+#define RTLS_LANEWISE(type, expr)           \
+    type r;                                 \
+    for (int i = 0; i < RTLS_LANES; i++)    \
+    {                                       \
+        expr;                               \
+    }                                       \
+    return r;
+
+inline lanes operator+(lanes a, lanes b) { RTLS_LANEWISE(lanes, r.v[i] = a.v[i] + b.v[i]) }
+inline lanes operator-(lanes a, lanes b) { RTLS_LANEWISE(lanes, r.v[i] = a.v[i] - b.v[i]) }
+inline lanes operator*(lanes a, lanes b) { RTLS_LANEWISE(lanes, r.v[i] = a.v[i] * b.v[i]) }
+inline lanes operator/(lanes a, lanes b) { RTLS_LANEWISE(lanes, r.v[i] = a.v[i] / b.v[i]) }
+inline lanes fma(lanes a, lanes b, lanes c) { RTLS_LANEWISE(lanes, r.v[i] = a.v[i] * b.v[i] + c.v[i]) }
+inline lanes sqrt(lanes a) { RTLS_LANEWISE(lanes, r.v[i] = std::sqrt(a.v[i])) }
+
+inline lane_mask operator<(lanes a, lanes b) { RTLS_LANEWISE(lane_mask, r.m[i] = a.v[i] < b.v[i]) }
+inline lane_mask operator>(lanes a, lanes b) { RTLS_LANEWISE(lane_mask, r.m[i] = a.v[i] > b.v[i]) }
+inline lane_mask operator&(lane_mask a, lane_mask b) { RTLS_LANEWISE(lane_mask, r.m[i] = a.m[i] && b.m[i]) }
+inline lane_mask operator|(lane_mask a, lane_mask b) { RTLS_LANEWISE(lane_mask, r.m[i] = a.m[i] || b.m[i]) }
+inline lane_mask operator~(lane_mask a) { RTLS_LANEWISE(lane_mask, r.m[i] = !a.m[i]) }
+inline lanes select(lane_mask m, lanes a, lanes b) { RTLS_LANEWISE(lanes, r.v[i] = m.m[i] ? a.v[i] : b.v[i]) }
+
+#undef RTLS_LANEWISE
+
+inline bool none(lane_mask a)
+{
+    for (int i = 0; i < RTLS_LANES; i++)
+    {
+        if (a.m[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool all(lane_mask a)
+{
+    for (int i = 0; i < RTLS_LANES; i++)
+    {
+        if (!a.m[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool lane(lane_mask a, int i) { return a.m[i]; }
+
+#endif
+
+} // namespace rtls
+
+#endif /* RTLS_LANES_HPP_ */
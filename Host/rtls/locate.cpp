@@ -0,0 +1,148 @@
+/*! ----------------------------------------------------------------------------
+ * @file    locate.cpp
+ * @brief   Positions from "DIST A: 1.23 m" records, the solver of Trilateration.ipynb on the PC
+ *
+ *          Reads the DIST records of a capture, or of report_decode on the
+ *          serial device, as a stream (see dist_stream.hpp). It groups them
+ *          into rounds (see dist_record.hpp) and prints one least squares fix
+ *          per round with at least D + 1 known anchors, as CSV: round,
+ *          position, residual RMS, anchors used.
+ *          The fixes are printed as the rounds close, so a live stream can be
+ *          followed. At the end it prints to stderr how many lines and rounds
+ *          there were.
+ *
+ *          usage: locate [-3] [-s lab|living] [-a A=x,y[,z]]... [-f anchors] [file]
+ *          -3 solves in 3D, the anchors then need a z.
+ *          -s starts from one of the notebook's rooms, lab by default when no
+ *          anchor is given; -a adds or moves an anchor; -f reads "A x y [z]"
+ *          lines.
+ *
+ *          ./report_decode /dev/ttyACM0 | ./locate -s lab
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "anchors.hpp"
+#include "dist_stream.hpp"
+#include "multilat.hpp"
+
+using namespace rtls;
+
+struct locate_ctx
+{
+    unsigned long rounds;
+    unsigned long fixes;
+    unsigned long too_few;
+    unsigned long failed;
+};
+
+template <int D>
+static void solve_round(void *ctx, const range<D> *r, int n)
+{
+    locate_ctx &st = *static_cast<locate_ctx *>(ctx);
+    fix<D> f;
+
+    st.rounds++;
+    if (n < D + 1)
+    {
+        st.too_few++;
+        return;
+    }
+    f = multilaterate(r, n);
+    if (f.status != fix_status::ok && f.status != fix_status::no_convergence)
+    {
+        st.failed++;
+        return;
+    }
+    st.fixes++;
+    printf("%lu", st.rounds);
+    for (int k = 0; k < D; k++)
+    {
+        printf(",%.3f", f.pos[k]);
+    }
+    printf(",%.3f,%d\n", f.rms, n);
+}
+
+template <int D>
+static int locate(int fd, const anchor_set &anchors)
+{
+    locate_ctx st = { 0, 0, 0, 0 };
+    dist_pipeline<D> pipeline(anchors, solve_round<D>, &st);
+    int ret;
+
+    printf(D == 3 ? "round,x,y,z,rms,anchors\n" : "round,x,y,rms,anchors\n");
+    ret = pipeline.read_fd(fd);
+    pipeline.finish();
+
+    fprintf(stderr, "%llu records, %llu other lines, %llu blank; %lu rounds, %lu fixes, %lu with too few anchors, "
+            "%lu degenerate, %lu records of unknown anchors\n",
+            pipeline.stats().records, pipeline.stats().bad, pipeline.stats().padding, st.rounds, st.fixes, st.too_few,
+            st.failed, pipeline.unknown());
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    anchor_set anchors;
+    const char *path = NULL;
+    int dim = 2;
+    int fd = 0;
+    int opt;
+    int ret;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-3") == 0)
+        {
+            dim = 3;
+        }
+        else if ((opt = anchors.option(argv[i], (i + 1 < argc) ? argv[i + 1] : NULL)) != 0)
+        {
+            if (opt < 0)
+            {
+                return 1;
+            }
+            i++;
+        }
+        else if (argv[i][0] == '-' && argv[i][1] != '\0')
+        {
+            fprintf(stderr, "usage: locate [-3] [-s lab|living] [-a A=x,y[,z]]... [-f anchors] [file]\n");
+            return 1;
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+    if (anchors.size() == 0)
+    {
+        anchors.preset("lab");
+    }
+
+    if (path != NULL)
+    {
+        fd = open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            perror(path);
+            return 1;
+        }
+    }
+
+    ret = (dim == 3) ? locate<3>(fd, anchors) : locate<2>(fd, anchors);
+    if (ret < 0)
+    {
+        perror((path != NULL) ? path : "stdin");
+    }
+
+    if (path != NULL)
+    {
+        close(fd);
+    }
+    return (ret < 0) ? 1 : 0;
+}
@@ -0,0 +1,233 @@
+/*! ----------------------------------------------------------------------------
+ * @file    mat.hpp
+ * @brief   Fixed size matrices for the position solvers
+ *
+ *          The sizes are template parameters, so a matrix is a plain array on
+ *          the stack: no allocation, and the compiler unrolls the loops of the
+ *          2x2 and 3x3 cases. Only what the solvers need is here.
+ */
+
+#ifndef RTLS_MAT_HPP_
+#define RTLS_MAT_HPP_
+
+#include <cmath>
+
+namespace rtls
+{
+
+template <int R, int C>
+struct mat
+{
+    double a[R][C];
+
+    static mat zero()
+    {
+        mat m;
+
+        for (int r = 0; r < R; r++)
+        {
+            for (int c = 0; c < C; c++)
+            {
+                m.a[r][c] = 0.0;
+            }
+        }
+        return m;
+    }
+
+    static mat identity()
+    {
+        static_assert(R == C, "identity of a non square matrix");
+        mat m = zero();
+
+        for (int i = 0; i < R; i++)
+        {
+            m.a[i][i] = 1.0;
+        }
+        return m;
+    }
+
+    double &operator()(int r, int c) { return a[r][c]; }
+    double operator()(int r, int c) const { return a[r][c]; }
+
+    /* Element i of a column vector */
+    double &operator[](int i)
+    {
+        static_assert(C == 1, "index of a matrix");
+        return a[i][0];
+    }
+    double operator[](int i) const
+    {
+        static_assert(C == 1, "index of a matrix");
+        return a[i][0];
+    }
+};
+
+template <int N>
+using vec = mat<N, 1>;
+
+template <int R, int C>
+inline mat<R, C> operator+(const mat<R, C> &x, const mat<R, C> &y)
+{
+    mat<R, C> m;
+
+    for (int r = 0; r < R; r++)
+    {
+        for (int c = 0; c < C; c++)
+        {
+            m.a[r][c] = x.a[r][c] + y.a[r][c];
+        }
+    }
+    return m;
+}
+
+template <int R, int C>
+inline mat<R, C> operator-(const mat<R, C> &x, const mat<R, C> &y)
+{
+    mat<R, C> m;
+
+    for (int r = 0; r < R; r++)
+    {
+        for (int c = 0; c < C; c++)
+        {
+            m.a[r][c] = x.a[r][c] - y.a[r][c];
+        }
+    }
+    return m;
+}
+
+template <int R, int C>
+inline mat<R, C> operator*(double s, const mat<R, C> &x)
+{
+    mat<R, C> m;
+
+    for (int r = 0; r < R; r++)
+    {
+        for (int c = 0; c < C; c++)
+        {
+            m.a[r][c] = s * x.a[r][c];
+        }
+    }
+    return m;
+}
+
+template <int R, int K, int C>
+inline mat<R, C> operator*(const mat<R, K> &x, const mat<K, C> &y)
+{
+    mat<R, C> m = mat<R, C>::zero();
+
+    for (int r = 0; r < R; r++)
+    {
+        for (int k = 0; k < K; k++)
+        {
+            for (int c = 0; c < C; c++)
+            {
+                m.a[r][c] += x.a[r][k] * y.a[k][c];
+            }
+        }
+    }
+    return m;
+}
+
+template <int R, int C>
+inline mat<C, R> transpose(const mat<R, C> &x)
+{
+    mat<C, R> m;
+
+    for (int r = 0; r < R; r++)
+    {
+        for (int c = 0; c < C; c++)
+        {
+            m.a[c][r] = x.a[r][c];
+        }
+    }
+    return m;
+}
+
+template <int N>
+inline double dot(const vec<N> &x, const vec<N> &y)
+{
+    double s = 0.0;
+
+    for (int i = 0; i < N; i++)
+    {
+        s += x.a[i][0] * y.a[i][0];
+    }
+    return s;
+}
+
+template <int N>
+inline double norm(const vec<N> &x)
+{
+    return std::sqrt(dot(x, x));
+}
+
+/*
+ * Solve A x = b for a symmetric positive definite A by Cholesky factorisation. Returns false, x untouched, if a pivot
+ * falls below rel_eps times the largest diagonal element: A is singular or nearly so (anchors in line, or in a plane
+ * for a 3D fix).
+ */
+template <int N>
+inline bool cholesky_solve(const mat<N, N> &A, const vec<N> &b, vec<N> &x, double rel_eps = 1e-12)
+{
+    mat<N, N> L = mat<N, N>::zero();
+    vec<N> y;
+    double max_diag = 0.0;
+    double s;
+
+    for (int i = 0; i < N; i++)
+    {
+        max_diag = (A.a[i][i] > max_diag) ? A.a[i][i] : max_diag;
+    }
+    if (!(max_diag > 0.0))
+    {
+        return false;
+    }
+
+    for (int j = 0; j < N; j++)
+    {
+        s = A.a[j][j];
+        for (int k = 0; k < j; k++)
+        {
+            s -= L.a[j][k] * L.a[j][k];
+        }
+        if (!(s > rel_eps * max_diag))
+        {
+            return false;
+        }
+        L.a[j][j] = std::sqrt(s);
+        for (int i = j + 1; i < N; i++)
+        {
+            s = A.a[i][j];
+            for (int k = 0; k < j; k++)
+            {
+                s -= L.a[i][k] * L.a[j][k];
+            }
+            L.a[i][j] = s / L.a[j][j];
+        }
+    }
+
+    /* L y = b, then L' x = y */
+    for (int i = 0; i < N; i++)
+    {
+        s = b.a[i][0];
+        for (int k = 0; k < i; k++)
+        {
+            s -= L.a[i][k] * y.a[k][0];
+        }
+        y.a[i][0] = s / L.a[i][i];
+    }
+    for (int i = N - 1; i >= 0; i--)
+    {
+        s = y.a[i][0];
+        for (int k = i + 1; k < N; k++)
+        {
+            s -= L.a[k][i] * x.a[k][0];
+        }
+        x.a[i][0] = s / L.a[i][i];
+    }
+    return true;
+}
+
+} // namespace rtls
+
+#endif /* RTLS_MAT_HPP_ */
@@ -0,0 +1,158 @@
+/*! ----------------------------------------------------------------------------
+ * @file    multilat.cpp
+ * @brief   N-anchor least squares multilateration, see multilat.hpp
+ */
+
+#include <cmath>
+
+#include "multilat.hpp"
+
+/* Below this distance from an anchor the residual has no direction, its row of the Jacobian is left out, m */
+#define MULTILAT_MIN_DIST   1e-9
+
+/* Step halvings tried when a Gauss-Newton step increases the residuals */
+#define MULTILAT_MAX_HALVINGS   8
+
+namespace rtls
+{
+
+/* Sum of the squared residuals at x */
+template <int D>
+static double cost(const range<D> *r, int n, const vec<D> &x)
+{
+    double s = 0.0;
+    double e;
+
+    for (int i = 0; i < n; i++)
+    {
+        e = norm(x - r[i].anchor) - r[i].distance;
+        s += e * e;
+    }
+    return s;
+}
+
+template <int D>
+bool linear_guess(const range<D> *r, int n, vec<D> &pos)
+{
+    mat<D, D> AtA = mat<D, D>::zero();
+    vec<D> Atb = vec<D>::zero();
+    vec<D> p, y;
+    double b;
+
+    if (n < D + 1)
+    {
+        return false;
+    }
+
+    /* Relative to the first anchor, y = x - anchor_0: 2 p_i . y = d_0^2 - d_i^2 + |p_i|^2 with p_i = anchor_i - anchor_0 */
+    for (int i = 1; i < n; i++)
+    {
+        p = r[i].anchor - r[0].anchor;
+        b = r[0].distance * r[0].distance - r[i].distance * r[i].distance + dot(p, p);
+        for (int j = 0; j < D; j++)
+        {
+            for (int k = 0; k < D; k++)
+            {
+                AtA(j, k) += 4.0 * p[j] * p[k];
+            }
+            Atb[j] += 2.0 * p[j] * b;
+        }
+    }
+
+    if (!cholesky_solve(AtA, Atb, y))
+    {
+        return false;
+    }
+    pos = y + r[0].anchor;
+    return true;
+}
+
+template <int D>
+fix<D> multilaterate(const range<D> *r, int n, const solver_options &opt)
+{
+    fix<D> f;
+    mat<D, D> JtJ;
+    vec<D> Jtr, u, step, next;
+    double dist, e, c, next_c;
+    int h;
+
+    f.pos = vec<D>::zero();
+    f.rms = 0.0;
+    f.iterations = 0;
+    if (n < D + 1)
+    {
+        f.status = fix_status::too_few_ranges;
+        return f;
+    }
+    if (!linear_guess(r, n, f.pos))
+    {
+        f.status = fix_status::degenerate;
+        return f;
+    }
+
+    c = cost(r, n, f.pos);
+    f.status = fix_status::no_convergence;
+    while (f.iterations < opt.max_iterations)
+    {
+        JtJ = mat<D, D>::zero();
+        Jtr = vec<D>::zero();
+        for (int i = 0; i < n; i++)
+        {
+            u = f.pos - r[i].anchor;
+            dist = norm(u);
+            if (dist < MULTILAT_MIN_DIST)
+            {
+                continue;
+            }
+            u = (1.0 / dist) * u;
+            e = dist - r[i].distance;
+            for (int j = 0; j < D; j++)
+            {
+                for (int k = 0; k < D; k++)
+                {
+                    JtJ(j, k) += u[j] * u[k];
+                }
+                Jtr[j] -= u[j] * e;
+            }
+        }
+        f.iterations++;
+
+        if (!cholesky_solve(JtJ, Jtr, step))
+        {
+            f.status = fix_status::degenerate;
+            break;
+        }
+
+        /* Gauss-Newton can overshoot far from the solution, shorten the step until the residuals go down */
+        next = f.pos + step;
+        next_c = cost(r, n, next);
+        for (h = 0; h < MULTILAT_MAX_HALVINGS && next_c > c; h++)
+        {
+            step = 0.5 * step;
+            next = f.pos + step;
+            next_c = cost(r, n, next);
+        }
+        if (next_c <= c)
+        {
+            f.pos = next;
+            c = next_c;
+        }
+
+        if (norm(step) < opt.tolerance || next_c > c)
+        {
+            /* Converged, or no step length improves on pos: a minimum as far as doubles can tell */
+            f.status = fix_status::ok;
+            break;
+        }
+    }
+
+    f.rms = std::sqrt(c / n);
+    return f;
+}
+
+template bool linear_guess<2>(const range<2> *, int, vec<2> &);
+template bool linear_guess<3>(const range<3> *, int, vec<3> &);
+template fix<2> multilaterate<2>(const range<2> *, int, const solver_options &);
+template fix<3> multilaterate<3>(const range<3> *, int, const solver_options &);
+
+} // namespace rtls
@@ -0,0 +1,102 @@
+/*! ----------------------------------------------------------------------------
+ * @file    multilat.hpp
+ * @brief   N-anchor least squares multilateration, 2D and 3D
+ *
+ *          Trilateration.ipynb solves the position from exactly three anchors
+ *          with 2x2 determinant ratios: the circle equations of anchors B and
+ *          C minus that of A. That is exact for perfect distances, but it
+ *          minimises nothing, so with noisy distances the error depends on
+ *          which anchor is subtracted, and a fourth anchor cannot help.
+ *
+ *          multilaterate() minimises the sum of the squared distance residuals
+ *          |x - anchor_i| - d_i over any number of anchors by Gauss-Newton.
+ *          It starts from linear_guess(), the least squares solution of the
+ *          notebook's subtracted equations (the same point for three anchors
+ *          in 2D). Each iteration accumulates the DxD normal equations anchor
+ *          by anchor and solves them by Cholesky, so nothing is allocated and
+ *          the cost is linear in the number of anchors.
+ *
+ *          A 2D fix needs 3 anchors, a 3D fix 4 that are not in one plane.
+ *          See Host/README.md for locate and the benchmark.
+ */
+
+#ifndef RTLS_MULTILAT_HPP_
+#define RTLS_MULTILAT_HPP_
+
+#include "mat.hpp"
+
+namespace rtls
+{
+
+/* One measured distance */
+template <int D>
+struct range
+{
+    vec<D> anchor;          // anchor position, m
+    double distance;        // measured distance, m
+};
+
+enum class fix_status
+{
+    ok,
+    too_few_ranges,         // fewer than D + 1
+    degenerate,             // anchors in line (2D) or in a plane (3D), the position is not determined
+    no_convergence,         // max_iterations reached, the position is the last iterate
+};
+
+template <int D>
+struct fix
+{
+    vec<D>      pos;        // m
+    double      rms;        // RMS of the distance residuals at pos, m
+    int         iterations; // Gauss-Newton iterations done
+    fix_status  status;
+};
+
+struct solver_options
+{
+    int     max_iterations = 10;
+    double  tolerance = 1e-3;       // stop when a step is shorter than this, m
+};
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn linear_guess()
+ *
+ * @brief Least squares solution of the equations |x - anchor_i|^2 = d_i^2 minus the one of the first anchor.
+ *
+ * input parameters
+ * @param r   - ranges
+ * @param n   - number of ranges, at least D + 1
+ *
+ * output parameters
+ * @param pos - position, m
+ *
+ * returns false if there are too few ranges or the anchors are degenerate, pos is then untouched
+ */
+template <int D>
+bool linear_guess(const range<D> *r, int n, vec<D> &pos);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn multilaterate()
+ *
+ * @brief Gauss-Newton least squares position from n ranges, starting from linear_guess(). A step that would increase
+ *        the residuals is halved until it does not.
+ *
+ * input parameters
+ * @param r   - ranges
+ * @param n   - number of ranges
+ * @param opt - iteration limits
+ *
+ * returns the fix; pos and rms are meaningful for fix_status::ok and fix_status::no_convergence
+ */
+template <int D>
+fix<D> multilaterate(const range<D> *r, int n, const solver_options &opt = solver_options());
+
+extern template bool linear_guess<2>(const range<2> *, int, vec<2> &);
+extern template bool linear_guess<3>(const range<3> *, int, vec<3> &);
+extern template fix<2> multilaterate<2>(const range<2> *, int, const solver_options &);
+extern template fix<3> multilaterate<3>(const range<3> *, int, const solver_options &);
+
+} // namespace rtls
+
+#endif /* RTLS_MULTILAT_HPP_ */
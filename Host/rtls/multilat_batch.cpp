@@ -0,0 +1,348 @@
+/*! ----------------------------------------------------------------------------
+ * @file    multilat_batch.cpp
+ * @brief   Multilateration of many tags at once, see multilat_batch.hpp
+ */
+
+#include "multilat_batch.hpp"
+
+/* As in multilat.cpp: residuals closer than this to their anchor are left out of the Jacobian, m */
+#define BATCH_MIN_DIST          1e-6f
+
+/* As in multilat.cpp */
+#define BATCH_MAX_HALVINGS      8
+
+/* Relative pivot below which a lane's system is singular: cholesky_solve()'s 1e-12 scaled to float */
+#define BATCH_REL_EPS           1e-6f
+
+namespace rtls
+{
+
+/* cholesky_solve() on every lane, returns the lanes whose A is positive definite; the others get x = 0 */
+template <int D>
+static lane_mask lane_cholesky_solve(const lanes (&A)[D][D], const lanes (&b)[D], lanes (&x)[D])
+{
+    lanes L[D][D], y[D];
+    lanes max_diag = A[0][0], s, eps;
+    lane_mask ok, pivot;
+
+    for (int i = 1; i < D; i++)
+    {
+        max_diag = select(A[i][i] > max_diag, A[i][i], max_diag);
+    }
+    eps = lanes::of(BATCH_REL_EPS) * max_diag;
+    ok = max_diag > lanes::of(0.0f);
+
+    for (int j = 0; j < D; j++)
+    {
+        s = A[j][j];
+        for (int k = 0; k < j; k++)
+        {
+            s = s - L[j][k] * L[j][k];
+        }
+        /* A failed lane carries on with a pivot of 1, its result is thrown away */
+        pivot = s > eps;
+        ok = ok & pivot;
+        L[j][j] = sqrt(select(pivot, s, lanes::of(1.0f)));
+        for (int i = j + 1; i < D; i++)
+        {
+            s = A[i][j];
+            for (int k = 0; k < j; k++)
+            {
+                s = s - L[i][k] * L[j][k];
+            }
+            L[i][j] = s / L[j][j];
+        }
+    }
+
+    for (int i = 0; i < D; i++)
+    {
+        s = b[i];
+        for (int k = 0; k < i; k++)
+        {
+            s = s - L[i][k] * y[k];
+        }
+        y[i] = s / L[i][i];
+    }
+    for (int i = D - 1; i >= 0; i--)
+    {
+        s = y[i];
+        for (int k = i + 1; k < D; k++)
+        {
+            s = s - L[k][i] * x[k];
+        }
+        x[i] = select(ok, s / L[i][i], lanes::of(0.0f));
+    }
+    return ok;
+}
+
+template <int D>
+batch_multilat<D>::batch_multilat(int max_anchors) : max_(max_anchors)
+{
+}
+
+template <int D>
+void batch_multilat<D>::clear()
+{
+    tags_ = 0;
+    block_n_.clear();
+    n_.clear();
+    origin_.clear();
+}
+
+template <int D>
+int batch_multilat<D>::add(const range<D> *r, int n)
+{
+    int block = tags_ / RTLS_LANES;
+    int l = tags_ % RTLS_LANES;
+    vec<D> origin = (n > 0) ? r[0].anchor : vec<D>::zero();
+
+    if (n > max_)
+    {
+        return -1;
+    }
+    if (l == 0)
+    {
+        /* A new block, all padding */
+        data_.resize((size_t)(block + 1) * max_ * FIELDS);
+        for (int k = 0; k < max_; k++)
+        {
+            for (int f = 0; f < FIELDS; f++)
+            {
+                field(block, k, f) = lanes::of(0.0f);
+            }
+        }
+        block_n_.push_back(0);
+    }
+
+    /* The lanes types alias floats: they are compiler vector types, or arrays of float */
+    for (int k = 0; k < n; k++)
+    {
+        for (int j = 0; j < D; j++)
+        {
+            reinterpret_cast<float *>(&field(block, k, j))[l] = (float)(r[k].anchor[j] - origin[j]);
+        }
+        reinterpret_cast<float *>(&field(block, k, D))[l] = (float)r[k].distance;
+        reinterpret_cast<float *>(&field(block, k, D + 1))[l] = 1.0f;
+    }
+    block_n_[block] = (n > block_n_[block]) ? n : block_n_[block];
+    n_.push_back(n);
+    origin_.push_back(origin);
+    return tags_++;
+}
+
+template <int D>
+void batch_multilat<D>::solve(fix<D> *out, const solver_options &opt) const
+{
+    for (int b = 0; b * RTLS_LANES < tags_; b++)
+    {
+        solve_block(b, out, opt);
+    }
+}
+
+template <int D>
+void batch_multilat<D>::solve_block(int block, fix<D> *out, const solver_options &opt) const
+{
+    const int slots = block_n_[block];
+    const lanes zero = lanes::of(0.0f), one = lanes::of(1.0f), half = lanes::of(0.5f);
+    const lanes min_dist = lanes::of(BATCH_MIN_DIST);
+    const lanes tol2 = lanes::of((float)(opt.tolerance * opt.tolerance));
+    lanes A[D][D], rhs[D], y[D], step[D], next[D], u[D];
+    lanes c, next_c, n, iterations, dist, e, w, p2, b, d0;
+    lane_mask active, degenerate, converged, worse, valid;
+    float n_f[RTLS_LANES], rms_f[RTLS_LANES], it_f[RTLS_LANES], pos_f[D][RTLS_LANES];
+    int first = block * RTLS_LANES;
+    int count = (tags_ - first < RTLS_LANES) ? tags_ - first : RTLS_LANES;
+    int h, l;
+
+    /* Sum of the squared residuals at x, over the anchor slots in use */
+    auto cost = [&](const lanes (&x)[D]) {
+        lanes s = zero, q, r;
+
+        for (int k = 0; k < slots; k++)
+        {
+            q = zero;
+            for (int j = 0; j < D; j++)
+            {
+                r = x[j] - field(block, k, j);
+                q = fma(r, r, q);
+            }
+            r = sqrt(q) - field(block, k, D);
+            s = fma(field(block, k, D + 1) * r, r, s);
+        }
+        return s;
+    };
+
+    /* Anchors per lane, 0 for the padding lanes of the last block */
+    for (l = 0; l < RTLS_LANES; l++)
+    {
+        n_f[l] = (l < count) ? (float)n_[first + l] : 0.0f;
+    }
+    n = lanes::load(n_f);
+
+    /* linear_guess(): 2 p_k . y = d_0^2 - d_k^2 + |p_k|^2, p_k the anchors already relative to the first one */
+    for (int i = 0; i < D; i++)
+    {
+        for (int j = 0; j < D; j++)
+        {
+            A[i][j] = zero;
+        }
+        rhs[i] = zero;
+    }
+    d0 = field(block, 0, D);
+    for (int k = 1; k < slots; k++)
+    {
+        w = field(block, k, D + 1);
+        p2 = zero;
+        for (int j = 0; j < D; j++)
+        {
+            p2 = fma(field(block, k, j), field(block, k, j), p2);
+        }
+        b = d0 * d0 - field(block, k, D) * field(block, k, D) + p2;
+        for (int i = 0; i < D; i++)
+        {
+            u[i] = w * field(block, k, i);
+        }
+        for (int i = 0; i < D; i++)
+        {
+            for (int j = 0; j <= i; j++)
+            {
+                A[i][j] = fma(u[i], field(block, k, j), A[i][j]);
+            }
+            rhs[i] = fma(u[i], b, rhs[i]);
+        }
+    }
+    for (int i = 0; i < D; i++)
+    {
+        for (int j = i + 1; j < D; j++)
+        {
+            A[i][j] = A[j][i];
+        }
+        /* The factors 4 and 2 of multilat.cpp cancel but for one half */
+        rhs[i] = half * rhs[i];
+    }
+    active = lane_cholesky_solve<D>(A, rhs, y) & (n > lanes::of((float)D + 0.5f));
+    degenerate = ~active & (n > lanes::of((float)D + 0.5f));
+
+    /* multilaterate(): Gauss-Newton, each lane stopping on its own */
+    c = cost(y);
+    iterations = zero;
+    converged = zero > one;
+    for (int it = 0; it < opt.max_iterations && !none(active); it++)
+    {
+        for (int i = 0; i < D; i++)
+        {
+            for (int j = 0; j < D; j++)
+            {
+                A[i][j] = zero;
+            }
+            rhs[i] = zero;
+        }
+        for (int k = 0; k < slots; k++)
+        {
+            p2 = zero;
+            for (int j = 0; j < D; j++)
+            {
+                u[j] = y[j] - field(block, k, j);
+                p2 = fma(u[j], u[j], p2);
+            }
+            dist = sqrt(p2);
+            valid = (field(block, k, D + 1) > zero) & (dist > min_dist);
+            w = select(valid, one / dist, zero);
+            e = dist - field(block, k, D);
+            for (int i = 0; i < D; i++)
+            {
+                u[i] = w * u[i];
+            }
+            for (int i = 0; i < D; i++)
+            {
+                for (int j = 0; j <= i; j++)
+                {
+                    A[i][j] = fma(u[i], u[j], A[i][j]);
+                }
+                rhs[i] = rhs[i] - u[i] * e;
+            }
+        }
+        for (int i = 0; i < D; i++)
+        {
+            for (int j = i + 1; j < D; j++)
+            {
+                A[i][j] = A[j][i];
+            }
+        }
+        iterations = select(active, iterations + one, iterations);
+
+        valid = lane_cholesky_solve<D>(A, rhs, step);
+        degenerate = degenerate | (active & ~valid);
+        active = active & valid;
+        for (int j = 0; j < D; j++)
+        {
+            step[j] = select(active, step[j], zero);
+            next[j] = y[j] + step[j];
+        }
+
+        /* Halve the steps of the lanes whose residuals went up, until none does */
+        next_c = cost(next);
+        worse = next_c > c;
+        for (h = 0; h < BATCH_MAX_HALVINGS && !none(worse); h++)
+        {
+            for (int j = 0; j < D; j++)
+            {
+                step[j] = select(worse, half * step[j], step[j]);
+                next[j] = y[j] + step[j];
+            }
+            next_c = select(worse, cost(next), next_c);
+            worse = next_c > c;
+        }
+        for (int j = 0; j < D; j++)
+        {
+            y[j] = select(worse, y[j], next[j]);
+        }
+        c = select(worse, c, next_c);
+
+        p2 = zero;
+        for (int j = 0; j < D; j++)
+        {
+            p2 = fma(step[j], step[j], p2);
+        }
+        valid = active & ((p2 < tol2) | worse);
+        converged = converged | valid;
+        active = active & ~valid;
+    }
+
+    sqrt(c / select(n > zero, n, one)).store(rms_f);
+    iterations.store(it_f);
+    for (int j = 0; j < D; j++)
+    {
+        y[j].store(pos_f[j]);
+    }
+    for (l = 0; l < count; l++)
+    {
+        fix<D> &f = out[first + l];
+
+        for (int j = 0; j < D; j++)
+        {
+            f.pos[j] = origin_[first + l][j] + pos_f[j][l];
+        }
+        f.rms = rms_f[l];
+        f.iterations = (int)it_f[l];
+        if (n_f[l] < D + 1)
+        {
+            f.status = fix_status::too_few_ranges;
+            f.pos = vec<D>::zero();
+            f.rms = 0.0;
+        }
+        else if (lane(degenerate, l))
+        {
+            f.status = fix_status::degenerate;
+        }
+        else
+        {
+            f.status = lane(converged, l) ? fix_status::ok : fix_status::no_convergence;
+        }
+    }
+}
+
+template class batch_multilat<2>;
+template class batch_multilat<3>;
+
+} // namespace rtls
@@ -0,0 +1,77 @@
+/*! ----------------------------------------------------------------------------
+ * @file    multilat_batch.hpp
+ * @brief   Multilateration of many tags at once, RTLS_LANES tags per SIMD lane group
+ *
+ *          multilaterate() solves one tag: a DxD system per iteration, a few
+ *          anchors, and branches on every step. Solving thousands of tags per
+ *          call that way leaves most of each vector unit idle. batch_multilat
+ *          stores the tags' ranges as a structure of arrays, a block of
+ *          RTLS_LANES tags side by side for each anchor slot, and runs the
+ *          same computation as multilaterate() on the whole block with
+ *          lanes.hpp: the linear guess of the notebook's subtracted
+ *          equations, then Gauss-Newton with step halving. A lane that
+ *          converges, or turns out degenerate, stops moving while the others
+ *          carry on; the block is done when all of its lanes are.
+ *
+ *          The lanes are floats, so that a 512 bit register holds 16 tags.
+ *          Each tag is solved relative to its first anchor, where the
+ *          coordinates are small: float then resolves well under a
+ *          millimetre across a 100 m hall, far below the ranging noise. The
+ *          fixes come out in double, like those of multilaterate().
+ *
+ *          Tags may have different numbers of anchors, up to max_anchors;
+ *          the missing slots of a block are padding with a zero weight.
+ *          See Host/README.md for the benchmark against multilaterate().
+ */
+
+#ifndef RTLS_MULTILAT_BATCH_HPP_
+#define RTLS_MULTILAT_BATCH_HPP_
+
+#include <vector>
+
+#include "lanes.hpp"
+#include "multilat.hpp"
+
+namespace rtls
+{
+
+template <int D>
+class batch_multilat
+{
+public:
+    explicit batch_multilat(int max_anchors);
+
+    /* Empty the batch, the storage is kept */
+    void clear();
+
+    /* Add a tag's ranges, returns its index in the batch or -1 if n is more than max_anchors */
+    int add(const range<D> *r, int n);
+
+    int size() const { return tags_; }
+
+    /* Solve every tag of the batch, out[i] for the tag of index i */
+    void solve(fix<D> *out, const solver_options &opt = solver_options()) const;
+
+private:
+    /* Per anchor slot: the anchor relative to the tag's first one, distance, weight (1, or 0 for padding) */
+    static constexpr int FIELDS = D + 2;
+
+    lanes &field(int block, int slot, int f) { return data_[((size_t)block * max_ + slot) * FIELDS + f]; }
+    const lanes &field(int block, int slot, int f) const { return data_[((size_t)block * max_ + slot) * FIELDS + f]; }
+
+    void solve_block(int block, fix<D> *out, const solver_options &opt) const;
+
+    int                     max_;
+    int                     tags_ = 0;
+    std::vector<lanes>      data_;
+    std::vector<int>        block_n_;   // most anchors of a tag of the block
+    std::vector<int>        n_;         // anchors per tag
+    std::vector<vec<D>>     origin_;    // first anchor per tag
+};
+
+extern template class batch_multilat<2>;
+extern template class batch_multilat<3>;
+
+} // namespace rtls
+
+#endif /* RTLS_MULTILAT_BATCH_HPP_ */
@@ -0,0 +1,161 @@
+/*! ----------------------------------------------------------------------------
+ * @file    multilat_batch_bench.cpp
+ * @brief   batch_multilat of multilat_batch.hpp against multilaterate() tag by tag
+ *
+ *          Draws a fleet of tags in the room of multilat_bench, each ranging
+ *          between D + 1 and the given number of anchors with Gaussian noise,
+ *          and solves them:
+ *          - tag by tag with multilaterate(), in double
+ *          - all at once with batch_multilat, RTLS_LANES tags per lane group
+ *          For each it prints fixes per second on one core and the position
+ *          error against the truth, then the largest distance between the
+ *          two fixes of a tag and the number of tags whose status differs.
+ *          The batch is filled once and solved repeatedly: filling it is a
+ *          copy of the ranges, the per-tag solver is given them as they are.
+ *
+ *          usage: multilat_batch_bench [tags] [noise_m]
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "multilat.hpp"
+#include "multilat_batch.hpp"
+
+using namespace rtls;
+
+/* Shortest timed run, s */
+#define BENCH_MIN_TIME  0.5
+
+static unsigned long long rng = 0x9E3779B97F4A7C15ULL;
+
+static double uniform(double lo, double hi)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return lo + (hi - lo) * (double)(rng >> 11) / (double)(1ULL << 53);
+}
+
+static double gaussian(double sigma)
+{
+    double u = uniform(1e-12, 1.0);
+    double v = uniform(0.0, 1.0);
+
+    return sigma * std::sqrt(-2.0 * std::log(u)) * std::cos(2.0 * M_PI * v);
+}
+
+/* The room of multilat_bench: anchors round a 10 m x 8 m room, alternately at 0.5 m and 2.5 m height */
+static const double room[8][3] = {
+    { 0.0, 0.0, 2.5 }, { 10.0, 0.5, 0.5 }, { 9.5, 8.0, 2.5 }, { 0.5, 7.5, 0.5 },
+    { 5.0, 0.0, 0.5 }, { 10.0, 4.0, 2.5 }, { 5.0, 8.0, 0.5 }, { 0.0, 4.0, 2.5 },
+};
+
+static bool usable(fix_status s)
+{
+    return s == fix_status::ok || s == fix_status::no_convergence;
+}
+
+template <int D>
+static void bench(int max_anchors, int tags, double noise)
+{
+    std::vector<range<D>> ranges((size_t)tags * max_anchors);
+    std::vector<int> count(tags);
+    std::vector<vec<D>> truth(tags);
+    std::vector<fix<D>> one(tags), batch(tags);
+    batch_multilat<D> solver(max_anchors);
+    double one_err = 0.0, batch_err = 0.0, diff = 0.0, sink = 0.0;
+    double one_rate, batch_rate, elapsed;
+    unsigned long mismatch = 0, solved = 0;
+    long fixes;
+
+    for (int s = 0; s < tags; s++)
+    {
+        for (int k = 0; k < D; k++)
+        {
+            truth[s][k] = uniform(0.5, (k == 0) ? 9.5 : (k == 1) ? 7.5 : 2.0);
+        }
+        count[s] = D + 1 + (int)uniform(0.0, max_anchors - D);
+        for (int i = 0; i < count[s]; i++)
+        {
+            range<D> &r = ranges[(size_t)s * max_anchors + i];
+
+            for (int k = 0; k < D; k++)
+            {
+                r.anchor[k] = room[i][k];
+            }
+            r.distance = std::fabs(norm(truth[s] - r.anchor) + gaussian(noise));
+        }
+        solver.add(&ranges[(size_t)s * max_anchors], count[s]);
+    }
+
+    fixes = 0;
+    auto start = std::chrono::steady_clock::now();
+    do
+    {
+        for (int s = 0; s < tags; s++)
+        {
+            one[s] = multilaterate(&ranges[(size_t)s * max_anchors], count[s]);
+            sink += one[s].pos[0];
+        }
+        fixes += tags;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < BENCH_MIN_TIME);
+    one_rate = fixes / elapsed;
+
+    fixes = 0;
+    start = std::chrono::steady_clock::now();
+    do
+    {
+        solver.solve(batch.data());
+        sink += batch[0].pos[0];
+        fixes += tags;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < BENCH_MIN_TIME);
+    batch_rate = fixes / elapsed;
+
+    for (int s = 0; s < tags; s++)
+    {
+        if (one[s].status != batch[s].status)
+        {
+            mismatch++;
+        }
+        if (!usable(one[s].status) || !usable(batch[s].status))
+        {
+            continue;
+        }
+        one_err += dot(one[s].pos - truth[s], one[s].pos - truth[s]);
+        batch_err += dot(batch[s].pos - truth[s], batch[s].pos - truth[s]);
+        diff = std::fmax(diff, norm(one[s].pos - batch[s].pos));
+        solved++;
+    }
+    solved = solved ? solved : 1;
+
+    printf("%dD %d..%d anchors: per tag %.2f M fixes/s (rms %.3f m), batch %.2f M fixes/s (rms %.3f m), "
+           "speedup %.2f, largest difference %.2g m, %lu status differ%s\n",
+           D, D + 1, max_anchors, one_rate / 1e6, std::sqrt(one_err / solved), batch_rate / 1e6,
+           std::sqrt(batch_err / solved), batch_rate / one_rate, diff, mismatch, (sink == 0.0) ? " " : "");
+}
+
+int main(int argc, char **argv)
+{
+    int tags = (argc > 1) ? atoi(argv[1]) : 4096;
+    double noise = (argc > 2) ? atof(argv[2]) : 0.1;
+
+    if (tags <= 0 || !(noise >= 0.0))
+    {
+        fprintf(stderr, "usage: multilat_batch_bench [tags] [noise_m]\n");
+        return 1;
+    }
+    printf("%d tags per call, distance noise %.3f m, %d %s lanes\n", tags, noise, RTLS_LANES, RTLS_LANES_ISA);
+
+    bench<2>(3, tags, noise);
+    bench<2>(4, tags, noise);
+    bench<2>(8, tags, noise);
+    bench<3>(4, tags, noise);
+    bench<3>(8, tags, noise);
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*! ----------------------------------------------------------------------------
+ * @file    multilat_bench.cpp
+ * @brief   Accuracy and speed of the multilateration of multilat.cpp
+ *
+ *          For rooms of 3 to 8 anchors in 2D and 4 to 8 in 3D, draws random
+ *          tag positions and distances with Gaussian noise, then:
+ *          - compares the position error of the linear guess (for three
+ *            anchors in 2D, the notebook's determinant solution) with the
+ *            Gauss-Newton fix
+ *          - counts the fixes still moving after max_iterations (their last
+ *            iterate is used) and the degenerate ones
+ *          - times multilaterate() on one thread, as fixes per second per core
+ *
+ *          usage: multilat_bench [samples] [noise_m]
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "multilat.hpp"
+
+using namespace rtls;
+
+/* Shortest timed run, s */
+#define BENCH_MIN_TIME  0.5
+
+static unsigned long long rng = 0x9E3779B97F4A7C15ULL;
+
+static double uniform(double lo, double hi)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return lo + (hi - lo) * (double)(rng >> 11) / (double)(1ULL << 53);
+}
+
+static double gaussian(double sigma)
+{
+    double u = uniform(1e-12, 1.0);
+    double v = uniform(0.0, 1.0);
+
+    return sigma * std::sqrt(-2.0 * std::log(u)) * std::cos(2.0 * M_PI * v);
+}
+
+/* Anchors round a 10 m x 8 m room, alternately at 0.5 m and 2.5 m height */
+static const double room[8][3] = {
+    { 0.0, 0.0, 2.5 }, { 10.0, 0.5, 0.5 }, { 9.5, 8.0, 2.5 }, { 0.5, 7.5, 0.5 },
+    { 5.0, 0.0, 0.5 }, { 10.0, 4.0, 2.5 }, { 5.0, 8.0, 0.5 }, { 0.0, 4.0, 2.5 },
+};
+
+template <int D>
+static void bench(int anchors, int samples, double noise)
+{
+    std::vector<range<D>> ranges((size_t)samples * anchors);
+    std::vector<vec<D>> truth(samples);
+    double guess_err = 0.0, fix_err = 0.0, iterations = 0.0;
+    unsigned long failed = 0, slow = 0;
+    double sink = 0.0;
+    vec<D> guess;
+    fix<D> f;
+    double elapsed;
+    long fixes = 0;
+
+    for (int s = 0; s < samples; s++)
+    {
+        for (int k = 0; k < D; k++)
+        {
+            truth[s][k] = uniform(0.5, (k == 0) ? 9.5 : (k == 1) ? 7.5 : 2.0);
+        }
+        for (int i = 0; i < anchors; i++)
+        {
+            range<D> &r = ranges[(size_t)s * anchors + i];
+
+            for (int k = 0; k < D; k++)
+            {
+                r.anchor[k] = room[i][k];
+            }
+            r.distance = std::fabs(norm(truth[s] - r.anchor) + gaussian(noise));
+        }
+    }
+
+    for (int s = 0; s < samples; s++)
+    {
+        const range<D> *r = &ranges[(size_t)s * anchors];
+
+        f = multilaterate(r, anchors);
+        if ((f.status != fix_status::ok && f.status != fix_status::no_convergence) || !linear_guess(r, anchors, guess))
+        {
+            failed++;
+            continue;
+        }
+        slow += (f.status == fix_status::no_convergence);
+        guess_err += dot(guess - truth[s], guess - truth[s]);
+        fix_err += dot(f.pos - truth[s], f.pos - truth[s]);
+        iterations += f.iterations;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    do
+    {
+        for (int s = 0; s < samples; s++)
+        {
+            f = multilaterate(&ranges[(size_t)s * anchors], anchors);
+            sink += f.pos[0];
+        }
+        fixes += samples;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < BENCH_MIN_TIME);
+
+    samples -= (int)failed;
+    printf("%dD %d anchors: error rms %.3f m (linear guess %.3f m), %.2f iterations, %lu not converged, %lu failed, "
+           "%.0f fixes/s per core (%.0f ns)%s\n",
+           D, anchors, std::sqrt(fix_err / samples), std::sqrt(guess_err / samples), iterations / samples, slow, failed,
+           fixes / elapsed, elapsed * 1e9 / fixes, (sink == 0.0) ? " " : "");
+}
+
+int main(int argc, char **argv)
+{
+    int samples = (argc > 1) ? atoi(argv[1]) : 100000;
+    double noise = (argc > 2) ? atof(argv[2]) : 0.1;
+
+    if (samples <= 0 || !(noise >= 0.0))
+    {
+        fprintf(stderr, "usage: multilat_bench [samples] [noise_m]\n");
+        return 1;
+    }
+    printf("%d samples, distance noise %.3f m\n", samples, noise);
+
+    bench<2>(3, samples, noise);
+    bench<2>(4, samples, noise);
+    bench<2>(8, samples, noise);
+    bench<3>(4, samples, noise);
+    bench<3>(5, samples, noise);
+    bench<3>(8, samples, noise);
+    return 0;
+}
@@ -0,0 +1,159 @@
+/*! ----------------------------------------------------------------------------
+ * @file    position_server.cpp
+ * @brief   Multi-tag position server, see position_server.hpp
+ */
+
+#include <thread>
+
+#include "position_server.hpp"
+
+namespace rtls
+{
+
+template <int D>
+position_server<D>::position_server(const anchor_set &anchors, int tags, int workers, publish_cb cb, void *ctx,
+                                    bool block)
+    : cb_(cb), ctx_(ctx), block_(block), pool_(workers)
+{
+    for (int i = 0; i < tags; i++)
+    {
+        tags_.emplace_back(new tag_state(anchors));
+        tags_[i]->server = this;
+        tags_[i]->id = i;
+    }
+}
+
+template <int D>
+position_server<D>::~position_server()
+{
+    pool_.wait_idle();
+}
+
+template <int D>
+void position_server<D>::queue_round(tag_state &t)
+{
+    unsigned long head = t.head.load(std::memory_order_relaxed);
+    unsigned long round = t.next_round++;
+    slot &s = t.ring[head % RTLS_TAG_QUEUE];
+
+    rounds_++;
+    while (head - t.tail.load(std::memory_order_acquire) == RTLS_TAG_QUEUE)
+    {
+        if (!block_)
+        {
+            dropped_++;
+            return;
+        }
+        std::this_thread::yield();
+    }
+
+    s.round = round;
+    s.n = t.rounds.size();
+    for (int i = 0; i < s.n; i++)
+    {
+        s.r[i] = t.rounds.ranges()[i];
+    }
+    t.head.store(head + 1, std::memory_order_release);
+
+    /* One task per tag: its rounds are solved in order, by one thread at a time */
+    if (!t.scheduled.exchange(true, std::memory_order_acq_rel))
+    {
+        pool_.submit(t.id, run_tag, &t);
+    }
+}
+
+template <int D>
+void position_server<D>::report(int tag, const dist_record &rec)
+{
+    tag_state &t = *tags_[tag];
+
+    if (t.rounds.add(rec))
+    {
+        queue_round(t);
+    }
+}
+
+template <int D>
+void position_server<D>::end(int tag)
+{
+    tag_state &t = *tags_[tag];
+
+    if (t.rounds.flush())
+    {
+        queue_round(t);
+    }
+}
+
+template <int D>
+void position_server<D>::run_tag(void *ctx, int worker)
+{
+    tag_state &t = *static_cast<tag_state *>(ctx);
+    position_server &srv = *t.server;
+    unsigned long tail = t.tail.load(std::memory_order_relaxed);
+    tag_fix<D> out;
+    int batch;
+
+    (void)worker;
+    out.tag = t.id;
+    for (;;)
+    {
+        for (batch = 0; batch < RTLS_TAG_BATCH && tail != t.head.load(std::memory_order_acquire); batch++)
+        {
+            const slot &s = t.ring[tail % RTLS_TAG_QUEUE];
+
+            out.round = s.round;
+            out.anchors = s.n;
+            if (s.n < D + 1)
+            {
+                t.too_few++;
+            }
+            else
+            {
+                out.f = multilaterate(s.r, s.n);
+                if (out.f.status == fix_status::ok || out.f.status == fix_status::no_convergence)
+                {
+                    t.fixes++;
+                    srv.cb_(srv.ctx_, out);
+                }
+                else
+                {
+                    t.failed++;
+                }
+            }
+            t.tail.store(++tail, std::memory_order_release);
+        }
+
+        if (batch == RTLS_TAG_BATCH)
+        {
+            /* Back of the home queue, still scheduled: the other tags of the worker get their turn */
+            srv.pool_.submit(t.id, run_tag, &t);
+            return;
+        }
+
+        /* Unschedule, then look again: a round queued in between would otherwise wait for the next one */
+        t.scheduled.store(false, std::memory_order_seq_cst);
+        if (tail == t.head.load(std::memory_order_seq_cst) || t.scheduled.exchange(true, std::memory_order_acq_rel))
+        {
+            return;
+        }
+    }
+}
+
+template <int D>
+position_server_stats position_server<D>::stats() const
+{
+    position_server_stats s = { rounds_, dropped_, 0, 0, 0 };
+
+    for (const auto &t : tags_)
+    {
+        s.fixes += t->fixes;
+        s.too_few += t->too_few;
+        s.failed += t->failed;
+    }
+    return s;
+}
+
+template class position_server<2>;
+template class position_server<3>;
+
+} // namespace rtls
@@ -0,0 +1,138 @@
+/*! ----------------------------------------------------------------------------
+ * @file    position_server.hpp
+ * @brief   Multi-tag position server on a work-stealing pool
+ *
+ *          Many tags range the same anchors, and each tag is solved on its own.
+ *          The server takes the DIST records of every tag from one ingest
+ *          thread, groups them into rounds per tag (round_builder) and hands
+ *          the rounds to a work_pool:
+ *          - each tag has a home worker, tag % workers. A tag has at most one
+ *            task queued or running, which solves all its pending rounds in
+ *            order, so the tag's state is only touched by one thread at a
+ *            time and stays in that worker's cache unless the task is stolen.
+ *          - the fixes of a tag are published in round order, from the worker
+ *            thread. Different tags publish concurrently, so the callback
+ *            must be thread safe.
+ *          - between the ingest thread and a tag's task the rounds go through
+ *            a lock-free ring of RTLS_TAG_QUEUE rounds. When it is full the
+ *            round is dropped and counted, as twr_report.h does with the
+ *            boards' reports, or, with block set, the ingest thread waits.
+ */
+
+#ifndef RTLS_POSITION_SERVER_HPP_
+#define RTLS_POSITION_SERVER_HPP_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "anchors.hpp"
+#include "dist_record.hpp"
+#include "multilat.hpp"
+#include "work_pool.hpp"
+
+namespace rtls
+{
+
+/* Rounds queued per tag between the ingest thread and the solver, a power of 2 */
+#ifndef RTLS_TAG_QUEUE
+#define RTLS_TAG_QUEUE      16
+#endif
+
+/* Rounds a task solves before it lets the other tasks of its worker run */
+#define RTLS_TAG_BATCH      8
+
+template <int D>
+struct tag_fix
+{
+    int                 tag;
+    unsigned long       round;      // round number of the tag, from 1; a gap is a round dropped or without a fix
+    int                 anchors;    // ranges used
+    fix<D>              f;
+};
+
+struct position_server_stats
+{
+    unsigned long long  rounds;     // rounds closed, dropped ones included
+    unsigned long long  dropped;    // rounds dropped on a full tag queue
+    unsigned long long  fixes;      // fixes published
+    unsigned long long  too_few;    // rounds with fewer than D + 1 known anchors
+    unsigned long long  failed;     // degenerate rounds
+};
+
+template <int D>
+class position_server
+{
+public:
+    typedef void (*publish_cb)(void *ctx, const tag_fix<D> &fix);
+
+    /*
+     * tags: number of tags, 0 .. tags - 1; workers: threads, 0 for one per core; block: wait on a full tag queue
+     * instead of dropping the round
+     */
+    position_server(const anchor_set &anchors, int tags, int workers, publish_cb cb, void *ctx, bool block = false);
+    ~position_server();
+
+    /* Ingest thread only: add a record of a tag */
+    void report(int tag, const dist_record &rec);
+
+    /* Ingest thread only: end of a tag's stream, its round in progress is queued */
+    void end(int tag);
+
+    /* Wait until every queued round is solved and published */
+    void wait_idle() { pool_.wait_idle(); }
+
+    int workers() const { return pool_.size(); }
+    work_pool_stats worker_stats(int worker) const { return pool_.stats(worker); }
+
+    /* Totals; exact once wait_idle() has returned */
+    position_server_stats stats() const;
+
+private:
+    struct slot
+    {
+        unsigned long   round;
+        int             n;
+        range<D>        r[RTLS_MAX_ANCHORS];
+    };
+
+    struct tag_state
+    {
+        explicit tag_state(const anchor_set &anchors) : rounds(anchors) {}
+
+        /* Ingest side */
+        round_builder<D>            rounds;
+        unsigned long               next_round = 1;     // dropped rounds take their number too
+
+        /* Ring, one producer (ingest) and one consumer (the tag's task) */
+        slot                        ring[RTLS_TAG_QUEUE];
+        std::atomic<unsigned long>  head{0};        // next round to queue
+        std::atomic<unsigned long>  tail{0};        // next round to solve
+        std::atomic<bool>           scheduled{false};
+
+        /* Task side, one thread at a time */
+        position_server            *server = nullptr;
+        int                         id = 0;
+        unsigned long long          fixes = 0;
+        unsigned long long          too_few = 0;
+        unsigned long long          failed = 0;
+    };
+
+    void queue_round(tag_state &t);
+    static void run_tag(void *ctx, int worker);
+
+    std::vector<std::unique_ptr<tag_state>> tags_;
+    publish_cb                              cb_;
+    void                                   *ctx_;
+    bool                                    block_;
+    unsigned long long                      rounds_ = 0;
+    unsigned long long                      dropped_ = 0;
+    work_pool                               pool_;      // last: stopped before the tags go
+};
+
+extern template class position_server<2>;
+extern template class position_server<3>;
+
+} // namespace rtls
+
+#endif /* RTLS_POSITION_SERVER_HPP_ */
@@ -0,0 +1,204 @@
+/*! ----------------------------------------------------------------------------
+ * @file    position_server_bench.cpp
+ * @brief   Scaling of the multi-tag position server with the number of workers
+ *
+ *          Tags walk at random through a 40 m x 40 m hall with a 4 x 4 anchor
+ *          grid. Each round ranges the anchors within 25 m, with 0.1 m noise,
+ *          and 1 % of the records are lost. The records of every tag are built
+ *          first, then fed round by round, all tags interleaved, from one
+ *          ingest thread, as tag_server does. For 1, 2, 4, ... workers up to
+ *          the number of cores (or the given maximum) it prints fixes/s, the
+ *          speedup over one worker, and the share of tasks that were stolen
+ *          from their tag's home worker. It checks that each tag's fixes are
+ *          published in round order, and compares with a plain loop over
+ *          multilaterate() on one thread.
+ *
+ *          usage: position_server_bench [tags] [rounds] [max_workers]
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "anchors.hpp"
+#include "position_server.hpp"
+
+using namespace rtls;
+
+/* Anchors on a grid of 4 x 4, HALL_STEP apart */
+#define HALL_GRID       4
+#define HALL_STEP       13.0
+#define HALL_SIZE       (HALL_STEP * (HALL_GRID - 1))
+#define ANCHOR_RANGE    25.0
+
+static unsigned long long rng = 0x9E3779B97F4A7C15ULL;
+
+static double uniform(double lo, double hi)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return lo + (hi - lo) * (double)(rng >> 11) / (double)(1ULL << 53);
+}
+
+struct feed
+{
+    int         tag;
+    dist_record rec;
+};
+
+struct check_ctx
+{
+    std::vector<unsigned long>  last;   // last round published per tag, each tag written by one task at a time
+    std::atomic<unsigned long>  out_of_order{0};
+    std::atomic<unsigned long long> fixes{0};
+};
+
+static void check_fix(void *ctx, const tag_fix<2> &f)
+{
+    check_ctx &c = *static_cast<check_ctx *>(ctx);
+
+    if (f.round <= c.last[f.tag])
+    {
+        c.out_of_order++;
+    }
+    c.last[f.tag] = f.round;
+    c.fixes.fetch_add(1, std::memory_order_relaxed);
+}
+
+static double run(const anchor_set &anchors, const std::vector<feed> &records, int tags, int workers,
+                  double *stolen, unsigned long *out_of_order, unsigned long long *fixes)
+{
+    check_ctx c;
+    unsigned long long executed = 0, steals = 0;
+    double t;
+
+    c.last.assign(tags, 0);
+    {
+        position_server<2> server(anchors, tags, workers, check_fix, &c, true);
+
+        auto start = std::chrono::steady_clock::now();
+        for (const feed &f : records)
+        {
+            server.report(f.tag, f.rec);
+        }
+        for (int i = 0; i < tags; i++)
+        {
+            server.end(i);
+        }
+        server.wait_idle();
+        t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (int w = 0; w < server.workers(); w++)
+        {
+            executed += server.worker_stats(w).executed;
+            steals += server.worker_stats(w).stolen;
+        }
+    }
+    *stolen = executed ? (double)steals / executed : 0.0;
+    *out_of_order = c.out_of_order.load();
+    *fixes = c.fixes.load();
+    return t;
+}
+
+int main(int argc, char **argv)
+{
+    int tags = (argc > 1) ? atoi(argv[1]) : 1000;
+    int rounds = (argc > 2) ? atoi(argv[2]) : 300;
+    int max_workers = (argc > 3) ? atoi(argv[3]) : (int)std::thread::hardware_concurrency();
+    std::vector<double> x, y;
+    std::vector<feed> records;
+    std::vector<range<2>> plain;
+    anchor_set anchors;
+    double t, t1 = 0.0, stolen, sink = 0.0;
+    unsigned long out_of_order;
+    unsigned long long fixes;
+    feed f;
+    int n;
+
+    if (tags <= 0 || rounds <= 0)
+    {
+        fprintf(stderr, "usage: position_server_bench [tags] [rounds] [max_workers]\n");
+        return 1;
+    }
+    max_workers = (max_workers > 0) ? max_workers : 1;
+
+    for (int i = 0; i < HALL_GRID * HALL_GRID; i++)
+    {
+        anchors.set((char)('A' + i), HALL_STEP * (i % HALL_GRID), HALL_STEP * (i / HALL_GRID));
+    }
+
+    /* Random walks, 0.3 m per round */
+    x.resize(tags);
+    y.resize(tags);
+    for (int k = 0; k < tags; k++)
+    {
+        x[k] = uniform(0.0, HALL_SIZE);
+        y[k] = uniform(0.0, HALL_SIZE);
+    }
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int k = 0; k < tags; k++)
+        {
+            x[k] = std::fmin(std::fmax(x[k] + uniform(-0.3, 0.3), 0.0), HALL_SIZE);
+            y[k] = std::fmin(std::fmax(y[k] + uniform(-0.3, 0.3), 0.0), HALL_SIZE);
+            f.tag = k;
+            n = 0;
+            for (int i = 0; i < anchors.size(); i++)
+            {
+                double d = std::hypot(x[k] - anchors[i].pos[0], y[k] - anchors[i].pos[1]);
+
+                if (d > ANCHOR_RANGE || uniform(0.0, 1.0) < 0.01)
+                {
+                    continue;
+                }
+                f.rec.label = anchors[i].label;
+                f.rec.distance = d + uniform(-0.17, 0.17);
+                records.push_back(f);
+                plain.push_back(range<2>{ anchors.pos<2>(i), f.rec.distance });
+                n++;
+            }
+            plain.push_back(range<2>{ vec<2>::zero(), -(double)n });     // end of round marker
+        }
+    }
+    printf("%d tags, %d rounds each, %zu records, %d anchors\n", tags, rounds, records.size(), anchors.size());
+
+    /* Plain loop: the solver alone, on one thread */
+    auto start = std::chrono::steady_clock::now();
+    fixes = 0;
+    for (size_t i = 0, first = 0; i < plain.size(); i++)
+    {
+        if (plain[i].distance < 0.0)
+        {
+            n = (int)(i - first);
+            if (n >= 3)
+            {
+                sink += multilaterate(&plain[first], n).pos[0];
+                fixes++;
+            }
+            first = i + 1;
+        }
+    }
+    t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("plain loop: %.2f M fixes/s%s\n", fixes / t / 1e6, (sink == 0.0) ? " " : "");
+
+    for (int w = 1; w <= max_workers; w = (w < max_workers && w * 2 > max_workers) ? max_workers : w * 2)
+    {
+        t = run(anchors, records, tags, w, &stolen, &out_of_order, &fixes);
+        t1 = (w == 1) ? t : t1;
+        printf("%2d workers: %.2f M fixes/s, speedup %.2f, %.1f %% of tasks stolen, %lu out of order\n", w,
+               fixes / t / 1e6, t1 / t, stolen * 100.0, out_of_order);
+        if (out_of_order != 0)
+        {
+            return 1;
+        }
+        if (w == max_workers)
+        {
+            break;
+        }
+    }
+    return 0;
+}
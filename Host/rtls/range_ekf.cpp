@@ -0,0 +1,233 @@
+/*! ----------------------------------------------------------------------------
+ * @file    range_ekf.cpp
+ * @brief   Constant velocity extended Kalman filter fed range by range, see range_ekf.hpp
+ */
+
+#include <cmath>
+
+#include "range_ekf.hpp"
+
+/* Below this predicted distance the direction to the anchor is unknown and the update is skipped, m */
+#define EKF_MIN_DIST    1e-6
+
+namespace rtls
+{
+
+template <int D>
+void range_ekf<D>::init(const vec<D> &pos, double t)
+{
+    double pv = opt_.init_pos_sigma * opt_.init_pos_sigma;
+    double vv = opt_.init_vel_sigma * opt_.init_vel_sigma;
+
+    x_ = vec<N>::zero();
+    P_ = mat<N, N>::zero();
+    for (int k = 0; k < D; k++)
+    {
+        x_[k] = pos[k];
+        P_(k, k) = pv;
+        P_(D + k, D + k) = vv;
+    }
+    t_ = t;
+}
+
+template <int D>
+void range_ekf<D>::predict(double t)
+{
+    double dt = t - t_;
+    double q = opt_.accel_noise * opt_.accel_noise;
+    double q11 = q * dt * dt * dt / 3.0, q12 = q * dt * dt / 2.0, q22 = q * dt;
+    double pp, pv, vp, vv;
+
+    if (!(dt > 0.0))
+    {
+        return;
+    }
+
+    /* x = F x, P = F P F' + Q with F = [I dt.I; 0 I], done per axis pair: the blocks are diagonal */
+    for (int k = 0; k < D; k++)
+    {
+        x_[k] += dt * x_[D + k];
+    }
+    for (int i = 0; i < D; i++)
+    {
+        for (int j = 0; j < D; j++)
+        {
+            pp = P_(i, j);
+            pv = P_(i, D + j);
+            vp = P_(D + i, j);
+            vv = P_(D + i, D + j);
+            P_(i, j) = pp + dt * (pv + vp) + dt * dt * vv;
+            P_(i, D + j) = pv + dt * vv;
+            P_(D + i, j) = vp + dt * vv;
+        }
+    }
+    for (int k = 0; k < D; k++)
+    {
+        P_(k, k) += q11;
+        P_(k, D + k) += q12;
+        P_(D + k, k) += q12;
+        P_(D + k, D + k) += q22;
+    }
+    t_ = t;
+}
+
+template <int D>
+ekf_update range_ekf<D>::update(const vec<D> &anchor, double distance, double t)
+{
+    vec<D> u;
+    vec<N> PHt;
+    double dist, innov, S;
+
+    predict(t);
+
+    for (int k = 0; k < D; k++)
+    {
+        u[k] = x_[k] - anchor[k];
+    }
+    dist = norm(u);
+    if (dist < EKF_MIN_DIST)
+    {
+        return ekf_update::rejected;
+    }
+    u = (1.0 / dist) * u;
+
+    /* H = [u' 0], PHt = P H', S = H P H' + R */
+    for (int i = 0; i < N; i++)
+    {
+        PHt[i] = 0.0;
+        for (int k = 0; k < D; k++)
+        {
+            PHt[i] += P_(i, k) * u[k];
+        }
+    }
+    S = opt_.range_sigma * opt_.range_sigma;
+    for (int k = 0; k < D; k++)
+    {
+        S += u[k] * PHt[k];
+    }
+
+    innov = distance - dist;
+    if (innov * innov > opt_.gate * opt_.gate * S)
+    {
+        return ekf_update::rejected;
+    }
+
+    /* K = PHt / S, x += K innov, P -= K S K' */
+    x_ = x_ + (innov / S) * PHt;
+    P_ = P_ - (1.0 / S) * (PHt * transpose(PHt));
+    return ekf_update::accepted;
+}
+
+template <int D>
+vec<D> range_ekf<D>::position() const
+{
+    vec<D> p;
+
+    for (int k = 0; k < D; k++)
+    {
+        p[k] = x_[k];
+    }
+    return p;
+}
+
+template <int D>
+vec<D> range_ekf<D>::velocity() const
+{
+    vec<D> v;
+
+    for (int k = 0; k < D; k++)
+    {
+        v[k] = x_[D + k];
+    }
+    return v;
+}
+
+template <int D>
+double range_ekf<D>::position_sigma() const
+{
+    double s = 0.0;
+
+    for (int k = 0; k < D; k++)
+    {
+        s += P_(k, k);
+    }
+    return std::sqrt(s);
+}
+
+template <int D>
+void tag_tracker<D>::restart()
+{
+    started_ = false;
+    distinct_ = 0;
+    for (int i = 0; i < RTLS_MAX_ANCHORS; i++)
+    {
+        have_[i] = false;
+        rejects_in_row_[i] = 0;
+    }
+}
+
+template <int D>
+ekf_update tag_tracker<D>::add(const dist_record &rec, double t)
+{
+    range<D> r[RTLS_MAX_ANCHORS];
+    fix<D> f;
+    int a = anchors_.find(rec.label);
+    int n = 0;
+
+    if (a < 0)
+    {
+        rejected_++;
+        return ekf_update::rejected;
+    }
+
+    if (started_)
+    {
+        if (ekf_.update(anchors_.pos<D>(a), rec.distance, t) == ekf_update::accepted)
+        {
+            accepted_++;
+            rejects_in_row_[a] = 0;
+            return ekf_update::accepted;
+        }
+        rejected_++;
+        if (++rejects_in_row_[a] < opt_.max_rejects)
+        {
+            return ekf_update::rejected;
+        }
+        /* Lost: start again from this distance on */
+        restart();
+        restarts_++;
+    }
+
+    /* Keep the latest distance of each anchor, until D + 1 of them give a fix */
+    distinct_ += !have_[a];
+    have_[a] = true;
+    first_[a].anchor = anchors_.pos<D>(a);
+    first_[a].distance = rec.distance;
+    if (distinct_ < D + 1)
+    {
+        return ekf_update::starting;
+    }
+    for (int i = 0; i < anchors_.size(); i++)
+    {
+        if (have_[i])
+        {
+            r[n++] = first_[i];
+        }
+    }
+    f = multilaterate(r, n);
+    if (f.status != fix_status::ok && f.status != fix_status::no_convergence)
+    {
+        return ekf_update::starting;
+    }
+    ekf_.init(f.pos, t);
+    started_ = true;
+    accepted_++;
+    return ekf_update::accepted;
+}
+
+template class range_ekf<2>;
+template class range_ekf<3>;
+template class tag_tracker<2>;
+template class tag_tracker<3>;
+
+} // namespace rtls
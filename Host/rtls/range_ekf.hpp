@@ -0,0 +1,130 @@
+/*! ----------------------------------------------------------------------------
+ * @file    range_ekf.hpp
+ * @brief   Constant velocity extended Kalman filter fed range by range
+ *
+ *          The notebook, and locate, solve each round on its own, so the
+ *          position jumps by the noise of three distances every round (see
+ *          the GIFs in "Measurements and Results"). range_ekf tracks position
+ *          and velocity, and takes each anchor's distance as it arrives: the
+ *          position moves at the per-anchor rate, three times the round rate
+ *          with three anchors, and each update only pulls it along one
+ *          direction by as much as the filter trusts the distance.
+ *
+ *          Model, state [position, velocity] in D dimensions:
+ *          - predict: constant velocity, white acceleration noise of spectral
+ *            density accel_noise^2 (m^2/s^3)
+ *          - update: distance to an anchor, noise range_sigma. A distance
+ *            further than gate sigmas from the prediction is rejected, which
+ *            drops the non line of sight and multipath outliers.
+ *
+ *          tag_tracker starts the filter from a multilateration fix of the
+ *          first distances of D + 1 different anchors, and restarts it when an
+ *          anchor's distances are rejected max_rejects times in a row. Outliers
+ *          come one at a time; an anchor that is never believed any more means
+ *          the state drifted off along the directions the other anchors do not
+ *          see, and every rejection would only let it drift further.
+ */
+
+#ifndef RTLS_RANGE_EKF_HPP_
+#define RTLS_RANGE_EKF_HPP_
+
+#include "anchors.hpp"
+#include "dist_record.hpp"
+#include "mat.hpp"
+#include "multilat.hpp"
+
+namespace rtls
+{
+
+struct ekf_options
+{
+    double  accel_noise = 1.0;      // m/s^2/sqrt(Hz), how fast the tag may change speed
+    double  range_sigma = 0.3;      // distance noise, m; the lab capture scatters by about this much
+    double  gate = 3.0;             // innovations beyond gate standard deviations are rejected
+    double  init_pos_sigma = 0.5;   // position uncertainty at the start, m
+    double  init_vel_sigma = 1.0;   // speed uncertainty at the start, m/s
+    int     max_rejects = 3;        // tag_tracker restarts after this many rejections in a row of one anchor
+};
+
+enum class ekf_update
+{
+    accepted,
+    rejected,       // outside the gate, the state is unchanged
+    starting,       // tag_tracker: not started yet, the distance was kept for the start
+};
+
+template <int D>
+class range_ekf
+{
+public:
+    static constexpr int N = 2 * D;
+
+    explicit range_ekf(const ekf_options &opt = ekf_options()) : opt_(opt) {}
+
+    /* Start at pos, at rest, at time t (s) */
+    void init(const vec<D> &pos, double t);
+
+    /* Move the state to time t; earlier times are ignored */
+    void predict(double t);
+
+    /* Predict to t, then fold in the distance to an anchor */
+    ekf_update update(const vec<D> &anchor, double distance, double t);
+
+    vec<D> position() const;
+    vec<D> velocity() const;
+
+    /* Position standard deviation, sqrt of the trace of its covariance, m */
+    double position_sigma() const;
+
+    double time() const { return t_; }
+
+private:
+    ekf_options     opt_;
+    vec<N>          x_;
+    mat<N, N>       P_;
+    double          t_ = 0.0;
+};
+
+template <int D>
+class tag_tracker
+{
+public:
+    tag_tracker(const anchor_set &anchors, const ekf_options &opt = ekf_options())
+        : anchors_(anchors), opt_(opt), ekf_(opt)
+    {
+    }
+
+    /* A distance of the tag at time t (s), records of unknown anchors are ignored (rejected) */
+    ekf_update add(const dist_record &rec, double t);
+
+    bool started() const { return started_; }
+    const range_ekf<D> &filter() const { return ekf_; }
+
+    unsigned long accepted() const { return accepted_; }
+    unsigned long rejected() const { return rejected_; }
+    unsigned long restarts() const { return restarts_; }
+
+private:
+    void restart();
+
+    const anchor_set   &anchors_;
+    ekf_options         opt_;
+    range_ekf<D>        ekf_;
+    bool                started_ = false;
+    range<D>            first_[RTLS_MAX_ANCHORS];   // latest distance of each anchor until the start
+    bool                have_[RTLS_MAX_ANCHORS] = {};
+    int                 distinct_ = 0;
+    int                 rejects_in_row_[RTLS_MAX_ANCHORS] = {};
+    unsigned long       accepted_ = 0;
+    unsigned long       rejected_ = 0;
+    unsigned long       restarts_ = 0;
+};
+
+extern template class range_ekf<2>;
+extern template class range_ekf<3>;
+extern template class tag_tracker<2>;
+extern template class tag_tracker<3>;
+
+} // namespace rtls
+
+#endif /* RTLS_RANGE_EKF_HPP_ */
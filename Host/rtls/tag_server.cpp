@@ -0,0 +1,188 @@
+/*! ----------------------------------------------------------------------------
+ * @file    tag_server.cpp
+ * @brief   Positions of many tags at once, see position_server.hpp
+ *
+ *          Each argument is the DIST record stream of one tag: its board's
+ *          serial device (through report_decode), a fifo or a capture. The
+ *          streams are read as data arrives (poll()), and the fixes are
+ *          printed as CSV as they are solved: tag, round, position, residual
+ *          RMS, anchors used. The fixes of a tag come in round order, those of
+ *          different tags interleave. Tags are numbered by argument, from 0.
+ *          A tag whose rounds queue up faster than they are solved, a capture
+ *          read at once, holds the reading until its worker catches up; the
+ *          kernel buffers the other streams meanwhile.
+ *
+ *          usage: tag_server [-3] [-w workers] [-s room] [-a A=x,y[,z]]... [-f anchors] stream...
+ *
+ *          mkfifo tag0 tag1
+ *          ./report_decode /dev/ttyACM0 > tag0 & ./report_decode /dev/ttyACM1 > tag1 &
+ *          ./tag_server -f anchors.txt tag0 tag1
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <unistd.h>
+#include <vector>
+
+#include "anchors.hpp"
+#include "dist_stream.hpp"
+#include "position_server.hpp"
+
+using namespace rtls;
+
+static std::mutex print_lock;
+
+template <int D>
+static void print_fix(void *ctx, const tag_fix<D> &f)
+{
+    std::lock_guard<std::mutex> g(print_lock);
+
+    (void)ctx;
+    printf("%d,%lu", f.tag, f.round);
+    for (int k = 0; k < D; k++)
+    {
+        printf(",%.3f", f.f.pos[k]);
+    }
+    printf(",%.3f,%d\n", f.f.rms, f.anchors);
+}
+
+template <int D>
+struct tag_input
+{
+    position_server<D> *server;
+    int                 tag;
+};
+
+template <int D>
+static void on_record(void *ctx, const dist_record &rec)
+{
+    tag_input<D> *in = static_cast<tag_input<D> *>(ctx);
+
+    in->server->report(in->tag, rec);
+}
+
+template <int D>
+static int serve(const anchor_set &anchors, int workers, char **paths, int n)
+{
+    position_server<D> server(anchors, n, workers, print_fix<D>, NULL, true);
+    std::vector<tag_input<D>> inputs(n);
+    std::vector<std::unique_ptr<dist_stream>> streams(n);
+    std::vector<struct pollfd> fds(n);
+    char buf[RTLS_READ_CHUNK];
+    position_server_stats st;
+    int open_streams = n;
+    ssize_t len;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        inputs[i].server = &server;
+        inputs[i].tag = i;
+        streams[i].reset(new dist_stream(on_record<D>, &inputs[i]));
+        fds[i].fd = open(paths[i], O_RDONLY);
+        fds[i].events = POLLIN;
+        if (fds[i].fd < 0)
+        {
+            perror(paths[i]);
+            open_streams--;
+        }
+    }
+
+    printf(D == 3 ? "tag,round,x,y,z,rms,anchors\n" : "tag,round,x,y,rms,anchors\n");
+    while (open_streams > 0)
+    {
+        if (poll(fds.data(), n, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("poll");
+            break;
+        }
+        for (i = 0; i < n; i++)
+        {
+            if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+                continue;
+            }
+            len = read(fds[i].fd, buf, sizeof(buf));
+            if (len > 0)
+            {
+                streams[i]->feed(buf, (size_t)len);
+                continue;
+            }
+            if (len < 0 && (errno == EINTR || errno == EAGAIN))
+            {
+                continue;
+            }
+            if (len < 0)
+            {
+                perror(paths[i]);
+            }
+            streams[i]->finish();
+            server.end(i);
+            close(fds[i].fd);
+            fds[i].fd = -1;
+            open_streams--;
+        }
+    }
+
+    server.wait_idle();
+    fflush(stdout);
+    st = server.stats();
+    fprintf(stderr, "%d tags, %d workers: %llu rounds, %llu fixes, %llu dropped, %llu with too few anchors, "
+            "%llu degenerate\n", n, server.workers(), st.rounds, st.fixes, st.dropped, st.too_few, st.failed);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    anchor_set anchors;
+    int dim = 2;
+    int workers = 0;
+    int opt;
+    int i;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (strcmp(argv[i], "-3") == 0)
+        {
+            dim = 3;
+        }
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+        {
+            workers = atoi(argv[++i]);
+        }
+        else if ((opt = anchors.option(argv[i], (i + 1 < argc) ? argv[i + 1] : NULL)) > 0)
+        {
+            i++;
+        }
+        else
+        {
+            if (opt == 0)
+            {
+                fprintf(stderr, "usage: tag_server [-3] [-w workers] [-s room] [-a A=x,y[,z]]... [-f anchors] "
+                        "stream...\n");
+            }
+            return 1;
+        }
+    }
+    if (i == argc)
+    {
+        fprintf(stderr, "no tag stream\n");
+        return 1;
+    }
+    if (anchors.size() == 0)
+    {
+        anchors.preset("lab");
+    }
+
+    return (dim == 3) ? serve<3>(anchors, workers, &argv[i], argc - i) : serve<2>(anchors, workers, &argv[i], argc - i);
+}
@@ -0,0 +1,309 @@
+/*! ----------------------------------------------------------------------------
+ * @file    track.cpp
+ * @brief   Replay of DIST records through the tracking filter of range_ekf.hpp
+ *
+ *          Feeds each record of a capture to a tag_tracker as it comes, and
+ *          solves the same records round by round as locate does. It prints
+ *          a CSV line per distance the filter takes: time, anchor, position,
+ *          velocity, position sigma. The summary on stderr compares the two:
+ *          - positions per round: one raw fix, an update per anchor
+ *          - jitter: mean distance between the positions of consecutive
+ *            rounds, raw fixes against the filter at the same instants
+ *          The captures carry no time, the records are taken -t seconds
+ *          apart (0.25 s by default).
+ *
+ *          -S seconds replays a synthetic walk instead: a tag circling inside
+ *          the anchors at 1 m/s, distances with range_sigma noise and 3 % of non line of
+ *          sight outliers 0.5 to 3 m long. The summary then adds the RMS
+ *          error of the raw fixes and of the filter against the true path.
+ *
+ *          usage: track [-3] [-t interval] [-q accel_noise] [-r range_sigma] [-S seconds]
+ *                       [-s room] [-a A=x,y[,z]]... [-f anchors] [file]
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "anchors.hpp"
+#include "dist_stream.hpp"
+#include "multilat.hpp"
+#include "range_ekf.hpp"
+
+using namespace rtls;
+
+/* Speed of the synthetic tag, m/s */
+#define WALK_SPEED      1.0
+
+template <int D>
+struct replay
+{
+    replay(const anchor_set &a, const ekf_options &opt, double dt) : anchors(a), tracker(a, opt), rounds(a), interval(dt)
+    {
+    }
+
+    const anchor_set   &anchors;
+    tag_tracker<D>      tracker;
+    round_builder<D>    rounds;
+    double              interval;
+    double              t = 0.0;
+    unsigned long       records = 0;
+
+    /* Raw fix and filter position at the end of each round */
+    bool                have_raw = false, have_ekf = false;
+    vec<D>              last_raw, last_ekf;
+    double              raw_steps = 0.0, ekf_steps = 0.0;
+    unsigned long       raw_fixes = 0, raw_pairs = 0, ekf_pairs = 0;
+
+    /* Synthetic walk: truth at the current record, errors */
+    bool                synthetic = false;
+    vec<D>              truth;
+    double              raw_err = 0.0, ekf_err = 0.0;
+    unsigned long       ekf_samples = 0;
+
+    void round_end(const range<D> *r, int n)
+    {
+        fix<D> f;
+
+        if (n >= D + 1)
+        {
+            f = multilaterate(r, n);
+            if (f.status == fix_status::ok || f.status == fix_status::no_convergence)
+            {
+                raw_fixes++;
+                if (have_raw)
+                {
+                    raw_steps += norm(f.pos - last_raw);
+                    raw_pairs++;
+                }
+                last_raw = f.pos;
+                have_raw = true;
+                if (synthetic)
+                {
+                    /* The round ended with the previous record, at the previous truth: close enough at 1 m/s */
+                    raw_err += dot(f.pos - truth, f.pos - truth);
+                }
+            }
+        }
+        if (tracker.started())
+        {
+            vec<D> p = tracker.filter().position();
+
+            if (have_ekf)
+            {
+                ekf_steps += norm(p - last_ekf);
+                ekf_pairs++;
+            }
+            last_ekf = p;
+            have_ekf = true;
+        }
+    }
+
+    void record(const dist_record &rec)
+    {
+        ekf_update u;
+
+        records++;
+        if (rounds.add(rec))
+        {
+            round_end(rounds.ranges(), rounds.size());
+        }
+        u = tracker.add(rec, t);
+        if (u == ekf_update::accepted)
+        {
+            const range_ekf<D> &f = tracker.filter();
+
+            printf("%.3f,%c", t, rec.label);
+            for (int k = 0; k < D; k++)
+            {
+                printf(",%.3f", f.position()[k]);
+            }
+            for (int k = 0; k < D; k++)
+            {
+                printf(",%.3f", f.velocity()[k]);
+            }
+            printf(",%.3f\n", f.position_sigma());
+            if (synthetic)
+            {
+                ekf_err += dot(f.position() - truth, f.position() - truth);
+                ekf_samples++;
+            }
+        }
+        t += interval;
+    }
+
+    static void on_record(void *ctx, const dist_record &rec)
+    {
+        static_cast<replay *>(ctx)->record(rec);
+    }
+
+    void summary()
+    {
+        if (rounds.flush())
+        {
+            round_end(rounds.ranges(), rounds.size());
+        }
+        fprintf(stderr, "%lu records over %.1f s: %lu raw fixes, %lu filter updates (%.2f per raw fix), "
+                "%lu rejected, %lu restarts\n", records, t, raw_fixes, tracker.accepted(),
+                raw_fixes ? (double)tracker.accepted() / raw_fixes : 0.0, tracker.rejected(), tracker.restarts());
+        fprintf(stderr, "jitter, mean move between rounds: raw %.3f m, filter %.3f m\n",
+                raw_pairs ? raw_steps / raw_pairs : 0.0, ekf_pairs ? ekf_steps / ekf_pairs : 0.0);
+        if (synthetic)
+        {
+            fprintf(stderr, "error rms against the path: raw %.3f m, filter %.3f m\n",
+                    raw_fixes ? std::sqrt(raw_err / raw_fixes) : 0.0,
+                    ekf_samples ? std::sqrt(ekf_err / ekf_samples) : 0.0);
+        }
+    }
+};
+
+static unsigned long long rng = 0x9E3779B97F4A7C15ULL;
+
+static double uniform(double lo, double hi)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return lo + (hi - lo) * (double)(rng >> 11) / (double)(1ULL << 53);
+}
+
+static double gaussian(double sigma)
+{
+    return sigma * std::sqrt(-2.0 * std::log(uniform(1e-12, 1.0))) * std::cos(2.0 * M_PI * uniform(0.0, 1.0));
+}
+
+/* Synthetic walk: a circle round the centroid of the anchors, anchors in turn */
+template <int D>
+static void walk(replay<D> &rp, double seconds, double sigma)
+{
+    vec<D> c = vec<D>::zero();
+    dist_record rec;
+    double radius = 1e9, a;
+    int i = 0;
+
+    for (int k = 0; k < rp.anchors.size(); k++)
+    {
+        c = c + (1.0 / rp.anchors.size()) * rp.anchors.template pos<D>(k);
+    }
+    for (int k = 0; k < rp.anchors.size(); k++)
+    {
+        radius = std::fmin(radius, 0.5 * norm(rp.anchors.template pos<D>(k) - c));
+    }
+    rp.synthetic = true;
+    while (rp.t < seconds)
+    {
+        a = rp.t * WALK_SPEED / radius;
+        rp.truth = c;
+        rp.truth[0] += radius * std::cos(a);
+        rp.truth[1] += radius * std::sin(a);
+
+        rec.label = rp.anchors[i].label;
+        rec.distance = norm(rp.truth - rp.anchors.template pos<D>(i)) + gaussian(sigma);
+        if (uniform(0.0, 1.0) < 0.03)
+        {
+            rec.distance += uniform(0.5, 3.0);
+        }
+        rp.record(rec);
+        i = (i + 1) % rp.anchors.size();
+    }
+}
+
+template <int D>
+static int run(const anchor_set &anchors, const ekf_options &opt, double interval, double seconds, const char *path)
+{
+    replay<D> rp(anchors, opt, interval);
+    dist_stream stream(replay<D>::on_record, &rp);
+    int fd = 0;
+
+    printf(D == 3 ? "t,anchor,x,y,z,vx,vy,vz,sigma\n" : "t,anchor,x,y,vx,vy,sigma\n");
+    if (seconds > 0.0)
+    {
+        walk(rp, seconds, opt.range_sigma);
+    }
+    else
+    {
+        if (path != NULL && (fd = open(path, O_RDONLY)) < 0)
+        {
+            perror(path);
+            return 1;
+        }
+        if (stream.read_fd(fd) < 0)
+        {
+            perror((path != NULL) ? path : "stdin");
+        }
+        stream.finish();
+        if (path != NULL)
+        {
+            close(fd);
+        }
+    }
+    rp.summary();
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    anchor_set anchors;
+    ekf_options opt;
+    const char *path = NULL;
+    double interval = 0.25, seconds = 0.0;
+    int dim = 2;
+    int o;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-3") == 0)
+        {
+            dim = 3;
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            interval = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc)
+        {
+            opt.accel_noise = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+        {
+            opt.range_sigma = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc)
+        {
+            seconds = atof(argv[++i]);
+        }
+        else if ((o = anchors.option(argv[i], (i + 1 < argc) ? argv[i + 1] : NULL)) != 0)
+        {
+            if (o < 0)
+            {
+                return 1;
+            }
+            i++;
+        }
+        else if (argv[i][0] == '-' && argv[i][1] != '\0')
+        {
+            fprintf(stderr, "usage: track [-3] [-t interval] [-q accel_noise] [-r range_sigma] [-S seconds] "
+                    "[-s room] [-a A=x,y[,z]]... [-f anchors] [file]\n");
+            return 1;
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+    if (!(interval > 0.0) || !(opt.range_sigma > 0.0) || !(opt.accel_noise > 0.0))
+    {
+        fprintf(stderr, "-t, -q and -r must be positive\n");
+        return 1;
+    }
+    if (anchors.size() == 0)
+    {
+        anchors.preset("lab");
+    }
+
+    return (dim == 3) ? run<3>(anchors, opt, interval, seconds, path) : run<2>(anchors, opt, interval, seconds, path);
+}
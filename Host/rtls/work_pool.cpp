@@ -0,0 +1,159 @@
+/*! ----------------------------------------------------------------------------
+ * @file    work_pool.cpp
+ * @brief   Work-stealing thread pool, see work_pool.hpp
+ */
+
+#include "work_pool.hpp"
+
+/* Empty looks at the queues, each after a yield, before a worker sleeps */
+#define WORK_POOL_SPINS     64
+
+namespace rtls
+{
+
+work_pool::work_pool(int workers)
+{
+    if (workers <= 0)
+    {
+        workers = (int)std::thread::hardware_concurrency();
+        workers = (workers > 0) ? workers : 1;
+    }
+    for (int i = 0; i < workers; i++)
+    {
+        workers_.emplace_back(new worker);
+    }
+    for (int i = 0; i < workers; i++)
+    {
+        workers_[i]->thread = std::thread(&work_pool::run, this, i);
+    }
+}
+
+work_pool::~work_pool()
+{
+    wait_idle();
+    {
+        std::lock_guard<std::mutex> g(idle_lock_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &w : workers_)
+    {
+        w->thread.join();
+    }
+}
+
+void work_pool::submit(int id, task_fn fn, void *ctx)
+{
+    worker &w = *workers_[(unsigned)id % workers_.size()];
+
+    pending_++;
+    {
+        std::lock_guard<std::mutex> g(w.lock);
+        w.queue.push_back(task{ fn, ctx });
+    }
+    queued_++;
+
+    /* A sleeping worker checks queued_ under idle_lock_, taking it here closes the window before its wait */
+    if (sleepers_.load() > 0)
+    {
+        {
+            std::lock_guard<std::mutex> g(idle_lock_);
+        }
+        wake_.notify_all();
+    }
+}
+
+/* The front of the worker's own queue, else the back of another one */
+bool work_pool::take(int id, task &t)
+{
+    int n = (int)workers_.size();
+
+    for (int k = 0; k < n; k++)
+    {
+        worker &w = *workers_[(id + k) % n];
+        std::lock_guard<std::mutex> g(w.lock);
+
+        if (w.queue.empty())
+        {
+            continue;
+        }
+        if (k == 0)
+        {
+            t = w.queue.front();
+            w.queue.pop_front();
+        }
+        else
+        {
+            t = w.queue.back();
+            w.queue.pop_back();
+            workers_[id]->stolen++;
+        }
+        queued_--;
+        return true;
+    }
+    return false;
+}
+
+void work_pool::run(int id)
+{
+    worker &self = *workers_[id];
+    int idle = 0;
+    task t;
+
+    for (;;)
+    {
+        if (take(id, t))
+        {
+            t.fn(t.ctx, id);
+            self.executed++;
+            if (--pending_ == 0)
+            {
+                std::lock_guard<std::mutex> g(idle_lock_);
+                idle_.notify_all();
+            }
+            idle = 0;
+            continue;
+        }
+
+        /* Tasks come in bursts, going to sleep for each gap would cost a wake up per task */
+        if (idle++ < WORK_POOL_SPINS)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        idle = 0;
+
+        std::unique_lock<std::mutex> g(idle_lock_);
+        sleepers_++;
+        while (queued_.load() == 0 && !stop_)
+        {
+            wake_.wait(g);
+        }
+        sleepers_--;
+        if (stop_ && queued_.load() == 0)
+        {
+            return;
+        }
+    }
+}
+
+void work_pool::wait_idle()
+{
+    std::unique_lock<std::mutex> g(idle_lock_);
+
+    while (pending_.load() != 0)
+    {
+        idle_.wait(g);
+    }
+}
+
+work_pool_stats work_pool::stats(int id) const
+{
+    work_pool_stats s;
+
+    s.executed = workers_[id]->executed.load();
+    s.stolen = workers_[id]->stolen.load();
+    return s;
+}
+
+} // namespace rtls
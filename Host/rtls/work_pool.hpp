@@ -0,0 +1,89 @@
+/*! ----------------------------------------------------------------------------
+ * @file    work_pool.hpp
+ * @brief   Work-stealing thread pool
+ *
+ *          Each worker has its own task queue. A task is submitted to a given
+ *          worker, which runs its queue in order. A worker with an empty
+ *          queue steals from the back of the others, so the tasks still run
+ *          when their worker is busy, and on the worker they were meant for
+ *          when it is not. position_server.hpp uses that to keep each tag on
+ *          one worker.
+ *
+ *          The queues are short and locked per worker, so a submit or a steal
+ *          only contends with the worker it touches. Idle workers sleep, a
+ *          submit wakes them only when some do.
+ */
+
+#ifndef RTLS_WORK_POOL_HPP_
+#define RTLS_WORK_POOL_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rtls
+{
+
+struct work_pool_stats
+{
+    unsigned long long  executed;   // tasks run by the worker, stolen ones included
+    unsigned long long  stolen;     // tasks the worker took from another queue
+};
+
+class work_pool
+{
+public:
+    typedef void (*task_fn)(void *ctx, int worker);
+
+    /* Start the worker threads, 0 means one per core */
+    explicit work_pool(int workers);
+
+    /* Runs what is queued, then stops the workers */
+    ~work_pool();
+
+    /* Queue fn(ctx, worker) on worker (modulo the number of workers); any thread may submit */
+    void submit(int worker, task_fn fn, void *ctx);
+
+    /* Wait until every queue is empty and no task runs; tasks submitted meanwhile are waited for too */
+    void wait_idle();
+
+    int size() const { return (int)workers_.size(); }
+
+    work_pool_stats stats(int worker) const;
+
+private:
+    struct task
+    {
+        task_fn     fn;
+        void       *ctx;
+    };
+
+    struct worker
+    {
+        std::mutex                      lock;
+        std::deque<task>                queue;
+        std::thread                     thread;
+        std::atomic<unsigned long long> executed{0};
+        std::atomic<unsigned long long> stolen{0};
+    };
+
+    void run(int id);
+    bool take(int id, task &t);
+
+    std::vector<std::unique_ptr<worker>>    workers_;
+    std::mutex                              idle_lock_;
+    std::condition_variable                 wake_;      // workers wait for a task
+    std::condition_variable                 idle_;      // wait_idle() waits for pending_ == 0
+    std::atomic<long>                       queued_{0};
+    std::atomic<long>                       pending_{0};    // queued or running
+    std::atomic<int>                        sleepers_{0};
+    bool                                    stop_ = false;
+};
+
+} // namespace rtls
+
+#endif /* RTLS_WORK_POOL_HPP_ */
@@ -0,0 +1,250 @@
+/*! ----------------------------------------------------------------------------
+ * @file    rx_burst_bench.c
+ * @brief   Frames lost by an anchor to bursts, with single and double RX buffering
+ *
+ *          Runs a master anchor of the ranging engine (twr_engine.h) on the
+ *          DW1000 emulator, with the fast radio profile of the examples
+ *          (6.8 Mb/s, 128 symbol preamble), and sends it bursts of relay
+ *          frames from the other anchors, back to back with a small gap.
+ *          The anchor hands each distance to the protocol layer, here
+ *          twr_report_range(), which takes a given time on the MCU.
+ *
+ *          With a single RX buffer the receiver is off from the end of a
+ *          frame until the anchor has handled it. A frame whose preamble has
+ *          gone by meanwhile is lost. With TWR_FLAG_DBL_RX the receiver is
+ *          back on before the frame is read, and the next frame waits in the
+ *          other buffer.
+ *
+ *          For each protocol layer time it prints the frames lost, polled
+ *          and with TWR_FLAG_IRQ, and what the emulator and the engine
+ *          counted: frames missed by the receiver, dropped and overruns.
+ *          See Host/README.md for the build.
+ *
+ *          usage: rx_burst_bench [bursts [frames [gap_us]]]
+ *          At most 8 frames per burst, the frames the emulator can queue.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deca_device_api.h"
+#include "deca_regs.h"
+#include "dw1000_emu.h"
+#include "host_port.h"
+#include "twr_engine.h"
+#include "twr_report.h"
+
+#define MAX_BURST       8
+#define RELAY_LEN       TWR_RELAY_LEN
+
+/* Fast profile of Examples/DS_TWR_Compete */
+static dwt_config_t config = {
+    2,               /* Channel number. */
+    DWT_PRF_64M,     /* Pulse repetition frequency. */
+    DWT_PLEN_128,    /* Preamble length. Used in TX only. */
+    DWT_PAC8,        /* Preamble acquisition chunk size. Used in RX only. */
+    9,               /* TX preamble code. Used in TX only. */
+    9,               /* RX preamble code. Used in RX only. */
+    0,               /* 0 to use standard SFD, 1 to use non-standard SFD. */
+    DWT_BR_6M8,      /* Data rate. */
+    DWT_PHRMODE_STD, /* PHY header mode. */
+    (129 + 8 - 8)    /* SFD timeout (preamble length + 1 + SFD length - PAC size). Used in RX only. */
+};
+
+typedef struct
+{
+    uint32  sent;
+    uint32  received;
+    uint32  missed;     // emulator: frames the receiver did not hear
+    uint32  dropped;    // engine: frames discarded when turning around
+    uint32  overruns;
+} burst_result_t;
+
+static dw1000_emu_t *emu;
+static uint64_t work_dtu;
+static uint32 reports;
+
+/* Protocol layer: takes the report, and work_dtu of MCU time */
+int twr_report_range(twr_range_report_t *r)
+{
+    (void)r;
+    reports++;
+    dw1000_emu_advance(emu, work_dtu);
+    return 0;
+}
+
+int twr_report_poll(void)
+{
+    return 0;
+}
+
+int twr_report_telemetry(const twr_telemetry_report_t *t)
+{
+    (void)t;
+    return 0;
+}
+
+int twr_report_cir(const twr_cir_report_t *c)
+{
+    (void)c;
+    return 0;
+}
+
+int twr_report_pending(void)
+{
+    return 0;
+}
+
+static uint16 fcs16(const uint8 *data, uint32 len)
+{
+    uint16 crc = 0;
+    uint32 i;
+    int b;
+
+    for (i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for (b = 0; b < 8; b++)
+        {
+            crc = (crc & 1) ? (uint16)((crc >> 1) ^ 0x8408) : (uint16)(crc >> 1);
+        }
+    }
+    return crc;
+}
+
+/* Relay of anchor id to the master anchor, as twr_ds_range() sends it */
+static void relay_frame(uint8 *msg, uint8 seq, uint8 id)
+{
+    uint16 fcs;
+
+    memset(msg, 0, RELAY_LEN);
+    msg[0] = 0x41;
+    msg[1] = 0x88;
+    msg[TWR_MSG_SN_IDX] = seq;
+    msg[3] = 0xCA;
+    msg[4] = 0xDE;
+    msg[TWR_MSG_ADDR_IDX] = 'D';
+    msg[TWR_MSG_ADDR_IDX + 1] = 'I';
+    msg[TWR_MSG_ID_IDX] = id;
+    msg[TWR_MSG_ADDR_IDX + 3] = 'T';
+    msg[TWR_MSG_FC_IDX] = TWR_FC_RELAY;
+    msg[TWR_RELAY_METRES_IDX] = 3;
+    msg[TWR_RELAY_CM_IDX] = 25;
+    fcs = fcs16(msg, RELAY_LEN - 2);
+    msg[RELAY_LEN - 2] = (uint8)fcs;
+    msg[RELAY_LEN - 1] = (uint8)(fcs >> 8);
+}
+
+static void run(uint8 flags, double work_us, uint32 bursts, uint32 frames, double gap_us, burst_result_t *res)
+{
+    static twr_engine_t engine;
+    const twr_cfg_t cfg = {
+        TWR_ROLE_ANCHOR,
+        TWR_MODE_DS,
+        '1',
+        (uint8)(TWR_FLAG_MASTER | flags),
+        { &config, 16505, 16505, 0, 0, 64 },   // preamble timeout of the examples' fast anchor
+        0,
+        0,
+        0,
+        0
+    };
+    uint8 msg[RELAY_LEN];
+    dw1000_emu_frame_t f;
+    dw1000_emu_stats_t stats;
+    uint64_t shr, payload, t, end;
+    uint32 b, k;
+
+    emu = dw1000_emu_create();
+    host_port_attach(emu);
+    memset(&engine, 0, sizeof(engine));
+    memset(res, 0, sizeof(*res));
+    reports = 0;
+    work_dtu = (uint64_t)(work_us * DW1000_EMU_DTU_PER_US);
+    if (twr_engine_init(&engine, &cfg) == DWT_ERROR)
+    {
+        fprintf(stderr, "DW1000 initialisation failed\n");
+        exit(1);
+    }
+    twr_anchor_start(&engine);
+    dw1000_emu_frame_durations(emu, RELAY_LEN, &shr, &payload);
+
+    memset(&f, 0, sizeof(f));
+    f.data = msg;
+    f.length = RELAY_LEN;
+    f.prf = config.prf;
+    f.dataRate = config.dataRate;
+    f.preambleLength = 128;
+    f.rxPower = -70.0;
+    f.fpPower = -72.0;
+
+    for (b = 0; b < bursts; b++)
+    {
+        /* The burst starts 1 ms from now, at a random point of the anchor's polling */
+        t = dw1000_emu_time(emu) + DW1000_EMU_DTU_PER_MS + (uint64_t)(rand() % 1000) * 64;
+        for (k = 0; k < frames; k++)
+        {
+            relay_frame(msg, (uint8)b, (uint8)('2' + k % 7));
+            f.start = t;
+            f.rmarker = t + shr;
+            f.end = t + shr + payload;
+            dw1000_emu_receive(emu, &f);
+            t = f.end + (uint64_t)(gap_us * DW1000_EMU_DTU_PER_US);
+        }
+        res->sent += frames;
+
+        /* Until every frame has been handled or lost */
+        end = f.end + 2 * DW1000_EMU_DTU_PER_MS;
+        while (dw1000_emu_time(emu) < end)
+        {
+            twr_engine_step(&engine);
+        }
+    }
+
+    dw1000_emu_get_stats(emu, &stats);
+    res->received = reports;
+    res->missed = stats.rx_missed;
+    res->dropped = engine.stats.rx_dropped;
+    res->overruns = engine.stats.rx_overruns + stats.rx_overruns;
+    host_port_attach(NULL);
+    dw1000_emu_destroy(emu);
+}
+
+int main(int argc, char **argv)
+{
+    static const double work[] = { 0, 50, 100, 150, 200, 300, 400 };
+    static const uint8 modes[] = { 0, TWR_FLAG_DBL_RX, TWR_FLAG_IRQ, TWR_FLAG_IRQ | TWR_FLAG_DBL_RX };
+    uint32 bursts = (argc > 1) ? (uint32)atoi(argv[1]) : 1000;
+    uint32 frames = (argc > 2) ? (uint32)atoi(argv[2]) : MAX_BURST;
+    double gap_us = (argc > 3) ? atof(argv[3]) : 10.0;
+    burst_result_t res;
+    size_t i, m;
+
+    if (frames == 0 || frames > MAX_BURST)
+    {
+        fprintf(stderr, "1 to %d frames per burst\n", MAX_BURST);
+        return 1;
+    }
+
+    printf("%lu bursts of %lu relay frames, %.1f us apart, 6.8 Mb/s, 128 symbol preamble\n",
+           (unsigned long)bursts, (unsigned long)frames, gap_us);
+    printf("frames lost, and missed / dropped / overruns\n");
+    printf("%-8s  %-20s  %-20s  %-20s  %-20s\n", "work us", "polled", "polled, double", "irq", "irq, double");
+    for (i = 0; i < sizeof(work) / sizeof(work[0]); i++)
+    {
+        printf("%-8.0f", work[i]);
+        for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+        {
+            char cell[64];
+
+            srand(1);
+            run(modes[m], work[i], bursts, frames, gap_us, &res);
+            snprintf(cell, sizeof(cell), "%5.1f %% %lu/%lu/%lu", 100.0 * (res.sent - res.received) / res.sent,
+                     (unsigned long)res.missed, (unsigned long)res.dropped, (unsigned long)res.overruns);
+            printf("  %-20s", cell);
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,278 @@
+/*! ----------------------------------------------------------------------------
+ * @file    rx_snapshot_bench.c
+ * @brief   Cost of reading a received frame, from RXFCG to the data ready
+ *
+ *          Sends frames to the DW1000 emulator, with the fast radio profile
+ *          of the examples, and once RXFCG is set reads each one twice:
+ *          - legacy:   the frame info and the frame, then
+ *                      dwt_readrxtimestamp(), dwt_readdiagnostics() and
+ *                      dwt_readcarrierintegrator() as the step needs them
+ *          - snapshot: dwt_readrxsnapshot() with the same parts
+ *          for the frames of a ranging exchange:
+ *          - ignored:  frame heard by an anchor waiting for requests, for
+ *                      another anchor: the frame alone
+ *          - poll:     poll of the anchor: frame and RX timestamp
+ *          - final:    DS final of the anchor: and the diagnostics, for the
+ *                      range report
+ *          - ss resp:  SS response of the tag: and the carrier integrator
+ *          It prints the SPI transactions and bytes per frame, the on-board
+ *          time from the emulated 8 MHz SPI clock, and that time plus cs_us
+ *          per transaction: chip select, and the HAL call around each
+ *          transfer, which the emulator does not count. It checks that both
+ *          ways read the same values. Build with DWM_SPI_STATS, see
+ *          Host/README.md.
+ *
+ *          usage: rx_snapshot_bench [frames [cs_us]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deca_device_api.h"
+#include "deca_regs.h"
+#include "DWM_functions.h"
+#include "dw1000_emu.h"
+#include "host_port.h"
+
+#ifndef DWM_SPI_STATS
+#error "rx_snapshot_bench needs the SPI counters, build with -DDWM_SPI_STATS"
+#endif
+
+#define FRAME_LEN       27      // DS final, FCS included
+#define MAX_FRAME_LEN   127
+
+/* Fast profile of Examples/DS_TWR_Compete */
+static dwt_config_t config = {
+    2,               /* Channel number. */
+    DWT_PRF_64M,     /* Pulse repetition frequency. */
+    DWT_PLEN_128,    /* Preamble length. Used in TX only. */
+    DWT_PAC8,        /* Preamble acquisition chunk size. Used in RX only. */
+    9,               /* TX preamble code. Used in TX only. */
+    9,               /* RX preamble code. Used in RX only. */
+    0,               /* 0 to use standard SFD, 1 to use non-standard SFD. */
+    DWT_BR_6M8,      /* Data rate. */
+    DWT_PHRMODE_STD, /* PHY header mode. */
+    (129 + 8 - 8)    /* SFD timeout (preamble length + 1 + SFD length - PAC size). Used in RX only. */
+};
+
+typedef struct
+{
+    const char *name;
+    uint8       flags;      // DWT_RXSNAP_xxx the step reads
+} step_t;
+
+static const step_t steps[] = {
+    { "ignored",  DWT_RXSNAP_FRAME },
+    { "poll",     DWT_RXSNAP_FRAME | DWT_RXSNAP_TIME },
+    { "final",    DWT_RXSNAP_FRAME | DWT_RXSNAP_TIME | DWT_RXSNAP_DIAG },
+    { "ss resp",  DWT_RXSNAP_ALL },
+};
+
+#define NUM_STEPS   (sizeof(steps) / sizeof(steps[0]))
+
+typedef struct
+{
+    dwm_spi_stats_t spi;
+    uint64_t        device_dtu;
+} read_cost_t;
+
+static dw1000_emu_t *emu;
+
+static uint16 fcs16(const uint8 *data, uint32 len)
+{
+    uint16 crc = 0;
+    uint32 i;
+    int b;
+
+    for (i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for (b = 0; b < 8; b++)
+        {
+            crc = (crc & 1) ? (uint16)((crc >> 1) ^ 0x8408) : (uint16)(crc >> 1);
+        }
+    }
+    return crc;
+}
+
+static void add_cost(read_cost_t *c, const dwm_spi_stats_t *spi, uint64_t dtu)
+{
+    c->spi.transactions += spi->transactions;
+    c->spi.header_bytes += spi->header_bytes;
+    c->spi.rx_bytes += spi->rx_bytes;
+    c->device_dtu += dtu;
+}
+
+/* Sends a frame to the receiver and waits for RXFCG. Returns 0 if it was not received. */
+static int receive_frame(const uint8 *msg, uint16 len, uint32 seq)
+{
+    dw1000_emu_frame_t f;
+    uint64_t shr, payload;
+
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_GOOD | SYS_STATUS_ALL_RX_ERR | SYS_STATUS_ALL_RX_TO);
+    dwt_rxenable(DWT_START_RX_IMMEDIATE);
+    dw1000_emu_frame_durations(emu, len, &shr, &payload);
+
+    memset(&f, 0, sizeof(f));
+    f.data = msg;
+    f.length = len;
+    f.prf = config.prf;
+    f.dataRate = config.dataRate;
+    f.preambleLength = 128;
+    f.rxPower = -70.0 - (seq % 20);
+    f.fpPower = -72.0 - (seq % 20);
+    f.clockOffset = ((double)(seq % 41) - 20.0) * 1e-6;
+    f.start = dw1000_emu_time(emu) + 10 * DW1000_EMU_DTU_PER_US + (uint64_t)(seq % 1000) * 64;
+    f.rmarker = f.start + shr;
+    f.end = f.rmarker + payload;
+    if (dw1000_emu_receive(emu, &f) != 0)
+    {
+        return 0;
+    }
+    dw1000_emu_advance_to(emu, f.end + DW1000_EMU_DTU_PER_US);
+    return (dwt_read32bitreg(SYS_STATUS_ID) & SYS_STATUS_RXFCG) != 0;
+}
+
+/* The reads of the engine before dwt_readrxsnapshot(), into snap and buffer */
+static void read_legacy(dwt_rxsnapshot_t *snap, uint8 *buffer, uint8 flags)
+{
+    snap->finfo = dwt_read32bitreg(RX_FINFO_ID);
+    snap->length = (uint16)(snap->finfo & RX_FINFO_RXFLEN_MASK);
+    dwt_readrxdata(buffer, snap->length, 0);
+    if (flags & DWT_RXSNAP_TIME)
+    {
+        dwt_readrxtimestamp(snap->rxStamp);
+    }
+    if (flags & DWT_RXSNAP_DIAG)
+    {
+        dwt_readdiagnostics(&snap->diag);
+    }
+    if (flags & DWT_RXSNAP_CI)
+    {
+        snap->carrierInt = dwt_readcarrierintegrator();
+    }
+}
+
+/* Nonzero if the parts of a and b that flags reads differ */
+static int snap_differs(const dwt_rxsnapshot_t *a, const uint8 *abuf, const dwt_rxsnapshot_t *b, const uint8 *bbuf,
+                        uint8 flags)
+{
+    if (a->finfo != b->finfo || a->length != b->length || memcmp(abuf, bbuf, a->length) != 0)
+    {
+        return 1;
+    }
+    if ((flags & DWT_RXSNAP_TIME) && memcmp(a->rxStamp, b->rxStamp, sizeof(a->rxStamp)) != 0)
+    {
+        return 1;
+    }
+    if ((flags & DWT_RXSNAP_DIAG) &&
+        (a->diag.maxNoise != b->diag.maxNoise || a->diag.firstPathAmp1 != b->diag.firstPathAmp1 ||
+         a->diag.stdNoise != b->diag.stdNoise || a->diag.firstPathAmp2 != b->diag.firstPathAmp2 ||
+         a->diag.firstPathAmp3 != b->diag.firstPathAmp3 || a->diag.maxGrowthCIR != b->diag.maxGrowthCIR ||
+         a->diag.rxPreamCount != b->diag.rxPreamCount || a->diag.firstPath != b->diag.firstPath))
+    {
+        return 1;
+    }
+    return (flags & DWT_RXSNAP_CI) && a->carrierInt != b->carrierInt;
+}
+
+static void print_cost(const char *name, const read_cost_t *c, uint32 frames, double cs_us)
+{
+    double xfers = (double)c->spi.transactions / frames;
+    double us = c->device_dtu / (double)frames / (1e-6 / DWT_TIME_UNITS);
+
+    printf("  %-9s %9.1f %10.1f %10.1f %12.2f %12.2f\n", name, xfers, (double)c->spi.header_bytes / frames,
+           (double)c->spi.rx_bytes / frames, us, us + xfers * cs_us);
+}
+
+int main(int argc, char **argv)
+{
+    uint32 frames = (argc > 1) ? (uint32)atoi(argv[1]) : 10000;
+    double cs_us = (argc > 2) ? atof(argv[2]) : 2.0;
+    uint8 msg[FRAME_LEN], legacy_buf[MAX_FRAME_LEN], snap_buf[MAX_FRAME_LEN];
+    dwt_rxsnapshot_t legacy, snap;
+    read_cost_t cost[NUM_STEPS][2];
+    dwm_spi_stats_t spi;
+    uint64_t t0;
+    uint32 i, k, lost = 0;
+    uint16 fcs;
+    size_t s;
+    int failed = 0;
+
+    if (frames == 0)
+    {
+        fprintf(stderr, "usage: rx_snapshot_bench [frames [cs_us]]\n");
+        return 1;
+    }
+
+    emu = dw1000_emu_create();
+    host_port_attach(emu);
+    if (dwt_initialise(DWT_LOADUCODE) == DWT_ERROR)
+    {
+        fprintf(stderr, "dwt_initialise() failed\n");
+        return 1;
+    }
+    port_set_dw1000_fastrate();
+    dwt_configure(&config);
+    memset(cost, 0, sizeof(cost));
+
+    for (i = 0; i < frames; i++)
+    {
+        for (k = 0; k < FRAME_LEN - 2; k++)
+        {
+            msg[k] = (uint8)(i * 31 + k);
+        }
+        fcs = fcs16(msg, FRAME_LEN - 2);
+        msg[FRAME_LEN - 2] = (uint8)fcs;
+        msg[FRAME_LEN - 1] = (uint8)(fcs >> 8);
+        if (!receive_frame(msg, FRAME_LEN, i))
+        {
+            lost++;
+            continue;
+        }
+        for (s = 0; s < NUM_STEPS; s++)
+        {
+            memset(&legacy, 0, sizeof(legacy));
+            memset(&snap, 0, sizeof(snap));
+
+            dwm_spi_stats_reset();
+            t0 = dw1000_emu_time(emu);
+            read_legacy(&legacy, legacy_buf, steps[s].flags);
+            dwm_spi_stats_get(&spi);
+            add_cost(&cost[s][0], &spi, dw1000_emu_time(emu) - t0);
+
+            dwm_spi_stats_reset();
+            t0 = dw1000_emu_time(emu);
+            dwt_readrxsnapshot(&snap, snap_buf, sizeof(snap_buf), steps[s].flags);
+            dwm_spi_stats_get(&spi);
+            add_cost(&cost[s][1], &spi, dw1000_emu_time(emu) - t0);
+
+            if (snap_differs(&legacy, legacy_buf, &snap, snap_buf, steps[s].flags) && !failed)
+            {
+                printf("%s: frame %lu, dwt_readrxsnapshot() differs from the legacy reads\n", steps[s].name,
+                       (unsigned long)i);
+                failed = 1;
+            }
+        }
+    }
+    if (lost == frames)
+    {
+        fprintf(stderr, "no frame received\n");
+        return 1;
+    }
+    frames -= lost;
+
+    printf("%lu frames of %d bytes, 6.8 Mb/s, %.1f us per SPI transaction\n", (unsigned long)frames, FRAME_LEN, cs_us);
+    printf("per frame    spi xfers  hdr bytes   rx bytes  on-board us   with cs us\n");
+    for (s = 0; s < NUM_STEPS; s++)
+    {
+        printf("%s\n", steps[s].name);
+        print_cost("legacy", &cost[s][0], frames, cs_us);
+        print_cost("snapshot", &cost[s][1], frames, cs_us);
+    }
+
+    host_port_attach(NULL);
+    dw1000_emu_destroy(emu);
+    return failed;
+}
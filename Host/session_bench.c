@@ -0,0 +1,166 @@
+/*! ----------------------------------------------------------------------------
+ * @file    session_bench.c
+ * @brief   Cost of one initiator round with and without the persistent session
+ *
+ *          Runs the start of an SS/DS TWR round (device set up, poll frame
+ *          write, immediate transmission) on the DW1000 emulator, in two ways:
+ *          - full: reset, dwt_initialise() and dwt_configure() every round, as
+ *            the examples used to do
+ *          - session: dwm_session_open() on an open session, then the frame
+ *          It prints the SPI transactions and bytes, the on-board time (from
+ *          the emulated SPI clock, delays and radio) and the host wall time per
+ *          round. The time on air of the frame is the same in both cases and
+ *          included. Build with DWM_SPI_STATS, see Host/README.md.
+ *
+ *          usage: session_bench [rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "deca_device_api.h"
+#include "deca_regs.h"
+#include "DWM_functions.h"
+#include "dwm_session.h"
+#include "dw1000_emu.h"
+#include "host_port.h"
+
+#ifndef DWM_SPI_STATS
+#error "session_bench needs the SPI counters, build with -DDWM_SPI_STATS"
+#endif
+
+/* Same settings as Examples/DS_TWR_Compete/ds_initiator.c */
+static dwt_config_t config = {
+    2,               /* Channel number. */
+    DWT_PRF_64M,     /* Pulse repetition frequency. */
+    DWT_PLEN_1024,   /* Preamble length. Used in TX only. */
+    DWT_PAC32,       /* Preamble acquisition chunk size. Used in RX only. */
+    9,               /* TX preamble code. Used in TX only. */
+    9,               /* RX preamble code. Used in RX only. */
+    1,               /* 0 to use standard SFD, 1 to use non-standard SFD. */
+    DWT_BR_110K,     /* Data rate. */
+    DWT_PHRMODE_STD, /* PHY header mode. */
+    (1025 + 64 - 32) /* SFD timeout (preamble length + 1 + SFD length - PAC size). Used in RX only. */
+};
+
+static const dwm_session_cfg_t session = { &config, 16505, 16505, 300, 3500, 30 };
+
+typedef struct
+{
+    dwm_spi_stats_t spi;
+    uint64_t        device_dtu;
+    double          wall_s;
+} round_cost_t;
+
+static dw1000_emu_t *emu;
+static dwm_session_t dev = DWM_SESSION_INIT;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* One round: set up the device, write the poll frame for anchor x and send it */
+static void round_start(int full, int x, uint8 seq)
+{
+    uint8 tx_poll_msg[] = {0x41, 0x88, 0, 0xCA, 0xDE, 'W', 'A', 'V', 'E', 0x21, 0, 0};
+    uint32 status;
+
+    if (full)
+    {
+        dwm_session_close(&dev);
+    }
+    if (dwm_session_open(&dev, &session) == DWT_ERROR)
+    {
+        fprintf(stderr, "dwt_initialise() failed\n");
+        exit(1);
+    }
+
+    tx_poll_msg[2] = seq;
+    tx_poll_msg[7] = '1' + x;
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_TXFRS);
+    dwt_writetxdata(sizeof(tx_poll_msg), tx_poll_msg, 0);
+    dwt_writetxfctrl(sizeof(tx_poll_msg), 0, 1);
+    dwt_starttx(DWT_START_TX_IMMEDIATE);
+
+    /* Skip to the end of the transmission instead of polling SYS_STATUS, so the polls do not hide the set up cost */
+    do
+    {
+        dw1000_emu_advance_to(emu, dw1000_emu_next_event(emu));
+        dw1000_emu_peek(emu, SYS_STATUS_ID, 0, sizeof(status), (uint8 *)&status);
+    }
+    while (!(status & SYS_STATUS_TXFRS));
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_TXFRS);
+}
+
+static void measure(int full, int rounds, round_cost_t *cost)
+{
+    uint64_t t0;
+    double w0;
+    int i;
+
+    /* Start from an open session in both cases, the first full init is not part of the round cost */
+    dwm_session_close(&dev);
+    round_start(0, 0, 0);
+
+    dwm_spi_stats_reset();
+    t0 = dw1000_emu_time(emu);
+    w0 = now();
+    for (i = 0; i < rounds; i++)
+    {
+        round_start(full, i % 3, (uint8)i);
+    }
+    cost->wall_s = now() - w0;
+    cost->device_dtu = dw1000_emu_time(emu) - t0;
+    dwm_spi_stats_get(&cost->spi);
+}
+
+static void print_cost(const char *name, const round_cost_t *c, int rounds)
+{
+    printf("%-8s %8.1f %10.1f %10.1f %10.1f %12.2f %10.2f\n", name,
+           (double)c->spi.transactions / rounds,
+           (double)c->spi.header_bytes / rounds,
+           (double)c->spi.tx_bytes / rounds,
+           (double)c->spi.rx_bytes / rounds,
+           c->device_dtu / (double)rounds / (1e-6 / DWT_TIME_UNITS),
+           c->wall_s / rounds * 1e6);
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = (argc > 1) ? atoi(argv[1]) : 10000;
+    round_cost_t full, reuse;
+    double full_bytes, reuse_bytes;
+
+    if (rounds <= 0)
+    {
+        fprintf(stderr, "usage: session_bench [rounds]\n");
+        return 1;
+    }
+
+    emu = dw1000_emu_create();
+    host_port_attach(emu);
+
+    measure(1, rounds, &full);
+    measure(0, rounds, &reuse);
+
+    printf("per round  spi xfers  hdr bytes   tx bytes   rx bytes  on-board us    host us\n");
+    print_cost("full", &full, rounds);
+    print_cost("session", &reuse, rounds);
+
+    full_bytes = (double)(full.spi.header_bytes + full.spi.tx_bytes + full.spi.rx_bytes) / rounds;
+    reuse_bytes = (double)(reuse.spi.header_bytes + reuse.spi.tx_bytes + reuse.spi.rx_bytes) / rounds;
+    printf("saved per round: %.1f SPI transactions, %.1f SPI bytes, %.2f us on board, %.2f us host\n",
+           (double)(full.spi.transactions - reuse.spi.transactions) / rounds,
+           full_bytes - reuse_bytes,
+           (full.device_dtu - reuse.device_dtu) / (double)rounds / (1e-6 / DWT_TIME_UNITS),
+           (full.wall_s - reuse.wall_s) / rounds * 1e6);
+
+    host_port_attach(NULL);
+    dw1000_emu_destroy(emu);
+    return 0;
+}
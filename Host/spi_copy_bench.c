@@ -0,0 +1,208 @@
+/*! ----------------------------------------------------------------------------
+ * @file    spi_copy_bench.c
+ * @brief   Bytes moved per dwt_writetxdata()/dwt_readrxdata() call
+ *
+ *          Calls dwt_writetxdata(), dwt_readrxdata() and dwt_readaccdata()
+ *          with the frame and accumulator lengths of the examples on the
+ *          DW1000 emulator, through two SPI transports:
+ *          - staged: that of DWM_functions.c before the zero-copy change,
+ *                    which copied the header and the body into stack
+ *                    buffers on a write, and copied the header and zeroed
+ *                    the read buffer on a read
+ *          - direct: the caller's buffers straight to the SPI, as the
+ *                    board does now
+ *          It prints per call the SPI transactions, the header and payload
+ *          bytes clocked, the bytes the transport copies or clears in
+ *          memory on top, the on-board time from the emulated 8 MHz SPI
+ *          clock, and the host time of each transport. Build with
+ *          DWM_SPI_STATS, see Host/README.md.
+ *
+ *          usage: spi_copy_bench [calls]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "deca_device_api.h"
+#include "deca_regs.h"
+#include "DWM_functions.h"
+#include "dw1000_emu.h"
+#include "host_port.h"
+
+#ifndef DWM_SPI_STATS
+#error "spi_copy_bench needs the SPI counters, build with -DDWM_SPI_STATS"
+#endif
+
+#define ACC_LEN         (1016 * 4 + 1)  // whole accumulator at 64 MHz PRF, with the dummy first byte
+#define MAX_LEN         ACC_LEN
+
+typedef enum { OP_WRITE_TX, OP_READ_RX, OP_READ_ACC } op_t;
+
+typedef struct
+{
+    const char *name;
+    op_t        op;
+    uint16      len;
+} call_t;
+
+static const call_t calls[] = {
+    { "writetxdata poll",   OP_WRITE_TX, 12 },
+    { "writetxdata final",  OP_WRITE_TX, 27 },
+    { "writetxdata max",    OP_WRITE_TX, 127 },
+    { "readrxdata poll",    OP_READ_RX, 12 },
+    { "readrxdata final",   OP_READ_RX, 27 },
+    { "readrxdata max",     OP_READ_RX, 127 },
+    { "readaccdata chunk",  OP_READ_ACC, 16 * 4 + 1 },
+    { "readaccdata all",    OP_READ_ACC, ACC_LEN },
+};
+
+#define NUM_CALLS   (sizeof(calls) / sizeof(calls[0]))
+
+typedef struct
+{
+    dwm_spi_stats_t spi;
+    uint64_t        copied;     // bytes copied or cleared by the transport
+    uint64_t        device_dtu;
+    double          wall_s;
+} call_cost_t;
+
+static dw1000_emu_t *emu;
+static const deca_spi_backend_t *emu_spi;
+static uint64_t copied;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* The transport before the zero-copy change, in front of the emulator */
+static int staged_write(void *ctx, uint16 headerLength, const uint8 *headerBuffer, uint32 bodyLength,
+                        const uint8 *bodyBuffer)
+{
+    uint8 headBuf[headerLength];
+    uint8 bodyBuf[bodyLength + 1];
+    uint32 i;
+
+    (void)ctx;
+    for (i = 0; i < headerLength; i++)
+    {
+        headBuf[i] = headerBuffer[i];
+    }
+    for (i = 0; i < bodyLength; i++)
+    {
+        bodyBuf[i] = bodyBuffer[i];
+    }
+    copied += headerLength + bodyLength;
+    return emu_spi->write(emu_spi->ctx, headerLength, headBuf, bodyLength, bodyBuf);
+}
+
+static int staged_read(void *ctx, uint16 headerLength, const uint8 *headerBuffer, uint32 readLength,
+                       uint8 *readBuffer)
+{
+    uint8 headBuf[headerLength];
+    uint32 i;
+
+    (void)ctx;
+    for (i = 0; i < headerLength; i++)
+    {
+        headBuf[i] = headerBuffer[i];
+    }
+    for (i = 0; i < readLength; i++)
+    {
+        readBuffer[i] = 0;
+    }
+    copied += headerLength + readLength;
+    return emu_spi->read(emu_spi->ctx, headerLength, headBuf, readLength, readBuffer);
+}
+
+static const deca_spi_backend_t staged_spi = { "staged", staged_write, staged_read, NULL };
+
+static void run_call(const call_t *c, uint8 *buf)
+{
+    switch (c->op)
+    {
+    case OP_WRITE_TX:
+        dwt_writetxdata(c->len, buf, 0);
+        break;
+    case OP_READ_RX:
+        dwt_readrxdata(buf, c->len, 0);
+        break;
+    case OP_READ_ACC:
+        dwt_readaccdata(buf, c->len, 0);
+        break;
+    }
+}
+
+static void measure(const deca_spi_backend_t *spi, const call_t *c, int n, call_cost_t *cost)
+{
+    static uint8 buf[MAX_LEN];
+    uint64_t t0;
+    double w0;
+    int i;
+
+    memset(buf, 0x5A, sizeof(buf));
+    deca_spi_set_backend(spi);
+    copied = 0;
+    dwm_spi_stats_reset();
+    t0 = dw1000_emu_time(emu);
+    w0 = now();
+    for (i = 0; i < n; i++)
+    {
+        run_call(c, buf);
+    }
+    cost->wall_s = now() - w0;
+    cost->device_dtu = dw1000_emu_time(emu) - t0;
+    cost->copied = copied;
+    dwm_spi_stats_get(&cost->spi);
+    deca_spi_set_backend(emu_spi);
+}
+
+int main(int argc, char **argv)
+{
+    int n = (argc > 1) ? atoi(argv[1]) : 10000;
+    call_cost_t staged, direct;
+    size_t k;
+
+    if (n <= 0)
+    {
+        fprintf(stderr, "usage: spi_copy_bench [calls]\n");
+        return 1;
+    }
+
+    emu = dw1000_emu_create();
+    host_port_attach(emu);
+    emu_spi = deca_spi_get_backend();
+    if (dwt_initialise(DWT_LOADUCODE) == DWT_ERROR)
+    {
+        fprintf(stderr, "dwt_initialise() failed\n");
+        return 1;
+    }
+    port_set_dw1000_fastrate();
+
+    printf("per call            len  xfers  hdr bytes  data bytes  staged copy  direct copy  on-board us"
+           "  staged host us  direct host us\n");
+    for (k = 0; k < NUM_CALLS; k++)
+    {
+        measure(&staged_spi, &calls[k], n, &staged);
+        measure(emu_spi, &calls[k], n, &direct);
+        printf("%-18s %5u %6.1f %10.1f %11.1f %12.1f %12.1f %12.2f %15.3f %15.3f\n", calls[k].name,
+               (unsigned)calls[k].len,
+               (double)direct.spi.transactions / n,
+               (double)direct.spi.header_bytes / n,
+               (double)(direct.spi.tx_bytes + direct.spi.rx_bytes) / n,
+               (double)staged.copied / n,
+               (double)direct.copied / n,
+               direct.device_dtu / (double)n / (1e-6 / DWT_TIME_UNITS),
+               staged.wall_s / n * 1e6,
+               direct.wall_s / n * 1e6);
+    }
+
+    host_port_attach(NULL);
+    dw1000_emu_destroy(emu);
+    return 0;
+}
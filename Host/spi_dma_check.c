@@ -0,0 +1,347 @@
+/*! ----------------------------------------------------------------------------
+ * @file    spi_dma_check.c
+ * @brief   Check of DWM_platform/spi_dma.c on the mock DMA engine
+ *
+ *          Runs the DMA transport on Host/spi_dma_mock.c, with a device model
+ *          that records what is clocked out and answers reads with a known
+ *          pattern, and checks:
+ *          - ordering: descriptors run and call back in submission order,
+ *            each in its own chip-select cycle, with its header and body
+ *          - full queue: a submission beyond SPI_DMA_QUEUE_LEN is refused,
+ *            and the blocking writetospi()/readfromspi() wait for room
+ *          - errors: a failed header or body transfer completes its
+ *            descriptor with DWT_ERROR, the blocking calls return it, and
+ *            the descriptors queued behind it still complete
+ *          - throughput: with the queue kept full the bus never waits for
+ *            the CPU, only for the set up of each DMA transfer
+ *          Then prints the bus time and throughput of the driver's usual
+ *          accesses for the given SPI clock and set up cost.
+ *
+ *          usage: spi_dma_check [setup_ns [bitrate_hz]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deca_device_api.h"
+#include "deca_spi.h"
+#include "spi_dma.h"
+#include "spi_dma_mock.h"
+
+#ifndef DWM_SPI_USE_DMA
+#error "spi_dma_check needs the DMA transport, build with -DDWM_SPI_USE_DMA"
+#endif
+
+#define MAX_BODY        (1016 * 4 + 1)  // whole accumulator at 64 MHz PRF, with the dummy first byte
+#define CHUNK           128             // as SPI_DMA_RX_CHUNK of DWM_functions.c
+
+/* Device model: keeps the bytes of the last transaction, answers reads with a counter of the bytes read */
+static uint8 mosi[3 + MAX_BODY];
+static uint32 mosi_len;
+static uint8 miso_next;
+
+static void dev_select(void *ctx, int asserted)
+{
+    (void)ctx;
+    if (asserted)
+    {
+        mosi_len = 0;
+    }
+}
+
+static void dev_exchange(void *ctx, const uint8 *out, uint8 *in, uint32 len)
+{
+    uint32 i;
+
+    (void)ctx;
+    for (i = 0; i < len; i++)
+    {
+        if (mosi_len < sizeof(mosi))
+        {
+            mosi[mosi_len++] = (out != NULL) ? out[i] : 0;
+        }
+        if (in != NULL)
+        {
+            in[i] = miso_next++;
+        }
+    }
+}
+
+static const spi_dma_mock_device_t device = { dev_select, dev_exchange, NULL };
+
+/* Completions of the asynchronous submissions, in the order they arrive */
+static int done_order[2 * SPI_DMA_QUEUE_LEN];
+static int done_status[2 * SPI_DMA_QUEUE_LEN];
+static int done_count;
+
+static void on_done(void *arg, int status)
+{
+    if (done_count < (int)(sizeof(done_order) / sizeof(done_order[0])))
+    {
+        done_order[done_count] = (int)(intptr_t)arg;
+        done_status[done_count] = status;
+    }
+    done_count++;
+}
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    if (!ok)
+    {
+        failures++;
+        printf("FAIL: %s\n", what);
+    }
+}
+
+static void start(uint32 setup_ns, uint32 bitrate_hz, uint32 max_chunk)
+{
+    spi_dma_mock_config_t cfg;
+
+    cfg.bitrate_hz = bitrate_hz;
+    cfg.setup_ns = setup_ns;
+    cfg.max_chunk = max_chunk;
+    spi_dma_mock_init(&cfg, &device);
+    spi_dma_reset_stats();
+    done_count = 0;
+    miso_next = 0;
+}
+
+/* Header of descriptor i: a 2-byte write or read header of register i */
+static void header_of(int i, int write, uint8 *h)
+{
+    h[0] = (uint8)((write ? 0x80 : 0x00) | 0x40 | (i & 0x3F));
+    h[1] = (uint8)i;
+}
+
+static void check_ordering(void)
+{
+    static uint8 body[SPI_DMA_QUEUE_LEN][8];
+    static uint8 rx[SPI_DMA_QUEUE_LEN][8];
+    const spi_dma_mock_txn_t *t;
+    spi_dma_stats_t s;
+    uint8 h[2];
+    int i, ok;
+
+    start(0, 8000000, 0);
+    for (i = 0; i < SPI_DMA_QUEUE_LEN; i++)
+    {
+        header_of(i, i & 1, h);
+        memset(body[i], 0xA0 + i, sizeof(body[i]));
+        if (i & 1)
+        {
+            ok = spi_dma_write(2, h, 1 + i % 8, body[i], on_done, (void *)(intptr_t)i);
+        }
+        else
+        {
+            ok = spi_dma_read(2, h, 1 + i % 8, rx[i], on_done, (void *)(intptr_t)i);
+        }
+        check(ok == DWT_SUCCESS, "ordering: submission refused");
+    }
+    check(spi_dma_pending() == SPI_DMA_QUEUE_LEN, "ordering: queue depth");
+    spi_dma_mock_run();
+    check(spi_dma_pending() == 0, "ordering: queue not drained");
+
+    check(done_count == SPI_DMA_QUEUE_LEN, "ordering: callback count");
+    for (i = 0; i < SPI_DMA_QUEUE_LEN && i < done_count; i++)
+    {
+        check(done_order[i] == i && done_status[i] == DWT_SUCCESS, "ordering: callback order or status");
+        t = spi_dma_mock_log((uint32)i);
+        header_of(i, i & 1, h);
+        check(t != NULL && t->headerLength == 2 && memcmp(t->header, h, 2) == 0, "ordering: header of transaction");
+        check(t != NULL && t->bodyLength == (uint32)(1 + i % 8), "ordering: body length of transaction");
+    }
+    check(spi_dma_mock_log(SPI_DMA_QUEUE_LEN) == NULL, "ordering: one chip-select cycle per descriptor");
+
+    /* The reads got the device's bytes in order: reads 0, 2 and 4 are 1, 3 and 5 bytes long */
+    check(rx[0][0] == 0 && rx[2][0] == 1 && rx[2][2] == 3 && rx[4][0] == 4, "ordering: read data");
+
+    spi_dma_get_stats(&s);
+    check(s.submitted == SPI_DMA_QUEUE_LEN && s.completed == SPI_DMA_QUEUE_LEN && s.errors == 0, "ordering: stats");
+    check(s.max_depth == SPI_DMA_QUEUE_LEN && s.dma_starts == 2 * SPI_DMA_QUEUE_LEN, "ordering: depth or DMA starts");
+    printf("ordering: %d descriptors, %d callbacks in order, %lu DMA transfers\n", SPI_DMA_QUEUE_LEN, done_count,
+           (unsigned long)s.dma_starts);
+}
+
+static void check_full_queue(void)
+{
+    static uint8 body[SPI_DMA_QUEUE_LEN + 1][4];
+    const uint8 last[4] = { 1, 2, 3, 4 };
+    const spi_dma_mock_txn_t *t;
+    spi_dma_stats_t s;
+    uint8 h[2];
+    int i;
+
+    start(0, 8000000, 0);
+    for (i = 0; i < SPI_DMA_QUEUE_LEN; i++)
+    {
+        header_of(i, 1, h);
+        check(spi_dma_write(2, h, sizeof(body[i]), body[i], on_done, (void *)(intptr_t)i) == DWT_SUCCESS,
+              "full queue: submission refused below the limit");
+    }
+    header_of(i, 1, h);
+    check(spi_dma_write(2, h, sizeof(body[i]), body[i], on_done, (void *)(intptr_t)i) == DWT_ERROR,
+          "full queue: submission accepted beyond the limit");
+    check(spi_dma_pending() == SPI_DMA_QUEUE_LEN, "full queue: refused submission queued");
+
+    /* The blocking write waits for the queue to drain, then goes last */
+    header_of(0x3F, 1, h);
+    check(writetospi(2, h, sizeof(last), last) == DWT_SUCCESS, "full queue: blocking write failed");
+    check(spi_dma_pending() == 0, "full queue: queue not drained");
+    check(done_count == SPI_DMA_QUEUE_LEN, "full queue: callback count");
+    t = spi_dma_mock_log(SPI_DMA_QUEUE_LEN);
+    check(t != NULL && memcmp(t->header, h, 2) == 0, "full queue: blocking write out of order");
+    check(mosi_len == 2 + sizeof(last) && memcmp(mosi + 2, last, sizeof(last)) == 0, "full queue: blocking write body");
+
+    spi_dma_get_stats(&s);
+    check(s.rejected == 2 && s.submitted == SPI_DMA_QUEUE_LEN + 1, "full queue: stats");
+    printf("full queue: submission %d refused, blocking write waited and ran after the %d queued\n", SPI_DMA_QUEUE_LEN + 1,
+           SPI_DMA_QUEUE_LEN);
+}
+
+static void check_errors(void)
+{
+    static uint8 rx[1000];
+    const uint8 body[4] = { 0 };
+    const spi_dma_mock_txn_t *t;
+    spi_dma_stats_t s;
+    uint8 h[2];
+
+    start(0, 8000000, CHUNK);
+    header_of(1, 0, h);
+
+    /* Blocking read and write, the header transfer fails */
+    spi_dma_mock_fail_next();
+    check(readfromspi(2, h, 4, rx) == DWT_ERROR, "errors: failed blocking read returned success");
+    check(readfromspi(2, h, 4, rx) == DWT_SUCCESS, "errors: blocking read after a failure");
+    spi_dma_mock_fail_next();
+    check(writetospi(2, h, sizeof(body), body) == DWT_ERROR, "errors: failed blocking write returned success");
+    check(writetospi(2, h, sizeof(body), body) == DWT_SUCCESS, "errors: blocking write after a failure");
+
+    /* A body chunk fails in the middle of a long read: the read ends there, the next descriptor still runs */
+    check(spi_dma_read(2, h, sizeof(rx), rx, on_done, (void *)(intptr_t)0) == DWT_SUCCESS, "errors: read refused");
+    check(spi_dma_read(2, h, 4, rx, on_done, (void *)(intptr_t)1) == DWT_SUCCESS, "errors: read refused");
+    spi_dma_mock_step();                // header, starts the first chunk
+    spi_dma_mock_fail_next();
+    spi_dma_mock_step();                // first chunk, starts the failing second one
+    spi_dma_mock_run();
+    check(done_count == 2 && done_status[0] == DWT_ERROR && done_status[1] == DWT_SUCCESS,
+          "errors: chunk failure not reported, or not limited to its descriptor");
+    t = spi_dma_mock_log(4);
+    check(t != NULL && t->bodyLength == 2 * CHUNK, "errors: read went on after the failed chunk");
+
+    spi_dma_get_stats(&s);
+    check(s.errors == 3, "errors: stats");
+    printf("errors: header and body failures reported, %lu descriptors failed of %lu\n", (unsigned long)s.errors,
+           (unsigned long)s.completed);
+}
+
+/* Accesses of the driver: register reads and writes, frames, the accumulator */
+typedef struct
+{
+    const char *name;
+    uint16      header;
+    uint32      length;
+    int         write;
+} access_t;
+
+static const access_t accesses[] = {
+    { "read SYS_STATUS",    1, 4,       0 },
+    { "write SYS_CTRL",     1, 4,       1 },
+    { "write final frame",  1, 27,      1 },
+    { "read final frame",   1, 27,      0 },
+    { "write 127 bytes",    1, 127,     1 },
+    { "read 127 bytes",     1, 127,     0 },
+    { "read accumulator",   3, MAX_BODY, 0 },
+};
+
+#define NUM_ACCESSES    (sizeof(accesses) / sizeof(accesses[0]))
+#define THROUGHPUT_N    1000
+
+static void throughput(uint32 setup_ns, uint32 bitrate_hz)
+{
+    static uint8 buf[MAX_BODY];
+    const uint8 h[3] = { 0x40, 0x80, 0x01 };
+    spi_dma_mock_stats_t m;
+    uint64_t want_ns;
+    uint32 transfers;
+    size_t k;
+    int i;
+
+    printf("\n%lu Hz SPI, %lu ns set up per DMA transfer, queue kept full\n", (unsigned long)bitrate_hz, (unsigned long)setup_ns);
+    printf("access               bytes  transfers   bus us    Mb/s  of SPI clock\n");
+    for (k = 0; k < NUM_ACCESSES; k++)
+    {
+        const access_t *a = &accesses[k];
+
+        start(setup_ns, bitrate_hz, a->write ? 0 : CHUNK);
+        for (i = 0; i < THROUGHPUT_N; i++)
+        {
+            while (spi_dma_pending() >= SPI_DMA_QUEUE_LEN)
+            {
+                spi_dma_mock_step();
+            }
+            if (a->write)
+            {
+                spi_dma_write(a->header, h, a->length, buf, NULL, NULL);
+            }
+            else
+            {
+                spi_dma_read(a->header, h, a->length, buf, NULL, NULL);
+            }
+        }
+        spi_dma_mock_run();
+        spi_dma_mock_get_stats(&m);
+
+        /* The bus time is the clocked bytes and the set up of each transfer, nothing else */
+        transfers = 1 + (a->write ? 1 : (a->length + CHUNK - 1) / CHUNK);
+        want_ns = (uint64_t)THROUGHPUT_N * (transfers * setup_ns +
+                                            ((uint64_t)(a->header + a->length) * 8 * 1000000000ULL) / bitrate_hz);
+        check(m.transactions == THROUGHPUT_N && m.dma_transfers == THROUGHPUT_N * transfers, "throughput: transfers");
+        check(spi_dma_mock_time_ns() <= want_ns + THROUGHPUT_N * transfers && spi_dma_mock_time_ns() == m.busy_ns,
+              "throughput: bus idle between transfers");
+
+        printf("%-18s %7lu %10lu %8.2f %7.2f %11.1f %%\n", a->name, (unsigned long)(a->header + a->length), (unsigned long)transfers,
+               m.busy_ns * 1e-3 / THROUGHPUT_N, (double)m.bytes * 8 * 1e3 / m.busy_ns,
+               100.0 * ((double)m.bytes * 8 * 1e9 / bitrate_hz) / m.busy_ns);
+    }
+}
+
+/* The blocking calls of spi_dma.c take the driver's mutex, single threaded here */
+decaIrqStatus_t decamutexon(void)
+{
+    return 0;
+}
+
+void decamutexoff(decaIrqStatus_t s)
+{
+    (void)s;
+}
+
+int main(int argc, char **argv)
+{
+    uint32 setup_ns = (argc > 1) ? (uint32)atoi(argv[1]) : 2000;
+    uint32 bitrate_hz = (argc > 2) ? (uint32)atoi(argv[2]) : 8000000;
+
+    if (bitrate_hz == 0)
+    {
+        fprintf(stderr, "usage: spi_dma_check [setup_ns [bitrate_hz]]\n");
+        return 1;
+    }
+    deca_spi_set_backend(&deca_spi_dma);
+
+    check_ordering();
+    check_full_queue();
+    check_errors();
+    throughput(setup_ns, bitrate_hz);
+
+    if (failures != 0)
+    {
+        printf("\n%d checks failed\n", failures);
+        return 1;
+    }
+    printf("\nall checks passed\n");
+    return 0;
+}
@@ -0,0 +1,226 @@
+/*! ----------------------------------------------------------------------------
+ * @file    spi_dma_mock.c
+ * @brief   Linux mock of the DMA engine behind DWM_platform/spi_dma.c
+ */
+
+#include <string.h>
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+#include "spi_dma.h"
+#include "spi_dma_mock.h"
+
+typedef struct
+{
+    const uint8    *tx;         // NULL for a read
+    uint8          *rx;         // NULL for a write
+    uint32          len;
+    uint8           active;
+    uint8           fail;
+} mock_xfer_t;
+
+static spi_dma_mock_config_t    config = { 8000000, 0, 0 };
+static spi_dma_mock_device_t    device;
+static spi_dma_mock_stats_t     stats;
+static mock_xfer_t              xfer;
+static uint8                    fail_next;
+static uint64_t                   now_ns;
+
+static spi_dma_mock_txn_t       txn_log[SPI_DMA_MOCK_LOG_LEN];
+static uint32                   txn_count;      // transactions started
+static uint8                    in_txn;         // chip select asserted
+
+void spi_dma_mock_init(const spi_dma_mock_config_t *cfg, const spi_dma_mock_device_t *dev)
+{
+    if (cfg != NULL)
+    {
+        config = *cfg;
+    }
+    if (dev != NULL)
+    {
+        device = *dev;
+    }
+    else
+    {
+        memset(&device, 0, sizeof(device));
+    }
+    memset(&stats, 0, sizeof(stats));
+    memset(&xfer, 0, sizeof(xfer));
+    memset(txn_log, 0, sizeof(txn_log));
+    txn_count = 0;
+    in_txn = 0;
+    fail_next = 0;
+    now_ns = 0;
+}
+
+static spi_dma_mock_txn_t *current_txn(void)
+{
+    return &txn_log[(txn_count - 1) & (SPI_DMA_MOCK_LOG_LEN - 1)];
+}
+
+/****************************************************************************************************************************************************
+ *
+ * spi_dma_port_xxx() hooks
+ *
+ ****************************************************************************************************************************************************/
+
+void spi_dma_port_cs(int asserted)
+{
+    if (asserted)
+    {
+        spi_dma_mock_txn_t *t = &txn_log[txn_count & (SPI_DMA_MOCK_LOG_LEN - 1)];
+
+        memset(t, 0, sizeof(*t));
+        t->seq = txn_count++;
+        t->start_ns = now_ns;
+        in_txn = 1;
+        stats.transactions++;
+    }
+    else if (in_txn)
+    {
+        current_txn()->end_ns = now_ns;
+        in_txn = 0;
+    }
+
+    if (device.select != NULL)
+    {
+        device.select(device.ctx, asserted);
+    }
+}
+
+static uint32 mock_start(const uint8 *tx, uint8 *rx, uint32 len)
+{
+    if (xfer.active || len == 0)
+    {
+        return 0;
+    }
+    if (config.max_chunk != 0 && len > config.max_chunk)
+    {
+        len = config.max_chunk;
+    }
+
+    xfer.tx = tx;
+    xfer.rx = rx;
+    xfer.len = len;
+    xfer.active = 1;
+    xfer.fail = fail_next;
+    fail_next = 0;
+    stats.dma_transfers++;
+
+    return len;
+}
+
+uint32 spi_dma_port_start_tx(const uint8 *buf, uint32 len)
+{
+    return mock_start(buf, NULL, len);
+}
+
+uint32 spi_dma_port_start_rx(uint8 *buf, uint32 len)
+{
+    return mock_start(NULL, buf, len);
+}
+
+void spi_dma_port_lock(void)
+{
+    // single threaded, completions only happen from spi_dma_mock_step()
+}
+
+void spi_dma_port_unlock(void)
+{
+}
+
+void spi_dma_port_wait(void)
+{
+    spi_dma_mock_step();
+}
+
+/****************************************************************************************************************************************************
+ *
+ * Engine
+ *
+ ****************************************************************************************************************************************************/
+
+int spi_dma_mock_step(void)
+{
+    mock_xfer_t x = xfer;
+    uint64_t duration;
+
+    if (!x.active)
+    {
+        return 0;
+    }
+    xfer.active = 0;
+
+    duration = config.setup_ns;
+    if (config.bitrate_hz != 0)
+    {
+        duration += ((uint64_t)x.len * 8 * 1000000000ULL) / config.bitrate_hz;
+    }
+    now_ns += duration;
+    stats.busy_ns += duration;
+    stats.bytes += x.len;
+
+    if (in_txn)
+    {
+        spi_dma_mock_txn_t *t = current_txn();
+
+        if (x.tx != NULL && t->headerLength == 0 && t->bodyLength == 0 && x.len <= sizeof(t->header))
+        {
+            memcpy(t->header, x.tx, x.len);   // first transfer of a transaction is the header
+            t->headerLength = (uint8)x.len;
+        }
+        else
+        {
+            t->bodyLength += x.len;
+        }
+    }
+
+    if (device.exchange != NULL)
+    {
+        device.exchange(device.ctx, x.tx, x.rx, x.len);
+    }
+    else if (x.rx != NULL)
+    {
+        memset(x.rx, 0xFF, x.len);
+    }
+
+    spi_dma_complete(x.fail ? DWT_ERROR : DWT_SUCCESS);
+    return 1;
+}
+
+uint32 spi_dma_mock_run(void)
+{
+    uint32 n = 0;
+
+    while (spi_dma_mock_step())
+    {
+        n++;
+    }
+    return n;
+}
+
+void spi_dma_mock_fail_next(void)
+{
+    fail_next = 1;
+}
+
+uint64_t spi_dma_mock_time_ns(void)
+{
+    return now_ns;
+}
+
+void spi_dma_mock_get_stats(spi_dma_mock_stats_t *s)
+{
+    *s = stats;
+}
+
+const spi_dma_mock_txn_t *spi_dma_mock_log(uint32 index)
+{
+    uint32 kept = (txn_count < SPI_DMA_MOCK_LOG_LEN) ? txn_count : SPI_DMA_MOCK_LOG_LEN;
+
+    if (index >= kept)
+    {
+        return NULL;
+    }
+    return &txn_log[(txn_count - kept + index) & (SPI_DMA_MOCK_LOG_LEN - 1)];
+}
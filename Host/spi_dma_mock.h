@@ -0,0 +1,82 @@
+/*! ----------------------------------------------------------------------------
+ * @file    spi_dma_mock.h
+ * @brief   Linux mock of the DMA engine behind DWM_platform/spi_dma.c
+ *
+ *          Implements the spi_dma_port_xxx() hooks. Transfers are not completed
+ *          by an interrupt but by spi_dma_mock_step(), which also advances a
+ *          simulated bus clock, so queue depth, ordering and throughput of the
+ *          transport can be exercised off the board.
+ *
+ *          Bytes are exchanged with an optional device model (e.g. the DW1000
+ *          emulator); without one reads return 0xFF and writes are discarded.
+ */
+
+#ifndef SPI_DMA_MOCK_H_
+#define SPI_DMA_MOCK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "deca_types.h"
+
+#define SPI_DMA_MOCK_LOG_LEN    (256)   // transactions kept for ordering checks, power of 2
+
+typedef struct
+{
+    /* chip select edge, asserted != 0 when NSS goes low */
+    void (*select)(void *ctx, int asserted);
+    /* clock len bytes: mosi is NULL when zeros are sent, miso is NULL when the read data is discarded */
+    void (*exchange)(void *ctx, const uint8 *mosi, uint8 *miso, uint32 len);
+    void *ctx;
+} spi_dma_mock_device_t;
+
+typedef struct
+{
+    uint32  bitrate_hz;     // SCK frequency, e.g. 8000000 for port_set_dw1000_fastrate()
+    uint32  setup_ns;       // fixed cost of arming one DMA transfer (IRQ entry, HAL bookkeeping)
+    uint32  max_chunk;      // largest single transfer, 0 for no limit
+} spi_dma_mock_config_t;
+
+typedef struct
+{
+    uint32  seq;            // transaction number since spi_dma_mock_init()
+    uint8   header[3];
+    uint8   headerLength;
+    uint32  bodyLength;     // bytes clocked after the header
+    uint64_t  start_ns;       // simulated time of the chip select falling edge
+    uint64_t  end_ns;         // simulated time of the chip select rising edge
+} spi_dma_mock_txn_t;
+
+typedef struct
+{
+    uint32  transactions;   // chip select cycles
+    uint32  dma_transfers;  // individual DMA transfers
+    uint64_t  bytes;          // bytes clocked in either direction
+    uint64_t  busy_ns;        // time the bus was busy
+} spi_dma_mock_stats_t;
+
+void    spi_dma_mock_init(const spi_dma_mock_config_t *config, const spi_dma_mock_device_t *device);
+
+/* Complete the transfer in flight. Returns 1 if a transfer was completed, 0 if the engine was idle */
+int     spi_dma_mock_step(void);
+
+/* Step until the engine is idle, returns the number of transfers completed */
+uint32  spi_dma_mock_run(void);
+
+/* Make the next started transfer complete with DWT_ERROR */
+void    spi_dma_mock_fail_next(void);
+
+uint64_t  spi_dma_mock_time_ns(void);
+void    spi_dma_mock_get_stats(spi_dma_mock_stats_t *stats);
+
+/* Transaction log, index 0 is the oldest entry still kept. Returns NULL past the end */
+const spi_dma_mock_txn_t *spi_dma_mock_log(uint32 index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPI_DMA_MOCK_H_ */
@@ -0,0 +1,193 @@
+/*! ----------------------------------------------------------------------------
+ * @file    telemetry_stats.c
+ * @brief   Aggregator of the DW1000 event counts sent by the boards
+ *
+ *          Reads the report stream (see DWM_platform/twr_report.h) of boards
+ *          built with TWR_USE_TELEMETRY from a file or the serial device,
+ *          adds up the telemetry frames of each node (see
+ *          DWM_platform/twr_telemetry.h), and prints per node at the end:
+ *          - the total and the rate per second of every event
+ *          - the failed receptions by cause: preamble, SFD and frame wait
+ *            timeouts, PHY header errors, sync losses, CRC errors and
+ *            overruns, each as a share of all the failures
+ *          - the frame error rate: frames detected but lost to a header,
+ *            sync or CRC error, out of all the frames detected
+ *          Many preamble or frame wait timeouts with few errors point at
+ *          timeouts set too short, or at a peer out of range; many errors at
+ *          a weak link; overruns at frames arriving while busy.
+ *
+ *          usage: telemetry_stats [-v] [file]
+ *          -v also prints the events per second of every sample.
+ *          Set a serial device to raw mode first: stty -F /dev/ttyACM0 raw
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "twr_report.h"
+
+#define MAX_NODES   256     // node labels are one byte
+
+typedef struct
+{
+    unsigned long samples;
+    unsigned long missing;  // gaps in the sample numbers
+    uint16  next_seq;
+    double  seconds;
+    unsigned long events[TWR_RPT_TM_NUM_COUNTS];
+} node_stats_t;
+
+typedef struct
+{
+    int             verbose;
+    node_stats_t    nodes[MAX_NODES];
+} stats_ctx_t;
+
+static const char *const event_names[TWR_RPT_TM_NUM_COUNTS] = {
+    "phr errors", "sync losses", "crc good", "crc errors", "filtered", "overruns",
+    "sfd timeouts", "preamble timeouts", "frame timeouts", "frames sent", "late trx", "tx power up"
+};
+
+/* Failed receptions, in the order printed */
+static const int failures[] = {
+    TWR_RPT_TM_PTO, TWR_RPT_TM_SFDTO, TWR_RPT_TM_RTO, TWR_RPT_TM_PHE, TWR_RPT_TM_RSL, TWR_RPT_TM_CRCB, TWR_RPT_TM_OVER
+};
+
+#define NUM_FAILURES    (sizeof(failures) / sizeof(failures[0]))
+
+static const char *node_name(int node, char *buf)
+{
+    if (node == 0)
+    {
+        return "tag";
+    }
+    sprintf(buf, "%c", node);
+    return buf;
+}
+
+static void on_telemetry(void *ctx, const twr_telemetry_report_t *t)
+{
+    stats_ctx_t *c = (stats_ctx_t *)ctx;
+    node_stats_t *n = &c->nodes[t->node];
+    double s = t->period_ms / 1000.0;
+    char name[2];
+    int i;
+
+    if (n->samples != 0 && t->seq != n->next_seq)
+    {
+        n->missing += (uint16)(t->seq - n->next_seq);
+    }
+    n->next_seq = (uint16)(t->seq + 1);
+    n->samples++;
+    n->seconds += s;
+    for (i = 0; i < TWR_RPT_TM_NUM_COUNTS; i++)
+    {
+        n->events[i] += t->counts[i];
+    }
+
+    if (!c->verbose)
+    {
+        return;
+    }
+    printf("%s %u, %.3f s:", node_name(t->node, name), (unsigned)t->seq, s);
+    for (i = 0; i < TWR_RPT_TM_NUM_COUNTS; i++)
+    {
+        if (t->counts[i] != 0 && s > 0.0)
+        {
+            printf(" %s %.1f/s", event_names[i], t->counts[i] / s);
+        }
+    }
+    printf("\n");
+}
+
+static void on_range(void *ctx, const twr_range_report_t *r)
+{
+    (void)ctx;
+    (void)r;
+}
+
+static void print_node(int node, const node_stats_t *n)
+{
+    const unsigned long *e = n->events;
+    unsigned long failed = 0, detected;
+    char name[2];
+    size_t k;
+    int i;
+
+    printf("%s: %lu samples, %.1f s, %lu samples missing\n", node_name(node, name), n->samples, n->seconds, n->missing);
+    for (i = 0; i < TWR_RPT_TM_NUM_COUNTS; i++)
+    {
+        printf("  %-18s %10lu %10.2f/s\n", event_names[i], e[i], (n->seconds > 0.0) ? e[i] / n->seconds : 0.0);
+    }
+
+    for (k = 0; k < NUM_FAILURES; k++)
+    {
+        failed += e[failures[k]];
+    }
+    printf("  failed receptions %lu", failed);
+    for (k = 0; k < NUM_FAILURES && failed != 0; k++)
+    {
+        printf(", %s %.1f %%", event_names[failures[k]], 100.0 * e[failures[k]] / failed);
+    }
+    detected = e[TWR_RPT_TM_CRCG] + e[TWR_RPT_TM_PHE] + e[TWR_RPT_TM_RSL] + e[TWR_RPT_TM_CRCB];
+    printf("\n  frame error rate %.3f %% of %lu frames detected\n",
+           (detected != 0) ? 100.0 * (detected - e[TWR_RPT_TM_CRCG]) / detected : 0.0, detected);
+}
+
+int main(int argc, char **argv)
+{
+    static stats_ctx_t ctx;
+    twr_report_decoder_t decoder;
+    const char *path = NULL;
+    uint8 buf[512];
+    size_t n;
+    FILE *in;
+    int c, found = 0;
+
+    for (c = 1; c < argc; c++)
+    {
+        if (strcmp(argv[c], "-v") == 0)
+        {
+            ctx.verbose = 1;
+        }
+        else
+        {
+            path = argv[c];
+        }
+    }
+
+    in = (path != NULL) ? fopen(path, "rb") : stdin;
+    if (in == NULL)
+    {
+        perror(path);
+        return 1;
+    }
+
+    memset(&decoder, 0, sizeof(decoder));
+    decoder.telemetry_cb = on_telemetry;
+    decoder.telemetry_ctx = &ctx;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+    {
+        twr_report_decode(&decoder, buf, (uint32)n, on_range, NULL);
+    }
+
+    for (c = 0; c < MAX_NODES; c++)
+    {
+        if (ctx.nodes[c].samples != 0)
+        {
+            print_node(c, &ctx.nodes[c]);
+            found = 1;
+        }
+    }
+    if (!found)
+    {
+        fprintf(stderr, "no telemetry in %lu frames, is the board built with TWR_USE_TELEMETRY?\n",
+                (unsigned long)decoder.frames);
+    }
+    if (in != stdin)
+    {
+        fclose(in);
+    }
+    return 0;
+}
@@ -0,0 +1,239 @@
+/*! ----------------------------------------------------------------------------
+ * @file    timing_check.c
+ * @brief   Check of DWM_platform/twr_timing.c
+ *
+ *          For every preamble length, PRF, data rate and SFD, and frame
+ *          lengths 3 to 127 bytes:
+ *          - configures the DW1000 emulator with dwt_configure() and compares
+ *            the frame durations it uses on air with twr_shr_clk() and
+ *            twr_payload_clk(), which must match to the DTU
+ *          - compares the macros with the functions
+ *          - checks the turn timing of twr_turn_timing() for a range of
+ *            turnarounds and margins: the reply is the shortest that leaves
+ *            the turnaround, the receiver is on margin ahead of the answer
+ *            (or right after the request), stays on margin after its end,
+ *            and the emulator acquires its preamble within the timeout
+ *          Then prints the turn timing of the examples' two profiles, for the
+ *          given turnaround and margin, as the examples derive it.
+ *
+ *          usage: timing_check [turnaround_uus [margin_uus]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "deca_device_api.h"
+#include "dw1000_emu.h"
+#include "host_port.h"
+#include "twr_engine.h"
+#include "twr_timing.h"
+
+static const uint8 plen_codes[] = {
+    DWT_PLEN_64, DWT_PLEN_128, DWT_PLEN_256, DWT_PLEN_512, DWT_PLEN_1024, DWT_PLEN_1536, DWT_PLEN_2048, DWT_PLEN_4096
+};
+
+static const uint8 rates[] = { DWT_BR_110K, DWT_BR_850K, DWT_BR_6M8 };
+
+/* Frame lengths of the exchanges, FCS included */
+#define POLL_LEN    (TWR_POLL_LEN + TWR_PROFILE_LEN)
+#define RESP_LEN    TWR_DS_RESP_LEN
+#define FINAL_LEN   TWR_DS_FINAL_LEN
+
+/* Examples/DS_TWR_Compete settings, as ds_initiator.c and ds_responder.c. Their delays and timeouts are derived with twr_timing.h, see
+ * their NOTE 15. */
+typedef struct
+{
+    const char  *name;
+    dwt_config_t config;
+} example_t;
+
+static const example_t examples[] = {
+    { "long range", { 2, DWT_PRF_64M, DWT_PLEN_1024, DWT_PAC32, 9, 9, 1, DWT_BR_110K, DWT_PHRMODE_STD, (1024 + 1 + 64 - 32) } },
+    { "fast",       { 2, DWT_PRF_64M, DWT_PLEN_128, DWT_PAC8, 9, 9, 0, DWT_BR_6M8, DWT_PHRMODE_STD, (129 + 8 - 8) } },
+};
+
+static int failures;
+
+static void fail(const dwt_config_t *c, const char *what, uint32 got, uint32 want)
+{
+    if (failures++ < 20)
+    {
+        printf("PRF %s, %u symbols, rate %d, SFD %d: %s %lu, expected %lu\n", (c->prf == DWT_PRF_64M) ? "64" : "16",
+               twr_plen_symbols(c->txPreambLength), c->dataRate, c->nsSFD, what, (unsigned long)got, (unsigned long)want);
+    }
+}
+
+/* Durations against the emulator, and the macros against the functions */
+static void check_durations(dw1000_emu_t *emu, const dwt_config_t *c)
+{
+    uint16 plen = twr_plen_symbols(c->txPreambLength);
+    uint64_t shr, payload;
+    uint16 len;
+
+    for (len = 3; len <= 127; len++)
+    {
+        dw1000_emu_frame_durations(emu, len, &shr, &payload);
+        if ((uint64_t)twr_shr_clk(c) * TWR_DTU_PER_CLK != shr)
+        {
+            fail(c, "SHR DTU", twr_shr_clk(c) * TWR_DTU_PER_CLK, (uint32)shr);
+        }
+        if ((uint64_t)twr_payload_clk(c, len) * TWR_DTU_PER_CLK != payload)
+        {
+            fail(c, "payload DTU", twr_payload_clk(c, len) * TWR_DTU_PER_CLK, (uint32)payload);
+        }
+        if (TWR_FRAME_CLK(c->prf, plen, c->dataRate, c->nsSFD, len) != twr_frame_clk(c, len))
+        {
+            fail(c, "TWR_FRAME_CLK", TWR_FRAME_CLK(c->prf, plen, c->dataRate, c->nsSFD, len), twr_frame_clk(c, len));
+        }
+    }
+    if (twr_sfd_timeout(c) != c->sfdTO)
+    {
+        fail(c, "SFD timeout", twr_sfd_timeout(c), c->sfdTO);
+    }
+}
+
+static void check_turn(const dwt_config_t *c, uint16 req_len, uint16 ans_len, uint32 turnaround, uint32 margin)
+{
+    uint16 plen = twr_plen_symbols(c->txPreambLength);
+    uint16 pac_symbols = twr_pac_symbols(c->rxPAC);
+    uint32 shr = twr_shr_clk(c);
+    uint32 pac = pac_symbols * TWR_PRE_SYM_CLK(c->prf);
+    uint32 req_end, preamble, answer_end, rx_on;
+    twr_turn_t t;
+
+    twr_turn_timing(c, req_len, ans_len, turnaround, margin, &t);
+
+    /* Times from the request's RX/TX timestamp, clk */
+    req_end = twr_payload_clk(c, req_len);
+    preamble = t.replyUus * TWR_CLK_PER_UUS - shr;
+    answer_end = preamble + twr_frame_clk(c, ans_len);
+    rx_on = req_end + t.rxAfterTxUus * TWR_CLK_PER_UUS;
+
+    if (preamble < req_end + turnaround * TWR_CLK_PER_UUS || preamble - TWR_CLK_PER_UUS >= req_end + turnaround * TWR_CLK_PER_UUS)
+    {
+        fail(c, "reply", t.replyUus, 0);
+    }
+    if (t.rxAfterTxUus > 0 && rx_on + margin * TWR_CLK_PER_UUS > preamble)
+    {
+        fail(c, "RX after TX", t.rxAfterTxUus, 0);
+    }
+    if (t.rxTimeoutUus < 0xFFFF && rx_on + t.rxTimeoutUus * TWR_CLK_PER_UUS < answer_end + margin * TWR_CLK_PER_UUS)
+    {
+        fail(c, "RX timeout", t.rxTimeoutUus, 0);
+    }
+    /* The emulator acquires one PAC after the later of receiver on and preamble start, see acquisition_time() */
+    if (((preamble > rx_on) ? preamble : rx_on) + pac >= rx_on + t.preambleTimeout * pac)
+    {
+        fail(c, "preamble timeout", t.preambleTimeout, 0);
+    }
+
+    if (TWR_REPLY_UUS(c->prf, plen, c->dataRate, c->nsSFD, req_len, turnaround) != t.replyUus)
+    {
+        fail(c, "TWR_REPLY_UUS", TWR_REPLY_UUS(c->prf, plen, c->dataRate, c->nsSFD, req_len, turnaround), t.replyUus);
+    }
+    if (TWR_RX_AFTER_TX_UUS(c->prf, plen, c->dataRate, c->nsSFD, req_len, t.replyUus, margin) != t.rxAfterTxUus)
+    {
+        fail(c, "TWR_RX_AFTER_TX_UUS", TWR_RX_AFTER_TX_UUS(c->prf, plen, c->dataRate, c->nsSFD, req_len, t.replyUus, margin),
+             t.rxAfterTxUus);
+    }
+    if (t.rxTimeoutUus < 0xFFFF &&
+        TWR_RX_TIMEOUT_UUS(c->prf, plen, c->dataRate, c->nsSFD, req_len, ans_len, t.replyUus, margin) != t.rxTimeoutUus)
+    {
+        fail(c, "TWR_RX_TIMEOUT_UUS", TWR_RX_TIMEOUT_UUS(c->prf, plen, c->dataRate, c->nsSFD, req_len, ans_len, t.replyUus, margin),
+             t.rxTimeoutUus);
+    }
+    if (TWR_PREAMBLE_TIMEOUT_PACS(c->prf, plen, c->dataRate, c->nsSFD, pac_symbols, req_len, t.replyUus, margin) != t.preambleTimeout)
+    {
+        fail(c, "TWR_PREAMBLE_TIMEOUT_PACS",
+             TWR_PREAMBLE_TIMEOUT_PACS(c->prf, plen, c->dataRate, c->nsSFD, pac_symbols, req_len, t.replyUus, margin),
+             t.preambleTimeout);
+    }
+}
+
+static void print_example(const example_t *x, uint32 turnaround, uint32 margin)
+{
+    twr_turn_t poll, resp;
+
+    twr_turn_timing(&x->config, POLL_LEN, RESP_LEN, turnaround, margin, &poll);
+    twr_turn_timing(&x->config, RESP_LEN, FINAL_LEN, turnaround, margin, &resp);
+
+    printf("%s: frames %lu / %lu / %lu us (poll / response / final)\n", x->name,
+           (unsigned long)TWR_CLK_TO_NS(twr_frame_clk(&x->config, POLL_LEN)) / 1000,
+           (unsigned long)TWR_CLK_TO_NS(twr_frame_clk(&x->config, RESP_LEN)) / 1000,
+           (unsigned long)TWR_CLK_TO_NS(twr_frame_clk(&x->config, FINAL_LEN)) / 1000);
+    printf("                 poll -> response  response -> final\n");
+    printf("  reply UUS        %5lu             %5lu\n", (unsigned long)poll.replyUus, (unsigned long)resp.replyUus);
+    printf("  RX after TX      %5lu             %5lu\n", (unsigned long)poll.rxAfterTxUus, (unsigned long)resp.rxAfterTxUus);
+    printf("  RX timeout       %5lu             %5lu\n", (unsigned long)poll.rxTimeoutUus, (unsigned long)resp.rxTimeoutUus);
+    printf("  preamble PACs    %5lu\n", (unsigned long)poll.preambleTimeout);
+}
+
+int main(int argc, char **argv)
+{
+    uint32 turnaround = (argc > 1) ? (uint32)atoi(argv[1]) : 300;
+    uint32 margin = (argc > 2) ? (uint32)atoi(argv[2]) : 20;
+    dw1000_emu_t *emu;
+    dwt_config_t c = { 2, DWT_PRF_64M, DWT_PLEN_128, DWT_PAC8, 9, 9, 0, DWT_BR_6M8, DWT_PHRMODE_STD, 0 };
+    size_t p, r;
+    int prf, sfd, configs = 0;
+    uint32 ta, m;
+
+    if (argc > 3 || (argc > 1 && atoi(argv[1]) < 0) || (argc > 2 && atoi(argv[2]) < 0))
+    {
+        fprintf(stderr, "usage: timing_check [turnaround_uus [margin_uus]]\n");
+        return 1;
+    }
+
+    emu = dw1000_emu_create();
+    host_port_attach(emu);
+    if (dwt_initialise(DWT_LOADUCODE) == DWT_ERROR)
+    {
+        fprintf(stderr, "dwt_initialise() failed\n");
+        return 1;
+    }
+
+    for (prf = DWT_PRF_16M; prf <= DWT_PRF_64M; prf++)
+    {
+        for (p = 0; p < sizeof(plen_codes); p++)
+        {
+            for (r = 0; r < sizeof(rates); r++)
+            {
+                for (sfd = 0; sfd <= 1; sfd++)
+                {
+                    c.prf = (uint8)prf;
+                    c.txCode = c.rxCode = (prf == DWT_PRF_64M) ? 9 : 3;
+                    c.txPreambLength = plen_codes[p];
+                    c.rxPAC = (twr_plen_symbols(plen_codes[p]) <= 128) ? DWT_PAC8 :
+                              (twr_plen_symbols(plen_codes[p]) <= 512) ? DWT_PAC16 :
+                              (twr_plen_symbols(plen_codes[p]) <= 1024) ? DWT_PAC32 : DWT_PAC64;
+                    c.dataRate = rates[r];
+                    c.nsSFD = (uint8)sfd;
+                    c.sfdTO = (uint16)(twr_plen_symbols(plen_codes[p]) + 1 + TWR_SFD_SYMBOLS(c.dataRate, c.nsSFD) -
+                                       twr_pac_symbols(c.rxPAC));
+                    dwt_configure(&c);
+                    check_durations(emu, &c);
+
+                    for (ta = 0; ta <= 3000; ta += 150)
+                    {
+                        for (m = 0; m <= 200; m += 25)
+                        {
+                            check_turn(&c, POLL_LEN, RESP_LEN, ta, m);
+                            check_turn(&c, RESP_LEN, 127, ta, m);
+                        }
+                    }
+                    configs++;
+                }
+            }
+        }
+    }
+    printf("%d configurations: %s\n\n", configs, failures ? "FAILED" : "durations match the emulator, turns consistent");
+
+    printf("turnaround %lu UUS, margin %lu UUS\n", (unsigned long)turnaround,
+           (unsigned long)margin);
+    print_example(&examples[0], turnaround, margin);
+    print_example(&examples[1], turnaround, margin);
+
+    host_port_attach(NULL);
+    dw1000_emu_destroy(emu);
+    return failures != 0;
+}
@@ -0,0 +1,382 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_math_bench.c
+ * @brief   Check and timing of DWM_platform/twr_math.c
+ *
+ *          Feeds random DS and SS exchanges, realistic ones (ranges up to
+ *          300 m, reply times up to 50 ms, 40 ppm clock offsets), long ones
+ *          (reply times up to 2 s, as the 40 bit timestamps of twr_ts.h
+ *          allow) and edge cases (any 40 bit time, saturation), to:
+ *          - the integer functions of twr_math.c
+ *          - a 128 bit integer reference of the same formulas, which the
+ *            integer results must match exactly
+ *          - the double (DS) and float (SS) code the ranging engine used
+ *            before, for comparison: double rounds the DS products to 53 bits
+ *            and float the SS response time to 24 bits
+ *          - for the long exchanges, the same integer functions given the
+ *            intervals of 32 bit timestamps, as the 4 byte frame fields did
+ *          then times the integer and floating point versions in CPU cycles
+ *          (x86 TSC) or nanoseconds. See Host/README.md for the build.
+ *
+ *          usage: twr_math_bench [samples]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "deca_device_api.h"
+#include "twr_math.h"
+
+#define SPEED_OF_LIGHT      299702547
+
+/* 1 m of flight, DTU */
+#define DTU_PER_METRE       213.14
+
+typedef __int128 i128;
+
+typedef struct
+{
+    uint64_t Ra, Rb, Da, Db;
+} ds_sample_t;
+
+typedef struct
+{
+    int64_t rtd_init, rtd_resp;
+    int32 ci;
+    const dwt_config_t *config;
+} ss_sample_t;
+
+static dwt_config_t configs[] = {
+    { 1, DWT_PRF_64M, DWT_PLEN_128,  DWT_PAC8,  9, 9, 0, DWT_BR_6M8, DWT_PHRMODE_STD, (129 + 8 - 8) },
+    { 2, DWT_PRF_64M, DWT_PLEN_1024, DWT_PAC32, 9, 9, 1, DWT_BR_110K, DWT_PHRMODE_STD, (1025 + 64 - 32) },
+    { 3, DWT_PRF_64M, DWT_PLEN_128,  DWT_PAC8,  9, 9, 0, DWT_BR_6M8, DWT_PHRMODE_STD, (129 + 8 - 8) },
+    { 4, DWT_PRF_64M, DWT_PLEN_128,  DWT_PAC8, 17, 17, 0, DWT_BR_850K, DWT_PHRMODE_STD, (129 + 8 - 8) },
+    { 5, DWT_PRF_64M, DWT_PLEN_128,  DWT_PAC8,  9, 9, 0, DWT_BR_6M8, DWT_PHRMODE_STD, (129 + 8 - 8) },
+    { 7, DWT_PRF_64M, DWT_PLEN_1024, DWT_PAC32, 17, 17, 1, DWT_BR_110K, DWT_PHRMODE_STD, (1025 + 64 - 32) },
+};
+
+static uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_rand(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+/* Uniform in [lo, hi] */
+static double uniform(double lo, double hi)
+{
+    return lo + (hi - lo) * (double)(next_rand() >> 11) / (double)(1ULL << 53);
+}
+
+/* --- Reference: same formulas on 128 bit integers ------------------------------------------------------------------ */
+
+static int32 ref_round(i128 n, i128 d)
+{
+    i128 a = (n < 0) ? -n : n;
+    i128 q = (a * SPEED_OF_LIGHT + d / 2) / d;
+
+    if (q > INT32_MAX)
+    {
+        q = INT32_MAX;
+    }
+    return (int32)((n < 0) ? -q : q);
+}
+
+static int64_t ref_ds_tof(const ds_sample_t *s)
+{
+    i128 den = (i128)s->Ra + s->Rb + s->Da + s->Db;
+
+    if (s->Ra > TWR_DS_MAX_INTERVAL || s->Rb > TWR_DS_MAX_INTERVAL || s->Da > TWR_DS_MAX_INTERVAL ||
+        s->Db > TWR_DS_MAX_INTERVAL)
+    {
+        return 0;
+    }
+    return (den == 0) ? 0 : (int64_t)(((i128)s->Ra * s->Rb - (i128)s->Da * s->Db) / den);
+}
+
+static int32 ref_distance(int64_t tof, uint32 unit)
+{
+    return ref_round(tof, (i128)975 * 65536 * unit);
+}
+
+static int32 ref_ss_distance(const ss_sample_t *s, uint32 unit)
+{
+    int shift = (s->config->dataRate == DWT_BR_110K) ? 31 : 28;
+    int a = (s->config->chan == 2 || s->config->chan == 4) ? 1 : 2;
+    int b = (s->config->chan == 1) ? 7 : (s->config->chan == 2 || s->config->chan == 4) ? 4 : (s->config->chan == 3) ? 9 : 13;
+    i128 diff = (i128)s->rtd_init - s->rtd_resp;
+    i128 resp = s->rtd_resp;
+    i128 ci = s->ci;
+
+    diff = (diff > TWR_SS_MAX_RTD_DIFF) ? TWR_SS_MAX_RTD_DIFF : (diff < -TWR_SS_MAX_RTD_DIFF) ? -TWR_SS_MAX_RTD_DIFF : diff;
+    resp = (resp > TWR_SS_MAX_RTD) ? TWR_SS_MAX_RTD : (resp < -TWR_SS_MAX_RTD) ? -TWR_SS_MAX_RTD : resp;
+    ci = (ci > (1 << 20) - 1) ? (1 << 20) - 1 : (ci < -(1 << 20) + 1) ? -(1 << 20) + 1 : ci;
+    return ref_round(diff * b * ((i128)1 << shift) - resp * ci * a,
+                     (i128)b * 975 * unit * ((i128)1 << (shift + 17)));
+}
+
+/* --- Previous engine code ------------------------------------------------------------------------------------------ */
+
+static int64_t legacy_ds_tof(const ds_sample_t *s)
+{
+    double Ra = (double)s->Ra, Rb = (double)s->Rb, Da = (double)s->Da, Db = (double)s->Db;
+
+    return (int64_t)((Ra * Rb - Da * Db) / (Ra + Rb + Da + Db));
+}
+
+static double legacy_ds_distance(const ds_sample_t *s)
+{
+    return legacy_ds_tof(s) * DWT_TIME_UNITS * SPEED_OF_LIGHT;
+}
+
+static double legacy_ss_distance(const ss_sample_t *s)
+{
+    const dwt_config_t *config = s->config;
+    float clockOffsetRatio;
+    double hz_to_ppm;
+
+    hz_to_ppm = (config->chan == 1) ? HERTZ_TO_PPM_MULTIPLIER_CHAN_1 :
+                (config->chan == 2 || config->chan == 4) ? HERTZ_TO_PPM_MULTIPLIER_CHAN_2 :
+                (config->chan == 3) ? HERTZ_TO_PPM_MULTIPLIER_CHAN_3 : HERTZ_TO_PPM_MULTIPLIER_CHAN_5;
+    clockOffsetRatio = s->ci *
+                       (((config->dataRate == DWT_BR_110K) ? FREQ_OFFSET_MULTIPLIER_110KB : FREQ_OFFSET_MULTIPLIER) * hz_to_ppm / 1.0e6);
+    return ((s->rtd_init - s->rtd_resp * (1 - clockOffsetRatio)) / 2.0) * DWT_TIME_UNITS * SPEED_OF_LIGHT;
+}
+
+/* --- Samples ------------------------------------------------------------------------------------------------------- */
+
+#define SAMPLE_REAL     0
+#define SAMPLE_LONG     1   // reply times over the 67 ms of 32 bit timestamps
+#define SAMPLE_EDGE     2
+
+/* Any 32 or 40 bit time, or 0 */
+static uint64_t edge_time(void)
+{
+    uint64_t r = next_rand();
+
+    return (r & 3) == 0 ? 0 : (r & 4) ? (uint32)(r >> 32) : (r >> 24) & TWR_DS_MAX_INTERVAL;
+}
+
+static void make_ds(ds_sample_t *s, int kind)
+{
+    double tof, ppm_a, ppm_b, Db, Da;
+    double max_reply = (kind == SAMPLE_LONG) ? 2.0 : 50e-3;
+
+    if (kind == SAMPLE_EDGE)
+    {
+        /* Any 32 or 40 bit times, including zeros and products above 2^64 */
+        s->Ra = edge_time();
+        s->Rb = edge_time();
+        s->Da = edge_time();
+        s->Db = edge_time();
+        return;
+    }
+
+    /* An exchange between an initiator and a responder 0 to 300 m apart, clocks up to 20 ppm off */
+    tof = uniform(0.0, 300.0) * DTU_PER_METRE;
+    ppm_a = uniform(-20e-6, 20e-6);
+    ppm_b = uniform(-20e-6, 20e-6);
+    Db = uniform(0.2e-3, max_reply) / DWT_TIME_UNITS;
+    Da = uniform(0.2e-3, max_reply) / DWT_TIME_UNITS;
+    s->Db = (uint64_t)(Db * (1 + ppm_b));
+    s->Ra = (uint64_t)((2 * tof + Db) * (1 + ppm_a));
+    s->Da = (uint64_t)(Da * (1 + ppm_a));
+    s->Rb = (uint64_t)((2 * tof + Da) * (1 + ppm_b));
+}
+
+static void make_ss(ss_sample_t *s, int kind)
+{
+    double tof, ppm, rtd_resp;
+
+    s->config = &configs[next_rand() % (sizeof(configs) / sizeof(configs[0]))];
+    if (kind == SAMPLE_EDGE)
+    {
+        /* Any 42 bit signed times and carrier integrator values, up to saturation */
+        s->rtd_init = (int64_t)(next_rand() & 0x3FFFFFFFFFFULL) - 0x20000000000LL;
+        s->rtd_resp = (int64_t)(next_rand() & 0x3FFFFFFFFFFULL) - 0x20000000000LL;
+        s->ci = (int32)((int64_t)(next_rand() & 0x3FFFFF) - 0x200000);
+        return;
+    }
+
+    /* Responder 0 to 300 m away, reply time up to 5 ms (2 s for a long one), clock up to 40 ppm off, carrier integrator
+     * to match */
+    tof = uniform(0.0, 300.0) * DTU_PER_METRE;
+    ppm = uniform(-40e-6, 40e-6);
+    rtd_resp = uniform(0.2e-3, (kind == SAMPLE_LONG) ? 2.0 : 5e-3) / DWT_TIME_UNITS;
+    s->rtd_resp = (int64_t)rtd_resp;
+    s->rtd_init = (int64_t)(2 * tof + rtd_resp * (1 + ppm));
+    s->ci = (int32)(ppm / (FREQ_OFFSET_MULTIPLIER * HERTZ_TO_PPM_MULTIPLIER_CHAN_5 / 1.0e6) *
+                    ((s->config->dataRate == DWT_BR_110K) ? 8 : 1));
+}
+
+/* --- Timing -------------------------------------------------------------------------------------------------------- */
+
+static uint64_t ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static volatile int64_t sink;
+
+int main(int argc, char **argv)
+{
+    int samples = (argc > 1) ? atoi(argv[1]) : 1000000;
+    ds_sample_t *ds;
+    ss_sample_t *ss;
+    unsigned long ds_errors = 0, ss_errors = 0, ds_tof_diff = 0, ds_mm_diff = 0;
+    double ss_err, ss_max_err = 0.0, ss_sum_err = 0.0;
+    unsigned long ss_real = 0;
+    unsigned long n_long = 0, ds_long_32 = 0, ss_long_32 = 0;
+    uint64_t t0, t_fixed_ds, t_double_ds, t_fixed_ss, t_float_ss;
+    int64_t tof, acc;
+    int32 mm;
+    int i, kind;
+
+    if (samples <= 0)
+    {
+        fprintf(stderr, "usage: twr_math_bench [samples]\n");
+        return 1;
+    }
+    ds = malloc(samples * sizeof(*ds));
+    ss = malloc(samples * sizeof(*ss));
+    if (ds == NULL || ss == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    /* One sample in 8 is an edge case, one in 8 a long exchange */
+    for (i = 0; i < samples; i++)
+    {
+        kind = ((i & 7) == 7) ? SAMPLE_EDGE : ((i & 7) == 6) ? SAMPLE_LONG : SAMPLE_REAL;
+        make_ds(&ds[i], kind);
+        make_ss(&ss[i], kind);
+    }
+
+    for (i = 0; i < samples; i++)
+    {
+        tof = twr_ds_tof_dtu(ds[i].Ra, ds[i].Rb, ds[i].Da, ds[i].Db);
+        if (tof != ref_ds_tof(&ds[i]) ||
+            twr_dtu_to_distance(tof, TWR_UNIT_MM) != ref_distance(tof, TWR_UNIT_MM) ||
+            twr_dtu_to_distance(tof, TWR_UNIT_CM) != ref_distance(tof, TWR_UNIT_CM))
+        {
+            if (ds_errors++ < 10)
+            {
+                printf("DS mismatch: Ra %llu Rb %llu Da %llu Db %llu: tof %lld, reference %lld\n",
+                       (unsigned long long)ds[i].Ra, (unsigned long long)ds[i].Rb, (unsigned long long)ds[i].Da,
+                       (unsigned long long)ds[i].Db, (long long)tof, (long long)ref_ds_tof(&ds[i]));
+            }
+        }
+        if (tof != legacy_ds_tof(&ds[i]))
+        {
+            ds_tof_diff++;
+        }
+        else if (fabs(legacy_ds_distance(&ds[i])) < 2e6 &&
+                 twr_dtu_to_distance(tof, TWR_UNIT_MM) != (int32)llround(legacy_ds_distance(&ds[i]) * 1000))
+        {
+            ds_mm_diff++;
+        }
+
+        if (twr_ss_distance(ss[i].rtd_init, ss[i].rtd_resp, ss[i].ci, ss[i].config, TWR_UNIT_MM) != ref_ss_distance(&ss[i], TWR_UNIT_MM) ||
+            twr_ss_distance(ss[i].rtd_init, ss[i].rtd_resp, ss[i].ci, ss[i].config, TWR_UNIT_CM) != ref_ss_distance(&ss[i], TWR_UNIT_CM))
+        {
+            if (ss_errors++ < 10)
+            {
+                printf("SS mismatch: rtd_init %lld rtd_resp %lld ci %ld chan %d: %ld mm, reference %ld mm\n",
+                       (long long)ss[i].rtd_init, (long long)ss[i].rtd_resp, (long)ss[i].ci, ss[i].config->chan,
+                       (long)twr_ss_distance(ss[i].rtd_init, ss[i].rtd_resp, ss[i].ci, ss[i].config, TWR_UNIT_MM),
+                       (long)ref_ss_distance(&ss[i], TWR_UNIT_MM));
+            }
+        }
+        if ((i & 7) == 6)
+        {
+            /* The intervals of 32 bit timestamps, wrapped */
+            n_long++;
+            mm = twr_dtu_to_distance(twr_ds_tof_dtu((uint32)ds[i].Ra, (uint32)ds[i].Rb, (uint32)ds[i].Da, (uint32)ds[i].Db),
+                                     TWR_UNIT_MM);
+            ds_long_32 += (labs((long)mm - twr_dtu_to_distance(tof, TWR_UNIT_MM)) > 100);
+            mm = twr_ss_distance((int32)ss[i].rtd_init, (int32)ss[i].rtd_resp, ss[i].ci, ss[i].config, TWR_UNIT_MM);
+            ss_long_32 += (labs((long)mm - twr_ss_distance(ss[i].rtd_init, ss[i].rtd_resp, ss[i].ci, ss[i].config,
+                                                            TWR_UNIT_MM)) > 100);
+        }
+        if ((i & 7) < 6)
+        {
+            ss_err = fabs(legacy_ss_distance(&ss[i]) * 1000 - ref_ss_distance(&ss[i], TWR_UNIT_MM));
+            ss_max_err = (ss_err > ss_max_err) ? ss_err : ss_max_err;
+            ss_sum_err += ss_err;
+            ss_real++;
+        }
+    }
+
+    printf("DS: %d samples, %lu differ from the 128 bit reference\n", samples, ds_errors);
+    printf("    double version: %lu ToF differ (products rounded to 53 bits), %lu mm distances differ\n", ds_tof_diff, ds_mm_diff);
+    printf("SS: %d samples, %lu differ from the 128 bit reference\n", samples, ss_errors);
+    printf("    float version: mean error %.2f mm, max %.2f mm over %lu realistic exchanges\n",
+           ss_sum_err / ss_real, ss_max_err, ss_real);
+    printf("long exchanges: %lu, with 32 bit timestamps %lu DS and %lu SS distances off by more than 10 cm\n",
+           n_long, ds_long_32, ss_long_32);
+
+    /* Timing, tof and distance of each sample */
+    acc = 0;
+    t0 = ticks();
+    for (i = 0; i < samples; i++)
+    {
+        acc += twr_dtu_to_distance(twr_ds_tof_dtu(ds[i].Ra, ds[i].Rb, ds[i].Da, ds[i].Db), TWR_UNIT_MM);
+    }
+    t_fixed_ds = ticks() - t0;
+    sink = acc;
+
+    acc = 0;
+    t0 = ticks();
+    for (i = 0; i < samples; i++)
+    {
+        acc += (int64_t)(legacy_ds_distance(&ds[i]) * 1000);
+    }
+    t_double_ds = ticks() - t0;
+    sink = acc;
+
+    acc = 0;
+    t0 = ticks();
+    for (i = 0; i < samples; i++)
+    {
+        acc += twr_ss_distance(ss[i].rtd_init, ss[i].rtd_resp, ss[i].ci, ss[i].config, TWR_UNIT_MM);
+    }
+    t_fixed_ss = ticks() - t0;
+    sink = acc;
+
+    acc = 0;
+    t0 = ticks();
+    for (i = 0; i < samples; i++)
+    {
+        acc += (int64_t)(legacy_ss_distance(&ss[i]) * 1000);
+    }
+    t_float_ss = ticks() - t0;
+    sink = acc;
+
+#if defined(__x86_64__) || defined(__i386__)
+    printf("per exchange (TSC cycles): ");
+#else
+    printf("per exchange (ns): ");
+#endif
+    printf("DS integer %.1f, double %.1f   SS integer %.1f, float %.1f\n",
+           (double)t_fixed_ds / samples, (double)t_double_ds / samples,
+           (double)t_fixed_ss / samples, (double)t_float_ss / samples);
+
+    free(ds);
+    free(ss);
+    return (ds_errors || ss_errors) ? 1 : 0;
+}
@@ -0,0 +1,269 @@
+/*! ----------------------------------------------------------------------------
+ * @file    twr_sim.c
+ * @brief   Simulated TWR deployment: one tag and anchors A, B and C
+ *
+ *          Runs Examples/DS_TWR_Compete unmodified on the air channel simulator
+ *          and prints the exchange success rate, latency and distance error.
+ *          The delays and timeouts to tune (POLL_RX_TO_RESP_TX_DLY_UUS,
+ *          RESP_RX_TIMEOUT_UUS, PRE_TIMEOUT, ...) are the #defines of the
+ *          example sources, see Host/README.md for the build.
+ *          Built with TWR_SIM_SS, it runs Examples/SS_TWR_Complete instead:
+ *          the tag computes the distances and there is no broadcast round.
+ *
+ *          usage: twr_sim [seconds] [-v] [-b] [-l loss_probability] [-u usb_ms] [-w metres] [-o prefix]
+ *          -b ranges the three anchors with one broadcast poll per round.
+ *          -u sets the time the PC takes for each USB transfer of reports.
+ *          -w walks the tag away along x, up to the given distance half way
+ *          through the run, and back: built with -DTWR_USE_PROFILES=1 the
+ *          tag and anchors move between the fast and the long range radio
+ *          profiles on the way, see twr_profile.h.
+ *          -o writes the report stream of each node to <prefix><name>.bin,
+ *          as read from its USB port, for Host/report_decode.c and the like.
+ *          Built with TWR_TRACE, it also prints the phase timings of each
+ *          node, see twr_trace.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deca_device_api.h"
+#include "main.h"
+#include "twr_trace.h"
+#include "uwb_sim.h"
+
+/* Pause of the tag between anchor rounds. On the board main.c waits between anchors. The relay frame an anchor sends
+ * to A after the final message needs this time on air, so that the next poll does not collide with it. */
+#define ROUND_GAP_MS    5
+
+/* After a broadcast round the anchors relay in their slots, the last one ends around 14 ms after the final message: the
+ * first slot delay plus two slots of SLOT_UUS (Examples/DS_TWR_Compete/ds_initiator.c) and a frame */
+#ifndef BCAST_ROUND_GAP_MS
+#define BCAST_ROUND_GAP_MS  15
+#endif
+
+#ifdef TWR_SIM_SS
+/* Examples/SS_TWR_Complete */
+void ss_init_main(int x);
+int ss_resp_main_A(void);
+int ss_resp_main_B(void);
+int ss_resp_main_C(void);
+
+static void ss_resp_a(void) { ss_resp_main_A(); }
+static void ss_resp_b(void) { ss_resp_main_B(); }
+static void ss_resp_c(void) { ss_resp_main_C(); }
+
+#define TAG_RANGE(x)    ss_init_main(x)
+#define ANCHOR_A        ss_resp_a
+#define ANCHOR_B        ss_resp_b
+#define ANCHOR_C        ss_resp_c
+#else
+/* Examples/DS_TWR_Compete */
+void ds_twr_init(int x);
+void ds_twr_init_all(void);
+void twr_resp_9m_1(void);
+void ds_twr_resp_b(void);
+void ds_twr_resp_c(void);
+
+#define TAG_RANGE(x)    ds_twr_init(x)
+#define ANCHOR_A        twr_resp_9m_1
+#define ANCHOR_B        ds_twr_resp_b
+#define ANCHOR_C        ds_twr_resp_c
+#endif
+
+/* Tag walk of -w */
+static uwb_sim_t *walk_sim;
+static double walk_m;
+static double walk_s;
+
+/* Tag position at the current simulation time: x from 1 m to walk_m and back over the run */
+static void walk(void)
+{
+    double f;
+
+    if (walk_m <= 0.0)
+    {
+        return;
+    }
+    f = 2.0 * uwb_sim_time(walk_sim) / walk_s;
+    f = (f > 1.0) ? 2.0 - f : f;
+    uwb_sim_move_node(walk_sim, 0, 1.0 + (walk_m - 1.0) * f, 1.5, 1.0);
+}
+
+static void tag_main(void *arg)
+{
+    int x;
+
+    for (;;)
+    {
+        walk();
+#ifdef TWR_SIM_SS
+        (void)arg;
+#else
+        if (arg != NULL)
+        {
+            ds_twr_init_all();
+            HAL_Delay(BCAST_ROUND_GAP_MS);
+            continue;
+        }
+#endif
+        for (x = 0; x < 3; x++)
+        {
+            TAG_RANGE(x);
+            HAL_Delay(ROUND_GAP_MS);
+        }
+    }
+}
+
+static void anchor_main(void *arg)
+{
+    ((void (*)(void))arg)();
+}
+
+static void print_line(void *ctx, int node, double t, const char *line, uint16 len)
+{
+    (void)ctx;
+    printf("%10.6f  node %d  %.*s", t, node, (int)len, line);
+}
+
+static void write_stream(void *ctx, int node, const uint8 *buf, uint16 len)
+{
+    FILE **streams = (FILE **)ctx;
+
+    fwrite(buf, 1, len, streams[node]);
+}
+
+#ifdef TWR_TRACE
+/* Phase timings of each node, since its last trace frames */
+static void print_trace(const uwb_sim_node_cfg_t *nodes, size_t n)
+{
+    static const char *const names[TWR_TRACE_NUM_PHASES] = TWR_TRACE_PHASE_NAMES;
+    twr_trace_report_t t;
+    double us_per_cycle;
+    size_t i;
+    uint8 p;
+
+    for (i = 0; i < n; i++)
+    {
+        twr_trace_select((unsigned int)i);
+        printf("trace %-4s  count   mean us    max us  device us  spi xfers  spi bytes   polls\n", nodes[i].name);
+        for (p = 0; p < TWR_TRACE_NUM_PHASES; p++)
+        {
+            twr_trace_get(p, &t);
+            if (t.count == 0)
+            {
+                continue;
+            }
+            us_per_cycle = 1e6 / t.cpu_hz;
+            printf("  %-9s %7lu %9.1f %9.1f %10.1f %10.2f %10.1f %7.2f\n", names[p], (unsigned long)t.count,
+                   t.cycles_mean * us_per_cycle, t.cycles_max * us_per_cycle, t.device_mean * 256.0 * DWT_TIME_UNITS * 1e6,
+                   (double)t.spi_xfers / t.count, (double)t.spi_bytes / t.count, (double)t.polls / t.count);
+        }
+    }
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    static uwb_sim_node_cfg_t nodes[] =
+    {
+        /* name   label init  x     y     z     ppm    clock0            antd   start  entry */
+        { "tag",  0,    1,    1.0,  1.5,  1.0,  +4.0,  0x0000000000ULL,  16505, 0.010, tag_main,    NULL },
+        { "A",    'A',  0,    0.0,  0.0,  2.5,  -2.5,  0xFF00000000ULL,  16505, 0.0,   anchor_main, (void *)ANCHOR_A },
+        { "B",    'B',  0,    5.0,  0.0,  2.5,  +9.0,  0x1234567890ULL,  16505, 0.0,   anchor_main, (void *)ANCHOR_B },
+        { "C",    'C',  0,    0.0,  4.0,  2.5,  -7.5,  0x8000000000ULL,  16505, 0.0,   anchor_main, (void *)ANCHOR_C },
+    };
+    dw1000_emu_stats_t tag_stats;
+    uwb_sim_channel_t channel;
+    uwb_sim_t *sim;
+    double seconds = 60.0;
+    double usb_ms = 1.0;
+    const char *prefix = NULL;
+    FILE *streams[sizeof(nodes) / sizeof(nodes[0])] = {NULL};
+    char path[256];
+    int verbose = 0;
+    size_t i;
+    int c;
+
+    uwb_sim_channel_defaults(&channel);
+    for (c = 1; c < argc; c++)
+    {
+        if (strcmp(argv[c], "-v") == 0)
+        {
+            verbose = 1;
+        }
+        else if (strcmp(argv[c], "-b") == 0)
+        {
+#ifdef TWR_SIM_SS
+            fprintf(stderr, "-b: no broadcast round in SS TWR\n");
+            return 1;
+#else
+            nodes[0].arg = (void *)"broadcast";
+#endif
+        }
+        else if (strcmp(argv[c], "-l") == 0 && c + 1 < argc)
+        {
+            channel.loss_probability = atof(argv[++c]);
+        }
+        else if (strcmp(argv[c], "-u") == 0 && c + 1 < argc)
+        {
+            usb_ms = atof(argv[++c]);
+        }
+        else if (strcmp(argv[c], "-w") == 0 && c + 1 < argc)
+        {
+            walk_m = atof(argv[++c]);
+        }
+        else if (strcmp(argv[c], "-o") == 0 && c + 1 < argc)
+        {
+            prefix = argv[++c];
+        }
+        else
+        {
+            seconds = atof(argv[c]);
+        }
+    }
+
+    sim = uwb_sim_create(&channel);
+    walk_sim = sim;
+    walk_s = seconds;
+    uwb_sim_set_usb_transfer(sim, usb_ms * 1e-3);
+    for (i = 0; i < sizeof(nodes) / sizeof(nodes[0]); i++)
+    {
+        uwb_sim_add_node(sim, &nodes[i]);
+    }
+    if (verbose)
+    {
+        uwb_sim_set_line_cb(sim, print_line, NULL);
+    }
+    if (prefix != NULL)
+    {
+        for (i = 0; i < sizeof(nodes) / sizeof(nodes[0]); i++)
+        {
+            snprintf(path, sizeof(path), "%s%s.bin", prefix, nodes[i].name);
+            streams[i] = fopen(path, "wb");
+            if (streams[i] == NULL)
+            {
+                perror(path);
+                return 1;
+            }
+        }
+        uwb_sim_set_stream_cb(sim, write_stream, streams);
+    }
+
+    uwb_sim_run(sim, seconds);
+    uwb_sim_print_report(sim, stdout);
+    dw1000_emu_get_stats(uwb_sim_node_emu(sim, 0), &tag_stats);
+    printf("tag: %lu SPI transactions, skipped busy wait reads not included\n", (unsigned long)tag_stats.spi_transactions);
+#ifdef TWR_TRACE
+    print_trace(nodes, sizeof(nodes) / sizeof(nodes[0]));
+#endif
+    uwb_sim_destroy(sim);
+    for (i = 0; i < sizeof(nodes) / sizeof(nodes[0]); i++)
+    {
+        if (streams[i] != NULL)
+        {
+            fclose(streams[i]);
+        }
+    }
+    return 0;
+}
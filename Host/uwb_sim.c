@@ -0,0 +1,827 @@
+/*! ----------------------------------------------------------------------------
+ * @file    uwb_sim.c
+ * @brief   Discrete event simulation of several DW1000 nodes sharing the air
+ *
+ *          See uwb_sim.h. Times handled here are either device times (uint64_t,
+ *          DTU of one node's clock) or simulation times (double, DTU of an ideal
+ *          clock); node_local()/node_global() convert between the two.
+ */
+
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+
+#include "deca_types.h"
+#include "deca_device_api.h"
+#include "dw1000_emu.h"
+#include "host_port.h"
+#include "twr_report.h"
+#include "twr_trace.h"
+#include "uwb_sim.h"
+
+#include "usbd_cdc_if.h"
+
+#define SPEED_OF_LIGHT      (299702547.0)
+#define POLL_FUNC_CODE      (0x21)  // DS TWR
+#define SS_POLL_FUNC_CODE   (0xE0)  // SS TWR
+#define BCAST_POLL_FUNC_CODE (0x22) // broadcast DS TWR
+#define FUNC_CODE_IDX       (9)
+#define SEQ_NUM_IDX         (2)
+#define POLL_HISTORY        (256)   // polls a range report can still complete
+#define LINE_MAX_LEN        (128)
+#define USB_TRANSFER_S      (1e-3)  // default time of a CDC transfer, the next full speed frame
+
+typedef struct
+{
+    uwb_sim_t          *sim;
+    uwb_sim_node_cfg_t  cfg;
+    dw1000_emu_t       *emu;
+    double              rate;           // 1 + ppm
+    ucontext_t          ctx;
+    void               *stack;
+    uint8               started;
+    uint8               done;
+    uint64_t            target;         // device time the node waits for
+    uint64_t            poll_period;    // non-zero while skipping a busy wait
+    uint8               idle;           // in port_wait_for_irq(), runs again when its IRQ line rises
+    double              usb_free;       // simulation time the USB takes the next CDC transfer
+    twr_report_decoder_t reports;       // binary range reports sent by the node
+    uint32              event_samples;  // telemetry frames received, see twr_telemetry.h
+    uint32              event_ms;       // time they cover
+    uint32              events[TWR_RPT_TM_NUM_COUNTS];
+    uint32              frame_poll[256];    // by sequence number: poll of the exchange the frame was last sent in
+} node_t;
+
+typedef struct
+{
+    double              start;          // simulation time
+    int                 poller;
+    uint8               open;           // no range report of the exchange yet
+} poll_t;
+
+struct uwb_sim
+{
+    uwb_sim_channel_t   channel;
+    node_t              nodes[UWB_SIM_MAX_NODES];
+    int                 n_nodes;
+    node_t             *current;
+    ucontext_t          main_ctx;
+    double              now;            // simulation time, DTU
+    double              end;            // end of the current uwb_sim_run(), DTU
+    uint64_t            rng;
+
+    uwb_sim_line_cb_t   line_cb;
+    void               *line_ctx;
+    uwb_sim_stream_cb_t stream_cb;
+    void               *stream_ctx;
+    double              usb_transfer;   // DTU
+
+    /* exchange accounting, poll n (from 1) is polls[n % POLL_HISTORY] */
+    poll_t              polls[POLL_HISTORY];
+    int                 last_poller;    // < 0 if no poll yet
+    double              latency_sum;
+    double              error_sum;
+    double              error_sq_sum;
+    uwb_sim_report_t    report;
+};
+
+static uwb_sim_t *active_sim = NULL;    // the coroutine entry and the port hooks have no context argument
+
+/****************************************************************************************************************************************************
+ *
+ * Clocks and random numbers
+ *
+ ****************************************************************************************************************************************************/
+
+static double node_global(const node_t *n, uint64_t local)
+{
+    return ((double)local - (double)n->cfg.clock0) / n->rate;
+}
+
+static uint64_t node_local(const node_t *n, double global)
+{
+    return (uint64_t)llround((double)n->cfg.clock0 + global * n->rate);
+}
+
+static double rng_uniform(uwb_sim_t *sim)
+{
+    // xorshift64*
+    sim->rng ^= sim->rng >> 12;
+    sim->rng ^= sim->rng << 25;
+    sim->rng ^= sim->rng >> 27;
+    return (double)((sim->rng * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+static double rng_gauss(uwb_sim_t *sim)
+{
+    double u1 = rng_uniform(sim), u2 = rng_uniform(sim);
+
+    if (u1 < 1e-300)
+    {
+        u1 = 1e-300;
+    }
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static double node_distance(const node_t *a, const node_t *b)
+{
+    double dx = a->cfg.x - b->cfg.x, dy = a->cfg.y - b->cfg.y, dz = a->cfg.z - b->cfg.z;
+
+    return sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+/****************************************************************************************************************************************************
+ *
+ * Scheduling
+ *
+ ****************************************************************************************************************************************************/
+
+/* Device time at which the node has to run next */
+static uint64_t node_wake(const node_t *n)
+{
+    uint64_t now, ev;
+
+    if (n->done)
+    {
+        return DW1000_EMU_NO_EVENT;
+    }
+    if (!n->started)
+    {
+        return n->target;
+    }
+
+    now = dw1000_emu_time(n->emu);
+    ev = dw1000_emu_next_event(n->emu);
+    if (n->poll_period != 0)
+    {
+        // First read of the busy wait that ends after the event
+        if (ev == DW1000_EMU_NO_EVENT)
+        {
+            return DW1000_EMU_NO_EVENT;
+        }
+        if (ev <= now)
+        {
+            return now + n->poll_period;
+        }
+        return now + ((ev - now + n->poll_period - 1) / n->poll_period) * n->poll_period;
+    }
+    return (ev < n->target) ? ev : n->target;
+}
+
+static double node_wake_global(const node_t *n)
+{
+    uint64_t w = node_wake(n);
+
+    return (w == DW1000_EMU_NO_EVENT) ? HUGE_VAL : node_global(n, w);
+}
+
+static double others_min(const uwb_sim_t *sim, const node_t *self)
+{
+    double m = HUGE_VAL;
+    int i;
+
+    for (i = 0; i < sim->n_nodes; i++)
+    {
+        const node_t *n = &sim->nodes[i];
+        double w;
+
+        if (n == self)
+        {
+            continue;
+        }
+        w = node_wake_global(n);
+        if (w < m)
+        {
+            m = w;
+        }
+    }
+    return m;
+}
+
+/* Block the calling node until its target is reached, or for a busy wait, until the read that sees a change, or when
+ * idle, until its IRQ line rises */
+static void node_wait(uwb_sim_t *sim, node_t *n)
+{
+    for (;;)
+    {
+        uint64_t w = node_wake(n);
+        double g = (w == DW1000_EMU_NO_EVENT) ? HUGE_VAL : node_global(n, w);
+
+        if (g <= sim->end && g <= others_min(sim, n))
+        {
+            if (g > sim->now)
+            {
+                sim->now = g;
+            }
+            dw1000_emu_advance_to(n->emu, w);
+            if (n->poll_period != 0 || dw1000_emu_time(n->emu) >= n->target ||
+                (n->idle && dw1000_emu_irq_level(n->emu)))
+            {
+                return;
+            }
+        }
+        else
+        {
+            swapcontext(&n->ctx, &sim->main_ctx);
+        }
+    }
+}
+
+static void node_main(void)
+{
+    uwb_sim_t *sim = active_sim;
+    node_t *n = sim->current;
+
+    n->cfg.entry(n->cfg.arg);
+    n->done = 1;
+}
+
+/****************************************************************************************************************************************************
+ *
+ * Emulator and port hooks
+ *
+ ****************************************************************************************************************************************************/
+
+static void on_spi_access(void *ctx, dw1000_emu_t *emu, uint32 bytes)
+{
+    node_t *n = (node_t *)ctx;
+    uwb_sim_t *sim = n->sim;
+    uint64_t dur = dw1000_emu_spi_duration(emu, bytes);
+    uint64_t t0 = dw1000_emu_time(emu);
+
+    if (sim->current != n)
+    {
+        dw1000_emu_advance(emu, dur);   // accessed from outside the simulation
+        return;
+    }
+
+    if (dw1000_emu_idle_polls(emu) > 0 && dur != 0)
+    {
+        uint64_t reads;
+
+        n->poll_period = dur;
+        n->target = DW1000_EMU_NO_EVENT;
+        node_wait(sim, n);
+        n->poll_period = 0;
+        reads = (dw1000_emu_time(emu) - t0) / dur;
+        if (reads > 1)
+        {
+            sim->report.skipped_polls += (uint32)(reads - 1);
+        }
+    }
+    else
+    {
+        n->target = t0 + dur;
+        node_wait(sim, n);
+    }
+}
+
+static void on_tx_frame(void *ctx, dw1000_emu_t *emu, const dw1000_emu_frame_t *f)
+{
+    node_t *x = (node_t *)ctx;
+    uwb_sim_t *sim = x->sim;
+    const uwb_sim_channel_t *ch = &sim->channel;
+    double g_rmarker = node_global(x, f->rmarker);
+    int i;
+
+    (void)emu;
+    sim->report.frames++;
+    if (f->dataRate < 3)
+    {
+        sim->report.rate_frames[f->dataRate]++;
+    }
+    sim->report.airtime += (double)(f->end - f->start) * DWT_TIME_UNITS;
+    if (x->cfg.initiator && f->length > FUNC_CODE_IDX &&
+        (f->data[FUNC_CODE_IDX] == POLL_FUNC_CODE || f->data[FUNC_CODE_IDX] == SS_POLL_FUNC_CODE ||
+         f->data[FUNC_CODE_IDX] == BCAST_POLL_FUNC_CODE))
+    {
+        poll_t *p = &sim->polls[++sim->report.polls % POLL_HISTORY];
+
+        p->start = node_global(x, f->start);
+        p->poller = (int)(x - sim->nodes);
+        p->open = 1;
+        sim->last_poller = p->poller;
+    }
+    if (f->length > SEQ_NUM_IDX)
+    {
+        x->frame_poll[f->data[SEQ_NUM_IDX]] = sim->report.polls;
+    }
+
+    for (i = 0; i < sim->n_nodes; i++)
+    {
+        node_t *y = &sim->nodes[i];
+        dw1000_emu_frame_t rf;
+        double d, power, error_s = 0.0, arrival;
+        uint64_t rmarker;
+
+        if (y == x || !y->started || y->done)
+        {
+            continue;
+        }
+
+        d = node_distance(x, y);
+        if (ch->link != NULL)
+        {
+            if (!ch->link(ch->link_ctx, (int)(x - sim->nodes), i, d, &power, &error_s))
+            {
+                sim->report.dropped++;
+                continue;
+            }
+        }
+        else
+        {
+            power = ch->tx_power_dbm - ch->ref_loss_db - 10.0 * ch->loss_exponent * log10((d > 0.1) ? d : 0.1);
+            if (power < ch->sensitivity_dbm + ((f->dataRate < 3) ? ch->rate_loss_db[f->dataRate] : 0.0) ||
+                rng_uniform(sim) < ch->loss_probability)
+            {
+                sim->report.dropped++;
+                continue;
+            }
+            error_s = rng_gauss(sim) * ch->range_noise_m / SPEED_OF_LIGHT;
+        }
+
+        arrival = g_rmarker + x->cfg.antenna_delay + (d / SPEED_OF_LIGHT + error_s) / DWT_TIME_UNITS + y->cfg.antenna_delay;
+        rmarker = node_local(y, arrival);
+
+        rf = *f;
+        rf.rmarker = rmarker;
+        rf.start = rmarker - (f->rmarker - f->start);
+        rf.end = rmarker + (f->end - f->rmarker);
+        rf.rxPower = power;
+        rf.fpPower = power - 2.0;
+        rf.clockOffset = x->rate / y->rate - 1.0;
+        rf.corrupt = 0;
+        dw1000_emu_receive(y->emu, &rf);
+        sim->report.deliveries++;
+    }
+}
+
+static void on_delay(void *ctx, uint32 ms)
+{
+    uwb_sim_t *sim = (uwb_sim_t *)ctx;
+    node_t *n = sim->current;
+
+    if (n == NULL)
+    {
+        return;
+    }
+    n->target = dw1000_emu_time(n->emu) + (uint64_t)ms * DW1000_EMU_DTU_PER_MS;
+    node_wait(sim, n);
+}
+
+static void on_idle(void *ctx)
+{
+    uwb_sim_t *sim = (uwb_sim_t *)ctx;
+    node_t *n = sim->current;
+
+    if (n == NULL)
+    {
+        return;
+    }
+    n->target = DW1000_EMU_NO_EVENT;
+    n->idle = 1;
+    node_wait(sim, n);
+    n->idle = 0;
+}
+
+/* A distance reported by the current node at simulation time t, of the exchange of poll n, 0 if not known */
+static void on_distance(uwb_sim_t *sim, double t, char label, double distance, uint32 n)
+{
+    poll_t *p = (n != 0 && sim->report.polls - n < POLL_HISTORY) ? &sim->polls[n % POLL_HISTORY] : NULL;
+    int poller = (p != NULL) ? p->poller : sim->last_poller;
+    int i;
+
+    // The first report of an exchange completes it
+    sim->report.reports++;
+    if (p != NULL && p->open)
+    {
+        double latency = (t - p->start) * DWT_TIME_UNITS;
+
+        p->open = 0;
+        sim->report.completed++;
+        sim->latency_sum += latency;
+        if (sim->report.completed == 1 || latency < sim->report.latency_min)
+        {
+            sim->report.latency_min = latency;
+        }
+        if (latency > sim->report.latency_max)
+        {
+            sim->report.latency_max = latency;
+        }
+    }
+
+    // Compare with the geometry
+    if (label == 0 || poller < 0)
+    {
+        return;
+    }
+    for (i = 0; i < sim->n_nodes; i++)
+    {
+        if (sim->nodes[i].cfg.label == label)
+        {
+            double err = distance - node_distance(&sim->nodes[poller], &sim->nodes[i]);
+
+            sim->report.ranged++;
+            sim->error_sum += err;
+            sim->error_sq_sum += err * err;
+            break;
+        }
+    }
+}
+
+/* Poll of the exchange of a range report, 0 if not known. r->exchange is the sequence number of the frame the distance
+ * was computed from: the tag's final for a DS anchor, the anchor's response for an SS tag. A relay is sent after its
+ * exchange, maybe after the next poll, so it does not tell the exchange. */
+static uint32 report_poll(uwb_sim_t *sim, const twr_range_report_t *r)
+{
+    int i;
+
+    if (r->kind == TWR_RPT_KIND_DS)
+    {
+        return (sim->last_poller >= 0) ? sim->nodes[sim->last_poller].frame_poll[r->exchange] : 0;
+    }
+    for (i = 0; i < sim->n_nodes && r->kind == TWR_RPT_KIND_SS; i++)
+    {
+        if (sim->nodes[i].cfg.label == (char)r->anchor)
+        {
+            return sim->nodes[i].frame_poll[r->exchange];
+        }
+    }
+    return 0;
+}
+
+static void on_range_report(void *ctx, const twr_range_report_t *r)
+{
+    uwb_sim_t *sim = (uwb_sim_t *)ctx;
+    node_t *n = sim->current;
+    double t = node_global(n, dw1000_emu_time(n->emu));
+    char line[LINE_MAX_LEN];
+    int len;
+
+    if (sim->line_cb != NULL)
+    {
+        len = snprintf(line, sizeof(line), "DIST %c: %.3f m (report %u, exchange %u)\r\n", r->anchor,
+                       r->distance_mm / 1000.0, (unsigned)r->seq, (unsigned)r->exchange);
+        sim->line_cb(sim->line_ctx, (int)(n - sim->nodes), t * DWT_TIME_UNITS, line, (uint16)len);
+    }
+    on_distance(sim, t, (char)r->anchor, r->distance_mm / 1000.0, report_poll(sim, r));
+}
+
+static void on_telemetry(void *ctx, const twr_telemetry_report_t *t)
+{
+    node_t *n = (node_t *)ctx;
+    int i;
+
+    n->event_samples++;
+    n->event_ms += t->period_ms;
+    for (i = 0; i < TWR_RPT_TM_NUM_COUNTS; i++)
+    {
+        n->events[i] += t->counts[i];
+    }
+}
+
+static uint8 on_cdc(void *ctx, const uint8 *buf, uint16 len)
+{
+    uwb_sim_t *sim = (uwb_sim_t *)ctx;
+    node_t *n = sim->current;
+    char line[LINE_MAX_LEN];
+    double t;
+
+    if (n == NULL)
+    {
+        return USBD_OK;
+    }
+    t = node_global(n, dw1000_emu_time(n->emu));
+
+    // One transfer at a time per node
+    if (t < n->usb_free)
+    {
+        sim->report.usb_busy++;
+        return USBD_BUSY;
+    }
+    n->usb_free = t + sim->usb_transfer;
+    sim->report.usb_transfers++;
+    sim->report.usb_bytes += len;
+
+    // Binary range reports, or text lines of the examples not using the ranging engine
+    if (n->reports.len > 0 || (len > 0 && buf[0] == TWR_RPT_SYNC0))
+    {
+        if (sim->stream_cb != NULL)
+        {
+            sim->stream_cb(sim->stream_ctx, (int)(n - sim->nodes), buf, len);
+        }
+        twr_report_decode(&n->reports, buf, len, on_range_report, sim);
+        return USBD_OK;
+    }
+
+    len = (uint16)strnlen((const char *)buf, len);
+    if (len >= LINE_MAX_LEN)
+    {
+        len = LINE_MAX_LEN - 1;
+    }
+    memcpy(line, buf, len);
+    line[len] = '\0';
+
+    if (sim->line_cb != NULL)
+    {
+        sim->line_cb(sim->line_ctx, (int)(n - sim->nodes), t * DWT_TIME_UNITS, line, len);
+    }
+
+    // "DIST A: 1.23 m", other DIST lines only complete the exchange. A line is of the last poll.
+    if (strncmp(line, "DIST", 4) == 0)
+    {
+        if (line[4] == ' ' && line[5] != '\0' && line[6] == ':')
+        {
+            on_distance(sim, t, line[5], strtod(&line[7], NULL), sim->report.polls);
+        }
+        else
+        {
+            on_distance(sim, t, 0, 0.0, sim->report.polls);
+        }
+    }
+    return USBD_OK;
+}
+
+/****************************************************************************************************************************************************
+ *
+ * Public API
+ *
+ ****************************************************************************************************************************************************/
+
+void uwb_sim_channel_defaults(uwb_sim_channel_t *channel)
+{
+    memset(channel, 0, sizeof(*channel));
+    channel->tx_power_dbm = -14.3;
+    channel->ref_loss_db = 44.5;        // free space at 3.99 GHz
+    channel->loss_exponent = 2.0;
+    channel->sensitivity_dbm = -100.0;
+    channel->rate_loss_db[DWT_BR_850K] = 3.0;
+    channel->rate_loss_db[DWT_BR_6M8] = 10.0;
+    channel->loss_probability = 0.0;
+    channel->range_noise_m = 0.05;
+    channel->seed = 1;
+}
+
+uwb_sim_t *uwb_sim_create(const uwb_sim_channel_t *channel)
+{
+    uwb_sim_t *sim = (uwb_sim_t *)calloc(1, sizeof(*sim));
+
+    if (sim == NULL)
+    {
+        return NULL;
+    }
+    if (channel != NULL)
+    {
+        sim->channel = *channel;
+    }
+    else
+    {
+        uwb_sim_channel_defaults(&sim->channel);
+    }
+    sim->rng = 0x9E3779B97F4A7C15ULL ^ sim->channel.seed;
+    sim->last_poller = -1;
+    sim->usb_transfer = USB_TRANSFER_S / DWT_TIME_UNITS;
+    return sim;
+}
+
+void uwb_sim_destroy(uwb_sim_t *sim)
+{
+    int i;
+
+    if (sim == NULL)
+    {
+        return;
+    }
+    if (active_sim == sim)
+    {
+        host_port_attach(NULL);
+        host_port_set_hooks(NULL);
+        active_sim = NULL;
+    }
+    for (i = 0; i < sim->n_nodes; i++)
+    {
+        dw1000_emu_destroy(sim->nodes[i].emu);
+        free(sim->nodes[i].stack);
+    }
+    free(sim);
+}
+
+int uwb_sim_add_node(uwb_sim_t *sim, const uwb_sim_node_cfg_t *cfg)
+{
+    node_t *n;
+    dw1000_emu_hooks_t hooks;
+
+    if (sim->n_nodes >= UWB_SIM_MAX_NODES || cfg->entry == NULL)
+    {
+        return -1;
+    }
+    n = &sim->nodes[sim->n_nodes];
+    memset(n, 0, sizeof(*n));
+    n->sim = sim;
+    n->cfg = *cfg;
+    n->rate = 1.0 + cfg->ppm * 1e-6;
+    n->emu = dw1000_emu_create();
+    n->stack = malloc(UWB_SIM_STACK_SIZE);
+    if (n->emu == NULL || n->stack == NULL)
+    {
+        dw1000_emu_destroy(n->emu);
+        free(n->stack);
+        return -1;
+    }
+
+    memset(&hooks, 0, sizeof(hooks));
+    hooks.tx_frame = on_tx_frame;
+    hooks.spi_access = on_spi_access;
+    hooks.ctx = n;
+    dw1000_emu_set_hooks(n->emu, &hooks);
+    n->reports.telemetry_cb = on_telemetry;
+    n->reports.telemetry_ctx = n;
+
+    // The node starts at cfg->start, or now if that has passed
+    dw1000_emu_set_time(n->emu, node_local(n, sim->now));
+    n->target = node_local(n, (cfg->start / DWT_TIME_UNITS > sim->now) ? cfg->start / DWT_TIME_UNITS : sim->now);
+
+    return sim->n_nodes++;
+}
+
+void uwb_sim_set_usb_transfer(uwb_sim_t *sim, double seconds)
+{
+    sim->usb_transfer = seconds / DWT_TIME_UNITS;
+}
+
+void uwb_sim_set_line_cb(uwb_sim_t *sim, uwb_sim_line_cb_t cb, void *ctx)
+{
+    sim->line_cb = cb;
+    sim->line_ctx = ctx;
+}
+
+void uwb_sim_set_stream_cb(uwb_sim_t *sim, uwb_sim_stream_cb_t cb, void *ctx)
+{
+    sim->stream_cb = cb;
+    sim->stream_ctx = ctx;
+}
+
+void uwb_sim_run(uwb_sim_t *sim, double seconds)
+{
+    host_port_hooks_t port_hooks;
+    struct timespec t0, t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    active_sim = sim;
+    memset(&port_hooks, 0, sizeof(port_hooks));
+    port_hooks.delay = on_delay;
+    port_hooks.cdc = on_cdc;
+    port_hooks.idle = on_idle;
+    port_hooks.ctx = sim;
+    host_port_set_hooks(&port_hooks);
+
+    sim->end = sim->now + seconds / DWT_TIME_UNITS;
+    for (;;)
+    {
+        node_t *next = NULL;
+        double best = HUGE_VAL;
+        int i;
+
+        for (i = 0; i < sim->n_nodes; i++)
+        {
+            double w = node_wake_global(&sim->nodes[i]);
+
+            if (w < best)
+            {
+                best = w;
+                next = &sim->nodes[i];
+            }
+        }
+        if (next == NULL || best > sim->end)
+        {
+            break;
+        }
+        if (best > sim->now)
+        {
+            sim->now = best;
+        }
+
+        sim->current = next;
+        host_port_attach(next->emu);
+        if (dwt_setlocaldataptr((unsigned int)(next - sim->nodes)) != DWT_SUCCESS)
+        {
+            dwt_setlocaldataptr(0);     // driver built for fewer devices, the nodes share its state
+        }
+        if (twr_report_select((unsigned int)(next - sim->nodes)) != DWT_SUCCESS)
+        {
+            twr_report_select(0);
+        }
+        TWR_TRACE_SELECT((unsigned int)(next - sim->nodes));
+        if (!next->started)
+        {
+            next->started = 1;
+            dw1000_emu_advance_to(next->emu, next->target);
+            getcontext(&next->ctx);
+            next->ctx.uc_stack.ss_sp = next->stack;
+            next->ctx.uc_stack.ss_size = UWB_SIM_STACK_SIZE;
+            next->ctx.uc_link = &sim->main_ctx;
+            makecontext(&next->ctx, node_main, 0);
+        }
+        swapcontext(&sim->main_ctx, &next->ctx);
+        sim->current = NULL;
+    }
+    sim->now = sim->end;
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    sim->report.wall_time += (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) * 1e-9;
+}
+
+void uwb_sim_move_node(uwb_sim_t *sim, int node, double x, double y, double z)
+{
+    if (node >= 0 && node < sim->n_nodes)
+    {
+        sim->nodes[node].cfg.x = x;
+        sim->nodes[node].cfg.y = y;
+        sim->nodes[node].cfg.z = z;
+    }
+}
+
+double uwb_sim_time(const uwb_sim_t *sim)
+{
+    return sim->now * DWT_TIME_UNITS;
+}
+
+dw1000_emu_t *uwb_sim_node_emu(uwb_sim_t *sim, int node)
+{
+    return (node >= 0 && node < sim->n_nodes) ? sim->nodes[node].emu : NULL;
+}
+
+void uwb_sim_get_report(const uwb_sim_t *sim, uwb_sim_report_t *report)
+{
+    dw1000_emu_stats_t stats;
+    int i;
+
+    *report = sim->report;
+    report->spi_transactions = 0;
+    report->report_errors = 0;
+    for (i = 0; i < sim->n_nodes; i++)
+    {
+        dw1000_emu_get_stats(sim->nodes[i].emu, &stats);
+        report->spi_transactions += stats.spi_transactions;
+        report->report_errors += sim->nodes[i].reports.errors;
+    }
+    report->sim_time = sim->now * DWT_TIME_UNITS;
+    report->success_rate = (report->polls != 0) ? (double)report->completed / report->polls : 0.0;
+    report->latency_mean = (report->completed != 0) ? sim->latency_sum / report->completed : 0.0;
+    if (report->ranged != 0)
+    {
+        double mean = sim->error_sum / report->ranged;
+        double var = sim->error_sq_sum / report->ranged - mean * mean;
+
+        report->error_mean = mean;
+        report->error_std = (var > 0.0) ? sqrt(var) : 0.0;
+    }
+}
+
+void uwb_sim_print_report(const uwb_sim_t *sim, FILE *out)
+{
+    uwb_sim_report_t r;
+    const node_t *n;
+    const uint32 *e;
+    int i;
+
+    uwb_sim_get_report(sim, &r);
+    fprintf(out, "simulated %.3f s in %.3f s wall time\n", r.sim_time, r.wall_time);
+    fprintf(out, "exchanges: %lu polls, %lu completed, success %.1f %%, %.0f exchanges/s wall time\n",
+            (unsigned long)r.polls, (unsigned long)r.completed, 100.0 * r.success_rate,
+            (r.wall_time > 0.0) ? r.polls / r.wall_time : 0.0);
+    fprintf(out, "latency: mean %.3f ms, min %.3f ms, max %.3f ms\n",
+            r.latency_mean * 1e3, r.latency_min * 1e3, r.latency_max * 1e3);
+    fprintf(out, "distance error: %lu of %lu reports, mean %.3f m, std %.3f m\n",
+            (unsigned long)r.ranged, (unsigned long)r.reports, r.error_mean, r.error_std);
+    fprintf(out, "frames: %lu sent, %lu delivered, %lu dropped\n",
+            (unsigned long)r.frames, (unsigned long)r.deliveries, (unsigned long)r.dropped);
+    fprintf(out, "air: %.1f ms, %lu frames at 110 kb/s, %lu at 850 kb/s, %lu at 6.8 Mb/s\n", r.airtime * 1e3,
+            (unsigned long)r.rate_frames[DWT_BR_110K], (unsigned long)r.rate_frames[DWT_BR_850K],
+            (unsigned long)r.rate_frames[DWT_BR_6M8]);
+    fprintf(out, "spi: %lu transactions, busy wait reads skipped: %lu\n",
+            (unsigned long)r.spi_transactions, (unsigned long)r.skipped_polls);
+    fprintf(out, "usb: %lu transfers, %lu bytes, %.2f reports per transfer, %lu busy, %lu bad report bytes\n",
+            (unsigned long)r.usb_transfers, (unsigned long)r.usb_bytes,
+            (r.usb_transfers != 0) ? (double)r.reports / r.usb_transfers : 0.0,
+            (unsigned long)r.usb_busy, (unsigned long)r.report_errors);
+    for (i = 0; i < sim->n_nodes; i++)
+    {
+        n = &sim->nodes[i];
+        if (n->event_samples == 0)
+        {
+            continue;
+        }
+        e = n->events;
+        fprintf(out, "events %s: %.1f s, crc good %lu bad %lu, phr errors %lu, sync loss %lu, timeouts preamble %lu "
+                "sfd %lu frame %lu, overruns %lu, sent %lu\n",
+                n->cfg.name, n->event_ms / 1000.0, (unsigned long)e[TWR_RPT_TM_CRCG], (unsigned long)e[TWR_RPT_TM_CRCB],
+                (unsigned long)e[TWR_RPT_TM_PHE], (unsigned long)e[TWR_RPT_TM_RSL], (unsigned long)e[TWR_RPT_TM_PTO],
+                (unsigned long)e[TWR_RPT_TM_SFDTO], (unsigned long)e[TWR_RPT_TM_RTO], (unsigned long)e[TWR_RPT_TM_OVER],
+                (unsigned long)e[TWR_RPT_TM_TXF]);
+    }
+}
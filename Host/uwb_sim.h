@@ -0,0 +1,161 @@
+/*! ----------------------------------------------------------------------------
+ * @file    uwb_sim.h
+ * @brief   Discrete event simulation of several DW1000 nodes sharing the air
+ *
+ *          Each node is a DW1000 emulator (dw1000_emu.h) with its own clock,
+ *          crystal offset, antenna delay and position. Each node runs unmodified
+ *          application code, e.g. ds_twr_init() or twr_resp_9m_1(), as a coroutine.
+ *          A node runs until its code touches the SPI bus or calls HAL_Delay().
+ *          It then yields. The node furthest behind in time always runs next, so
+ *          every frame reaches the other receivers before they pass its arrival
+ *          time.
+ *
+ *          Frames go through a propagation and loss model: log-distance path
+ *          loss, a sensitivity limit that depends on the data rate, random loss
+ *          and Gaussian timestamp noise. A user callback can replace the model.
+ *
+ *          Busy waiting on SYS_STATUS is skipped up to the next radio event. The
+ *          skip is rounded to whole polls, so the code sees the change at the
+ *          same time as it would on the board. This is what keeps thousands of
+ *          exchanges per second of wall time possible.
+ *
+ *          Each node has its own driver state (dwt_setlocaldataptr()) when the
+ *          driver is built with DWT_NUM_DW_DEV >= UWB_SIM_MAX_NODES, otherwise
+ *          the nodes share it. Nodes that install dwt_isr() callbacks need
+ *          their own. The same goes for the range report queues of
+ *          twr_report.c and TWR_REPORT_NUM_STREAMS.
+ *
+ *          Poll frames (function code 0x21, 0x22 or 0xE0) sent by initiator nodes
+ *          start an exchange. The first range report (see twr_report.h) of the
+ *          exchange, found from the sequence number of the frame it was computed
+ *          from, completes it, even if the report was held in a batch past later
+ *          polls. The first "DIST" line sent with CDC_Transmit_FS() after a poll
+ *          completes that poll. The USB
+ *          of each node takes one transfer per millisecond (see
+ *          uwb_sim_set_usb_transfer()), CDC_Transmit_FS() returns USBD_BUSY in
+ *          between.
+ *
+ *          The report prints the DW1000 event counts of the nodes that send
+ *          telemetry frames (see twr_telemetry.h), added up over the run.
+ */
+
+#ifndef UWB_SIM_H_
+#define UWB_SIM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "deca_types.h"
+#include "dw1000_emu.h"
+
+#define UWB_SIM_MAX_NODES       (16)
+#define UWB_SIM_STACK_SIZE      (256 * 1024)
+
+typedef struct uwb_sim uwb_sim_t;
+
+typedef void (*uwb_sim_entry_t)(void *arg);
+
+typedef struct
+{
+    const char     *name;
+    char            label;          // anchor of the range reports ("DIST <label>:") about this node, 0 if none
+    uint8           initiator;      // poll frames from this node start exchanges
+    double          x, y, z;        // position, m
+    double          ppm;            // crystal offset, parts per million
+    uint64_t        clock0;         // device time at simulation time 0, DTU
+    uint16          antenna_delay;  // physical TX and RX antenna delay each, DTU
+    double          start;          // simulation time at which the code starts, s
+    uwb_sim_entry_t entry;          // application code, never needs to return
+    void           *arg;
+} uwb_sim_node_cfg_t;
+
+typedef struct
+{
+    double          tx_power_dbm;   // total transmit power
+    double          ref_loss_db;    // path loss at 1 m
+    double          loss_exponent;  // log-distance path loss exponent
+    double          sensitivity_dbm;// 110 kb/s frames weaker than this are not detected
+    double          rate_loss_db[3];// sensitivity lost at each data rate, DWT_BR_110K / DWT_BR_850K / DWT_BR_6M8
+    double          loss_probability; // random frame loss on every link
+    double          range_noise_m;  // standard deviation of the arrival time noise, in metres
+    uint32          seed;
+
+    /* Optional replacement of the model above: return 0 to drop the frame, else fill the received power and
+     * the arrival time error (s) of the link */
+    int           (*link)(void *ctx, int from, int to, double distance, double *rx_power_dbm, double *error_s);
+    void           *link_ctx;
+} uwb_sim_channel_t;
+
+typedef struct
+{
+    uint32          polls;          // exchanges started
+    uint32          completed;      // polls followed by a report before the next poll
+    uint32          reports;        // range reports and DIST lines, relayed ones included
+    double          success_rate;   // completed / polls
+    double          latency_mean;   // from the start of the poll to its first report, s
+    double          latency_min;
+    double          latency_max;
+    uint32          ranged;         // reports about a labelled node
+    double          error_mean;     // reported minus true distance, m
+    double          error_std;
+    uint32          frames;         // frames sent
+    uint32          rate_frames[3]; // of which at each data rate
+    double          airtime;        // time on air of the frames sent, s
+    uint32          deliveries;     // frames offered to a receiver
+    uint32          dropped;        // frames lost on a link (sensitivity or random loss)
+    uint32          skipped_polls;  // busy wait reads not executed
+    uint32          spi_transactions; // SPI transactions executed by all nodes
+    uint32          usb_transfers;  // CDC_Transmit_FS() calls accepted
+    uint32          usb_bytes;
+    uint32          usb_busy;       // CDC_Transmit_FS() calls refused, previous transfer in flight
+    uint32          report_errors;  // bytes of the report streams that were not part of a good frame
+    double          sim_time;       // s
+    double          wall_time;      // s
+} uwb_sim_report_t;
+
+/* Called for every line sent with CDC_Transmit_FS(), and for every range report as a "DIST" line, t is the simulation
+ * time in s */
+typedef void (*uwb_sim_line_cb_t)(void *ctx, int node, double t, const char *line, uint16 len);
+
+/* Called for every transfer of binary reports, as the PC receives them */
+typedef void (*uwb_sim_stream_cb_t)(void *ctx, int node, const uint8 *buf, uint16 len);
+
+/* Channel defaults: channel 2 free space, -14.3 dBm, -100 dBm sensitivity at 110 kb/s (-97 dBm at 850 kb/s, -90 dBm
+ * at 6.8 Mb/s), no random loss, 5 cm noise */
+void            uwb_sim_channel_defaults(uwb_sim_channel_t *channel);
+
+uwb_sim_t      *uwb_sim_create(const uwb_sim_channel_t *channel);
+void            uwb_sim_destroy(uwb_sim_t *sim);
+
+/* Returns the node index, -1 if there is no room */
+int             uwb_sim_add_node(uwb_sim_t *sim, const uwb_sim_node_cfg_t *cfg);
+
+void            uwb_sim_set_line_cb(uwb_sim_t *sim, uwb_sim_line_cb_t cb, void *ctx);
+void            uwb_sim_set_stream_cb(uwb_sim_t *sim, uwb_sim_stream_cb_t cb, void *ctx);
+
+/* Time a node's USB takes to complete a CDC transfer, default 1 ms. A slow PC makes the reports queue up. */
+void            uwb_sim_set_usb_transfer(uwb_sim_t *sim, double seconds);
+
+/* Move a node, e.g. from its own code between exchanges */
+void            uwb_sim_move_node(uwb_sim_t *sim, int node, double x, double y, double z);
+
+/* Run the simulation for a further 'seconds' of simulated time */
+void            uwb_sim_run(uwb_sim_t *sim, double seconds);
+
+/* Current simulation time, s */
+double          uwb_sim_time(const uwb_sim_t *sim);
+
+dw1000_emu_t   *uwb_sim_node_emu(uwb_sim_t *sim, int node);
+
+void            uwb_sim_get_report(const uwb_sim_t *sim, uwb_sim_report_t *report);
+void            uwb_sim_print_report(const uwb_sim_t *sim, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UWB_SIM_H_ */